@@ -92,6 +92,9 @@ Collector::Collector()
         man = new Manager(exporter);
         listenPort = config_space::DEFAULT_LISTEN_PORT;
         receiverType = config_space::DEFAULT_TRANSPORT_PROTO;
+        listenerThreads = config_space::DEFAULT_LISTENER_THREADS;
+        receiveBufferSize = 0;
+        zeroCopy = false;
 	recorder = new RecorderOff();
 }
 
@@ -197,10 +200,21 @@ void Collector::readDetectionModules(XMLConfObj* config)
 					args.push_back(config->getValue());
 				    } while(config->selectNextNodeIfExists(config_space::ARG));
 				}
+				/* module reads the flow records decoded by the collector instead of the raw packets */
+				bool decodedRecords = false;
+				if (config->nodeExists(config_space::DECODED_RECORDS)) {
+				    tmp = config->getValue(config_space::DECODED_RECORDS);
+				    if (tmp == "yes") {
+					decodedRecords = true;
+				    } else if (tmp != "no") {
+					throw exceptions::ConfigError("Bad value for <" + config_space::DECODED_RECORDS
+						+ "> of a module. Expecting \"yes\" or \"no\"");
+				    }
+				}
 				if (run == "yes") {
-				    man->addDetectionModule(filename, configFile, args, Manager::start);
+				    man->addDetectionModule(filename, configFile, args, Manager::start, decodedRecords);
 				} else if (run == "no") {
-				    man->addDetectionModule(filename, configFile, args, Manager::dontStart);
+				    man->addDetectionModule(filename, configFile, args, Manager::dontStart, decodedRecords);
 				} else {
 				    throw exceptions::ConfigError("Bad value for <" + config_space::RUN
 					    + ">. Expecting \"yes\" or \"no\"");
@@ -228,6 +242,21 @@ void Collector::readMisc(XMLConfObj* config)
 		msg(MSG_INFO, "No port specified, taking default port %i", listenPort);
 	}
 
+	/* number of threads listening on the port */
+	if (config->nodeExists(config_space::LISTENER_THREADS)) {
+		listenerThreads = atoi(config->getValue(config_space::LISTENER_THREADS).c_str());
+		if (listenerThreads < 1) {
+			throw exceptions::ConfigError("<" + config_space::LISTENER_THREADS + "> must be at least 1");
+		}
+		msg(MSG_INFO, "Using %i listener threads", listenerThreads);
+	}
+
+	/* socket receive buffer size */
+	if (config->nodeExists(config_space::RECEIVE_BUFFER_SIZE)) {
+		receiveBufferSize = atoi(config->getValue(config_space::RECEIVE_BUFFER_SIZE).c_str());
+		msg(MSG_INFO, "Socket receive buffer size: %i bytes", receiveBufferSize);
+	}
+
 	/* killtime */
 	if (config->nodeExists(config_space::KILL_TIME)) {
 		tmp = config->getValue(config_space::KILL_TIME);
@@ -281,6 +310,17 @@ void Collector::readExchangeProtocol(XMLConfObj* config)
 		} else {
 			throw exceptions::ConfigError("No tmp directory for IPFIX-files specified");
 		}
+		/* append packets to preallocated segment files instead of one file per packet */
+		if (config->nodeExists(config_space::SPOOL_SEGMENTS)) {
+			unsigned segments = atoi(config->getValue(config_space::SPOOL_SEGMENTS).c_str());
+			size_t segmentSize = config_space::DEFAULT_SPOOL_SEGMENT_SIZE;
+			if (config->nodeExists(config_space::SPOOL_SEGMENT_SIZE)) {
+				segmentSize = atoi(config->getValue(config_space::SPOOL_SEGMENT_SIZE).c_str());
+			}
+			exporter->setExportingStyle(DetectModExporter::USE_SPOOL);
+			exporter->setSpool(segments, segmentSize);
+			msg(MSG_INFO, "Using spool with %u segments of %u bytes", segments, (unsigned)segmentSize);
+		}
 		config->leaveNode();
 	} else if (type == config_space::EP_SHM) {
 		config->enterNode(config_space::EXCHANGE_PROTOCOL);
@@ -293,6 +333,36 @@ void Collector::readExchangeProtocol(XMLConfObj* config)
 		} else {
 			throw exceptions::ConfigError("No shm size for IPFIX-storage specified");
 		}
+		/* wait for all modules after every packet or let them read at their own pace */
+		if (config->nodeExists(config_space::DELIVERY)) {
+			tmp = config->getValue(config_space::DELIVERY);
+			if (tmp == config_space::DELIVERY_ASYNC) {
+				exporter->setAsyncDelivery(true);
+				msg(MSG_INFO, "Asynchronous delivery to the detection modules turned on");
+			} else if (tmp != config_space::DELIVERY_SYNC) {
+				throw exceptions::ConfigError("Bad value for configuration item \"" +
+							      config_space::DELIVERY + "\"\n Posibilities are " +
+							      config_space::DELIVERY_SYNC + " or " +
+							      config_space::DELIVERY_ASYNC);
+			}
+		}
+		/* receive the packets directly into the shared memory ring */
+		if (config->nodeExists(config_space::ZERO_COPY)) {
+			tmp = config->getValue(config_space::ZERO_COPY);
+			if (tmp == "yes") {
+				zeroCopy = true;
+			} else if (tmp != "no") {
+				throw exceptions::ConfigError("Bad value for configuration item \"" +
+							      config_space::ZERO_COPY +
+							      "\"\n Posibilities are yes or no");
+			}
+		}
+		/* parse the packets once and publish the decoded records to the modules */
+		if (config->nodeExists(config_space::DECODED_RECORDS)) {
+			unsigned recordSize = atoi(config->getValue(config_space::DECODED_RECORDS).c_str());
+			exporter->setDecoding(recordSize);
+			msg(MSG_INFO, "Publishing decoded flow records to the detection modules");
+		}
 		config->leaveNode();
 	}
 }
@@ -413,9 +483,25 @@ void Collector::run()
 		initializeIpfixCollectors();
 		IpfixCollector* ipfixCollector = createIpfixCollector();
 
-		IpfixReceiver* ipfixReceiver = createIpfixReceiver(receiverType, listenPort);
+		IpfixReceiver* ipfixReceiver = createIpfixReceiverGroup(receiverType, listenPort,
+									listenerThreads, receiveBufferSize);
+		if (!ipfixReceiver) {
+			throw std::runtime_error("Collector: Could not create IPFIX receiver");
+		}
 		addIpfixReceiver(ipfixCollector, ipfixReceiver);
 
+		if (zeroCopy) {
+			bufferProvider.handle = NULL;
+			bufferProvider.acquireBuffers = Collector::acquireBuffers;
+			bufferProvider.releaseBuffers = Collector::releaseBuffers;
+			bufferProvider.bufferLength = config_space::ZERO_COPY_SLOT_SIZE;
+			if (0 == setBufferProvider(ipfixReceiver, &bufferProvider)) {
+				msg(MSG_INFO, "Receiving packets directly into the shared memory ring");
+			} else {
+				msg(MSG_ERROR, "Collector: Zero copy receiving not possible, copying packets into the shared memory ring");
+			}
+		}
+
 		msg(MSG_INFO, "Initializing PacketProcessor");
 		IpfixPacketProcessor* packetProcessor = createIpfixPacketProcessor();
 		packetProcessor->processPacketCallbackFunction = Collector::messageCallBackFunction;
@@ -466,6 +552,16 @@ int Collector::messageCallBackFunction(IpfixParser* ipfixParser, byte* data, uin
         return ret;
 }
 
+int Collector::acquireBuffers(void* /*handle*/, byte** buffers, int count, uint16_t length)
+{
+	return IpfixShm::reserveSlots(buffers, count, length);
+}
+
+void Collector::releaseBuffers(void* /*handle*/)
+{
+	IpfixShm::cancelSlots();
+}
+
 void Collector::sigInt(int /*sig*/) 
 {
         man->prepareShutdown();
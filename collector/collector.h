@@ -25,6 +25,7 @@
 
 #include <concentrator/ipfix.h>
 #include <concentrator/rcvIpfix.h>
+#include <concentrator/ipfixReceiver.h>
 #include <commonutils/metering.h>
 
 
@@ -150,6 +151,13 @@ public:
          */
         static int messageCallBackFunction(IpfixParser*, byte* data, uint16_t len);
 
+        /**
+         * Buffer provider functions for the IPFIX receiver. Lets the receiver read
+         * the packets directly into slots of the shared memory ring (zero copy).
+         */
+        static int acquireBuffers(void* handle, byte** buffers, int count, uint16_t length);
+        static void releaseBuffers(void* handle);
+
         /**
          * Signal handler for signal SIGINT.
          * The function initiates cleanup process.
@@ -160,6 +168,10 @@ public:
 
         int listenPort;
         Receiver_Type receiverType;
+        int listenerThreads;
+        int receiveBufferSize;
+        bool zeroCopy;
+        IpfixBufferProvider bufferProvider;
 };
 
 #endif
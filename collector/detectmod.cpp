@@ -33,7 +33,7 @@
 
 
 DetectMod::DetectMod(const std::string& filename)
-	: busy(false)
+	: shmConsumer(-1), recordConsumer(-1), decodedRecords(false), busy(false), busySince(0)
 {
         this->filename = filename;
         /* Initial semahore key. We will try to find an unsed semaphore >= the initial value. */
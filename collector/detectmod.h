@@ -25,6 +25,7 @@
 
 
 #include <sys/types.h>
+#include <time.h>
 
 
 #include <string>
@@ -113,6 +114,43 @@ public:
          */
         key_t getShmKey() const { return shmKey; }
 
+        /**
+         * Sets the consumer slot within the shared memory ring
+         * @param c consumer slot, -1 if there is none
+         */
+        void setShmConsumer(int c) { shmConsumer = c; }
+
+        /**
+         * Returns the consumer slot within the shared memory ring
+         * @return consumer slot, -1 if there is none
+         */
+        int getShmConsumer() const { return shmConsumer; }
+
+        /**
+         * Sets the consumer slot within the decoded flow record ring
+         * @param c consumer slot, -1 if there is none
+         */
+        void setRecordConsumer(int c) { recordConsumer = c; }
+
+        /**
+         * Returns the consumer slot within the decoded flow record ring
+         * @return consumer slot, -1 if there is none
+         */
+        int getRecordConsumer() const { return recordConsumer; }
+
+        /**
+         * Sets if the module reads the flow records decoded by the collector
+         * instead of the raw packets. It only gets a slot within that ring.
+         * @param b true if the module reads decoded records
+         */
+        void setReadsDecodedRecords(bool b) { decodedRecords = b; }
+
+        /**
+         * Returns if the module reads the flow records decoded by the collector
+         * @return true if the module reads decoded records
+         */
+        bool readsDecodedRecords() const { return decodedRecords; }
+
         /**
          * Returns pipe descriptor
          * @return pipe descriptor
@@ -150,7 +188,11 @@ public:
 	 * @param busy is module busy or not
 	 * @return void
 	 */
-	void setBusyState(bool busy) { this->busy = busy; }
+	void setBusyState(bool busy) {
+		if (busy && !this->busy)
+			busySince = time(NULL);
+		this->busy = busy;
+	}
 	
 	/**
 	 * Get busy state.
@@ -158,13 +200,23 @@ public:
 	 */
 	bool getBusyState() { return busy; }
 
+	/**
+	 * Returns the time the module became busy.
+	 * @return time of the last notification the module did not answer yet
+	 */
+	time_t getBusySince() const { return busySince; }
+
 private:
         pid_t pid;
         std::string filename;
         key_t semKey;
         int semId;
         key_t shmKey;
+        int shmConsumer;
+        int recordConsumer;
+        bool decodedRecords;
         bool busy;
+        time_t busySince;
         int pipeFd;
 
         std::vector<std::string> arguments;
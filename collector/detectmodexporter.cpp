@@ -20,6 +20,7 @@
 #include "manager.h"
 #include "detectmod.h"
 #include "modulecontainer.h"
+#include "flowdecoder.h"
 
 
 #include <concentrator/rcvIpfix.h>
@@ -43,7 +44,7 @@
 
 
 DetectModExporter::DetectModExporter()
-	: nps(NULL), exchangeStyle(USE_FILES)
+	: nps(NULL), exchangeStyle(USE_FILES), asyncDelivery(false), decoder(NULL)
 {
         nps = new shared::SharedObj();
         shmKey = nps->getShmKey();
@@ -53,14 +54,15 @@ DetectModExporter::DetectModExporter()
 DetectModExporter::~DetectModExporter()
 {
         delete nps; nps = 0;
+        delete decoder; decoder = 0;
 }
 
 int DetectModExporter::exportToSink(IpfixParser*, const byte* data, uint16_t len) {
 
         uint32_t sourceId = ntohl(*(uint32_t*)(data+12)); // see Ipfix-Protocol
 
+	static shared::FileCounter counter;
 	if (exchangeStyle == USE_FILES) {
-                static shared::FileCounter counter;
                 static IpfixFile* ipfixFile = NULL;
                 static int filesize = strlen(packetDir.c_str()) + 30;
                 static char* filename = new char[filesize];
@@ -73,7 +75,20 @@ int DetectModExporter::exportToSink(IpfixParser*, const byte* data, uint16_t len
                         return -1;
                 }
                 counter++;
+	} else if (exchangeStyle == USE_SPOOL) {
+		IpfixSpool* ipfixSpool = IpfixSpool::writePacket((unsigned)counter, data, len);
+		if (ipfixSpool) {
+			ipfixPacketStore.pushIpfixPacket(sourceId, ipfixSpool);
+		} else {
+			return -1;
+		}
+		counter++;
 	} else {
+		/* template sets are always decoded, the records are only published
+		   if at least one module reads them */
+		if (decoder) {
+			decoder->decode(data, len, FlowRecordShm::hasConsumers());
+		}
                 static IpfixShm* ipfixShm = NULL;
                 ipfixShm = IpfixShm::writePacket(data, len);
                 if (ipfixShm) {
@@ -87,6 +102,41 @@ int DetectModExporter::exportToSink(IpfixParser*, const byte* data, uint16_t len
 
 void DetectModExporter::installNotification(DetectMod& detectMod) const {
         detectMod.setShmKey(shmKey);
+	if (exchangeStyle == USE_SHARED_MEMORY) {
+		/* a restarted module starts reading at the current ring position.
+		   The module gets a slot only within the ring it reads, the slots
+		   are ours: the module never frees them */
+		IpfixShm::unregisterConsumer(detectMod.getShmConsumer());
+		detectMod.setShmConsumer(-1);
+		FlowRecordShm::unregisterConsumer(detectMod.getRecordConsumer());
+		detectMod.setRecordConsumer(-1);
+		if (decoder && detectMod.readsDecodedRecords()) {
+			detectMod.setRecordConsumer(FlowRecordShm::registerConsumer());
+			if (detectMod.getRecordConsumer() == -1) {
+				msg(MSG_ERROR, "DetectModExporter: No free flow record consumer slot for %s",
+				    detectMod.getFileName().c_str());
+			}
+		} else {
+			if (detectMod.readsDecodedRecords()) {
+				msg(MSG_ERROR, "DetectModExporter: %s reads decoded records, but the collector "
+				    "doesn't decode the packets. Passing raw packets", detectMod.getFileName().c_str());
+			}
+			detectMod.setShmConsumer(IpfixShm::registerConsumer());
+			if (detectMod.getShmConsumer() == -1) {
+				msg(MSG_ERROR, "DetectModExporter: No free shared memory consumer slot for %s",
+				    detectMod.getFileName().c_str());
+			}
+		}
+	}
+}
+
+void DetectModExporter::removeNotification(DetectMod& detectMod) const {
+	if (exchangeStyle == USE_SHARED_MEMORY) {
+		IpfixShm::unregisterConsumer(detectMod.getShmConsumer());
+		detectMod.setShmConsumer(-1);
+		FlowRecordShm::unregisterConsumer(detectMod.getRecordConsumer());
+		detectMod.setRecordConsumer(-1);
+	}
 }
 
 
@@ -152,7 +202,43 @@ int DetectModExporter::wait(DetectMod* module)
 
 void DetectModExporter::clearSink()
 {
-	ipfixPacketStore.popIpfixPacket(0, nps->to() - nps->from());
+	if (asyncDelivery) {
+		/* space in the ring is reclaimed by the modules read positions,
+		   so we only need to forget about the packets */
+		PacketStats ps = ipfixPacketStore.getPacketStats(0);
+		ipfixPacketStore.popIpfixPacket(0, ps.newest - ps.oldest);
+	} else {
+		ipfixPacketStore.popIpfixPacket(0, nps->to() - nps->from());
+	}
+}
+
+bool DetectModExporter::isIdle(DetectMod* module)
+{
+	if (!module->getBusyState()) {
+		return true;
+	}
+
+	/* the module decrements its semaphore to 0 after processing the data */
+	int val = semctl(module->getSemId(), 0, GETVAL);
+	if (-1 == val) {
+		msg(MSG_ERROR, "Manager: Error reading semaphore of %s: %s",
+		    module->getFileName().c_str(), strerror(errno));
+		return false;
+	}
+	if (val == 0) {
+		module->setBusyState(false);
+		return true;
+	}
+	return false;
+}
+
+uint64_t DetectModExporter::getLag(const DetectMod* module) const
+{
+	if (exchangeStyle != USE_SHARED_MEMORY) {
+		return 0;
+	}
+	/* a module has a slot within only one of the rings, the other one lags 0 */
+	return IpfixShm::getLag(module->getShmConsumer()) + FlowRecordShm::getLag(module->getRecordConsumer());
 }
 
 
@@ -165,8 +251,10 @@ void DetectModExporter::sendInitData(const DetectMod& detectMod, const std::stri
         ss << detectMod.getSemKey() << " " << detectMod.getShmKey() << " ";
 	if (exchangeStyle == USE_FILES) {
 		ss << "USE_FILES ";
+	} else if (exchangeStyle == USE_SPOOL) {
+		ss << "USE_SPOOL ";
 	} else {
-		ss << "USE_SHM ";
+		ss << "USE_SHM " << detectMod.getShmConsumer() << " " << detectMod.getRecordConsumer() << " ";
 	}
         tmp =  ss.str();
         write(detectMod.getPipeFd(), tmp.c_str(), tmp.size());
@@ -197,7 +285,15 @@ void DetectModExporter::setExportingStyle(ExchangeStyle e)
 	exchangeStyle = e;
 }
 
-void DetectModExporter::setSharedMemorySize(size_t size)
+void DetectModExporter::setAsyncDelivery(bool async)
+{
+	if (async && exchangeStyle != USE_SHARED_MEMORY) {
+		throw exceptions::ConfigError("Asynchronous delivery is only available with shared memory exchange");
+	}
+	asyncDelivery = async;
+}
+
+byte* DetectModExporter::allocateSharedMemory(size_t size, key_t& key)
 {
 	int keyNo = 1;
 	bool searchFreeKey = true;
@@ -215,14 +311,44 @@ void DetectModExporter::setSharedMemorySize(size_t size)
 			searchFreeKey = 0;
 	} while (searchFreeKey);
 
-	nps->setStorageKey(keyNo);
-	nps->setStorageSize(size);
-
 	void* shmPtr = shmat(id, NULL, 0);
 	if ((void*)-1 == shmPtr) {
 		throw std::runtime_error(std::string("DetectModExporter: Could not attach shared memory storage area: ") + strerror(errno));
 	}
 
-	IpfixShm::setShmPointer((byte*)shmPtr);
-	IpfixShm::setShmSize(size);
+	key = keyNo;
+	return (byte*)shmPtr;
+}
+
+void DetectModExporter::setSharedMemorySize(size_t size)
+{
+	key_t key;
+	byte* shmPtr = allocateSharedMemory(size, key);
+
+	nps->setStorageKey(key);
+	nps->setStorageSize(size);
+
+	IpfixShm::createRing(shmPtr, size);
+}
+
+void DetectModExporter::setDecoding(size_t size)
+{
+	if (exchangeStyle != USE_SHARED_MEMORY) {
+		throw exceptions::ConfigError("Decoding within the collector is only available with shared memory exchange");
+	}
+
+	key_t key;
+	byte* shmPtr = allocateSharedMemory(size, key);
+
+	nps->setRecordKey(key);
+	nps->setRecordSize(size);
+
+	FlowRecordShm::createRing(shmPtr, size);
+	delete decoder;
+	decoder = new FlowDecoder();
+}
+
+void DetectModExporter::setSpool(unsigned segments, size_t segmentSize)
+{
+	IpfixSpool::createSpool(packetDir, segments, segmentSize);
 }
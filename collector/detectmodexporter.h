@@ -26,6 +26,7 @@
 
 class ModuleContainer;
 class DetectMod;
+class FlowDecoder;
 
 
 /**
@@ -37,14 +38,17 @@ public:
 	/**
 	 * Defines exporting style.
 	 *
-	 * There are two existing exchange styles. The first (USE_FILES) will
+	 * There are three existing exchange styles. The first (USE_FILES) will
 	 * exchange IPFIX Packets via a file system (most likely on a RAM-Disk).
 	 * The second exchange method uses a shared memory block to copy the data
-	 * to the modules.
+	 * to the modules. The third (USE_SPOOL) also uses the file system, but
+	 * appends the packets to a few preallocated segment files instead of
+	 * creating one file per packet.
 	 */
 	typedef enum {
 		USE_FILES,
-		USE_SHARED_MEMORY
+		USE_SHARED_MEMORY,
+		USE_SPOOL
 	} ExchangeStyle;
 
 
@@ -76,6 +80,21 @@ public:
 	 */
 	void clearSink();
 
+	/**
+	 * Checks whether the module finished processing the data it was
+	 * notified about. Never blocks.
+	 * @param module Module to check
+	 * @return true if the module can be notified again
+	 */
+	bool isIdle(DetectMod* module);
+
+	/**
+	 * Returns the number of bytes the module still has to read from the
+	 * shared memory ring. Always 0 when using files.
+	 * @param module Module to check
+	 */
+	uint64_t getLag(const DetectMod* module) const;
+
         /**
 	 * Informes one detection module about new incoming data. The method does not
 	 * guaranty that the module got the notification.
@@ -95,6 +114,12 @@ public:
 	 */
         void installNotification(DetectMod& detectMod) const;
 
+	/**
+	 * Releases all resources needed for notifying a module which
+	 * is about to be removed.
+	 */
+        void removeNotification(DetectMod& detectMod) const;
+
 	/**
 	 * Sends the information about semaphores and the shared memory
 	 * object to all modules.
@@ -112,13 +137,49 @@ public:
 	void setSharedMemorySize(size_t size);
 
 	/**
-	 * sets exporting style. This can be either DetectModExporter::USE_FILES
-	 * or DetectModExporter::USE_SHARED_MEMORY
+	 * Turns on decoding within the collector. Every packet is parsed once
+	 * and its records are published as @c FlowRecord objects within a second
+	 * shared memory ring. Modules can read these records instead of parsing
+	 * the packets themselves. Only available with USE_SHARED_MEMORY.
+	 * @param size size of the shared memory block for the record ring
+	 */
+	void setDecoding(size_t size);
+
+	/**
+	 * Creates the spool segment files within the packet directory. The
+	 * packet directory has to be set before.
+	 * @param segments number of segment files
+	 * @param segmentSize size of every segment file
+	 */
+	void setSpool(unsigned segments, size_t segmentSize);
+
+	/**
+	 * sets exporting style. This can be either DetectModExporter::USE_FILES,
+	 * DetectModExporter::USE_SHARED_MEMORY or DetectModExporter::USE_SPOOL
 	 * @param e the exporting style
 	 */
 	void setExportingStyle(ExchangeStyle e);
 
+	/**
+	 * Turns asynchronous delivery on or off. With asynchronous delivery
+	 * the manager does not wait for the modules. Every module reads at its
+	 * own pace from the shared memory ring. Only available with
+	 * USE_SHARED_MEMORY.
+	 * @param async true to turn asynchronous delivery on
+	 */
+	void setAsyncDelivery(bool async);
+
+	bool isAsyncDelivery() const { return asyncDelivery; }
+
 private:
+	/**
+	 * Allocates and attaches a new shared memory block.
+	 * @param size size of the block
+	 * @param key will contain the key of the block
+	 * @return start of the attached block
+	 */
+	static byte* allocateSharedMemory(size_t size, key_t& key);
+
         IpfixPacketStore ipfixPacketStore;
 
         key_t shmKey;
@@ -129,6 +190,9 @@ private:
         std::string packetDir;
 
 	ExchangeStyle exchangeStyle;
+	bool asyncDelivery;
+
+	FlowDecoder* decoder;
 };
 
 #endif
@@ -0,0 +1,183 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#include "flowdecoder.h"
+
+
+#include <commonutils/packetstats.h>
+#include <concentrator/msg.h>
+
+
+#include <string.h>
+
+
+FlowDecoder::FlowDecoder()
+	: packetProcessor(NULL), publish(true)
+{
+	CallbackInfo cbi;
+	memset(&cbi, 0, sizeof(CallbackInfo));
+
+	cbi.handle = this;
+	cbi.templateCallbackFunction = templateArrived;
+	cbi.dataTemplateCallbackFunction = dataTemplateArrived;
+	cbi.dataRecordCallbackFunction = dataRecordArrived;
+	cbi.dataDataRecordCallbackFunction = dataDataRecordArrived;
+	cbi.templateDestructionCallbackFunction = templateDestroyed;
+	cbi.dataTemplateDestructionCallbackFunction = dataTemplateDestroyed;
+
+	IpfixParser* ipfixParser = createIpfixParser();
+	addIpfixParserCallbacks(ipfixParser, cbi);
+
+	packetProcessor = createIpfixPacketProcessor();
+	setIpfixParser(packetProcessor, ipfixParser);
+
+	records.reserve(FlowRecordShm::MAX_RECORDS);
+}
+
+FlowDecoder::~FlowDecoder()
+{
+	if (packetProcessor)
+		destroyIpfixPacketProcessor(packetProcessor);
+}
+
+void FlowDecoder::decode(const byte* data, uint16_t len, bool publishRecords)
+{
+	publish = publishRecords;
+	/* the parser doesn't modify the packet */
+	packetProcessor->processPacketCallbackFunction(packetProcessor->ipfixParser, (byte*)data, len);
+	flush();
+}
+
+void FlowDecoder::flush()
+{
+	if (records.empty())
+		return;
+	/* errors are reported by FlowRecordShm, the records are lost */
+	FlowRecordShm::writeRecords(&records[0], records.size());
+	records.clear();
+}
+
+void FlowDecoder::addControl(uint8_t type, SourceID sourceID, uint16_t templateId)
+{
+	if (!publish)
+		return;
+	if (records.size() == FlowRecordShm::MAX_RECORDS)
+		flush();
+	records.resize(records.size() + 1);
+	FlowRecord& r = records.back();
+	r.clear(type);
+	r.sourceId = sourceID;
+	r.templateId = templateId;
+}
+
+void FlowDecoder::addRecord(SourceID sourceID, const Plan* plan, const FieldInfo* fieldInfo, FieldData* data,
+			    const FieldInfo* dataInfo, FieldData* fixedData)
+{
+	if (!publish)
+		return;
+	if (records.size() == FlowRecordShm::MAX_RECORDS)
+		flush();
+	records.resize(records.size() + 1);
+	FlowRecord& r = records.back();
+	r.clear();
+	r.sourceId = sourceID;
+	r.templateId = plan->templateId;
+	for (unsigned i = 0; i != plan->columns.size(); ++i) {
+		const Plan::Column& c = plan->columns[i];
+		if (c.fixed) {
+			r.setField(c.field, fixedData + dataInfo[c.index].offset, dataInfo[c.index].type.length);
+		} else {
+			r.setField(c.field, data + fieldInfo[c.index].offset, fieldInfo[c.index].type.length);
+		}
+	}
+}
+
+void FlowDecoder::Plan::addColumns(const FieldInfo* fieldInfo, uint16_t fieldCount, bool fixed)
+{
+	for (uint16_t i = 0; i < fieldCount; ++i) {
+		int field = FlowRecord::fieldForType(fieldInfo[i].type.id);
+		if (field >= 0 && fieldInfo[i].type.eid == 0) {
+			Column c;
+			c.field = field;
+			c.index = i;
+			c.fixed = fixed;
+			columns.push_back(c);
+		}
+	}
+}
+
+int FlowDecoder::templateArrived(void* handle, SourceID sourceID, TemplateInfo* ti)
+{
+	FlowDecoder* decoder = static_cast<FlowDecoder*>(handle);
+	Plan* plan = new Plan();
+	plan->templateId = ti->templateId;
+	plan->addColumns(ti->fieldInfo, ti->fieldCount, false);
+	ti->userData = plan;
+	decoder->addControl(FlowRecord::TEMPLATE_ADDED, sourceID, ti->templateId);
+	return 0;
+}
+
+int FlowDecoder::dataTemplateArrived(void* handle, SourceID sourceID, DataTemplateInfo* ti)
+{
+	FlowDecoder* decoder = static_cast<FlowDecoder*>(handle);
+	Plan* plan = new Plan();
+	plan->templateId = ti->id;
+	plan->addColumns(ti->fieldInfo, ti->fieldCount, false);
+	plan->addColumns(ti->dataInfo, ti->dataCount, true);
+	ti->userData = plan;
+	decoder->addControl(FlowRecord::TEMPLATE_ADDED, sourceID, ti->id);
+	return 0;
+}
+
+int FlowDecoder::templateDestroyed(void* handle, SourceID sourceID, TemplateInfo* ti)
+{
+	FlowDecoder* decoder = static_cast<FlowDecoder*>(handle);
+	delete static_cast<Plan*>(ti->userData);
+	ti->userData = 0;
+	decoder->addControl(FlowRecord::TEMPLATE_DESTROYED, sourceID, ti->templateId);
+	return 0;
+}
+
+int FlowDecoder::dataTemplateDestroyed(void* handle, SourceID sourceID, DataTemplateInfo* ti)
+{
+	FlowDecoder* decoder = static_cast<FlowDecoder*>(handle);
+	delete static_cast<Plan*>(ti->userData);
+	ti->userData = 0;
+	decoder->addControl(FlowRecord::TEMPLATE_DESTROYED, sourceID, ti->id);
+	return 0;
+}
+
+int FlowDecoder::dataRecordArrived(void* handle, SourceID sourceID, TemplateInfo* ti,
+				   uint16_t, FieldData* data)
+{
+	FlowDecoder* decoder = static_cast<FlowDecoder*>(handle);
+	if (!ti->userData) {
+		templateArrived(handle, sourceID, ti);
+	}
+	decoder->addRecord(sourceID, static_cast<Plan*>(ti->userData), ti->fieldInfo, data, (FieldInfo*)0, (FieldData*)0);
+	return 0;
+}
+
+int FlowDecoder::dataDataRecordArrived(void* handle, SourceID sourceID, DataTemplateInfo* ti,
+				       uint16_t, FieldData* data)
+{
+	FlowDecoder* decoder = static_cast<FlowDecoder*>(handle);
+	if (!ti->userData) {
+		dataTemplateArrived(handle, sourceID, ti);
+	}
+	decoder->addRecord(sourceID, static_cast<Plan*>(ti->userData), ti->fieldInfo, data, ti->dataInfo, ti->data);
+	return 0;
+}
@@ -0,0 +1,97 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#ifndef _FLOW_DECODER_H_
+#define _FLOW_DECODER_H_
+
+
+#include <concentrator/rcvIpfix.h>
+#include <commonutils/flowrecord.h>
+
+
+#include <vector>
+
+
+/**
+ * Parses the incoming IPFIX packets once within the collector and publishes
+ * the data records as normalized @c FlowRecord objects via @c FlowRecordShm.
+ * Template changes are published as control records within the same stream.
+ * Detection modules reading the records don't need a parser or a template
+ * buffer of their own.
+ */
+class FlowDecoder {
+public:
+	FlowDecoder();
+	~FlowDecoder();
+
+	/**
+	 * Decodes all data records of a packet and publishes them.
+	 * Template sets are always processed, otherwise the records of later
+	 * packets couldn't be decoded.
+	 * @param data IPFIX packet
+	 * @param len length of the packet
+	 * @param publishRecords false if nobody reads the records, only templates are processed
+	 */
+	void decode(const byte* data, uint16_t len, bool publishRecords = true);
+
+private:
+	/**
+	 * Fields of a template that have a counterpart within @c FlowRecord.
+	 * Compiled once per template and stored in the templates userData field.
+	 */
+	struct Plan {
+		struct Column {
+			uint16_t field;
+			uint16_t index;  /**< index into fieldInfo or dataInfo */
+			bool fixed;      /**< true if the field is a fixed field of a data template (dataInfo) */
+		};
+		uint16_t templateId;
+		std::vector<Column> columns;
+
+		void addColumns(const FieldInfo* fieldInfo, uint16_t fieldCount, bool fixed);
+	};
+
+	static int templateArrived(void* handle, SourceID sourceID, TemplateInfo* ti);
+	static int dataTemplateArrived(void* handle, SourceID sourceID, DataTemplateInfo* ti);
+	static int templateDestroyed(void* handle, SourceID sourceID, TemplateInfo* ti);
+	static int dataTemplateDestroyed(void* handle, SourceID sourceID, DataTemplateInfo* ti);
+	static int dataRecordArrived(void* handle, SourceID sourceID, TemplateInfo* ti,
+				     uint16_t, FieldData* data);
+	static int dataDataRecordArrived(void* handle, SourceID sourceID, DataTemplateInfo* ti,
+					 uint16_t, FieldData* data);
+
+	/**
+	 * Appends a control record announcing a template change.
+	 */
+	void addControl(uint8_t type, SourceID sourceID, uint16_t templateId);
+
+	/**
+	 * Decodes a data record and appends it to the records of the current packet.
+	 */
+	void addRecord(SourceID sourceID, const Plan* plan, const FieldInfo* fieldInfo, FieldData* data,
+		       const FieldInfo* dataInfo, FieldData* fixedData);
+
+	/**
+	 * Publishes all records collected so far.
+	 */
+	void flush();
+
+	IpfixPacketProcessor* packetProcessor;
+	std::vector<FlowRecord> records;  /**< records of the current packet */
+	bool publish;                     /**< false if the records of the current packet are dropped */
+};
+
+#endif
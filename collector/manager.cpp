@@ -31,6 +31,7 @@
 #include <signal.h>
 #include <errno.h>
 #include <pthread.h>
+#include <time.h>
 
 #include <fstream>
 
@@ -40,6 +41,11 @@ DetectModExporter* Manager::exporter = 0;
 bool Manager::restartOnCrash = false;
 bool Manager::shutdown = false;
 
+/* seconds between two lag reports in asynchronous delivery mode */
+static const time_t LAG_LOG_INTERVAL = 10;
+/* microseconds between two looks at busy modules in asynchronous delivery mode */
+static const useconds_t ASYNC_POLL_INTERVAL = 1000;
+
 
 Manager::Manager(DetectModExporter* exporter)
         : killTime(config_space::DEFAULT_KILL_TIME)
@@ -81,7 +87,7 @@ Manager::~Manager()
 void Manager::addDetectionModule(const std::string& modulePath,
 				 const std::string& configFile,
 				 std::vector<std::string>& arguments,
-				 ModuleState s)
+				 ModuleState s, bool decodedRecords)
 {
         if (modulePath.size() == 0) {
                 msg(MSG_ERROR, "Manager: Got empty path to detection module");
@@ -96,9 +102,10 @@ void Manager::addDetectionModule(const std::string& modulePath,
 
 	arguments.insert(arguments.begin(), 1, configFile);
 	availableModules[modulePath] = arguments;
+	decodedRecordModules[modulePath] = decodedRecords;
 
 	if (s == start) {
-		runningModules.createModule(modulePath, arguments);
+		runningModules.createModule(modulePath, arguments, decodedRecords);
 	}
 }
 
@@ -200,13 +207,31 @@ void* Manager::run(void* data)
 	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
         
+	time_t lastLagLog = time(NULL);
 	while (!shutdown) {
-		man->lockMutex();
+		if (exporter->isAsyncDelivery() && runningModules.hasPendingData(exporter)) {
+			/* a module was busy when data arrived. It is only notified
+			   again when it is idle, so we can't wait for the next packet */
+			if (!man->tryLockMutex()) {
+				usleep(ASYNC_POLL_INTERVAL);
+			}
+		} else {
+			man->lockMutex();
+		}
 		
-		alarm(man->killTime);
-		runningModules.notifyAll(exporter);
-		exporter->clearSink();
-		alarm(0);
+		if (exporter->isAsyncDelivery()) {
+			runningModules.notifyIdle(exporter, man->killTime);
+			exporter->clearSink();
+			if (time(NULL) - lastLagLog >= LAG_LOG_INTERVAL) {
+				runningModules.logLag(exporter);
+				lastLagLog = time(NULL);
+			}
+		} else {
+			alarm(man->killTime);
+			runningModules.notifyAll(exporter);
+			exporter->clearSink();
+			alarm(0);
+		}
  
 #ifdef IDMEF_SUPPORT_ENABLED
                 for (unsigned i = 0; i != man->commObjs.size(); ++i) {
@@ -238,6 +263,11 @@ void Manager::lockMutex()
 	mutex.lock();
 }
 
+bool Manager::tryLockMutex() 
+{
+	return mutex.tryLock();
+}
+
 void Manager::unlockMutex() 
 {
 	mutex.unlock();
@@ -266,7 +296,7 @@ void Manager::update(XMLConfObj* xmlObj)
 			if (availableModules.find(filename) != availableModules.end()) {
 				msg(MSG_INFO, "Manager: starting module...");
 				availableModules[filename][0] = config_file;
-				runningModules.createModule(filename, availableModules[filename]);
+				runningModules.createModule(filename, availableModules[filename], decodedRecordModules[filename]);
 				runningModules.startModules(exporter);
 				sendControlMessage("<result oid=\"" + config_space::TOPAS + "-" + topasID + "\">Manager: module \"" + 
 						   filename + "\" started</result>");
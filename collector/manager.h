@@ -73,11 +73,12 @@ public:
 	 * @param modulePath Path to module executable
 	 * @param arguments Arguments that are passed to the module on startup.
 	 * @param s should a module be startet or not
+	 * @param decodedRecords module reads the flow records decoded by the collector
          */
         void addDetectionModule(const std::string& module_path,
 			        const std::string& configFile,
 			        std::vector<std::string>& arguments,
-				ModuleState s);
+				ModuleState s, bool decodedRecords = false);
 
         
         /**
@@ -92,6 +93,12 @@ public:
          */
         void lockMutex();
 
+        /**
+         * Locks the mutex if it is unlocked.
+         * @return true if the mutex was locked
+         */
+        bool tryLockMutex();
+
         /**
          * Unlocks the mutex. 
          */
@@ -123,6 +130,7 @@ private:
         static DetectModExporter* exporter;
 
 	std::map<std::string, std::vector<std::string> > availableModules;
+	std::map<std::string, bool> decodedRecordModules;
 
         unsigned killTime;
         static bool restartOnCrash;
@@ -23,6 +23,9 @@
 #include <concentrator/msg.h>
 
 
+#include <time.h>
+
+
 ModuleContainer::ModuleContainer()
 {
 
@@ -51,6 +54,7 @@ void ModuleContainer::restartCrashedModule(pid_t pid, DetectModExporter* exporte
         for (std::vector<DetectMod*>::iterator i = detectionModules.begin();
 	     i != detectionModules.end(); ++i) {
                 if (pid == (*i)->getPid()) {
+                        exporter->installNotification(*(*i));
                         (*i)->restartCrashed();
 #ifdef IDMEF_SUPPORT_ENABLED
                         exporter->sendInitData(*(*i), topasID);
@@ -93,10 +97,12 @@ void ModuleContainer::startModules(DetectModExporter* exporter)
 }
 
 
-void ModuleContainer::createModule(const std::string& command, const std::vector<std::string>& args)
+void ModuleContainer::createModule(const std::string& command, const std::vector<std::string>& args,
+				   bool decodedRecords)
 {
 	DetectMod* mod = new DetectMod(command);
 	mod->setArgs(args);
+	mod->setReadsDecodedRecords(decodedRecords);
 	mod->setState(DetectMod::NotRunning);
 	detectionModules.push_back(mod);
 }
@@ -114,18 +120,24 @@ void ModuleContainer::setState(pid_t pid, DetectMod::State state)
 	    "with pid %i", pid);
 }
 
-void ModuleContainer::notifyAll(DetectModExporter* exporter)
+void ModuleContainer::removeModules(DetectModExporter* exporter)
 {
-        /* this is the right place to remove no longer modules from the container */
         int i = 0;
         while (i < detectionModules.size()) {
                 if (detectionModules[i]->getState() == DetectMod::Remove) {
                         msg(MSG_INFO, "Finaly removing detection module!");
+                        exporter->removeNotification(*detectionModules[i]);
                         detectionModules.erase(detectionModules.begin() + i);
                         continue;
                 }
                 ++i;
         }
+}
+
+void ModuleContainer::notifyAll(DetectModExporter* exporter)
+{
+        /* this is the right place to remove no longer modules from the container */
+        removeModules(exporter);
 
         /* notify the modules */
 	for (std::vector<DetectMod*>::iterator i = detectionModules.begin();
@@ -141,6 +153,52 @@ void ModuleContainer::notifyAll(DetectModExporter* exporter)
 	}
 }
 
+void ModuleContainer::notifyIdle(DetectModExporter* exporter, unsigned killTime)
+{
+        removeModules(exporter);
+
+	time_t now = time(NULL);
+	for (std::vector<DetectMod*>::iterator i = detectionModules.begin();
+	     i != detectionModules.end(); ++i) {
+		if ((*i)->getState() != DetectMod::Running) {
+			continue;
+		}
+		if (exporter->isIdle(*i)) {
+			if (exporter->getLag(*i) > 0)
+				exporter->notify(*i);
+		} else if (killTime && now - (*i)->getBusySince() > (time_t)killTime) {
+			msg(MSG_ERROR, "Manager: %s seems to parse its data to slowly.",
+			    (*i)->getFileName().c_str());
+			(*i)->stopModule();
+		}
+	}
+}
+
+bool ModuleContainer::hasPendingData(DetectModExporter* exporter)
+{
+	for (std::vector<DetectMod*>::iterator i = detectionModules.begin();
+	     i != detectionModules.end(); ++i) {
+		if ((*i)->getState() != DetectMod::Running) {
+			continue;
+		}
+		if (!exporter->isIdle(*i) || exporter->getLag(*i) > 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void ModuleContainer::logLag(DetectModExporter* exporter)
+{
+	for (std::vector<DetectMod*>::iterator i = detectionModules.begin();
+	     i != detectionModules.end(); ++i) {
+		if ((*i)->getState() == DetectMod::Running) {
+			msg(MSG_DEBUG, "Manager: %s lags %llu bytes behind",
+			    (*i)->getFileName().c_str(), (unsigned long long)exporter->getLag(*i));
+		}
+	}
+}
+
 void ModuleContainer::findAndKillSlowModule()
 {
 	for (std::vector<DetectMod*>::iterator i = detectionModules.begin();
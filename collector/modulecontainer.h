@@ -55,8 +55,10 @@ public:
 	 * Creates new detection module
 	 * @param command path to the detection modules binary
 	 * @param args arguments passed to the detection modules
+	 * @param decodedRecords module reads the flow records decoded by the collector
 	 */
-	void createModule(const std::string& command, const std::vector<std::string>& args);
+	void createModule(const std::string& command, const std::vector<std::string>& args,
+			  bool decodedRecords = false);
                
 
         /**
@@ -98,6 +100,29 @@ public:
 	 */
 	void notifyAll(DetectModExporter* exporter);
 
+	/**
+	 * Informes all modules which finished their previous work and didn't
+	 * read all published data yet. This method never waits for a module. Modules which didn't
+	 * answer for more than killTime seconds will be killed.
+	 * @param exporter Exporter instance used to inform the modules.
+	 * @param killTime Seconds a module may stay busy. 0 disables killing.
+	 */
+	void notifyIdle(DetectModExporter* exporter, unsigned killTime);
+
+	/**
+	 * True if a module is still busy or didn't read all published data.
+	 * Such a module has to be notified again once it is idle, even if no
+	 * new packet arrives.
+	 * @param exporter Exporter instance the modules are attached to.
+	 */
+	bool hasPendingData(DetectModExporter* exporter);
+
+	/**
+	 * Logs how many bytes every module still has to read.
+	 * @param exporter Exporter instance the modules are attached to.
+	 */
+	void logLag(DetectModExporter* exporter);
+
 	/**
 	 * Checks all modules if they are busy. All found modules will be 
 	 * killed.
@@ -116,6 +141,11 @@ public:
 
 private:
         std::vector<DetectMod*> detectionModules;
+
+	/**
+	 * Finally removes modules with state DetectMod::Remove
+	 */
+	void removeModules(DetectModExporter* exporter);
 };
 
 #endif
@@ -0,0 +1,197 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#ifndef _FLOW_RECORD_H_
+#define _FLOW_RECORD_H_
+
+
+#include "../concentrator/rcvIpfix.h"
+#include "../concentrator/ipfix.h"
+
+
+#include <stdint.h>
+#include <string.h>
+
+
+/**
+ * Normalized flow record with a fixed layout. The collector decodes every
+ * IPFIX data record once into a FlowRecord and publishes the records to the
+ * detection modules (see @c FlowRecordShm), so the modules don't have to
+ * parse the IPFIX packets themselves.
+ *
+ * Besides flow records, the stream contains control records, which tell the
+ * modules that a template was added or destroyed (type TEMPLATE_ADDED or
+ * TEMPLATE_DESTROYED, only sourceId and templateId are set).
+ *
+ * Fields that were not contained in the data record are 0 and their bit
+ * (1 << field) in present is not set. Fields that were contained with a
+ * length they can't be decoded from are 0 as well, their bit is set in
+ * malformed instead.
+ */
+struct FlowRecord {
+	enum Type {
+		FLOW = 0,
+		TEMPLATE_ADDED,
+		TEMPLATE_DESTROYED
+	};
+
+	enum Field {
+		SRC_IP = 0,
+		DST_IP,
+		SRC_PORT,
+		DST_PORT,
+		PROTO,
+		PACKETS,
+		OCTETS,
+		FLOW_START,
+		FLOW_END,
+		FIELD_COUNT
+	};
+
+	uint8_t type;
+	uint8_t proto;
+	uint16_t present;       /**< bit (1 << field) is set if the field was contained in the record */
+	uint32_t sourceId;
+	uint32_t srcIp;         /**< network byte order */
+	uint32_t dstIp;         /**< network byte order */
+	uint16_t srcPort;       /**< host byte order */
+	uint16_t dstPort;       /**< host byte order */
+	uint16_t templateId;
+	uint16_t malformed;     /**< bit (1 << field) is set if the field had an unsupported length */
+	uint32_t flowStart;
+	uint32_t flowEnd;
+	uint64_t packets;
+	uint64_t octets;
+
+	/**
+	 * Maps an IPFIX field id to its field.
+	 * @return field number or -1 if the IPFIX field has no counterpart
+	 */
+	static int fieldForType(uint16_t id)
+	{
+		switch (id) {
+		case IPFIX_TYPEID_sourceIPv4Address:
+			return SRC_IP;
+		case IPFIX_TYPEID_destinationIPv4Address:
+			return DST_IP;
+		case IPFIX_TYPEID_sourceTransportPort:
+			return SRC_PORT;
+		case IPFIX_TYPEID_destinationTransportPort:
+			return DST_PORT;
+		case IPFIX_TYPEID_protocolIdentifier:
+			return PROTO;
+		case IPFIX_TYPEID_packetDeltaCount:
+			return PACKETS;
+		case IPFIX_TYPEID_octetDeltaCount:
+			return OCTETS;
+		case IPFIX_TYPEID_flowStartSeconds:
+			return FLOW_START;
+		case IPFIX_TYPEID_flowEndSeconds:
+			return FLOW_END;
+		default:
+			return -1;
+		}
+	}
+
+	/**
+	 * Resets all fields and sets the record type.
+	 */
+	void clear(uint8_t t = FLOW)
+	{
+		memset(this, 0, sizeof(FlowRecord));
+		type = t;
+	}
+
+	/**
+	 * Decodes an IPFIX field into the record.
+	 * Fields with unsupported lengths are marked as malformed.
+	 */
+	void setField(unsigned field, const byte* data, uint16_t length)
+	{
+		switch (field) {
+		case SRC_IP:
+			/* length 5 means ip address and netmask, we ignore the netmask */
+			if (length != 4 && length != 5)
+				goto malformed;
+			memcpy(&srcIp, data, 4);
+			break;
+		case DST_IP:
+			if (length != 4 && length != 5)
+				goto malformed;
+			memcpy(&dstIp, data, 4);
+			break;
+		case SRC_PORT:
+			if (length != 1 && length != 2)
+				goto malformed;
+			srcPort = (uint16_t)toInt(data, length);
+			break;
+		case DST_PORT:
+			if (length != 1 && length != 2)
+				goto malformed;
+			dstPort = (uint16_t)toInt(data, length);
+			break;
+		case PROTO:
+			if (length != 1)
+				goto malformed;
+			proto = *data;
+			break;
+		case PACKETS:
+			if (length == 0 || length > 8)
+				goto malformed;
+			packets = toInt(data, length);
+			break;
+		case OCTETS:
+			if (length == 0 || length > 8)
+				goto malformed;
+			octets = toInt(data, length);
+			break;
+		case FLOW_START:
+			if (length == 0 || length > 4)
+				goto malformed;
+			flowStart = (uint32_t)toInt(data, length);
+			break;
+		case FLOW_END:
+			if (length == 0 || length > 4)
+				goto malformed;
+			flowEnd = (uint32_t)toInt(data, length);
+			break;
+		default:
+			return;
+		}
+		present |= (1 << field);
+		return;
+	malformed:
+		malformed |= (1 << field);
+	}
+
+	bool hasField(Field field) const { return present & (1 << field); }
+
+	/**
+	 * Network byte order integer of 1 to 8 bytes (reduced size encoding) to host byte order.
+	 */
+	static uint64_t toInt(const byte* data, uint16_t length)
+	{
+		if (length > 8)
+			return 0;
+		uint64_t ret = 0;
+		for (uint16_t i = 0; i != length; ++i) {
+			ret = (ret << 8) | data[i];
+		}
+		return ret;
+	}
+};
+
+#endif
@@ -41,8 +41,11 @@ namespace config_space
         static const int MAX_PATH_SIZE = 30;
         
         static const unsigned MAX_FILES = 100000;
+        static const unsigned DEFAULT_SPOOL_SEGMENT_SIZE = 4*1024*1024;
+        static const unsigned ZERO_COPY_SLOT_SIZE = 2048;
 
         static const int DEFAULT_LISTEN_PORT = 4711;
+        static const int DEFAULT_LISTENER_THREADS = 1;
         static const Receiver_Type DEFAULT_TRANSPORT_PROTO = UDP_IPV4;
 
         /* entries in xml-files */
@@ -56,15 +59,24 @@ namespace config_space
 	static const std::string ARG="arg";
         static const std::string COLLECTOR_STRING="collector";
         static const std::string LISTEN_PORT="listenPort";
+        static const std::string LISTENER_THREADS="listenerThreads";
+        static const std::string RECEIVE_BUFFER_SIZE="receiveBufferSize";
         static const std::string KILL_TIME="detectmod_killtime";
         static const std::string RESTART_ON_CRASH="restartOnCrash";
         static const std::string PACKET_DIRECTORY="packetDir";
+        static const std::string SPOOL_SEGMENTS="spoolSegments";
+        static const std::string SPOOL_SEGMENT_SIZE="spoolSegmentSize";
 	static const std::string PLAYER="player";
 	static const std::string EXCHANGE_PROTOCOL="exchangeProtocol";
 	static const std::string EP_TYPE="type";
 	static const std::string EP_FILES="files";
 	static const std::string EP_SHM="shm";
 	static const std::string SHMSIZE="shmSize";
+	static const std::string DELIVERY="delivery";
+	static const std::string DELIVERY_SYNC="sync";
+	static const std::string DELIVERY_ASYNC="async";
+	static const std::string ZERO_COPY="zeroCopy";
+	static const std::string DECODED_RECORDS="decodedRecords";
 	static const std::string TRAFFIC_DIR="trafficDir";
 	static const std::string ACTION="action";
 	static const std::string RECORD="record";
@@ -50,19 +50,19 @@ void MsgStream::printIntro(MsgLevel level)
 {
     switch(level){
 	case FATAL:
-	    std::cout << "FATAL [" << name << "]: ";
+	    printTarget() << "FATAL [" << name << "]: ";
 	    break;
 	case ERROR:
-	    std::cout << "ERROR [" << name << "]: ";
+	    printTarget() << "ERROR [" << name << "]: ";
 	    break;
 	case WARN:
-	    std::cout << "WARNING [" << name << "]: ";
+	    printTarget() << "WARNING [" << name << "]: ";
 	    break;
 	case INFO:
-	    std::cout << "INFORMATION [" << name << "]: ";
+	    printTarget() << "INFORMATION [" << name << "]: ";
 	    break;
 	case DEBUG:
-	    std::cout << "DEBUG [" << name << "]: ";
+	    printTarget() << "DEBUG [" << name << "]: ";
 	    break;
     }
 }
@@ -71,19 +71,19 @@ void MsgStream::logIntro(MsgLevel level)
 {
     switch(level){
 	case FATAL:
-	    logfile << "FATAL [" << name << "]: ";
+	    logTarget() << "FATAL [" << name << "]: ";
 	    break;
 	case ERROR:
-	    logfile << "ERROR [" << name << "]: ";
+	    logTarget() << "ERROR [" << name << "]: ";
 	    break;
 	case WARN:
-	    logfile << "WARNING [" << name << "]: ";
+	    logTarget() << "WARNING [" << name << "]: ";
 	    break;
 	case INFO:
-	    logfile << "INFORMATION [" << name << "]: ";
+	    logTarget() << "INFORMATION [" << name << "]: ";
 	    break;
 	case DEBUG:
-	    logfile << "DEBUG [" << name << "]: ";
+	    logTarget() << "DEBUG [" << name << "]: ";
 	    break;
     }
 }
@@ -93,12 +93,12 @@ void MsgStream::print(MsgLevel level, const std::string& msg)
   if(level <= outputLevel)
   {
     printIntro(level);
-    std::cout << msg << std::endl;
+    printTarget() << msg << std::endl;
   }
-  if(level <= logLevel)
+  if(level <= logLevel && logOpen())
   {
     logIntro(level);
-    logfile << msg << std::endl;
+    logTarget() << msg << std::endl;
   }
 }
 
@@ -106,11 +106,28 @@ void MsgStream::rawPrint(MsgLevel level, const std::string& msg)
 {
   if(level <= outputLevel)
   {
-    std::cout << msg << std::endl;
+    printTarget() << msg << std::endl;
   }
-  if(level <= logLevel)
+  if(level <= logLevel && logOpen())
   {
-    logfile << msg << std::endl;
+    logTarget() << msg << std::endl;
   }
 }
 
+void MsgStream::bufferFor(MsgStream& parent)
+{
+    name = parent.name;
+    outputLevel = parent.outputLevel;
+    logLevel = parent.logLevel;
+    buffered = true;
+    bufferLog = parent.logOpen();
+}
+
+void MsgStream::flushTo(MsgStream& target)
+{
+    std::cout << printBuffer.str();
+    if (target.logfile.is_open())
+	target.logfile << logBuffer.str();
+    printBuffer.str("");
+    logBuffer.str("");
+}
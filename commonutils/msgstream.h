@@ -70,9 +70,11 @@ class MsgStream {
 	 * Creates a new message stream.
 	 */
 	MsgStream() : name("unknown"), outputLevel(WARN), printThis(false), 
-		      logLevel(NONE), logThis(false), noIntro(false) {}
+		      logLevel(NONE), logThis(false), noIntro(false),
+		      buffered(false), bufferLog(false) {}
 	MsgStream(MsgLevel l, std::string s) : name(s), outputLevel(l), printThis(false),
-					       logLevel(NONE), logThis(false), noIntro(false) {}
+					       logLevel(NONE), logThis(false), noIntro(false),
+					       buffered(false), bufferLog(false) {}
 
 	/**
 	 * Destroyes the message stream
@@ -141,6 +143,22 @@ class MsgStream {
 	 */
 	void rawPrint(MsgLevel level, const std::string& msg);
 
+	/**
+	 * Keeps all further output in memory instead of printing it.
+	 * Name and levels are taken over from parent, messages are only logged
+	 * if parent has an open logfile. This allows worker threads to produce
+	 * output which is printed later on in a defined order.
+	 * @parent message stream the output is meant for
+	 */
+	void bufferFor(MsgStream& parent);
+
+	/**
+	 * Prints the buffered output to stdout and to the logfile of target.
+	 * The buffer is cleared afterwards.
+	 * @target message stream whose logfile is used
+	 */
+	void flushTo(MsgStream& target);
+
 	friend MsgStream& operator<<(MsgStream&, MsgStream::MsgLevel);
 	friend MsgStream& operator<<(MsgStream&, MsgStream::MsgControl);
 	friend MsgStream& operator<<(MsgStream&, const std::string&);
@@ -157,6 +175,26 @@ class MsgStream {
 	void printIntro(MsgLevel level);
 	void logIntro(MsgLevel level);
 
+	/* stdout and logfile, or the buffers (see bufferFor()) */
+	std::ostream& printTarget()
+	{
+	    if (buffered)
+		return printBuffer;
+	    return std::cout;
+	}
+	std::ostream& logTarget()
+	{
+	    if (buffered)
+		return logBuffer;
+	    return logfile;
+	}
+	bool logOpen()
+	{
+	    if (buffered)
+		return bufferLog;
+	    return logfile.is_open();
+	}
+
 	std::string name;
 
 	MsgLevel outputLevel;
@@ -167,6 +205,11 @@ class MsgStream {
 	bool logThis;
 
 	bool noIntro;
+
+	bool buffered;
+	bool bufferLog;
+	std::ostringstream printBuffer;
+	std::ostringstream logBuffer;
 };
 
 inline MsgStream& operator<<(MsgStream& ms, MsgStream::MsgLevel input)
@@ -177,7 +220,7 @@ inline MsgStream& operator<<(MsgStream& ms, MsgStream::MsgLevel input)
 	    ms.printIntro(input);
 	ms.printThis = true;
     }
-    if(ms.logfile.is_open() && (input <= ms.logLevel))
+    if(ms.logOpen() && (input <= ms.logLevel))
     {
 	if(!ms.noIntro)
 	    ms.logIntro(input);
@@ -189,11 +232,11 @@ inline MsgStream& operator<<(MsgStream& ms, MsgStream::MsgLevel input)
 inline MsgStream& operator<<(MsgStream& ms, MsgStream::MsgControl input)
 {
     if((ms.printThis) && (input == MsgStream::endl)) {
-	std::cout << std::endl;
+	ms.printTarget() << std::endl;
 	ms.printThis = false;
     }
     if((ms.logThis) && (input == MsgStream::endl)) {
-	ms.logfile << std::endl;
+	ms.logTarget() << std::endl;
 	ms.logThis = false;
     }
     if(input == MsgStream::raw)
@@ -206,81 +249,81 @@ inline MsgStream& operator<<(MsgStream& ms, MsgStream::MsgControl input)
 inline MsgStream& operator<<(MsgStream& ms, const std::string& input)
 {
     if(ms.printThis)
-	std::cout << input;
+	ms.printTarget() << input;
     if(ms.logThis)
-	ms.logfile << input;
+	ms.logTarget() << input;
     return ms;
 }
 
 inline MsgStream& operator<<(MsgStream& ms, int16_t input)
 {
     if(ms.printThis)
-	std::cout << input;
+	ms.printTarget() << input;
     if(ms.logThis)
-	ms.logfile << input;
+	ms.logTarget() << input;
     return ms;
 }
 
 inline MsgStream& operator<<(MsgStream& ms, uint16_t input)
 {
     if(ms.printThis)
-	std::cout << input;
+	ms.printTarget() << input;
     if(ms.logThis)
-	ms.logfile << input;
+	ms.logTarget() << input;
     return ms;
 }
 
 inline MsgStream& operator<<(MsgStream& ms, int32_t input)
 {
     if(ms.printThis)
-	std::cout << input;
+	ms.printTarget() << input;
     if(ms.logThis)
-	ms.logfile << input;
+	ms.logTarget() << input;
     return ms;
 }
 
 inline MsgStream& operator<<(MsgStream& ms, uint32_t input)
 {
     if(ms.printThis)
-	std::cout << input;
+	ms.printTarget() << input;
     if(ms.logThis)
-	ms.logfile << input;
+	ms.logTarget() << input;
     return ms;
 }
 
 inline MsgStream& operator<<(MsgStream& ms, int64_t input)
 {
     if(ms.printThis)
-	std::cout << input;
+	ms.printTarget() << input;
     if(ms.logThis)
-	ms.logfile << input;
+	ms.logTarget() << input;
     return ms;
 }
 
 inline MsgStream& operator<<(MsgStream& ms, uint64_t input)
 {
     if(ms.printThis)
-	std::cout << input;
+	ms.printTarget() << input;
     if(ms.logThis)
-	ms.logfile << input;
+	ms.logTarget() << input;
     return ms;
 }
 
 inline MsgStream& operator<<(MsgStream& ms, float input)
 {
     if(ms.printThis)
-	std::cout << input;
+	ms.printTarget() << input;
     if(ms.logThis)
-	ms.logfile << input;
+	ms.logTarget() << input;
     return ms;
 }
 
 inline MsgStream& operator<<(MsgStream& ms, double input)
 {
     if(ms.printThis)
-	std::cout << input;
+	ms.printTarget() << input;
     if(ms.logThis)
-	ms.logfile << input;
+	ms.logTarget() << input;
     return ms;
 }
 
@@ -70,12 +70,8 @@ void IpfixFile::proceedOnePacket()
 
 /********************************************************************************/
 
-byte* IpfixShm::startLocation = NULL;
-byte* IpfixShm::writePosition = NULL;
-byte* IpfixShm::readPosition  = NULL;
-bool  IpfixShm::writeBeforeRead = false;
-size_t IpfixShm::size = 0;
-uint16_t IpfixShm::packetSize = 0;
+ShmRing* IpfixShm::ring = NULL;
+int IpfixShm::consumer = -1;
 IpfixShm* IpfixShm::instance = NULL;
 
 
@@ -94,88 +90,215 @@ IpfixShm* IpfixShm::writePacket(const byte* data, uint16_t len)
                 return NULL;
 	}
 
-	if (startLocation == NULL) {
+	if (ring == NULL) {
 		msg(MSG_ERROR, "IpfixShm: No shared memory storage area allocated!");
                 return NULL;
 	}
 
-	if (len > size) {
-		msg(MSG_ERROR, "IpfixShm: Packet too long for shared memory");
+	if (!ring->write(data, len)) {
+		msg(MSG_ERROR, "IpfixShm: Shared memory block too small. Slowest module didn't free enough space. Trashing packet!");
                 return NULL;
 	}
-	
-	if ((writePosition + len + sizeof(len)) >= (startLocation + size)) {
-		// we only write a complete packet to the shared memory
-		// if there is not enough space to do that, we'll start at the
-		// the beginning of the buffer
-		// We signal this jump to the reader by zeroing the remaining
-		// buffer.
-		bzero(writePosition, ((startLocation + size) - writePosition));
-
-		if (readPosition >= writePosition) {
-			msg(MSG_ERROR, "IpfixShm: Shared memory block too small. Trashing packet!!!!!");
-                        return NULL;
-		}
-
-		writeBeforeRead = true;
-		writePosition = startLocation;
-	}
 
-	if (writeBeforeRead && (writePosition + len + sizeof(len)) > readPosition) {
-		//msg(MSG_ERROR, "%i %i", (writePosition - startLocation), (readPosition - startLocation));
-		msg(MSG_ERROR, "IpfixShm: Shared memory block too small!");
-                return NULL;
+        return instance;
+}
+
+uint16_t IpfixShm::readPacket(byte** data) {
+	if (ring == NULL || consumer == -1) {
+		return 0;
 	}
+	return ring->read(consumer, data);
+}
 
-	//msg(MSG_ERROR, "Writing packet len: %i", len);
-	memcpy(writePosition, &len, sizeof(len));
-	//msg(MSG_FATAL, "written: %i", *(uint16_t*)writePosition);
-	memcpy(writePosition + sizeof(len), data, len);
-	//msg(MSG_FATAL, "written: %#06x", ntohs(*(uint16_t*)(writePosition+sizeof(len))));
-	writePosition += sizeof(len) + len;
+void IpfixShm::releasePacket()
+{
+	if (ring && consumer != -1)
+		ring->release(consumer);
+}
 
-        return instance;
+unsigned IpfixShm::reserveSlots(byte** slots, unsigned count, uint16_t slotSize)
+{
+	if (ring == NULL)
+		return 0;
+	return ring->reserve(slots, count, slotSize);
 }
 
-uint16_t IpfixShm::readPacket(byte** data) {
-	// go to the next packet;
-	// packetSize == 0 for the first packet
-	readPosition += packetSize;
+void IpfixShm::cancelSlots()
+{
+	if (ring)
+		ring->cancel();
+}
 
-	if (sizeof(uint16_t) > ((startLocation + size) - readPosition)) {
-		writeBeforeRead = false;
-		readPosition = startLocation;
-	}
+void IpfixShm::proceedOnePacket()
+{
+	// nothing to do: space is reclaimed as soon as all modules advanced their
+	// read sequences past the packet
+}
+
+void IpfixShm::createRing(byte* ptr, size_t size)
+{
+	delete ring;
+	ring = new ShmRing(ptr, size, true);
+}
+
+void IpfixShm::attachRing(byte* ptr, size_t size, int c)
+{
+	delete ring;
+	ring = new ShmRing(ptr, size, false);
+	consumer = c;
+}
+
+int IpfixShm::registerConsumer()
+{
+	if (ring == NULL)
+		return -1;
+	return ring->registerConsumer();
+}
+
+void IpfixShm::unregisterConsumer(int c)
+{
+	if (ring)
+		ring->unregisterConsumer(c);
+}
+
+uint64_t IpfixShm::getLag(int c)
+{
+	if (ring == NULL)
+		return 0;
+	return ring->lag(c);
+}
+
+
+/********************************************************************************/
+
+ShmRing* FlowRecordShm::ring = NULL;
+int FlowRecordShm::consumer = -1;
+
+
+void FlowRecordShm::createRing(byte* ptr, size_t size)
+{
+	delete ring;
+	ring = new ShmRing(ptr, size, true);
+}
+
+void FlowRecordShm::attachRing(byte* ptr, size_t size, int c)
+{
+	delete ring;
+	ring = new ShmRing(ptr, size, false);
+	consumer = c;
+}
+
+int FlowRecordShm::registerConsumer()
+{
+	if (ring == NULL)
+		return -1;
+	return ring->registerConsumer();
+}
+
+void FlowRecordShm::unregisterConsumer(int c)
+{
+	if (ring)
+		ring->unregisterConsumer(c);
+}
 
-	// get the packet length
-	packetSize = *(uint16_t*)readPosition;
-	readPosition += sizeof(uint16_t);
+uint64_t FlowRecordShm::getLag(int c)
+{
+	if (ring == NULL)
+		return 0;
+	return ring->lag(c);
+}
+
+bool FlowRecordShm::hasConsumers()
+{
+	return ring != NULL && ring->hasConsumers();
+}
 
-	if (packetSize == 0) {
-		writeBeforeRead = false;
-		readPosition = startLocation;
-		packetSize = *(uint16_t*)readPosition;
-		readPosition += sizeof(uint16_t);
+bool FlowRecordShm::writeRecords(const FlowRecord* records, unsigned count)
+{
+	if (ring == NULL || count == 0 || count > MAX_RECORDS) {
+		return false;
 	}
-	
-	//msg(MSG_FATAL, "reading: %#06x",  ntohs(*(uint16_t*)readPosition));
-	*data = readPosition;
-	
-	
-	return packetSize;
+	if (!ring->write((const byte*)records, count * sizeof(FlowRecord))) {
+		msg(MSG_ERROR, "FlowRecordShm: Record ring too small. Slowest module didn't free enough space. Trashing records!");
+		return false;
+	}
+	return true;
 }
 
-void IpfixShm::proceedOnePacket()
+unsigned FlowRecordShm::readRecords(const byte** d)
+{
+	if (ring == NULL || consumer == -1) {
+		return 0;
+	}
+	byte* data;
+	uint16_t len = ring->read(consumer, &data);
+	*d = data;
+	return len / sizeof(FlowRecord);
+}
+
+void FlowRecordShm::releaseRecords()
+{
+	if (ring && consumer != -1)
+		ring->release(consumer);
+}
+
+
+/********************************************************************************/
+
+IpfixSpool* IpfixSpool::instance = NULL;
+SpoolWriter* IpfixSpool::writer = NULL;
+SpoolReader* IpfixSpool::reader = NULL;
+
+
+IpfixSpool::IpfixSpool()
 {
-        readPacket(&readPosition);
 }
 
-void IpfixShm::setShmPointer(byte* ptr)
+void IpfixSpool::createSpool(const std::string& dir, unsigned segments, size_t segmentSize)
 {
-	startLocation = writePosition = readPosition = ptr;
+	delete writer;
+	writer = new SpoolWriter(dir, segments, segmentSize);
+}
+
+void IpfixSpool::attachSpool(const std::string& dir)
+{
+	delete reader;
+	reader = new SpoolReader(dir);
+}
+
+IpfixSpool* IpfixSpool::writePacket(uint32_t seq, const byte* data, uint16_t len)
+{
+        if (!instance) {
+                instance = new IpfixSpool();
+        }
+
+        if (len == 0) {
+                msg(MSG_ERROR, "IpfixSpool: Got empty packet!!!!");
+                return NULL;
+	}
+
+	if (writer == NULL) {
+		msg(MSG_ERROR, "IpfixSpool: No spool created!");
+                return NULL;
+	}
+
+	if (!writer->write(seq, data, len)) {
+		msg(MSG_ERROR, "IpfixSpool: No free spool segment. Slowest module didn't process the oldest segment. Trashing packet!");
+                return NULL;
+	}
+
+        return instance;
+}
+
+uint16_t IpfixSpool::readPacket(uint32_t seq, const byte** data)
+{
+	if (reader == NULL) {
+		return 0;
+	}
+	return reader->read(seq, data);
 }
 
-void IpfixShm::setShmSize(size_t s)
+void IpfixSpool::proceedOnePacket()
 {
-	size = s;
+	writer->release();
 }
@@ -27,6 +27,9 @@
 #include "global.h"
 #include "sharedobj.h"
 #include "mutex.h"
+#include "shmring.h"
+#include "spool.h"
+#include "flowrecord.h"
 
 
 #include <concentrator/msg.h>
@@ -96,15 +99,78 @@ private:
 
 /**
  * Handles incoming IPFIX-Packets from the time they arrive by writing them onto
- * a shared memory storage block.
+ * a shared memory storage block. The storage block is organised as a ring
+ * (see @c ShmRing) with one read sequence per detection module, so every
+ * module reads at its own pace.
  */ 
 class IpfixShm : public PacketStorage {
 public:
 
-	static void setShmPointer(byte*);
-	static void setShmSize(size_t);
+	/**
+	 * Initialises the ring on the collector side.
+	 * @param ptr start of the shared memory storage block
+	 * @param size size of the shared memory storage block
+	 */
+	static void createRing(byte* ptr, size_t size);
+
+	/**
+	 * Attaches to an existing ring on the detection module side.
+	 * @param ptr start of the shared memory storage block
+	 * @param size size of the shared memory storage block
+	 * @param consumer consumer slot assigned by the collector
+	 */
+	static void attachRing(byte* ptr, size_t size, int consumer);
+
+	/**
+	 * Reserves a consumer slot for a new detection module.
+	 * @return slot number or -1 if there is no free slot
+	 */
+	static int registerConsumer();
+
+	/**
+	 * Frees the consumer slot of a stopped detection module.
+	 */
+	static void unregisterConsumer(int consumer);
 
+	/**
+	 * Returns the number of bytes a module still has to read.
+	 */
+	static uint64_t getLag(int consumer);
+
+	/**
+	 * Returns the next packet for this module. The previously returned
+	 * packet is handed back to the collector.
+	 * @param d will point to the packet within the shared memory block
+	 * @return packet length, 0 if no packet is available
+	 */
 	static uint16_t readPacket(byte** d);
+
+	/**
+	 * Hands the last packet returned by @c readPacket() back to the collector.
+	 */
+	static void releasePacket();
+
+	/**
+	 * True if this module is attached to the ring (module side).
+	 */
+	static bool isAttached() { return ring != NULL && consumer != -1; }
+
+	/**
+	 * Reserves slots within the ring, the collector can receive packets
+	 * directly into them. A packet within such a slot is published without
+	 * copying by @c writePacket().
+	 * @param slots will contain the start of the reserved slots
+	 * @param count maximum number of slots
+	 * @param slotSize size of every slot
+	 * @return number of reserved slots
+	 */
+	static unsigned reserveSlots(byte** slots, unsigned count, uint16_t slotSize);
+
+	/**
+	 * Hands all reserved slots that weren't published back to the ring.
+	 */
+	static void cancelSlots();
+
         virtual void proceedOnePacket();
         static IpfixShm* writePacket(const byte* d, uint16_t len);
 
@@ -113,39 +179,139 @@ private:
         IpfixShm();
         static IpfixShm* instance;
 
-	/** TODO: HACK FOR THE MODULE SITE! */
-	static uint16_t packetSize;
-	
 	/**
-	 * location on which this instance of IpfixShm stored it's
-	 * packet
+	 * ring within the shared memory storage block
 	 */
-	//void* packetLocation;
+	static ShmRing* ring;
+
 	/**
-	 * start of the shared memory block
+	 * consumer slot of this detection module (module side only)
 	 */
-	static byte* startLocation;
+	static int consumer;
+};
 
+/**
+ * Publishes the flow records decoded by the collector to the detection
+ * modules. Like @c IpfixShm, the records are stored within a ring in a
+ * shared memory block, every module reads with its own consumer slot.
+ * Every ring entry contains the records of one IPFIX packet. Records
+ * within the ring are not aligned, copy them before accessing their fields.
+ */
+class FlowRecordShm {
+public:
 	/**
-	 * the next incoming paket will be written to this location
+	 * Maximum number of records written with one call to @c writeRecords().
 	 */
-	static byte* writePosition;
+	static const unsigned MAX_RECORDS = 0xffff / sizeof(FlowRecord);
 
 	/**
-	 * pointer to the first not yet  processed ipfix packet
+	 * Initialises the ring on the collector side.
+	 * @param ptr start of the shared memory block
+	 * @param size size of the shared memory block
 	 */
-	static byte* readPosition;
-	
+	static void createRing(byte* ptr, size_t size);
+
 	/**
-	 * total size of the shared memory block
-	 */ 
-	static size_t size;
+	 * Attaches to an existing ring on the detection module side.
+	 * @param ptr start of the shared memory block
+	 * @param size size of the shared memory block
+	 * @param consumer consumer slot assigned by the collector
+	 */
+	static void attachRing(byte* ptr, size_t size, int consumer);
+
+	/**
+	 * True if this module is attached to the ring (module side).
+	 */
+	static bool isAttached() { return ring != NULL && consumer != -1; }
 
 	/**
-	 * if writeBeforeRead is true, then writePosition < readPosition
-	 * else writePosition >= readPosition;
+	 * Reserves a consumer slot for a new detection module.
+	 * @return slot number or -1 if there is no ring or no free slot
 	 */
-	static bool writeBeforeRead;
+	static int registerConsumer();
+
+	/**
+	 * Frees the consumer slot of a stopped detection module.
+	 */
+	static void unregisterConsumer(int consumer);
+
+	/**
+	 * Returns the number of bytes a module still has to read.
+	 */
+	static uint64_t getLag(int consumer);
+
+	/**
+	 * True if at least one module reads the decoded records. The collector
+	 * doesn't decode any packets if this is false.
+	 */
+	static bool hasConsumers();
+
+	/**
+	 * Publishes records to all modules (collector side).
+	 * @param records records to publish
+	 * @param count number of records, at most MAX_RECORDS
+	 * @return false if the slowest module didn't free enough space
+	 */
+	static bool writeRecords(const FlowRecord* records, unsigned count);
+
+	/**
+	 * Returns the next records for this module. The previously returned
+	 * records are handed back to the collector. Besides flow records the
+	 * stream contains control records (see @c FlowRecord::Type), which
+	 * readers have to handle or skip.
+	 * @param d will point to the first record within the shared memory block
+	 * @return number of records, 0 if no records are available
+	 */
+	static unsigned readRecords(const byte** d);
+
+	/**
+	 * Hands the records returned by @c readRecords() back to the collector.
+	 */
+	static void releaseRecords();
+
+private:
+	static ShmRing* ring;
+	static int consumer;
+};
+
+/**
+ * Handles incoming IPFIX-Packets by appending them to a spool of preallocated
+ * segment files (see @c Spool). Packets are identified by their sequence
+ * number, which is the same number the files exchange uses for its file names.
+ */
+class IpfixSpool : public PacketStorage {
+public:
+	/**
+	 * Creates the spool on the collector side.
+	 * @param dir directory for the segment files
+	 * @param segments number of segment files
+	 * @param segmentSize size of every segment file
+	 */
+	static void createSpool(const std::string& dir, unsigned segments, size_t segmentSize);
+
+	/**
+	 * Attaches to an existing spool on the detection module side.
+	 * @param dir directory containing the segment files
+	 */
+	static void attachSpool(const std::string& dir);
+
+	/**
+	 * Returns a packet from the spool (detection module side).
+	 * @param seq sequence number of the packet
+	 * @param d will point to the packet within the mapped segment
+	 * @return packet length, 0 if the packet is not within the spool
+	 */
+	static uint16_t readPacket(uint32_t seq, const byte** d);
+
+        virtual void proceedOnePacket();
+        static IpfixSpool* writePacket(uint32_t seq, const byte* d, uint16_t len);
+
+private:
+        IpfixSpool();
+        static IpfixSpool* instance;
+
+	static SpoolWriter* writer;
+	static SpoolReader* reader;
 };
 
 /**
@@ -175,6 +175,30 @@ namespace shared
 			return sb->storageSize;
 		}
 
+		/**
+		 * Sets the shared memory id of the decoded flow record ring.
+		 * @param key shared memory key of the record ring, 0 if the
+		 *        collector doesn't decode the packets
+		 */
+		void setRecordKey(key_t key)
+		{
+			sb->recordKey = key;
+		}
+
+		key_t getRecordKey() { return sb->recordKey; }
+
+		/**
+		 * Sets the size of the decoded flow record ring.
+		 * @param size size
+		 */
+		void setRecordSize(size_t size) {
+			sb->recordSize = size;
+		}
+
+		size_t getRecordSize() {
+			return sb->recordSize;
+		}
+
         private:
                 /** 
                  * Hidden (unimplemented) copy constructor
@@ -196,6 +220,8 @@ namespace shared
                         unsigned to;
 			key_t storageKey;
 			unsigned storageSize;
+			key_t recordKey;
+			unsigned recordSize;
                 } ShmBlock;
 
                 /**
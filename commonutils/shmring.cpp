@@ -0,0 +1,298 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#include "shmring.h"
+
+
+#include <cstring>
+#include <stdexcept>
+
+
+/* consumer slot states */
+enum {
+	SLOT_FREE = 0,
+	SLOT_ACTIVE = 1,
+	SLOT_CLAIMED = 2
+};
+
+
+ShmRing::ShmRing(byte* mem, size_t size, bool create)
+	: header((Header*)mem), dataStart(mem + sizeof(Header)), dataSize(0),
+	  reservedCount(0), reservedFirst(0)
+{
+	memset(pending, 0, sizeof(pending));
+
+	if (create) {
+		if (size <= sizeof(Header)) {
+			throw std::runtime_error("ShmRing: Shared memory block too small for ring header");
+		}
+		memset(header, 0, sizeof(Header));
+		header->dataSize = size - sizeof(Header);
+		header->magic = MAGIC;
+		__sync_synchronize();
+	} else if (header->magic != MAGIC) {
+		throw std::runtime_error("ShmRing: Shared memory block does not contain an initialised ring");
+	}
+
+	dataSize = header->dataSize;
+}
+
+uint64_t ShmRing::load(const volatile uint64_t* v)
+{
+	return __sync_fetch_and_add(const_cast<volatile uint64_t*>(v), 0);
+}
+
+void ShmRing::store(volatile uint64_t* v, uint64_t value)
+{
+	/* make all previous writes (packet data) visible before the sequence */
+	__sync_synchronize();
+	__sync_lock_test_and_set(v, value);
+}
+
+uint64_t ShmRing::minConsumerSequence(uint64_t writeSeq) const
+{
+	uint64_t ret = writeSeq;
+	for (unsigned i = 0; i != MAX_CONSUMERS; ++i) {
+		if (header->consumers[i].active == SLOT_ACTIVE) {
+			uint64_t seq = load(&header->consumers[i].value);
+			if (seq < ret)
+				ret = seq;
+		}
+	}
+	return ret;
+}
+
+bool ShmRing::place(uint64_t& seq, uint64_t& skip, uint64_t need) const
+{
+	if (need > dataSize) {
+		return false;
+	}
+
+	/* records are never split. jump to the beginning if there is not enough space left */
+	uint64_t pos = seq % dataSize;
+	skip = 0;
+	if (dataSize - pos < need) {
+		skip = dataSize - pos;
+	}
+
+	if (seq + skip + need - minConsumerSequence(header->producer.value) > dataSize) {
+		return false;
+	}
+
+	seq += skip;
+	return true;
+}
+
+void ShmRing::writeWrapMarker(uint64_t seq, uint64_t skip)
+{
+	if (skip >= sizeof(RecordHeader)) {
+		memset(dataStart + (seq - skip) % dataSize, 0, sizeof(RecordHeader));
+	}
+}
+
+void ShmRing::publish(unsigned j)
+{
+	RecordHeader rh;
+
+	/* slots in front of j that weren't used (e.g. packets of unauthorized hosts) are skipped */
+	for (unsigned i = reservedFirst; i <= j; ++i) {
+		const Reservation& r = reserved[i];
+		writeWrapMarker(r.seq, r.skip);
+		rh.length = r.length;
+		rh.padding = r.size - r.length;
+		memcpy(dataStart + r.seq % dataSize, &rh, sizeof(rh));
+	}
+	reservedFirst = j + 1;
+
+	store(&header->producer.value, reserved[j].seq + sizeof(RecordHeader) + reserved[j].size);
+}
+
+bool ShmRing::write(const byte* data, uint16_t len)
+{
+	RecordHeader rh;
+
+	/* packet received into a reserved slot? */
+	for (unsigned j = reservedFirst; j < reservedCount; ++j) {
+		Reservation& r = reserved[j];
+		if (r.length != 0 || data != dataStart + r.seq % dataSize + sizeof(RecordHeader))
+			continue;
+		if (len > r.size)
+			break;
+		r.length = len;
+		publish(j);
+		return true;
+	}
+
+	uint64_t seq;
+	uint64_t skip;
+	if (reservedFirst != reservedCount) {
+		/* the slots may still receive packets, so the packet is copied behind
+		   them and published after them */
+		if (reservedCount == 2 * MAX_RESERVED) {
+			return false;
+		}
+		const Reservation& last = reserved[reservedCount - 1];
+		seq = last.seq + sizeof(RecordHeader) + last.size;
+		if (!place(seq, skip, sizeof(RecordHeader) + len)) {
+			return false;
+		}
+		/* wrap marker and record header are written when the packet is published */
+		memmove(dataStart + seq % dataSize + sizeof(RecordHeader), data, len);
+		Reservation& r = reserved[reservedCount++];
+		r.seq = seq;
+		r.skip = skip;
+		r.size = len;
+		r.length = len;
+		return true;
+	}
+	cancel();
+
+	/* we are the only writer of the producer sequence */
+	seq = header->producer.value;
+	if (!place(seq, skip, sizeof(RecordHeader) + len)) {
+		return false;
+	}
+
+	writeWrapMarker(seq, skip);
+	rh.length = len;
+	rh.padding = 0;
+	memcpy(dataStart + seq % dataSize, &rh, sizeof(rh));
+	/* data may be a cancelled slot within the ring */
+	memmove(dataStart + seq % dataSize + sizeof(rh), data, len);
+
+	store(&header->producer.value, seq + sizeof(rh) + len);
+	return true;
+}
+
+unsigned ShmRing::reserve(byte** slots, unsigned count, uint16_t slotSize)
+{
+	cancel();
+
+	uint64_t seq = header->producer.value;
+	uint64_t skip;
+	unsigned i;
+	for (i = 0; i != count && i != MAX_RESERVED; ++i) {
+		if (!place(seq, skip, sizeof(RecordHeader) + slotSize)) {
+			break;
+		}
+		Reservation& r = reserved[i];
+		r.seq = seq;
+		r.skip = skip;
+		r.size = slotSize;
+		r.length = 0;
+		slots[i] = dataStart + seq % dataSize + sizeof(RecordHeader);
+		seq += sizeof(RecordHeader) + slotSize;
+	}
+
+	reservedCount = i;
+	return i;
+}
+
+void ShmRing::cancel()
+{
+	/* publish the packets copied behind the slots, the slots behind them are handed back */
+	for (unsigned j = reservedCount; j > reservedFirst; --j) {
+		if (reserved[j - 1].length != 0) {
+			publish(j - 1);
+			break;
+		}
+	}
+	reservedFirst = reservedCount = 0;
+}
+
+int ShmRing::registerConsumer()
+{
+	for (unsigned i = 0; i != MAX_CONSUMERS; ++i) {
+		if (__sync_bool_compare_and_swap(&header->consumers[i].active, SLOT_FREE, SLOT_CLAIMED)) {
+			/* the slot isn't taken into account by the producer before it is active */
+			store(&header->consumers[i].value, load(&header->producer.value));
+			header->consumers[i].active = SLOT_ACTIVE;
+			__sync_synchronize();
+			pending[i] = 0;
+			return i;
+		}
+	}
+	return -1;
+}
+
+void ShmRing::unregisterConsumer(int consumer)
+{
+	if (consumer < 0 || consumer >= (int)MAX_CONSUMERS)
+		return;
+	header->consumers[consumer].active = SLOT_FREE;
+	__sync_synchronize();
+}
+
+bool ShmRing::hasConsumers() const
+{
+	for (unsigned i = 0; i != MAX_CONSUMERS; ++i) {
+		if (header->consumers[i].active == SLOT_ACTIVE)
+			return true;
+	}
+	return false;
+}
+
+uint16_t ShmRing::read(int consumer, byte** data)
+{
+	release(consumer);
+
+	/* we are the only writer of our own sequence */
+	uint64_t readSeq = header->consumers[consumer].value;
+	uint64_t writeSeq = load(&header->producer.value);
+	while (readSeq != writeSeq) {
+		uint64_t pos = readSeq % dataSize;
+		uint64_t skip = 0;
+		RecordHeader rh;
+		rh.length = rh.padding = 0;
+		if (dataSize - pos >= sizeof(rh)) {
+			memcpy(&rh, dataStart + pos, sizeof(rh));
+		}
+		if (rh.length == 0 && rh.padding == 0) {
+			skip = dataSize - pos;
+			pos = 0;
+			memcpy(&rh, dataStart, sizeof(rh));
+		}
+
+		uint64_t size = skip + sizeof(rh) + rh.length + rh.padding;
+		if (rh.length == 0) {
+			/* unused slot */
+			readSeq += size;
+			store(&header->consumers[consumer].value, readSeq);
+			continue;
+		}
+
+		*data = dataStart + pos + sizeof(rh);
+		pending[consumer] = size;
+		return rh.length;
+	}
+
+	return 0;
+}
+
+void ShmRing::release(int consumer)
+{
+	if (pending[consumer]) {
+		store(&header->consumers[consumer].value, header->consumers[consumer].value + pending[consumer]);
+		pending[consumer] = 0;
+	}
+}
+
+uint64_t ShmRing::lag(int consumer) const
+{
+	if (consumer < 0 || consumer >= (int)MAX_CONSUMERS || header->consumers[consumer].active != SLOT_ACTIVE)
+		return 0;
+	return load(&header->producer.value) - load(&header->consumers[consumer].value);
+}
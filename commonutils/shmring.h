@@ -0,0 +1,223 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#ifndef _SHM_RING_H_
+#define _SHM_RING_H_
+
+
+#include "global.h"
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/**
+ * Single producer, multiple consumer ring buffer living in a shared memory
+ * block. The collector is the only producer, every detection module is a
+ * consumer with its own read sequence.
+ *
+ * The shared memory block starts with a header containing the producer
+ * sequence and one sequence per consumer slot. Every sequence lives in its
+ * own cache line. Sequences are monotonically increasing byte offsets into
+ * the ring, the position within the data area is sequence % dataSize.
+ * Packets are stored as [uint16_t length][uint16_t padding][data][padding].
+ * A record with length 0 and padding 0 (or less than a record header left in
+ * the data area) tells the consumer to continue at the beginning of the data
+ * area. A record with length 0 and padding > 0 is skipped by the consumer.
+ *
+ * Besides copying packets into the ring with @c write(), the producer can
+ * reserve fixed size slots with @c reserve() and let the packets be received
+ * directly into them (zero copy). Passing a pointer to the oldest reserved slot
+ * to @c write() publishes the slot in place; reserved slots that are not used
+ * are published as skipped records or handed back with @c cancel(). Packets
+ * written from outside the ring while slots are reserved are copied behind
+ * the reserved slots and published after them.
+ *
+ * The producer only overwrites data that every active consumer already passed.
+ * No locks or semaphores are involved, synchronisation is done by atomic
+ * operations on the sequences.
+ */
+class ShmRing {
+public:
+	static const unsigned MAX_CONSUMERS = 32;
+	static const unsigned CACHE_LINE_SIZE = 64;
+
+	/**
+	 * Creates a ring on top of an existing memory block.
+	 * @param mem start of the shared memory block
+	 * @param size total size of the shared memory block (header included)
+	 * @param create true if the header should be initialised (producer side),
+	 *               false if an already initialised ring is attached (consumer side)
+	 */
+	ShmRing(byte* mem, size_t size, bool create);
+
+	/**
+	 * Copies a packet into the ring and publishes it to all consumers.
+	 * If data points to a reserved slot, the packet is published in place
+	 * (reserved slots before it are skipped). Otherwise the packet is copied
+	 * behind the reserved slots, which may still receive packets, and is
+	 * published with the next slot behind it or by @c cancel().
+	 * @param data packet data
+	 * @param len packet length
+	 * @return true on success, false if the slowest active consumer did not
+	 *         free enough space for the packet.
+	 */
+	bool write(const byte* data, uint16_t len);
+
+	/**
+	 * Reserves slots for packets to be written in place. The slots are
+	 * published in order when they are passed to @c write().
+	 * @param slots will contain the start of the reserved slots
+	 * @param count maximum number of slots to reserve
+	 * @param slotSize size of every slot
+	 * @return number of reserved slots, less than count if the slowest consumer
+	 *         did not free enough space
+	 */
+	unsigned reserve(byte** slots, unsigned count, uint16_t slotSize);
+
+	/**
+	 * Publishes the packets copied behind the reserved slots and hands all
+	 * unused slots back to the ring.
+	 */
+	void cancel();
+
+	/**
+	 * Reserves a consumer slot. The consumer starts reading at the current
+	 * producer position.
+	 * @return slot number or -1 if all slots are in use
+	 */
+	int registerConsumer();
+
+	/**
+	 * Frees a consumer slot. The producer will no longer wait for this consumer.
+	 * @param consumer slot number returned by @c registerConsumer()
+	 */
+	void unregisterConsumer(int consumer);
+
+	/**
+	 * True if at least one consumer slot is in use.
+	 */
+	bool hasConsumers() const;
+
+	/**
+	 * Returns the next packet for the consumer. The packet stays valid until the
+	 * next call to @c read() or @c release() for that consumer, it is handed
+	 * back to the producer by those calls.
+	 * @param consumer consumer slot
+	 * @param data will point to the packet data within the ring
+	 * @return packet length, 0 if there is no new packet
+	 */
+	uint16_t read(int consumer, byte** data);
+
+	/**
+	 * Hands the last packet read by the consumer back to the producer.
+	 * @param consumer consumer slot
+	 */
+	void release(int consumer);
+
+	/**
+	 * Number of bytes the consumer still has to read.
+	 * @param consumer consumer slot
+	 * @return bytes between consumers read sequence and producer sequence
+	 */
+	uint64_t lag(int consumer) const;
+
+	/**
+	 * Number of bytes needed by the ring header. The data area is the size
+	 * of the shared memory block minus the header size.
+	 */
+	static size_t headerSize() { return sizeof(Header); }
+
+private:
+	/**
+	 * Pads a sequence number to a full cache line to avoid
+	 * false sharing between producer and consumers.
+	 */
+	struct Sequence {
+		volatile uint64_t value;
+		volatile uint32_t active;
+		char pad[CACHE_LINE_SIZE - sizeof(uint64_t) - sizeof(uint32_t)];
+	};
+
+	struct Header {
+		uint32_t magic;
+		uint32_t dataSize;
+		char pad[CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+		Sequence producer;
+		Sequence consumers[MAX_CONSUMERS];
+	};
+
+	/**
+	 * Record header in front of every packet
+	 */
+	struct RecordHeader {
+		uint16_t length;
+		uint16_t padding;
+	};
+
+	/**
+	 * Smallest read sequence of all active consumers.
+	 */
+	uint64_t minConsumerSequence(uint64_t writeSeq) const;
+
+	/**
+	 * Finds a position for a record of need bytes starting at sequence seq.
+	 * @param seq sequence to start at, will be set to the sequence of the record
+	 * @param skip will be set to the number of bytes skipped at the end of the data area
+	 * @return false if the slowest consumer did not free enough space
+	 */
+	bool place(uint64_t& seq, uint64_t& skip, uint64_t need) const;
+
+	/**
+	 * Writes a wrap marker in front of the record at seq if skip > 0.
+	 */
+	void writeWrapMarker(uint64_t seq, uint64_t skip);
+
+	/**
+	 * Publishes all reservations up to (and including) reservation j.
+	 * Unfilled reservations in front of j become skipped records.
+	 */
+	void publish(unsigned j);
+
+	static uint64_t load(const volatile uint64_t* v);
+	static void store(volatile uint64_t* v, uint64_t value);
+
+	Header* header;
+	byte* dataStart;
+	uint64_t dataSize;
+
+	/* consumer side: bytes occupied by the last packet handed out (per slot) */
+	uint64_t pending[MAX_CONSUMERS];
+
+	/* producer side: reserved but not yet published slots and the packets
+	   copied behind them. The producer sequence never passes an unfilled slot
+	   that may still receive a packet */
+	struct Reservation {
+		uint64_t seq;    /**< sequence of the record header */
+		uint64_t skip;   /**< bytes skipped in front of the record (wrap) */
+		uint16_t size;   /**< bytes available for the packet */
+		uint16_t length; /**< packet length, 0 if the slot wasn't filled yet */
+	};
+	static const unsigned MAX_RESERVED = 64;
+	Reservation reserved[2 * MAX_RESERVED];
+	unsigned reservedCount;
+	unsigned reservedFirst;
+
+	static const uint32_t MAGIC = 0x49504658; // "IPFX"
+};
+
+#endif
@@ -0,0 +1,245 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#include "spool.h"
+
+
+#include <concentrator/msg.h>
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+
+
+std::string Spool::segmentName(const std::string& dir, unsigned n)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "spool.%u", n);
+	return dir + name;
+}
+
+Spool::~Spool()
+{
+	for (unsigned i = 0; i != segments.size(); ++i) {
+		munmap(segments[i], segmentSize);
+	}
+}
+
+byte* Spool::mapSegment(const std::string& name, size_t size, bool writable)
+{
+	int fd;
+	if (writable) {
+		fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	} else {
+		fd = open(name.c_str(), O_RDONLY);
+	}
+	if (-1 == fd) {
+		throw std::runtime_error("Spool: Could not open segment file " + name + ": " + strerror(errno));
+	}
+
+	/* preallocate the whole segment, we don't want to extend files while writing packets */
+	int err;
+	if (writable && 0 != (err = posix_fallocate(fd, 0, size))) {
+		close(fd);
+		throw std::runtime_error("Spool: Could not allocate segment file " + name + ": " + strerror(err));
+	}
+
+	void* ptr = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == ptr) {
+		throw std::runtime_error("Spool: Could not map segment file " + name + ": " + strerror(errno));
+	}
+	return (byte*)ptr;
+}
+
+
+/********************************************************************************/
+
+
+SpoolWriter::SpoolWriter(const std::string& dir, unsigned count, size_t size)
+	: current(0), oldest(0), lastSeq(0), outstanding(count, 0)
+{
+	if (count == 0) {
+		throw std::runtime_error("SpoolWriter: Spool needs at least one segment");
+	}
+	if (size <= sizeof(SegmentHeader) + RECORD_HEADER_SIZE + config_space::MAX_IPFIX_PACKET_LENGTH) {
+		throw std::runtime_error("SpoolWriter: Segment size too small for an IPFIX packet");
+	}
+	segmentCount = count;
+	segmentSize = size;
+
+	for (unsigned i = 0; i != count; ++i) {
+		segments.push_back(mapSegment(segmentName(dir, i), size, true));
+		SegmentHeader* h = header(i);
+		h->segmentCount = segmentCount;
+		h->segmentSize = segmentSize;
+		h->used = sizeof(SegmentHeader);
+		h->firstSeq = 0;
+		h->magic = MAGIC;
+	}
+	msg(MSG_INFO, "SpoolWriter: Created %u segments of %u bytes in %s", segmentCount, segmentSize, dir.c_str());
+}
+
+bool SpoolWriter::write(uint32_t fileNo, const byte* data, uint16_t len)
+{
+	uint32_t need = RECORD_HEADER_SIZE + len;
+
+	lock.lock();
+	uint64_t seq = unwrap(lastSeq, fileNo);
+	SegmentHeader* h = header(current);
+	if (h->used + need > segmentSize) {
+		/* continue with the next segment if all of its packets were processed */
+		unsigned next = (current + 1) % segmentCount;
+		if (outstanding[next] != 0) {
+			lock.unlock();
+			return false;
+		}
+		if (oldest == current && outstanding[current] == 0) {
+			oldest = next;
+		}
+		current = next;
+		h = header(current);
+		h->used = sizeof(SegmentHeader);
+		h->firstSeq = seq;
+	}
+
+	byte* p = segments[current] + h->used;
+	memcpy(p, &seq, sizeof(seq));
+	memcpy(p + sizeof(seq), &len, sizeof(len));
+	memcpy(p + RECORD_HEADER_SIZE, data, len);
+	/* the packet has to be complete before it becomes visible */
+	__sync_synchronize();
+	h->used += need;
+	++outstanding[current];
+	lastSeq = seq;
+	lock.unlock();
+
+	return true;
+}
+
+void SpoolWriter::release()
+{
+	lock.lock();
+	if (outstanding[oldest] != 0) {
+		--outstanding[oldest];
+	}
+	while (outstanding[oldest] == 0 && oldest != current) {
+		oldest = (oldest + 1) % segmentCount;
+	}
+	lock.unlock();
+}
+
+
+/********************************************************************************/
+
+
+SpoolReader::SpoolReader(const std::string& dir)
+	: current(0), offset(sizeof(SegmentHeader)), lastSeq(0), tracking(false)
+{
+	/* the first segment tells us about the others */
+	byte* first = mapSegment(segmentName(dir, 0), sizeof(SegmentHeader), false);
+	SegmentHeader h = *(SegmentHeader*)first;
+	munmap(first, sizeof(SegmentHeader));
+	if (h.magic != MAGIC) {
+		throw std::runtime_error("SpoolReader: " + segmentName(dir, 0) + " is no spool segment");
+	}
+
+	segmentCount = h.segmentCount;
+	segmentSize = h.segmentSize;
+	for (unsigned i = 0; i != segmentCount; ++i) {
+		segments.push_back(mapSegment(segmentName(dir, i), segmentSize, false));
+	}
+}
+
+uint16_t SpoolReader::readAt(unsigned n, uint32_t off, uint64_t seq, const byte** data)
+{
+	const byte* start = segments[n];
+	if (off + RECORD_HEADER_SIZE > header(n)->used) {
+		return 0;
+	}
+	uint64_t s;
+	uint16_t len;
+	memcpy(&s, start + off, sizeof(s));
+	if (s != seq) {
+		return 0;
+	}
+	memcpy(&len, start + off + sizeof(s), sizeof(len));
+	*data = start + off + RECORD_HEADER_SIZE;
+	return len;
+}
+
+uint16_t SpoolReader::read(uint32_t fileNo, const byte** data)
+{
+	uint16_t len;
+
+	if (tracking) {
+		uint64_t seq = unwrap(lastSeq, fileNo);
+
+		/* usual case: the packet follows the previous one ... */
+		if (0 != (len = readAt(current, offset, seq, data))) {
+			offset += RECORD_HEADER_SIZE + len;
+			lastSeq = seq;
+			return len;
+		}
+
+		/* ... or starts the next segment */
+		unsigned next = (current + 1) % segmentCount;
+		if (header(next)->firstSeq == seq && 0 != (len = readAt(next, sizeof(SegmentHeader), seq, data))) {
+			current = next;
+			offset = sizeof(SegmentHeader) + RECORD_HEADER_SIZE + len;
+			lastSeq = seq;
+			return len;
+		}
+	}
+
+	/* we lost track (first call, restarted module): search all segments.
+	   Packets with the same file number are MAX_FILES packets apart, the
+	   collector announced the newest one */
+	bool found = false;
+	for (unsigned n = 0; n != segmentCount; ++n) {
+		uint32_t off = sizeof(SegmentHeader);
+		while (off + RECORD_HEADER_SIZE <= header(n)->used) {
+			uint64_t s;
+			uint16_t l;
+			memcpy(&s, segments[n] + off, sizeof(s));
+			memcpy(&l, segments[n] + off + sizeof(s), sizeof(l));
+			if (s % config_space::MAX_FILES == fileNo && (!found || s > lastSeq)) {
+				found = true;
+				current = n;
+				offset = off + RECORD_HEADER_SIZE + l;
+				lastSeq = s;
+				len = l;
+				*data = segments[n] + off + RECORD_HEADER_SIZE;
+			}
+			off += RECORD_HEADER_SIZE + l;
+		}
+	}
+
+	if (!found) {
+		return 0;
+	}
+	tracking = true;
+	return len;
+}
@@ -0,0 +1,169 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#ifndef _SPOOL_H_
+#define _SPOOL_H_
+
+
+#include "global.h"
+#include "mutex.h"
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#include <string>
+#include <vector>
+
+
+/**
+ * Append-only packet spool made of preallocated segment files. Used by the
+ * files exchange protocol instead of creating (and removing) one file per
+ * IPFIX packet.
+ *
+ * Every segment file starts with a @c SegmentHeader followed by the packets,
+ * each stored as [uint64_t sequence][uint16_t length][data]. The collector
+ * appends packets to the current segment and continues with the next segment
+ * if the packet doesn't fit anymore. A segment is recycled as a whole once
+ * all packets within it were processed by the detection modules. The detection
+ * modules map the segments read-only and look up packets by their sequence
+ * number.
+ *
+ * Packets are announced by their file number, which wraps at
+ * config_space::MAX_FILES. The spool stores a sequence number that doesn't
+ * wrap, so an old packet with the same file number is never mistaken for
+ * the requested one.
+ */
+class Spool {
+public:
+	/**
+	 * Header at the beginning of every segment file.
+	 */
+	struct SegmentHeader {
+		uint32_t magic;
+		uint32_t segmentCount;  /**< number of segment files of the spool */
+		uint32_t segmentSize;   /**< size of every segment file (header included) */
+		volatile uint32_t used; /**< bytes used within this segment (header included) */
+		uint64_t firstSeq;      /**< sequence number of the first packet within this segment */
+	};
+
+	static const unsigned RECORD_HEADER_SIZE = sizeof(uint64_t) + sizeof(uint16_t);
+
+	/**
+	 * Returns the file name of segment n within dir.
+	 */
+	static std::string segmentName(const std::string& dir, unsigned n);
+
+protected:
+	Spool() : segmentCount(0), segmentSize(0) {}
+	~Spool();
+
+	SegmentHeader* header(unsigned n) const { return (SegmentHeader*)segments[n]; }
+
+	/**
+	 * Returns the sequence number following last, whose file number is fileNo.
+	 */
+	static uint64_t unwrap(uint64_t last, uint32_t fileNo)
+	{
+		return last + (fileNo + config_space::MAX_FILES - last % config_space::MAX_FILES) % config_space::MAX_FILES;
+	}
+
+	/**
+	 * Maps a segment file into memory.
+	 */
+	static byte* mapSegment(const std::string& name, size_t size, bool writable);
+
+	std::vector<byte*> segments;
+	uint32_t segmentCount;
+	uint32_t segmentSize;
+
+	static const uint32_t MAGIC = 0x49505350; // "IPSP"
+};
+
+
+/**
+ * Collector side of the spool.
+ */
+class SpoolWriter : public Spool {
+public:
+	/**
+	 * Creates and preallocates the segment files.
+	 * @param dir directory for the segment files (packetDir)
+	 * @param count number of segment files
+	 * @param size size of every segment file
+	 */
+	SpoolWriter(const std::string& dir, unsigned count, size_t size);
+
+	/**
+	 * Appends a packet to the spool.
+	 * @param seq file number of the packet
+	 * @param data packet data
+	 * @param len packet length
+	 * @return false if there is no free segment left (the detection modules
+	 *         didn't process the packets of the oldest segment yet)
+	 */
+	bool write(uint32_t seq, const byte* data, uint16_t len);
+
+	/**
+	 * Marks the oldest packet within the spool as processed.
+	 */
+	void release();
+
+private:
+	unsigned current;
+	unsigned oldest;
+	uint64_t lastSeq;
+
+	/* packets within every segment that weren't released yet */
+	std::vector<unsigned> outstanding;
+	Mutex lock;
+};
+
+
+/**
+ * Detection module side of the spool.
+ */
+class SpoolReader : public Spool {
+public:
+	/**
+	 * Maps all segment files of the spool read-only.
+	 * @param dir directory containing the segment files (packetDir)
+	 */
+	SpoolReader(const std::string& dir);
+
+	/**
+	 * Looks up a packet. Packets are expected to be read in order of
+	 * their sequence numbers, other packets are searched within all segments.
+	 * @param seq file number of the packet
+	 * @param data will point to the packet data within the segment
+	 * @return packet length, 0 if the packet is not within the spool
+	 */
+	uint16_t read(uint32_t seq, const byte** data);
+
+private:
+	/**
+	 * Returns the packet at offset within segment n if it has sequence number seq.
+	 */
+	uint16_t readAt(unsigned n, uint32_t offset, uint64_t seq, const byte** data);
+
+	unsigned current;
+	uint32_t offset;
+	uint64_t lastSeq;     /**< sequence number of the last packet read */
+	bool tracking;        /**< false until the first packet was found */
+};
+
+#endif
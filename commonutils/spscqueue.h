@@ -0,0 +1,181 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+
+/**
+ * Bounded queue for one producer thread and one consumer thread.
+ *
+ * The elements live in a ring of 2^n slots. The producer only writes the
+ * tail index and the consumer only writes the head index, both are
+ * monotonically increasing and live in their own cache line. Adding and
+ * taking elements needs no locks, synchronisation is done by memory
+ * barriers around the index updates.
+ *
+ * A consumer finding the queue empty can sleep in @c waitBatch(). Only then
+ * the producer takes the mutex to wake it up, so the mutex and the
+ * condition variable are not touched as long as elements keep coming.
+ */
+template <class T>
+class SpscQueue {
+public:
+	static const unsigned CACHE_LINE_SIZE = 64;
+
+	/**
+	 * Creates a queue.
+	 * @param capacity minimum number of elements, rounded up to a power of two
+	 */
+	SpscQueue(unsigned capacity = 1024)
+		: slots(NULL)
+	{
+		head.value = 0;
+		tail.value = 0;
+		sleeping = 0;
+		pthread_mutex_init(&mutex, NULL);
+		pthread_cond_init(&cond, NULL);
+		resize(capacity);
+	}
+
+	~SpscQueue()
+	{
+		delete[] slots;
+		pthread_cond_destroy(&cond);
+		pthread_mutex_destroy(&mutex);
+	}
+
+	/**
+	 * Changes the capacity. Must only be called while no other thread uses
+	 * the queue; queued elements are lost.
+	 */
+	void resize(unsigned capacity)
+	{
+		unsigned long size = 1;
+		while (size < capacity)
+			size <<= 1;
+		delete[] slots;
+		slots = new T[size];
+		mask = size - 1;
+		head.value = 0;
+		tail.value = 0;
+	}
+
+	/**
+	 * Number of elements the queue can hold.
+	 */
+	unsigned capacity() const { return mask + 1; }
+
+	/**
+	 * Number of queued elements. Exact when called by producer or consumer,
+	 * an estimate for other threads.
+	 */
+	unsigned depth() const { return tail.value - head.value; }
+
+	/**
+	 * Adds an element (producer side).
+	 * @return false if the queue is full
+	 */
+	bool push(const T& t)
+	{
+		unsigned long pos = tail.value;
+		if (pos - head.value > mask)
+			return false;
+		slots[pos & mask] = t;
+		/* the element must be visible before the new tail, and the
+		   tail before we look for a sleeping consumer */
+		__sync_synchronize();
+		tail.value = pos + 1;
+		__sync_synchronize();
+		if (sleeping) {
+			pthread_mutex_lock(&mutex);
+			pthread_cond_signal(&cond);
+			pthread_mutex_unlock(&mutex);
+		}
+		return true;
+	}
+
+	/**
+	 * Takes up to max elements without waiting (consumer side).
+	 * @return number of elements copied to out
+	 */
+	unsigned popBatch(T* out, unsigned max)
+	{
+		unsigned long pos = head.value;
+		unsigned long n = tail.value - pos;
+		if (n > max)
+			n = max;
+		if (n == 0)
+			return 0;
+		/* read the elements only after reading the tail */
+		__sync_synchronize();
+		for (unsigned long i = 0; i != n; ++i)
+			out[i] = slots[(pos + i) & mask];
+		/* the slots may be overwritten as soon as the head moves */
+		__sync_synchronize();
+		head.value = pos + n;
+		return n;
+	}
+
+	/**
+	 * Takes up to max elements, sleeps while the queue is empty (consumer side).
+	 * @return number of elements copied to out (at least one)
+	 */
+	unsigned waitBatch(T* out, unsigned max)
+	{
+		unsigned n;
+		while (0 == (n = popBatch(out, max))) {
+			pthread_mutex_lock(&mutex);
+			sleeping = 1;
+			__sync_synchronize();
+			while (tail.value == head.value)
+				pthread_cond_wait(&cond, &mutex);
+			sleeping = 0;
+			pthread_mutex_unlock(&mutex);
+		}
+		return n;
+	}
+
+private:
+	/**
+	 * Pads an index to a full cache line to avoid false sharing
+	 * between producer and consumer.
+	 */
+	struct Index {
+		volatile unsigned long value;
+		char pad[CACHE_LINE_SIZE - sizeof(unsigned long)];
+	};
+
+	Index head;   /**< next element to take, written by the consumer */
+	Index tail;   /**< next free slot, written by the producer */
+	T* slots;
+	unsigned long mask;
+
+	volatile int sleeping; /**< consumer waits in waitBatch() */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	/* not copyable */
+	SpscQueue(const SpscQueue&);
+	SpscQueue& operator=(const SpscQueue&);
+};
+
+#endif
@@ -5,7 +5,8 @@
  * into a parsing module.
  */
 
-
+/* recvmmsg() */
+#define _GNU_SOURCE
 
 #include "ipfixReceiver.h"
 
@@ -15,6 +16,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <netinet/in.h>
 #include <sys/types.h>
@@ -25,12 +27,15 @@
 
 #define MAX_MSG_LEN     65536
 
+/* number of datagrams fetched from the socket with one system call */
+#define RECV_BATCH_SIZE 32
+
 /******************************************* Forward declaration *********************************/
 
 static int createUdpIpv4Receiver(IpfixReceiver* ipfixReceiver, int port);
-static void* listenerThread(void* ipfixReceiver_);
+static void* listenerThread(void* ipfixListener_);
 static void destroyUdpReceiver(IpfixReceiver* ipfixReceiver);
-static void udpListener(IpfixReceiver* ipfixReceiver);
+static void udpListener(IpfixListener* listener);
 
 /******************************************* Implementation *************************************/
 
@@ -65,35 +70,79 @@ int deinitializeIpfixReceivers() {
  * @return handle to the created instance.
  */
 IpfixReceiver* createIpfixReceiver(Receiver_Type receiver_type, int port) {
+        return createIpfixReceiverGroup(receiver_type, port, 1, 0);
+}
+
+/**
+ * Creates an IpfixReceiver with several listener threads.
+ * Every listener thread gets its own socket. If more than one listener is
+ * requested, the sockets form a SO_REUSEPORT group and the kernel distributes
+ * the incoming datagrams among them.
+ * @param receiver_type Desired Transport/Network protocol
+ * @param port Port to listen on
+ * @param listenerCount Number of listener threads (>= 1)
+ * @param rcvBufSize Receive buffer size for each socket, 0 keeps the system default
+ * @return handle to the created instance.
+ */
+IpfixReceiver* createIpfixReceiverGroup(Receiver_Type receiver_type, int port, int listenerCount, int rcvBufSize) {
         IpfixReceiver* ipfixReceiver;
+        pthread_rwlockattr_t lockAttr;
+        int i, j;
         
+        if (listenerCount < 1) {
+                msg(MSG_FATAL, "Need at least one listener thread");
+                goto out0;
+        }
+
         if(!(ipfixReceiver=(IpfixReceiver*)malloc(sizeof(IpfixReceiver)))) {
                 msg(MSG_FATAL, "Ran out of memory");
                 goto out0;
         }
         
+        if(!(ipfixReceiver->listeners=(IpfixListener*)calloc(listenerCount, sizeof(IpfixListener)))) {
+                msg(MSG_FATAL, "Ran out of memory");
+                free(ipfixReceiver);
+                goto out0;
+        }
+        for (i = 0; i != listenerCount; ++i) {
+                ipfixReceiver->listeners[i].socket = -1;
+                ipfixReceiver->listeners[i].ipfixReceiver = ipfixReceiver;
+        }
+        ipfixReceiver->listenerCount = listenerCount;
+        ipfixReceiver->rcvBufSize = rcvBufSize;
+        ipfixReceiver->receivedRecords = 0;
+
         ipfixReceiver->receiver_type = receiver_type;
         
         ipfixReceiver->processorCount = 0;
         ipfixReceiver->packetProcessor = NULL;
+        ipfixReceiver->bufferProvider = NULL;
         
         ipfixReceiver->authCount = 0;
         ipfixReceiver->authHosts = NULL;
 	ipfixReceiver->exit = 0;
         
-        if (pthread_mutex_init(&ipfixReceiver->mutex, NULL) != 0) {
-                msg(MSG_FATAL, "Could not init mutex");
+        /* the listeners overlap in holding the read lock, prefer the writer so
+           stopIpfixReceiver() isn't starved */
+        pthread_rwlockattr_init(&lockAttr);
+        pthread_rwlockattr_setkind_np(&lockAttr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        i = pthread_rwlock_init(&ipfixReceiver->lock, &lockAttr);
+        pthread_rwlockattr_destroy(&lockAttr);
+        if (i != 0) {
+                msg(MSG_FATAL, "Could not init lock");
                 goto out1;
         }
         
-        if (pthread_mutex_lock(&ipfixReceiver->mutex) != 0) {
-                msg(MSG_FATAL, "Could not lock mutex");
+        if (pthread_rwlock_wrlock(&ipfixReceiver->lock) != 0) {
+                msg(MSG_FATAL, "Could not lock lock");
                 goto out1;
         }
         
         switch (receiver_type) {
         case UDP_IPV4:
-                createUdpIpv4Receiver(ipfixReceiver, port);
+                if (createUdpIpv4Receiver(ipfixReceiver, port)) {
+                        goto out1;
+                }
                 break;
         case UDP_IPV6:
                 msg(MSG_FATAL, "UDP over IPv6 support isn't implemented yet");
@@ -116,12 +165,26 @@ IpfixReceiver* createIpfixReceiver(Receiver_Type receiver_type, int port) {
         }
 
 
-        if(pthread_create(&(ipfixReceiver->thread), 0, listenerThread, ipfixReceiver) != 0) {
-                msg(MSG_FATAL, "Could not create listener thread");
-                goto out1;
+        for (i = 0; i != listenerCount; ++i) {
+                if(pthread_create(&(ipfixReceiver->listeners[i].thread), 0, listenerThread, &ipfixReceiver->listeners[i]) != 0) {
+                        msg(MSG_FATAL, "Could not create listener thread");
+                        goto out2;
+                }
         }
         
         return ipfixReceiver;
+out2:
+        /* the listeners already started use the receiver, stop them first.
+           shutdown() wakes them up in recvmmsg() */
+        ipfixReceiver->exit = 1;
+        for (j = 0; j != i; ++j) {
+                shutdown(ipfixReceiver->listeners[j].socket, SHUT_RDWR);
+        }
+        pthread_rwlock_unlock(&ipfixReceiver->lock);
+        for (j = 0; j != i; ++j) {
+                pthread_join(ipfixReceiver->listeners[j].thread, NULL);
+        }
+        pthread_rwlock_wrlock(&ipfixReceiver->lock);
 out1:
         destroyIpfixReceiver(ipfixReceiver);
 out0:
@@ -152,12 +215,13 @@ void destroyIpfixReceiver(IpfixReceiver* ipfixReceiver) {
         
         /* general cleanup */
         
-        if (pthread_mutex_unlock(&ipfixReceiver->mutex) != 0) {
-                msg(MSG_FATAL, "Could not unlock mutex");
+        if (pthread_rwlock_unlock(&ipfixReceiver->lock) != 0) {
+                msg(MSG_FATAL, "Could not unlock lock");
         }
 
-        pthread_mutex_destroy(&ipfixReceiver->mutex);
+        pthread_rwlock_destroy(&ipfixReceiver->lock);
        
+        free(ipfixReceiver->listeners);
         free(ipfixReceiver);
 }
 
@@ -170,8 +234,8 @@ void destroyIpfixReceiver(IpfixReceiver* ipfixReceiver) {
  * @return 0 on success
  */
 int startIpfixReceiver(IpfixReceiver* ipfixReceiver) {
-        if (pthread_mutex_unlock(&ipfixReceiver->mutex) != 0) {
-                msg(MSG_FATAL, "Could not unlock mutex");
+        if (pthread_rwlock_unlock(&ipfixReceiver->lock) != 0) {
+                msg(MSG_FATAL, "Could not unlock lock");
                 return -1;
         }
         return 0;
@@ -183,8 +247,8 @@ int startIpfixReceiver(IpfixReceiver* ipfixReceiver) {
  * @return 0 on success, non-zero on error
  */
 int stopIpfixReceiver(IpfixReceiver* ipfixReceiver) {
-        if (pthread_mutex_lock(&ipfixReceiver->mutex) != 0) {
-                msg(MSG_FATAL, "Could not lock mutex");
+        if (pthread_rwlock_wrlock(&ipfixReceiver->lock) != 0) {
+                msg(MSG_FATAL, "Could not lock lock");
                 return -1;
         }
         ipfixReceiver->exit = 1;
@@ -206,6 +270,29 @@ int setPacketProcessors(IpfixReceiver* ipfixReceiver, void* packetProcessor, int
         return 0;
 }
 
+/**
+ * Assigns a buffer provider to the Receiver. Datagrams will be received directly into
+ * the buffers of the provider (zero copy). The provider has to be managed by the calling
+ * instance. Only supported for UDP receivers with a single listener thread, as the
+ * buffers have to be used in the order they were acquired.
+ * @param ipfixReceiver handle of receiver
+ * @param bufferProvider buffer provider, NULL to use the receivers own buffers
+ * @return 0 on success, non-zero on error
+ */
+int setBufferProvider(IpfixReceiver* ipfixReceiver, IpfixBufferProvider* bufferProvider) {
+        if (bufferProvider && ipfixReceiver->listenerCount != 1) {
+                msg(MSG_ERROR, "Buffer providers need exactly one listener thread");
+                return -1;
+        }
+        if (bufferProvider && ipfixReceiver->receiver_type != UDP_IPV4) {
+                msg(MSG_ERROR, "Buffer providers are only supported by UDP receivers");
+                return -1;
+        }
+        ipfixReceiver->bufferProvider = bufferProvider;
+
+        return 0;
+}
+
 /**
  * Checks if PacketProcessors where assigned to the IpfixReceiver
  * @return 0 if no PacketProcessors where assigned, > 0 otherwise
@@ -260,16 +347,17 @@ int isHostAuthorized(IpfixReceiver* ipfixReceiver, struct in_addr* inaddr, int a
 
 /**
  * Thread function responsible for receiving packets from the network
- * @param ipfixReceiver_ handle to an IpfixReceiver created by @c createIpfixReceiver()
+ * @param ipfixListener_ handle to one of the listeners of an IpfixReceiver created by @c createIpfixReceiver()
  * @return NULL
  */
-static void* listenerThread(void* ipfixReceiver_) {
-        IpfixReceiver* ipfixReceiver = (IpfixReceiver*)ipfixReceiver_;
+static void* listenerThread(void* ipfixListener_) {
+        IpfixListener* listener = (IpfixListener*)ipfixListener_;
+        IpfixReceiver* ipfixReceiver = (IpfixReceiver*)listener->ipfixReceiver;
 
         switch (ipfixReceiver->receiver_type) {
         case UDP_IPV4:
         case UDP_IPV6:
-                udpListener(ipfixReceiver);
+                udpListener(listener);
                 break;
         case TCP_IPV4:
         case TCP_IPV6:
@@ -289,9 +377,18 @@ static void* listenerThread(void* ipfixReceiver_) {
 void statsIpfixReceiver(void* ipfixReceiver_)
 {
         IpfixReceiver* ipfixReceiver = (IpfixReceiver*)ipfixReceiver_;
+        int i;
 
-	msg_stat("Concentrator: IpfixReceiver: %6d records received", ipfixReceiver->receivedRecords);
-		ipfixReceiver->receivedRecords = 0;
+	msg_stat(MSG_INFO, "Concentrator: IpfixReceiver: %6d records received", ipfixReceiver->receivedRecords);
+	ipfixReceiver->receivedRecords = 0;
+
+        for (i = 0; i != ipfixReceiver->listenerCount; ++i) {
+                IpfixListener* listener = &ipfixReceiver->listeners[i];
+                uint32_t received = __sync_fetch_and_and(&listener->receivedPackets, 0);
+                uint32_t dropped = __sync_fetch_and_and(&listener->droppedPackets, 0);
+                msg_stat(MSG_INFO, "Concentrator: IpfixReceiver: listener %d: %6u packets received, %6u packets dropped",
+                         i, received, dropped);
+        }
 }
 
 
@@ -300,28 +397,66 @@ void statsIpfixReceiver(void* ipfixReceiver_)
 
 /** 
  * Does UDP/IPv4 specific initialization.
+ * Creates one socket per listener thread.
  * @param ipfixReceiver handle to an IpfixReceiver created by @createIpfixReceiver()
  * @param port Port to listen on
  * @return 0 on success, non-zero on error
  */
 static int createUdpIpv4Receiver(IpfixReceiver* ipfixReceiver, int port) {
         struct sockaddr_in serverAddress;
-        
+        int i;
+        int on = 1;
+        int bufSize;
+        socklen_t optLen;
 
-        ipfixReceiver->listen_socket = socket(AF_INET, SOCK_DGRAM, 0);
-        if(ipfixReceiver->listen_socket < 0) {
-                perror("Could not create socket");
-                return -1;
-        }
-        
 	ipfixReceiver->exit = 0;
         
         serverAddress.sin_family = AF_INET;
         serverAddress.sin_addr.s_addr = htonl(INADDR_ANY);
         serverAddress.sin_port = htons(port);
-        if(bind(ipfixReceiver->listen_socket, (struct sockaddr*)&serverAddress, sizeof(struct sockaddr_in)) < 0) {
-                perror("Could not bind socket");
-                return -1;
+
+        for (i = 0; i != ipfixReceiver->listenerCount; ++i) {
+                int sock = socket(AF_INET, SOCK_DGRAM, 0);
+                if(sock < 0) {
+                        perror("Could not create socket");
+                        return -1;
+                }
+                ipfixReceiver->listeners[i].socket = sock;
+
+                if (ipfixReceiver->listenerCount > 1) {
+#ifdef SO_REUSEPORT
+                        if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+                                perror("Could not set SO_REUSEPORT");
+                                return -1;
+                        }
+#else
+                        msg(MSG_FATAL, "SO_REUSEPORT isn't supported, can't run more than one listener");
+                        return -1;
+#endif
+                }
+
+                if (ipfixReceiver->rcvBufSize > 0) {
+                        if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &ipfixReceiver->rcvBufSize,
+                                       sizeof(ipfixReceiver->rcvBufSize)) < 0) {
+                                perror("Could not set SO_RCVBUF");
+                        }
+                        optLen = sizeof(bufSize);
+                        if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufSize, &optLen) == 0) {
+                                msg(MSG_INFO, "Socket receive buffer size is %d bytes", bufSize);
+                        }
+                }
+
+#ifdef SO_RXQ_OVFL
+                /* let the kernel tell us how many packets it dropped */
+                if (setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0) {
+                        msg(MSG_INFO, "Could not enable drop counters: %s", strerror(errno));
+                }
+#endif
+
+                if(bind(sock, (struct sockaddr*)&serverAddress, sizeof(struct sockaddr_in)) < 0) {
+                        perror("Could not bind socket");
+                        return -1;
+                }
         }
         return 0;
 }
@@ -332,44 +467,152 @@ static int createUdpIpv4Receiver(IpfixReceiver* ipfixReceiver, int port) {
  * @param ipfixReceiver handle to an IpfixReceiver, created by @createIpfixReceiver()
  */
 static void destroyUdpReceiver(IpfixReceiver* ipfixReceiver) {
-        close(ipfixReceiver->listen_socket);
+        int i;
+        for (i = 0; i != ipfixReceiver->listenerCount; ++i) {
+                if (ipfixReceiver->listeners[i].socket != -1) {
+                        close(ipfixReceiver->listeners[i].socket);
+                }
+        }
+}
+
+
+/**
+ * Updates the drop counter of a listener from the ancillary data of a received message.
+ * @param listener listener which received the message
+ * @param hdr message header
+ */
+static void updateDropCounter(IpfixListener* listener, struct msghdr* hdr) {
+#ifdef SO_RXQ_OVFL
+        struct cmsghdr* cmsg;
+        for (cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                        uint32_t drops;
+                        memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                        __sync_fetch_and_add(&listener->droppedPackets, drops - listener->kernelDrops);
+                        listener->kernelDrops = drops;
+                }
+        }
+#endif
 }
 
 
 /**
  * UDP specific listener function. This function is called by @c listenerThread(), when receiver_type is
  * UDP_IPV4 or UDP_IPV6.
- * @param ipfixReceiver handle to an IpfixReceiver, created by @createIpfixReceiver()
+ * Datagrams are fetched in batches of up to RECV_BATCH_SIZE packets. The whole batch is passed
+ * to the packet processors while holding the locks only once.
+ * If a buffer provider is assigned, datagrams are received directly into its buffers. A datagram
+ * exceeding the providers buffer length continues in the listeners own buffer and is copied there
+ * as a whole.
+ * @param listener one of the listeners of an IpfixReceiver, created by @createIpfixReceiver()
  */
-static void udpListener(IpfixReceiver* ipfixReceiver) {
-        struct sockaddr_in clientAddress;
-        socklen_t clientAddressLen;
-        byte* data = (byte*)malloc(sizeof(byte)*MAX_MSG_LEN);
-        int n, i;
+static void udpListener(IpfixListener* listener) {
+        IpfixReceiver* ipfixReceiver = (IpfixReceiver*)listener->ipfixReceiver;
+        struct sockaddr_in clientAddresses[RECV_BATCH_SIZE];
+        struct mmsghdr msgs[RECV_BATCH_SIZE];
+        struct iovec iovecs[RECV_BATCH_SIZE][2];
+        byte* packets[RECV_BATCH_SIZE];
+        byte* buffers[RECV_BATCH_SIZE];
+        IpfixBufferProvider* provider = ipfixReceiver->bufferProvider;
+        int bufferCount = 0;
+        char controls[RECV_BATCH_SIZE][CMSG_SPACE(sizeof(uint32_t))];
+        int authorized[RECV_BATCH_SIZE];
+        byte* data = (byte*)malloc(sizeof(byte)*MAX_MSG_LEN*RECV_BATCH_SIZE);
+        int n, i, j;
+
+        if (!data) {
+                msg(MSG_FATAL, "Ran out of memory");
+                return;
+        }
+
+        memset(msgs, 0, sizeof(msgs));
+        for (i = 0; i != RECV_BATCH_SIZE; ++i) {
+                msgs[i].msg_hdr.msg_iov = iovecs[i];
+                msgs[i].msg_hdr.msg_name = &clientAddresses[i];
+                msgs[i].msg_hdr.msg_control = controls[i];
+        }
         
         while(!ipfixReceiver->exit) {
-                clientAddressLen = sizeof(struct sockaddr_in);
-                n = recvfrom(ipfixReceiver->listen_socket, data, MAX_MSG_LEN, 0, (struct sockaddr*)&clientAddress, &clientAddressLen);
+                if (provider) {
+                        bufferCount = provider->acquireBuffers(provider->handle, buffers, RECV_BATCH_SIZE, provider->bufferLength);
+                }
+
+                /* the kernel modifies the lengths, reset them before every call */
+                for (i = 0; i != RECV_BATCH_SIZE; ++i) {
+                        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+                        msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+                        if (i < bufferCount) {
+                                iovecs[i][0].iov_base = buffers[i];
+                                iovecs[i][0].iov_len = provider->bufferLength;
+                                iovecs[i][1].iov_base = data + i * MAX_MSG_LEN + provider->bufferLength;
+                                iovecs[i][1].iov_len = MAX_MSG_LEN - provider->bufferLength;
+                                msgs[i].msg_hdr.msg_iovlen = 2;
+                        } else {
+                                iovecs[i][0].iov_base = data + i * MAX_MSG_LEN;
+                                iovecs[i][0].iov_len = MAX_MSG_LEN;
+                                msgs[i].msg_hdr.msg_iovlen = 1;
+                        }
+                }
+
+                n = recvmmsg(listener->socket, msgs, RECV_BATCH_SIZE, MSG_WAITFORONE, NULL);
+                if (n == 0) {
+                        /* socket was shut down */
+                        if (provider)
+                                provider->releaseBuffers(provider->handle);
+                        break;
+                }
                 if (n < 0) {
-                        msg(MSG_DEBUG, "recvfrom returned without data, terminating listener thread");
+                        if (provider)
+                                provider->releaseBuffers(provider->handle);
+                        if (errno == EINTR)
+                                continue;
+                        msg(MSG_DEBUG, "recvmmsg returned without data, terminating listener thread");
                         break;
                 }
                 
-                if (isHostAuthorized(ipfixReceiver, &clientAddress.sin_addr, sizeof(clientAddress.sin_addr))) {
-                        pthread_mutex_lock(&ipfixReceiver->mutex);
-                        IpfixPacketProcessor* pp = (IpfixPacketProcessor*)(ipfixReceiver->packetProcessor);
-                        for (i = 0; i != ipfixReceiver->processorCount; ++i) { 
-                         	pthread_mutex_lock(&pp[i].mutex);
-				pp[i].processPacketCallbackFunction(pp[i].ipfixParser, data, n);
-                        	pthread_mutex_unlock(&pp[i].mutex);
-			}
-                        pthread_mutex_unlock(&ipfixReceiver->mutex);
+                __sync_fetch_and_add(&listener->receivedPackets, n);
+                updateDropCounter(listener, &msgs[n-1].msg_hdr);
+
+                for (i = 0; i != n; ++i) {
+                        packets[i] = iovecs[i][0].iov_base;
+                        if (msgs[i].msg_hdr.msg_iovlen == 2 && msgs[i].msg_len > iovecs[i][0].iov_len) {
+                                /* datagram didn't fit into the providers buffer */
+                                packets[i] = data + i * MAX_MSG_LEN;
+                                memcpy(packets[i], iovecs[i][0].iov_base, iovecs[i][0].iov_len);
+                        }
+                        authorized[i] = isHostAuthorized(ipfixReceiver, &clientAddresses[i].sin_addr,
+                                                         sizeof(clientAddresses[i].sin_addr));
+                        if (!authorized[i]) {
+                                msg(MSG_DEBUG, "packet from unauthorized host %s discarded", inet_ntoa(clientAddresses[i].sin_addr));
+                        }
                 }
-                else{
-                        msg(MSG_DEBUG, "packet from unauthorized host %s discarded", inet_ntoa(clientAddress.sin_addr));
+
+                /* the read lock only pauses us while the receiver is stopped, the listeners
+                   run in parallel. They serialize on the packetProcessors mutexes, as a
+                   processors parser keeps the template state of all exporters */
+                pthread_rwlock_rdlock(&ipfixReceiver->lock);
+                if (ipfixReceiver->exit) {
+                        pthread_rwlock_unlock(&ipfixReceiver->lock);
+                        if (provider)
+                                provider->releaseBuffers(provider->handle);
+                        break;
+                }
+                IpfixPacketProcessor* pp = (IpfixPacketProcessor*)(ipfixReceiver->packetProcessor);
+                for (j = 0; j != ipfixReceiver->processorCount; ++j) { 
+                        pthread_mutex_lock(&pp[j].mutex);
+                        for (i = 0; i != n; ++i) {
+                                if (authorized[i]) {
+                                        pp[j].processPacketCallbackFunction(pp[j].ipfixParser, packets[i], msgs[i].msg_len);
+                                }
+                        }
+                        pthread_mutex_unlock(&pp[j].mutex);
+                }
+                pthread_rwlock_unlock(&ipfixReceiver->lock);
+
+                if (provider) {
+                        provider->releaseBuffers(provider->handle);
                 }
         }
         
         free(data);
 }
-
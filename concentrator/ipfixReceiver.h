@@ -44,17 +44,53 @@ typedef enum {
 } Receiver_Type;
 
 
+/**
+ * State of one listener thread. A receiver runs one or more listener threads,
+ * each of them with its own socket.
+ */
+typedef struct {
+        int socket;
+        pthread_t thread;
+        void* ipfixReceiver;       /**< IpfixReceiver this listener belongs to */
+
+        uint32_t receivedPackets;  /**< Statistics: Packets received since last statistics were polled */
+        uint32_t droppedPackets;   /**< Statistics: Packets dropped by the kernel since last statistics were polled */
+        uint32_t kernelDrops;      /**< Last (absolute) drop counter reported by the kernel */
+} IpfixListener;
+
+/**
+ * Lets the receiver read datagrams directly into buffers owned by someone else
+ * (e.g. slots of a shared memory ring) instead of its own receive buffer.
+ * The buffers are passed to the packetProcessors as usual.
+ */
+typedef struct {
+        void* handle;
+        /**
+         * Reserves up to count buffers of length bytes each.
+         * @return number of reserved buffers
+         */
+        int (*acquireBuffers)(void* handle, uint8_t** buffers, int count, uint16_t length);
+        /**
+         * Called after all received packets were passed to the packetProcessors.
+         * Buffers that weren't used can be reclaimed.
+         */
+        void (*releaseBuffers)(void* handle);
+        uint16_t bufferLength; /**< datagrams exceeding this length are received into the receivers own buffer */
+} IpfixBufferProvider;
+
 /**
  * Control structure for receiving process.
  */
 typedef struct {
-        int listen_socket;
+        IpfixListener* listeners;  /**< One entry per listener thread */
+        int listenerCount;
+        int rcvBufSize;            /**< Socket receive buffer size, 0 for system default */
 
         int* connected_sockets;
         int connection_count;
 
-        pthread_mutex_t mutex; /**< Mutex to pause receiving thread */
-        pthread_t thread;      /**< Thread ID for this particular instance, to sync against etc */
+        pthread_rwlock_t lock; /**< Held for reading by the listeners while they pass packets on,
+                                  for writing to pause them. Listeners don't block each other */
 
         int authCount;
         struct in_addr* authHosts; /**< List of authorized hosts. Only packets from hosts in this list, will be 
@@ -64,6 +100,7 @@ typedef struct {
                                       of packetProcessor must be created, managed and destroyed by an superior instance. The
                                       IpfixReceiver will only work with the given list */
         int processorCount;
+        IpfixBufferProvider* bufferProvider; /**< NULL if datagrams are received into the receivers own buffers */
 	int exit; /**< exit flag to terminate thread */
 
 	uint32_t receivedRecords; /**< Statistics: Total number of data (or dataData) records received since last statistics were polled */
@@ -76,6 +113,7 @@ int initializeIpfixReceivers();
 int deinitializeIpfixReceivers();
 
 IpfixReceiver* createIpfixReceiver(Receiver_Type receiver_type, int port);
+IpfixReceiver* createIpfixReceiverGroup(Receiver_Type receiver_type, int port, int listenerCount, int rcvBufSize);
 void destroyIpfixReceiver(IpfixReceiver* ipfixReceiver);
 
 int startIpfixReceiver(IpfixReceiver* ipfixReceiver);
@@ -84,6 +122,7 @@ int stopIpfixReceiver(IpfixReceiver* ipfixReceiver);
 int addAuthorizedHost(IpfixReceiver* ipfixReceiver, const char*);
 int isHostAuthorized(IpfixReceiver* ipfixReceiver, struct in_addr* inaddr, int addrlen);
 int setPacketProcessors(IpfixReceiver* ipfixReceiver, void* packetProcessor, int processorCount);
+int setBufferProvider(IpfixReceiver* ipfixReceiver, IpfixBufferProvider* bufferProvider);
 
 void statsIpfixReceiver(void* ipfixReceiver);
 
@@ -194,14 +194,25 @@ static void processTemplateSet(IpfixParser* ipfixParser, SourceID sourceId, Ipfi
 				record = (byte*)((byte*)record+4);
 			}
 		}
+		bt->fixedPrefixFields = ti->fieldCount;
+		bt->fixedPrefixLength = bt->recordLength;
 		if (isLengthVarying) {
+			/* offsets of the fields in front of the first variable-length field are
+			   the same for every record. processDataSet only has to decode the rest */
+			bt->fixedPrefixLength = 0;
+			for (fieldNo = 0; fieldNo < ti->fieldCount && !ti->fieldInfo[fieldNo].type.isVariableLength; fieldNo++) {
+				bt->fixedPrefixLength += ti->fieldInfo[fieldNo].type.length;
+			}
+			bt->fixedPrefixFields = fieldNo;
 			bt->recordLength = 65535;
-			for (fieldNo = 0; fieldNo < ti->fieldCount; fieldNo++) {
+			for (; fieldNo < ti->fieldCount; fieldNo++) {
 				ti->fieldInfo[fieldNo].offset = 65535;
 			}
 		}
         
-		bufferTemplate(ipfixParser->templateBuffer, bt); 
+		if (bufferTemplate(ipfixParser->templateBuffer, bt) != 0) {
+			continue;
+		}
 		// FIXME: Template expiration disabled for debugging
 		// bt->expires = time(0) + TEMPLATE_EXPIRE_SECS;
 
@@ -237,6 +248,8 @@ static void processOptionsTemplateSet(IpfixParser* ipfixParser, SourceID sourceI
 		bt->sourceID = sourceId;
 		bt->templateID = ntohs(th->templateId);
 		bt->recordLength = 0;
+		bt->fixedPrefixFields = 0;
+		bt->fixedPrefixLength = 0;
 		bt->setID = ntohs(set->id);
 		bt->optionsTemplateInfo = ti;
 		ti->userData = 0;
@@ -289,7 +302,9 @@ static void processOptionsTemplateSet(IpfixParser* ipfixParser, SourceID sourceI
 				ti->fieldInfo[fieldNo].offset = 65535;
 			}
 		}
-		bufferTemplate(ipfixParser->templateBuffer, bt); 
+		if (bufferTemplate(ipfixParser->templateBuffer, bt) != 0) {
+			continue;
+		}
 		// FIXME: Template expiration disabled for debugging
 		// bt->expires = time(0) + TEMPLATE_EXPIRE_SECS;
 
@@ -326,6 +341,8 @@ static void processDataTemplateSet(IpfixParser* ipfixParser, SourceID sourceId,
 		bt->sourceID = sourceId;
 		bt->templateID = ntohs(th->templateId);
 		bt->recordLength = 0;
+		bt->fixedPrefixFields = 0;
+		bt->fixedPrefixLength = 0;
 		bt->setID = ntohs(set->id);
 		bt->dataTemplateInfo = ti;
 		ti->userData = 0;
@@ -398,7 +415,9 @@ static void processDataTemplateSet(IpfixParser* ipfixParser, SourceID sourceId,
 		/* Advance record to end of fixed data block, i.e. start of next template*/
 		record += dataLength;
 
-		bufferTemplate(ipfixParser->templateBuffer, bt); 
+		if (bufferTemplate(ipfixParser->templateBuffer, bt) != 0) {
+			continue;
+		}
 		// FIXME: Template expiration disabled for debugging
 		// bt->expires = time(0) + TEMPLATE_EXPIRE_SECS;
 
@@ -464,9 +483,10 @@ static void processDataSet(IpfixParser* ipfixParser, SourceID sourceId, IpfixSet
 
 			/* We assume that all variable-length records are >= 4 byte, so we stop processing when only 3 bytes are left */
 			while (record < recordX - 3) {
-				int recordLength=0;
+				/* the leading fixed-length fields were decoded when the template arrived */
+				int recordLength = bt->fixedPrefixLength;
 				int i;
-				for (i = 0; i < ti->fieldCount; i++) {
+				for (i = bt->fixedPrefixFields; i < ti->fieldCount; i++) {
 					int fieldLength = 0;
 					if (!ti->fieldInfo[i].type.isVariableLength) {
 						fieldLength = ti->fieldInfo[i].type.length;
@@ -696,6 +716,8 @@ static int processIpfixPacket(IpfixParser* ipfixParser, byte* message, uint16_t
  */     
 static int processMessage(IpfixParser* ipfixParser, byte* message, uint16_t length) {
 	IpfixHeader* header = (IpfixHeader*)message;
+	/* expiry checks within this packet use the same timestamp */
+	updateTemplateBufferTime((TemplateBuffer*)ipfixParser->templateBuffer);
 	if (ntohs(header->version) == 0x000a) {
 		return processIpfixPacket(ipfixParser, message, length);
 	}
@@ -27,37 +27,161 @@
 
 /***** Internal Functions ****************************************************/
 
-/***** Exported Functions ****************************************************/
+/**
+ * Hashes (sourceID, templateID) to a slot number
+ */
+static uint32_t templateHash(TemplateBuffer* templateBuffer, SourceID sourceId, TemplateID templateId)
+{
+	uint64_t key = ((uint64_t)sourceId << 16) | templateId;
+	/* fibonacci hashing */
+	key *= 0x9E3779B97F4A7C15ULL;
+	return (uint32_t)(key >> 32) & (templateBuffer->size - 1);
+}
 
 /**
- * Returns a TemplateInfo, OptionsTemplateInfo, DataTemplateInfo or NULL
+ * Returns the slot containing (sourceID, templateID) or the empty slot
+ * where it would have to be inserted
  */
-BufferedTemplate* getBufferedTemplate(TemplateBuffer* templateBuffer, SourceID sourceId, TemplateID templateId) 
+static uint32_t findSlot(TemplateBuffer* templateBuffer, SourceID sourceId, TemplateID templateId)
 {
-	time_t now = time(0);
-	BufferedTemplate* bt = templateBuffer->head;
-	while (bt != 0) {
+	uint32_t mask = templateBuffer->size - 1;
+	uint32_t i = templateHash(templateBuffer, sourceId, templateId);
+	BufferedTemplate* bt;
+	while ((bt = templateBuffer->table[i]) != 0) {
 		if ((bt->sourceID == sourceId) && (bt->templateID == templateId)) {
-			if ((bt->expires) && (bt->expires < now)) {
-				destroyBufferedTemplate(templateBuffer, sourceId, templateId);
-				return 0;
-			}
-			return bt;
+			break;
+		}
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+/**
+ * Doubles the size of the hash table
+ * @return 0 on success
+ */
+static int growTemplateBuffer(TemplateBuffer* templateBuffer)
+{
+	BufferedTemplate** oldTable = templateBuffer->table;
+	uint32_t oldSize = templateBuffer->size;
+	uint32_t i;
+
+	BufferedTemplate** table = (BufferedTemplate**)calloc(oldSize * 2, sizeof(BufferedTemplate*));
+	if (!table) {
+		msg(MSG_FATAL, "Ran out of memory");
+		return -1;
+	}
+	templateBuffer->table = table;
+	templateBuffer->size = oldSize * 2;
+
+	for (i = 0; i != oldSize; i++) {
+		BufferedTemplate* bt = oldTable[i];
+		if (bt) {
+			templateBuffer->table[findSlot(templateBuffer, bt->sourceID, bt->templateID)] = bt;
 		}
-		bt = (BufferedTemplate*)bt->next;
 	}
+	free(oldTable);
 	return 0;
 }
 
+/**
+ * Removes the entry in slot i from the hash table. Following entries of
+ * the same probe sequence are moved backwards, so no tombstones are needed.
+ */
+static void removeSlot(TemplateBuffer* templateBuffer, uint32_t i)
+{
+	uint32_t mask = templateBuffer->size - 1;
+	uint32_t j = i;
+	templateBuffer->table[i] = 0;
+	templateBuffer->count--;
+	for (;;) {
+		BufferedTemplate* bt;
+		uint32_t home;
+		j = (j + 1) & mask;
+		if ((bt = templateBuffer->table[j]) == 0) {
+			return;
+		}
+		home = templateHash(templateBuffer, bt->sourceID, bt->templateID);
+		/* move bt to the gap at i if its home slot isn't located cyclically in (i, j] */
+		if ((i <= j) ? ((i < home) && (home <= j)) : ((i < home) || (home <= j))) {
+			continue;
+		}
+		templateBuffer->table[i] = bt;
+		templateBuffer->table[j] = 0;
+		i = j;
+	}
+}
+
+/**
+ * Frees a template that never made it into the buffer. No destruction
+ * callbacks are invoked, as nobody has been told about the template.
+ */
+static void freeTemplate(BufferedTemplate* bt)
+{
+	if (bt->setID == IPFIX_SetId_OptionsTemplate) {
+		free(bt->optionsTemplateInfo->scopeInfo);
+		free(bt->optionsTemplateInfo->fieldInfo);
+		free(bt->optionsTemplateInfo);
+	} else if (bt->setID == IPFIX_SetId_DataTemplate) {
+		free(bt->dataTemplateInfo->fieldInfo);
+		free(bt->dataTemplateInfo->dataInfo);
+		free(bt->dataTemplateInfo->data);
+		free(bt->dataTemplateInfo);
+	} else {
+		free(bt->templateInfo->fieldInfo);
+		free(bt->templateInfo);
+	}
+	free(bt);
+}
+
+/***** Exported Functions ****************************************************/
+
+/**
+ * Updates the time used for template expiry checks.
+ * Call once per packet instead of once per data set.
+ */
+void updateTemplateBufferTime(TemplateBuffer* templateBuffer)
+{
+	templateBuffer->now = time(0);
+}
+
+/**
+ * Returns a TemplateInfo, OptionsTemplateInfo, DataTemplateInfo or NULL
+ */
+BufferedTemplate* getBufferedTemplate(TemplateBuffer* templateBuffer, SourceID sourceId, TemplateID templateId) 
+{
+	BufferedTemplate* bt = templateBuffer->table[findSlot(templateBuffer, sourceId, templateId)];
+	if (bt == 0) {
+		return 0;
+	}
+	if ((bt->expires) && (bt->expires < templateBuffer->now)) {
+		destroyBufferedTemplate(templateBuffer, sourceId, templateId);
+		return 0;
+	}
+	return bt;
+}
+
 /**
  * Saves a TemplateInfo, OptionsTemplateInfo, DataTemplateInfo overwriting existing Templates
+ * @return 0 on success. On failure bt has been freed
  */
-void bufferTemplate(TemplateBuffer* templateBuffer, BufferedTemplate* bt) 
+int bufferTemplate(TemplateBuffer* templateBuffer, BufferedTemplate* bt) 
 {
 	destroyBufferedTemplate(templateBuffer, bt->sourceID, bt->templateID);
-	bt->next = templateBuffer->head;
 	bt->expires = 0;
-	templateBuffer->head = bt;
+	/* keep the load factor below 1/2. If the table can't grow, go on filling
+	   it as long as one empty slot is left to terminate the probe sequences */
+	if (2 * (templateBuffer->count + 1) > templateBuffer->size) {
+		if (growTemplateBuffer(templateBuffer) && (templateBuffer->count + 1 >= templateBuffer->size)) {
+			msg(MSG_ERROR, "Template buffer full, dropping template %d of source %u",
+			    bt->templateID, bt->sourceID);
+			freeTemplate(bt);
+			return -1;
+		}
+	}
+	templateBuffer->table[findSlot(templateBuffer, bt->sourceID, bt->templateID)] = bt;
+	templateBuffer->count++;
+	return 0;
 }
 
 /**
@@ -65,21 +189,10 @@ void bufferTemplate(TemplateBuffer* templateBuffer, BufferedTemplate* bt)
  */
 void destroyBufferedTemplate(TemplateBuffer* templateBuffer, SourceID sourceId, TemplateID templateId) 
 {
-	BufferedTemplate* predecessor = 0;
-	BufferedTemplate* bt = templateBuffer->head;
-	while (bt != 0) {
-		if ((bt->sourceID == sourceId) && (bt->templateID == templateId)) {
-			break;
-		}
-		predecessor = bt;
-		bt = (BufferedTemplate*)bt->next;
-	}
+	uint32_t i = findSlot(templateBuffer, sourceId, templateId);
+	BufferedTemplate* bt = templateBuffer->table[i];
 	if (bt == 0) return;
-	if (predecessor != 0) {
-		predecessor->next = bt->next;
-	} else {
-		templateBuffer->head = (BufferedTemplate*)bt->next;
-	}
+	removeSlot(templateBuffer, i);
 	if (bt->setID == IPFIX_SetId_Template) {
 		free(bt->templateInfo->fieldInfo);
 
@@ -151,23 +264,42 @@ void destroyBufferedTemplate(TemplateBuffer* templateBuffer, SourceID sourceId,
  */
 TemplateBuffer* createTemplateBuffer(IpfixParser* parentIpfixParser) {
 	TemplateBuffer* templateBuffer = (TemplateBuffer*)malloc(sizeof(TemplateBuffer));
+	if (!templateBuffer) {
+		msg(MSG_FATAL, "Ran out of memory");
+		goto out0;
+	}
 
-	templateBuffer->head = 0;
+	templateBuffer->table = (BufferedTemplate**)calloc(TEMPLATE_BUFFER_INITIAL_SIZE, sizeof(BufferedTemplate*));
+	if (!templateBuffer->table) {
+		msg(MSG_FATAL, "Ran out of memory");
+		goto out1;
+	}
+	templateBuffer->size = TEMPLATE_BUFFER_INITIAL_SIZE;
+	templateBuffer->count = 0;
+	templateBuffer->now = time(0);
 	templateBuffer->ipfixParser = parentIpfixParser;
 
 	return templateBuffer;
+out1:
+	free(templateBuffer);
+out0:
+	return 0;
 }
 
 /**
  * Destroys all buffered templates
  */
 void destroyTemplateBuffer(TemplateBuffer* templateBuffer) {
-	while (templateBuffer->head != 0) {
-		BufferedTemplate* bt = templateBuffer->head;
-		BufferedTemplate* bt2 = (BufferedTemplate*)bt->next;
-		destroyBufferedTemplate(templateBuffer, bt->sourceID, bt->templateID);
-		templateBuffer->head = bt2;
+	uint32_t i = 0;
+	while (templateBuffer->count > 0) {
+		BufferedTemplate* bt = templateBuffer->table[i];
+		if (bt) {
+			destroyBufferedTemplate(templateBuffer, bt->sourceID, bt->templateID);
+			/* backward shifting may have moved another template into slot i */
+			continue;
+		}
+		i++;
 	}
+	free(templateBuffer->table);
 	free(templateBuffer);
 }
-
@@ -13,6 +13,9 @@ extern "C" {
 
 #define TEMPLATE_EXPIRE_SECS  60
 
+/** Initial number of slots in the template hash table. Must be a power of two */
+#define TEMPLATE_BUFFER_INITIAL_SIZE 64
+
 /***** Data Types ************************************************************/
 
 /**
@@ -24,19 +27,25 @@ typedef struct {
 	uint16_t	recordLength; /**< length of one Data Record that will be transferred in Data Sets. Variable-length carry -1 */
 	TemplateID	setID;        /**< should be 2,3,4 and determines the type of pointer used in the unions */
 	time_t		expires;      /**< Timestamp when this Template will expire or 0 if it will never expire */
+	uint16_t	fixedPrefixFields; /**< Variable-length templates: number of leading fixed-length fields. Their offsets never change */
+	uint16_t	fixedPrefixLength; /**< Variable-length templates: total length of the leading fixed-length fields */
 	union {
 		TemplateInfo* templateInfo;
 		OptionsTemplateInfo* optionsTemplateInfo;
 		DataTemplateInfo* dataTemplateInfo;
 	};
-	void*	next;             /**< Pointer to next buffered Template */
 } BufferedTemplate;
 
 /**
- * Represents a Template Buffer
+ * Represents a Template Buffer.
+ * Templates are stored in an open addressing hash table (linear probing)
+ * keyed by (sourceID, templateID).
  */
 typedef struct {
-	BufferedTemplate* head; /**< Start of BufferedTemplate chain */
+	BufferedTemplate** table; /**< Hash table, NULL marks an empty slot */
+	uint32_t size;            /**< Number of slots in table, always a power of two */
+	uint32_t count;           /**< Number of buffered templates */
+	time_t now;               /**< Time used for expiry checks, see @c updateTemplateBufferTime() */
 	IpfixParser* ipfixParser; /**< Pointer to the ipfixReceiver which instantiated this TemplateBuffer */
 } TemplateBuffer;
 
@@ -47,7 +56,8 @@ TemplateBuffer* createTemplateBuffer(IpfixParser* parentIpfixParser);
 void destroyTemplateBuffer(TemplateBuffer* templateBuffer);
 BufferedTemplate* getBufferedTemplate(TemplateBuffer* templateBuffer, SourceID sourceId, TemplateID templateId);
 void destroyBufferedTemplate(TemplateBuffer* templateBuffer, SourceID sourceId, TemplateID id);
-void bufferTemplate(TemplateBuffer* templateBuffer, BufferedTemplate* bt);
+int bufferTemplate(TemplateBuffer* templateBuffer, BufferedTemplate* bt);
+void updateTemplateBufferTime(TemplateBuffer* templateBuffer);
 
 
 #ifdef __cplusplus
@@ -62,8 +62,9 @@ void AgeBloomFilter::init(uint32_t size, unsigned hashfunctions)
 {
     hf_number = hashfunctions;
     initHF();
-    filter_size = size;
-    filter.resize(size);
+    filter_size = roundSize(size);
+    filter_mask = filter_size - 1;
+    filter.resize(filter_size);
 }
 
 void AgeBloomFilter::clear()
@@ -75,9 +76,10 @@ uint16_t AgeBloomFilter::getLastTime(uint8_t* input, unsigned len, uint16_t time
 {
     uint16_t ret = 0;
     uint16_t current, diff, maxdiff = 0;
+    HashValue h = hash(input, len);
     for(unsigned i=0; i < hf_number; i++) 
     {
-	current = filter.get(hashU(input, len, filter_size, hf_list[i].seed));
+	current = filter.get(index(h, i, filter_mask));
 	diff = time - current;
 	if(diff > maxdiff)
 	{
@@ -92,9 +94,10 @@ uint16_t AgeBloomFilter::getAndSetLastTime(uint8_t* input, unsigned len, uint16_
 {
     uint16_t ret = 0;
     uint16_t current, diff, maxdiff = 0;
+    HashValue h = hash(input, len);
     for(unsigned i=0; i < hf_number; i++) 
     {
-	current = filter.getAndSet(hashU(input, len, filter_size, hf_list[i].seed), time);
+	current = filter.getAndSet(index(h, i, filter_mask), time);
 	diff = time - current;
 	if(diff > maxdiff)
 	{
@@ -17,7 +17,6 @@
 /**************************************************************************/
 
 #include <iostream>
-#include <gsl/gsl_rng.h>
 #include "bloomfilter.h"
 
 class AgeArray {
@@ -55,11 +54,11 @@ class AgeBloomFilter : public HashFunctions
     friend std::ostream & operator << (std::ostream &, const AgeBloomFilter &);
 
     public:
-    AgeBloomFilter() : HashFunctions(), filter_size(0) {}
+    AgeBloomFilter() : HashFunctions(), filter_size(0), filter_mask(0) {}
 
-    AgeBloomFilter(uint32_t size, unsigned hashfunctions) : HashFunctions(hashfunctions), filter_size(size) 
+    AgeBloomFilter(uint32_t size, unsigned hashfunctions) : HashFunctions()
     {
-	filter.resize(size);
+	init(size, hashfunctions);
     }
 
     ~AgeBloomFilter() {}
@@ -72,6 +71,7 @@ class AgeBloomFilter : public HashFunctions
     private:
     AgeArray filter;
     uint32_t filter_size;
+    uint32_t filter_mask;
 };
 
 std::ostream & operator << (std::ostream &, const AgeBloomFilter &);
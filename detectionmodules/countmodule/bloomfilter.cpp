@@ -18,6 +18,9 @@
 
 #include "bloomfilter.h"
 
+#include <time.h>
+#include <new>
+
 const uint8_t bitmask[8] =
 {
     0x01, //00000001
@@ -73,30 +76,75 @@ std::ostream & operator << (std::ostream & os, const Bitmap & b)
 
 void HashFunctions::initHF()
 {
-    free(hf_list);
-    hf_list = NULL;
-
-    if(hf_number > 0)
-    {
-	hf_list = (hash_params*) calloc(sizeof(hash_params), hf_number);
+    /* seed only once, filters created within the same second would
+       get the same hash functions otherwise */
+    static bool seeded = false;
+    if(!seeded) {
 	srand(time(0));
-	for(unsigned i=0; i < hf_number; i++)
-	{
-	    hf_list[i].seed = rand();
-	}
+	seeded = true;
     }
+    seed = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+}
+
+uint32_t HashFunctions::roundSize(uint32_t size)
+{
+    uint32_t ret = 1;
+    while(ret < size && ret < 0x80000000U)
+	ret <<= 1;
+    return ret;
 }
 
-uint32_t HashFunctions::hashU(uint8_t* input, uint16_t len, uint32_t max, uint32_t seed) const
+/* MurmurHash64A by Austin Appleby (public domain) */
+uint64_t HashFunctions::hash64(const uint8_t* input, unsigned len) const
 {
-    uint32_t random;
-    uint32_t result = 0;
-    gsl_rng_set(r, seed);
-    for(unsigned i = 0; i < len; i++) {
-	random = gsl_rng_get (r);
-	result = (random*result + input[i]);
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (len * m);
+
+    const uint8_t* end = input + (len & ~7U);
+    for(; input != end; input += 8)
+    {
+	uint64_t k;
+	memcpy(&k, input, 8);
+	k *= m;
+	k ^= k >> r;
+	k *= m;
+	h ^= k;
+	h *= m;
+    }
+
+    switch(len & 7)
+    {
+	/* the remaining bytes are mixed in from the last to the first */
+	case 7: h ^= (uint64_t)input[6] << 48;
+		/* fall through */
+	case 6: h ^= (uint64_t)input[5] << 40;
+		/* fall through */
+	case 5: h ^= (uint64_t)input[4] << 32;
+		/* fall through */
+	case 4: h ^= (uint64_t)input[3] << 24;
+		/* fall through */
+	case 3: h ^= (uint64_t)input[2] << 16;
+		/* fall through */
+	case 2: h ^= (uint64_t)input[1] << 8;
+		/* fall through */
+	case 1: h ^= (uint64_t)input[0];
+		h *= m;
     }
-    return result % max;
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+HashFunctions::HashValue HashFunctions::hash(const uint8_t* input, unsigned len) const
+{
+    uint64_t h = hash64(input, len);
+    HashValue ret;
+    ret.h1 = (uint32_t)h;
+    ret.h2 = (uint32_t)(h >> 32) | 1;
+    return ret;
 }
 
 uint32_t HashFunctions::ggT(uint32_t m, uint32_t n)
@@ -116,8 +164,9 @@ void BloomFilter::init(uint32_t size, unsigned hashfunctions)
 {
     hf_number = hashfunctions;
     initHF();
-    filter_size = size;
-    filter.resize(size);
+    filter_size = roundSize(size);
+    filter_mask = filter_size - 1;
+    filter.resize(filter_size);
 }
 
 void BloomFilter::clear()
@@ -127,15 +176,17 @@ void BloomFilter::clear()
 
 void BloomFilter::insert(uint8_t* input, unsigned len)
 {
+    HashValue h = hash(input, len);
     for(unsigned i=0; i < hf_number; i++) {
-	filter.set(hashU(input, len, filter_size, hf_list[i].seed));
+	filter.set(index(h, i, filter_mask));
     }
 }
 
 bool BloomFilter::test(uint8_t* input, unsigned len) const
 {
+    HashValue h = hash(input, len);
     for(unsigned i=0; i < hf_number; i++) {
-	if(filter.test(hashU(input, len, filter_size, hf_list[i].seed)) == false)
+	if(filter.test(index(h, i, filter_mask)) == false)
 	    return false;
     }
     return true;
@@ -145,8 +196,9 @@ bool BloomFilter::testBeforeInsert(uint8_t* input, unsigned len)
 {
     bool result = true;
     uint32_t index;
+    HashValue h = hash(input, len);
     for(unsigned i=0; i < hf_number; i++) {
-	index = hashU(input, len, filter_size, hf_list[i].seed);
+	index = HashFunctions::index(h, i, filter_mask);
 	if(filter.test(index) == false)
 	    result = false;
 	filter.set(index);
@@ -160,3 +212,87 @@ std::ostream & operator << (std::ostream & os, const BloomFilter & b)
     return os;
 }
 
+
+void BlockedBloomFilter::init(uint32_t size, unsigned hashfunctions)
+{
+    hf_number = hashfunctions;
+    initHF();
+    size = roundSize(size);
+    block_count = size > BLOCK_BITS ? size / BLOCK_BITS : 1;
+    free(blocks);
+    blocks = NULL;
+    /* blocks are aligned to cache lines */
+    if(posix_memalign((void**)&blocks, sizeof(Block), block_count * sizeof(Block)) != 0)
+	throw std::bad_alloc();
+    clear();
+}
+
+void BlockedBloomFilter::clear()
+{
+    memset(blocks, 0, block_count * sizeof(Block));
+}
+
+BlockedBloomFilter::Block* BlockedBloomFilter::locate(const uint8_t* input, unsigned len, Block& mask) const
+{
+    uint64_t h = hash64(input, len);
+
+    /* the upper half selects the block. The bit positions must not depend
+       on the block, so they are taken from 9 bit slices of a remix of h,
+       which is mixed again after every 7 positions. (A double hashing
+       sequence degenerates to a single bit for small steps.) */
+    uint32_t block = (uint32_t)(((h >> 32) * block_count) >> 32);
+    uint64_t r = h;
+
+    memset(&mask, 0, sizeof(mask));
+    for(unsigned i=0; i < hf_number; i++) {
+	if(i % 7 == 0) {
+	    r ^= r >> 33;
+	    r *= 0xff51afd7ed558ccdULL;
+	    r ^= r >> 33;
+	    r *= 0xc4ceb9fe1a85ec53ULL;
+	    r ^= r >> 33;
+	}
+	uint32_t bit = (uint32_t)(r >> (9 * (i % 7))) & (BLOCK_BITS - 1);
+	mask.words[bit / 64] |= (uint64_t)1 << (bit % 64);
+    }
+    return &blocks[block];
+}
+
+void BlockedBloomFilter::insert(uint8_t* input, unsigned len)
+{
+    Block mask;
+    Block* block = locate(input, len, mask);
+    for(unsigned w=0; w < BLOCK_WORDS; w++)
+	block->words[w] |= mask.words[w];
+}
+
+bool BlockedBloomFilter::test(uint8_t* input, unsigned len) const
+{
+    Block mask;
+    const Block* block = locate(input, len, mask);
+    uint64_t missing = 0;
+    for(unsigned w=0; w < BLOCK_WORDS; w++)
+	missing |= mask.words[w] & ~block->words[w];
+    return missing == 0;
+}
+
+bool BlockedBloomFilter::testBeforeInsert(uint8_t* input, unsigned len)
+{
+    Block mask;
+    Block* block = locate(input, len, mask);
+    uint64_t missing = 0;
+    for(unsigned w=0; w < BLOCK_WORDS; w++) {
+	missing |= mask.words[w] & ~block->words[w];
+	block->words[w] |= mask.words[w];
+    }
+    return missing == 0;
+}
+
+std::ostream & operator << (std::ostream & os, const BlockedBloomFilter & b) 
+{
+    for(uint32_t i=0; i<b.block_count; i++)
+	for(unsigned w=0; w < BlockedBloomFilter::BLOCK_WORDS; w++)
+	    for(unsigned j=0; j < 64; j++)
+		os << (((b.blocks[i].words[w] >> j) & 1) ? '1' : '0');
+    return os;
+}
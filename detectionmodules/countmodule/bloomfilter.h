@@ -17,8 +17,8 @@
 /**************************************************************************/
 
 #include <iostream>
-#include <gsl/gsl_rng.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* GenericKey class holding uint8_t* input for BloomFilter hash functions */
@@ -140,40 +140,46 @@ class Bitmap {
 std::ostream & operator << (std::ostream &, const Bitmap &);
 
 
-/* HashFunctions provides hash functions for filters */
+/* HashFunctions provides hash functions for filters.
+   Only one 64 bit hash is computed per key. The indices of the k hash
+   functions are derived from its two halves by double hashing:
+   index_i = (h1 + i * h2) mod size. Filter sizes are powers of two, so the
+   modulo is a mask. */
 class HashFunctions
 {
     public:
-	HashFunctions() : hf_list(NULL), hf_number(0) 
-	{
-	    r = gsl_rng_alloc (gsl_rng_fishman18);
-	}
+	HashFunctions() : seed(0), hf_number(0) {}
 
-	HashFunctions(unsigned hashfunctions) : hf_list(NULL), hf_number(hashfunctions)
+	HashFunctions(unsigned hashfunctions) : seed(0), hf_number(hashfunctions)
 	{
-	    r = gsl_rng_alloc (gsl_rng_fishman18);
 	    initHF();
 	}
 
-	~HashFunctions()
-	{
-	    free(hf_list);
-	    gsl_rng_free(r);
-	}
+	~HashFunctions() {}
+
+	/* rounds a filter size up to the next power of two */
+	static uint32_t roundSize(uint32_t size);
+
+	/* seeded 64 bit hash of input */
+	uint64_t hash64(const uint8_t* input, unsigned len) const;
 
     protected:
+	struct HashValue
+	{
+	    uint32_t h1;
+	    uint32_t h2; /* always odd, so all k indices differ */
+	};
+
 	void initHF();
-	uint32_t hashU(uint8_t* input, uint16_t len, uint32_t max, uint32_t seed) const;
+	HashValue hash(const uint8_t* input, unsigned len) const;
 	uint32_t ggT(uint32_t m, uint32_t n);
 
-	gsl_rng * r;
-
-	struct hash_params
+	static inline uint32_t index(const HashValue& h, unsigned i, uint32_t mask)
 	{
-	    uint32_t seed;
-	};
+	    return (h.h1 + i * h.h2) & mask;
+	}
 
-	hash_params* hf_list;
+	uint64_t seed;
 	unsigned hf_number;
 };
 
@@ -184,11 +190,11 @@ class BloomFilter : public HashFunctions
     friend std::ostream & operator << (std::ostream &, const BloomFilter &);
 
     public:
-	BloomFilter() : HashFunctions(), filter_size(0) {}
+	BloomFilter() : HashFunctions(), filter_size(0), filter_mask(0) {}
 
-	BloomFilter(uint32_t size, unsigned hashfunctions) : HashFunctions(hashfunctions), filter_size(size) 
+	BloomFilter(uint32_t size, unsigned hashfunctions) : HashFunctions()
 	{
-	    filter.resize(size);
+	    init(size, hashfunctions);
 	}
 
 	~BloomFilter() {}
@@ -202,9 +208,59 @@ class BloomFilter : public HashFunctions
     private:
 	Bitmap filter;
 	uint32_t filter_size;
+	uint32_t filter_mask;
 };
 
 std::ostream & operator << (std::ostream &, const BloomFilter &);
 
 
+/* BlockedBloomFilter places all k bits of a key into one 64 byte block
+   (one cache line), so test and insert touch a single cache line. The bits
+   of a key are combined into a block sized mask first, test and insert
+   are done on whole 64 bit words. Slightly higher false positive rate than
+   BloomFilter for the same size, meant for large filters. */
+class BlockedBloomFilter : public HashFunctions
+{
+    friend std::ostream & operator << (std::ostream &, const BlockedBloomFilter &);
+
+    public:
+	static const unsigned BLOCK_WORDS = 8;
+	static const unsigned BLOCK_BITS = BLOCK_WORDS * 64;
+
+	BlockedBloomFilter() : HashFunctions(), blocks(NULL), block_count(0) {}
+
+	BlockedBloomFilter(uint32_t size, unsigned hashfunctions) : HashFunctions(), blocks(NULL)
+	{
+	    init(size, hashfunctions);
+	}
+
+	~BlockedBloomFilter()
+	{
+	    free(blocks);
+	}
+
+	/* size is rounded up to a power of two, at least one block */
+	void init(uint32_t size, unsigned hashfunctions);
+	void clear();
+	void insert(uint8_t* input, unsigned len);
+	bool test(uint8_t* input, unsigned len) const;
+	bool testBeforeInsert(uint8_t* input, unsigned len);
+
+    private:
+	/* hidden, the filter owns its blocks */
+	BlockedBloomFilter(const BlockedBloomFilter&);
+	BlockedBloomFilter& operator=(const BlockedBloomFilter&);
+
+	struct Block
+	{
+	    uint64_t words[BLOCK_WORDS];
+	};
+
+	/* returns the block of the key and its bits within the block */
+	Block* locate(const uint8_t* input, unsigned len, Block& mask) const;
+
+	Block* blocks;
+	uint32_t block_count;
+};
 
+std::ostream & operator << (std::ostream &, const BlockedBloomFilter &);
@@ -26,7 +26,7 @@ bool CountModule::verbose = false;
 
 /* Constructor and destructor */
 CountModule::CountModule(const std::string& configfile)
-: DetectionBase<CountStore>(configfile), octetThreshold(0), packetThreshold(0), flowThreshold(0)
+: DetectionBase<CountStore, BatchInputPolicy<SemShmNotifier, CountStore> >(configfile), octetThreshold(0), packetThreshold(0), flowThreshold(0)
 {
     /* signal handlers */
     if (signal(SIGTERM, sigTerm) == SIG_ERR) {
@@ -50,6 +50,9 @@ void CountModule::init(const std::string& configfile)
     alarm = 10;
     unsigned bfSize = 1024;
     unsigned bfHF = 3;
+    bool bfBlocked = false;
+    unsigned cmWidth = 65536;
+    unsigned cmDepth = 4;
     char filename[] = "countmodule.txt";
 
     XMLConfObj config = XMLConfObj(configfile, XMLConfObj::XML_FILE);
@@ -130,8 +133,35 @@ void CountModule::init(const std::string& configfile)
 	    bfSize = atoi(config.getValue("bf_size").c_str());
 	if(config.nodeExists("bf_hashfunctions"))
 	    bfHF = atoi(config.getValue("bf_hashfunctions").c_str());
-	CountStore::init(bfSize, bfHF);
-	msgStr << MsgStream::INFO << "Bloomfilter: " << bfSize << " bits, " << bfHF << " hash functions" << MsgStream::endl;
+	if(config.nodeExists("bf_blocked"))
+	    if(config.getValue("bf_blocked") != "false")
+		bfBlocked = true;
+	if(config.nodeExists("hh_top_k"))
+	{
+	    unsigned topK = atoi(config.getValue("hh_top_k").c_str());
+	    if(config.nodeExists("hh_cm_width"))
+		cmWidth = atoi(config.getValue("hh_cm_width").c_str());
+	    if(cmWidth < 2)
+		cmWidth = 2;
+	    if(config.nodeExists("hh_cm_depth"))
+		cmDepth = atoi(config.getValue("hh_cm_depth").c_str());
+	    CountStore::initHeavyHitters(topK, cmWidth, cmDepth);
+	    msgStr << MsgStream::INFO << "Heavy hitters: top " << topK << " keys, Count-Min sketch " << HashFunctions::roundSize(cmWidth)
+		<< " x " << cmDepth << MsgStream::endl;
+	    if(config.nodeExists("hll_precision"))
+		msgStr.print(MsgStream::WARN, "hll_precision is ignored in heavy-hitter mode.");
+	}
+	if(config.nodeExists("hll_precision") && !CountStore::heavyHitterMode())
+	{
+	    CountStore::initSketches(atoi(config.getValue("hll_precision").c_str()));
+	    msgStr << MsgStream::INFO << "HyperLogLog flow counting: " << (1 << HyperLogLog::getPrecision()) << " registers, "
+		<< 100 * HyperLogLog::standardError() << "% standard error" << MsgStream::endl;
+	}
+	else
+	{
+	    CountStore::init(bfSize, bfHF, bfBlocked);
+	    msgStr << MsgStream::INFO << (bfBlocked ? "Blocked bloomfilter: " : "Bloomfilter: ") << BloomFilter::roundSize(bfSize) << " bits, " << bfHF << " hash functions" << MsgStream::endl;
+	}
 
 	msgStr << MsgStream::INFO << "Counting per ";
 	if(config.nodeExists("count_per_src_ip"))
@@ -227,6 +257,10 @@ void CountModule::test(CountStore* store)
     IdmefMessage& idmefMessage = getNewIdmefMessage("Countmodule", "threshold detection");
 #endif
 
+    std::vector<const CountTable::Entry*> entries;
+
+    store->estimateFlowCounts();
+
     msgStr.print(MsgStream::INFO, "Generating report...");
     outfile << "******************** Report *********************" << std::endl;
     outfile << "thresholds: octets>=" << octetThreshold << " packets>=" << packetThreshold << " flows>=" << flowThreshold << std::endl;
@@ -234,111 +268,128 @@ void CountModule::test(CountStore* store)
     if(CountStore::countPerSrcIp)
     {
 	outfile << "per source IP address:" << std::endl;
-	for (CountStore::IpCountMap::const_iterator i = store->srcIpCounts.begin(); i != store->srcIpCounts.end(); ++i) 
+	collect(store->srcIpCounts, store->srcIpHitters, entries);
+	for (unsigned j = 0; j != entries.size(); ++j) 
 	{
-	    if(checkThresholds(i->second))
-	    {
-		outfile << i->first << " \to:" << i->second.octetCount << " \tp:" << i->second.packetCount << " \tf:" << i->second.flowCount << std::endl;
+	    const Counters& counters = entries[j]->counters;
+	    const IpAddress addr(entries[j]->key >> 24, entries[j]->key >> 16, entries[j]->key >> 8, entries[j]->key);
+	    outfile << addr << " \to:" << counters.octetCount << " \tp:" << counters.packetCount << " \tf:" << counters.flowCount << std::endl;
 
 #ifdef IDMEF_SUPPORT_ENABLED
-		idmefMessage = getNewIdmefMessage();
-		idmefMessage.createSourceNode("no", "ipv4-addr", i->first.toString(), "255.255.255.255");
-		ocStr.str(""); ocStr << i->second.octetCount;
-		pcStr.str(""); pcStr << i->second.packetCount;
-		fcStr.str(""); fcStr << i->second.flowCount;
-		orStr.str(""); orStr << (unsigned)(i->second.octetCount/alarm);
-		prStr.str(""); prStr << (unsigned)(i->second.packetCount/alarm);
-		idmefMessage.createExtStatisticsNode(ocStr.str(), pcStr.str(), fcStr.str(), orStr.str(), prStr.str(), "");
-		sendIdmefMessage("Dummy", idmefMessage);
+	    idmefMessage = getNewIdmefMessage();
+	    idmefMessage.createSourceNode("no", "ipv4-addr", addr.toString(), "255.255.255.255");
+	    ocStr.str(""); ocStr << counters.octetCount;
+	    pcStr.str(""); pcStr << counters.packetCount;
+	    fcStr.str(""); fcStr << counters.flowCount;
+	    orStr.str(""); orStr << (unsigned)(counters.octetCount/alarm);
+	    prStr.str(""); prStr << (unsigned)(counters.packetCount/alarm);
+	    idmefMessage.createExtStatisticsNode(ocStr.str(), pcStr.str(), fcStr.str(), orStr.str(), prStr.str(), "");
+	    sendIdmefMessage("Dummy", idmefMessage);
 #endif       
-	    }   
 	}
     }
 
     if(CountStore::countPerDstIp)
     {
 	outfile << "per destination IP address:" << std::endl;
-	for (CountStore::IpCountMap::const_iterator i = store->dstIpCounts.begin(); i != store->dstIpCounts.end(); ++i) 
+	collect(store->dstIpCounts, store->dstIpHitters, entries);
+	for (unsigned j = 0; j != entries.size(); ++j) 
 	{
-	    if(checkThresholds(i->second))
-	    {
-		outfile << i->first << " \to:" << i->second.octetCount << " \tp:" << i->second.packetCount << " \tf:" << i->second.flowCount << std::endl;
+	    const Counters& counters = entries[j]->counters;
+	    const IpAddress addr(entries[j]->key >> 24, entries[j]->key >> 16, entries[j]->key >> 8, entries[j]->key);
+	    outfile << addr << " \to:" << counters.octetCount << " \tp:" << counters.packetCount << " \tf:" << counters.flowCount << std::endl;
 
 #ifdef IDMEF_SUPPORT_ENABLED
-		idmefMessage = getNewIdmefMessage();
-		idmefMessage.createTargetNode("no", "ipv4-addr", i->first.toString(), "255.255.255.255");
-		ocStr.str(""); ocStr << i->second.octetCount;
-		pcStr.str(""); pcStr << i->second.packetCount;
-		fcStr.str(""); fcStr << i->second.flowCount;
-		orStr.str(""); orStr << (unsigned)(i->second.octetCount/alarm);
-		prStr.str(""); prStr << (unsigned)(i->second.packetCount/alarm);
-		idmefMessage.createExtStatisticsNode(ocStr.str(), pcStr.str(), fcStr.str(), orStr.str(), prStr.str(), "");
-		sendIdmefMessage("Dummy", idmefMessage);
+	    idmefMessage = getNewIdmefMessage();
+	    idmefMessage.createTargetNode("no", "ipv4-addr", addr.toString(), "255.255.255.255");
+	    ocStr.str(""); ocStr << counters.octetCount;
+	    pcStr.str(""); pcStr << counters.packetCount;
+	    fcStr.str(""); fcStr << counters.flowCount;
+	    orStr.str(""); orStr << (unsigned)(counters.octetCount/alarm);
+	    prStr.str(""); prStr << (unsigned)(counters.packetCount/alarm);
+	    idmefMessage.createExtStatisticsNode(ocStr.str(), pcStr.str(), fcStr.str(), orStr.str(), prStr.str(), "");
+	    sendIdmefMessage("Dummy", idmefMessage);
 #endif       
-	    }
 	}
     }
 
     if(CountStore::countPerSrcPort)
     {
 	outfile << "per source protocol.port:" << std::endl;
-	for (CountStore::PortCountMap::const_iterator i = store->srcPortCounts.begin(); i != store->srcPortCounts.end(); ++i) 
+	collect(store->srcPortCounts, store->srcPortHitters, entries);
+	for (unsigned j = 0; j != entries.size(); ++j) 
 	{
-	    if(checkThresholds(i->second))
-	    {
-		outfile << (i->first >> 16) << "." << (0x0000FFFF & i->first) << " \to:" << i->second.octetCount << " \tp:" << i->second.packetCount << " \tf:" << i->second.flowCount << std::endl;
+	    const Counters& counters = entries[j]->counters;
+	    const CountStore::ProtoPort key = entries[j]->key;
+	    outfile << (key >> 16) << "." << (0x0000FFFF & key) << " \to:" << counters.octetCount << " \tp:" << counters.packetCount << " \tf:" << counters.flowCount << std::endl;
 
 #ifdef IDMEF_SUPPORT_ENABLED
-		idmefMessage = getNewIdmefMessage();
-		//idmefMessage.createSourceNode("unknown", "ipv4-addr", "0.0.0.0", "0.0.0.0");
-		portStr.str(""); protoStr << (0x0000FFFF & i->first);
-		protoStr.str(""); protoStr << (i->first >> 16);
-		idmefMessage.createServiceNode("Source", "", portStr.str(), "", protoStr.str()); 
-		ocStr.str(""); ocStr << i->second.octetCount;
-		pcStr.str(""); pcStr << i->second.packetCount;
-		fcStr.str(""); fcStr << i->second.flowCount;
-		orStr.str(""); orStr << (unsigned)(i->second.octetCount/alarm);
-		prStr.str(""); prStr << (unsigned)(i->second.packetCount/alarm);
-		idmefMessage.createExtStatisticsNode(ocStr.str(), pcStr.str(), fcStr.str(), orStr.str(), prStr.str(), "");
-		sendIdmefMessage("Dummy", idmefMessage);
+	    idmefMessage = getNewIdmefMessage();
+	    //idmefMessage.createSourceNode("unknown", "ipv4-addr", "0.0.0.0", "0.0.0.0");
+	    portStr.str(""); protoStr << (0x0000FFFF & key);
+	    protoStr.str(""); protoStr << (key >> 16);
+	    idmefMessage.createServiceNode("Source", "", portStr.str(), "", protoStr.str()); 
+	    ocStr.str(""); ocStr << counters.octetCount;
+	    pcStr.str(""); pcStr << counters.packetCount;
+	    fcStr.str(""); fcStr << counters.flowCount;
+	    orStr.str(""); orStr << (unsigned)(counters.octetCount/alarm);
+	    prStr.str(""); prStr << (unsigned)(counters.packetCount/alarm);
+	    idmefMessage.createExtStatisticsNode(ocStr.str(), pcStr.str(), fcStr.str(), orStr.str(), prStr.str(), "");
+	    sendIdmefMessage("Dummy", idmefMessage);
 #endif       
-	    }
 	}
     }
 
     if(CountStore::countPerDstPort)
     {
 	outfile << "per destination protocol.port:" << std::endl;
-	for (CountStore::PortCountMap::const_iterator i = store->dstPortCounts.begin(); i != store->dstPortCounts.end(); ++i) 
+	collect(store->dstPortCounts, store->dstPortHitters, entries);
+	for (unsigned j = 0; j != entries.size(); ++j) 
 	{
-	    if(checkThresholds(i->second))
-	    {
-		outfile << (i->first >> 16) << "." << (0x0000FFFF & i->first) << " \to:" << i->second.octetCount << " \tp:" << i->second.packetCount << " \tf:" << i->second.flowCount << std::endl;
+	    const Counters& counters = entries[j]->counters;
+	    const CountStore::ProtoPort key = entries[j]->key;
+	    outfile << (key >> 16) << "." << (0x0000FFFF & key) << " \to:" << counters.octetCount << " \tp:" << counters.packetCount << " \tf:" << counters.flowCount << std::endl;
 
 #ifdef IDMEF_SUPPORT_ENABLED
-		idmefMessage = getNewIdmefMessage();
-		//idmefMessage.createTargetNode("unknown", "ipv4-addr", "0.0.0.0", "0.0.0.0");
-		portStr.str(""); protoStr << (0x0000FFFF & i->first);
-		protoStr.str(""); protoStr << (i->first >> 16);
-		idmefMessage.createServiceNode("Target", "", portStr.str(), "", protoStr.str()); 
-		ocStr.str(""); ocStr << i->second.octetCount;
-		pcStr.str(""); pcStr << i->second.packetCount;
-		fcStr.str(""); fcStr << i->second.flowCount;
-		orStr.str(""); orStr << (unsigned)(i->second.octetCount/alarm);
-		prStr.str(""); prStr << (unsigned)(i->second.packetCount/alarm);
-		idmefMessage.createExtStatisticsNode(ocStr.str(), pcStr.str(), fcStr.str(), orStr.str(), prStr.str(), "");
-		sendIdmefMessage("Dummy", idmefMessage);
+	    idmefMessage = getNewIdmefMessage();
+	    //idmefMessage.createTargetNode("unknown", "ipv4-addr", "0.0.0.0", "0.0.0.0");
+	    portStr.str(""); protoStr << (0x0000FFFF & key);
+	    protoStr.str(""); protoStr << (key >> 16);
+	    idmefMessage.createServiceNode("Target", "", portStr.str(), "", protoStr.str()); 
+	    ocStr.str(""); ocStr << counters.octetCount;
+	    pcStr.str(""); pcStr << counters.packetCount;
+	    fcStr.str(""); fcStr << counters.flowCount;
+	    orStr.str(""); orStr << (unsigned)(counters.octetCount/alarm);
+	    prStr.str(""); prStr << (unsigned)(counters.packetCount/alarm);
+	    idmefMessage.createExtStatisticsNode(ocStr.str(), pcStr.str(), fcStr.str(), orStr.str(), prStr.str(), "");
+	    sendIdmefMessage("Dummy", idmefMessage);
 #endif       
-	    }
 	}
     }
 
     outfile << "********************* End ***********************" << std::endl;
 
     delete store;
+    /* all tables of the interval are gone, give unneeded memory back */
+    CountTable::trimArena();
+}
+
+void CountModule::collect(CountTable& table, HeavyHitters& hitters, std::vector<const CountTable::Entry*>& entries)
+{
+    if(CountStore::heavyHitterMode())
+    {
+	const CountMinSketch& cm = hitters.sketch();
+	outfile << "(estimated, too high by at most o:" << (uint64_t)(cm.epsilon() * cm.total().octetCount)
+	    << " p:" << (uint64_t)(cm.epsilon() * cm.total().packetCount)
+	    << " f:" << (uint64_t)(cm.epsilon() * cm.total().flowCount)
+	    << " with probability " << 1 - cm.delta() << ")" << std::endl;
+	hitters.collect(entries, ThresholdFilter(*this));
+    }
+    else
+	table.collect(entries, ThresholdFilter(*this));
 }
 
-bool CountModule::checkThresholds(const Counters& count)
+bool CountModule::checkThresholds(const Counters& count) const
 {
     return ((count.octetCount >= octetThreshold) || (count.packetCount >= packetThreshold) || (count.flowCount >= flowThreshold));
 }
@@ -28,7 +28,7 @@
 #include <fstream>
 
 
-class CountModule : public DetectionBase<CountStore> 
+class CountModule : public DetectionBase<CountStore, BatchInputPolicy<SemShmNotifier, CountStore> > 
 {
     public:
 	CountModule(const std::string& configfile);
@@ -74,7 +74,22 @@ to do this)
 	static void sigInt(int);
 
 	void init(const std::string& configfile);
-	bool checkThresholds(const Counters& count);
+	bool checkThresholds(const Counters& count) const;
+
+	/**
+	 * Collects the entries exceeding one of the thresholds from the
+	 * table or, in heavy-hitter mode, from the heavy-hitter summary
+	 */
+	void collect(CountTable& table, HeavyHitters& hitters, std::vector<const CountTable::Entry*>& entries);
+
+	/**
+	 * Selects the table entries exceeding one of the thresholds
+	 */
+	struct ThresholdFilter {
+	    ThresholdFilter(const CountModule& m) : module(m) {}
+	    bool operator()(const Counters& c) const { return module.checkThresholds(c); }
+	    const CountModule& module;
+	};
 };
 
 
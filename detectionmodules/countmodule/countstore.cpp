@@ -19,10 +19,20 @@
 #include "countstore.h"
 #include "countmodule.h"
 
+#include <algorithm>
 #include <cassert>
+#include <new>
 
 
 BloomFilter CountStore::bfilter;
+BlockedBloomFilter CountStore::bbfilter;
+bool CountStore::blockedFilter = false;
+bool CountStore::flowSketches = false;
+bool CountStore::heavyHitters = false;
+unsigned CountStore::hhTopK = 0;
+unsigned CountStore::hhDepth = 0;
+uint32_t CountStore::hhWidth = 0;
+HashFunctions CountStore::flowHasher(1);
 bool CountStore::countPerSrcIp = false;
 bool CountStore::countPerDstIp = false;
 bool CountStore::countPerSrcPort = false;
@@ -38,7 +48,7 @@ void CountStore::addFieldData(int id, byte* fieldData, int fieldDataLength, Ente
 	       */
 	    if(fieldDataLength>=4)
 	    {
-		srcIp.setAddress(fieldData);
+		srcIp = ntohl(*((uint32_t*)fieldData));
 		//flowKey.append(fieldData, 4); // we ignore the netmask
 		flowKey.getQuintuple()->srcIp = *((uint32_t*)fieldData); // we ignore the netmask
 	    }
@@ -51,7 +61,7 @@ void CountStore::addFieldData(int id, byte* fieldData, int fieldDataLength, Ente
 	       */
 	    if(fieldDataLength>=4)
 	    {
-		dstIp.setAddress(fieldData);
+		dstIp = ntohl(*((uint32_t*)fieldData));
 		//flowKey.append(fieldData, 4); // we ignore the netmask
 		flowKey.getQuintuple()->dstIp = *((uint32_t*)fieldData); // we ignore the netmask
 	    }
@@ -101,14 +111,71 @@ void CountStore::addFieldData(int id, byte* fieldData, int fieldDataLength, Ente
 }
 
 
+void CountStore::addRecordBatch(const RecordBatch& batch)
+{
+    batchSketches = flowSketches;
+    for (unsigned i = 0; i != batch.count; ++i)
+    {
+	if (batch.isMalformed(i))
+	    msgStr.print(MsgStream::ERROR, "Invalid field length.");
+	loadRecord(batch, i);
+	countRecord();
+    }
+    if (batchSketches)
+    {
+	flushSketchUpdates();
+	batchSketches = false;
+    }
+}
+
+void CountStore::loadRecord(const RecordBatch& batch, unsigned i)
+{
+    flowKey.reset();
+    srcIp = dstIp = 0;
+    srcPort = dstPort = 0;
+    packets = octets = 0;
+
+    QuintupleKey::Quintuple* q = flowKey.getQuintuple();
+    if (batch.hasField(i, RecordBatch::SRC_IP))
+    {
+	srcIp = ntohl(batch.srcIp[i]);
+	q->srcIp = batch.srcIp[i];
+    }
+    if (batch.hasField(i, RecordBatch::DST_IP))
+    {
+	dstIp = ntohl(batch.dstIp[i]);
+	q->dstIp = batch.dstIp[i];
+    }
+    if (batch.hasField(i, RecordBatch::SRC_PORT))
+    {
+	srcPort = batch.srcPort[i];
+	q->srcPort = htons(batch.srcPort[i]);
+    }
+    if (batch.hasField(i, RecordBatch::DST_PORT))
+    {
+	dstPort = batch.dstPort[i];
+	q->dstPort = htons(batch.dstPort[i]);
+    }
+    if (batch.hasField(i, RecordBatch::PROTO))
+    {
+	srcPort += batch.proto[i] << 16;
+	dstPort += batch.proto[i] << 16;
+	q->proto = batch.proto[i];
+    }
+    if (batch.hasField(i, RecordBatch::OCTETS))
+	octets = batch.octets[i];
+    if (batch.hasField(i, RecordBatch::PACKETS))
+	packets = batch.packets[i];
+}
+
+
 bool CountStore::recordStart(SourceID id) 
 {
     assert(recordStarted == false);
     flowKey.reset();
     recordStarted = true;
 
-    srcIp.setAddress(0,0,0,0);
-    dstIp.setAddress(0,0,0,0);
+    srcIp = dstIp = 0;
     srcPort = dstPort = 0;
     packets = octets = 0;
 
@@ -118,36 +185,67 @@ bool CountStore::recordStart(SourceID id)
 void CountStore::recordEnd() 
 {
     assert(recordStarted == true);
+    countRecord();
+    recordStarted = false;
+}
+
+void CountStore::countRecord()
+{
+    if(flowSketches)
+    {
+	sketchRecordEnd(flowHasher.hash64(flowKey.data, flowKey.len));
+	return;
+    }
+
+    bool newFlowKeyBf;
+    if(blockedFilter)
+	newFlowKeyBf = (bbfilter.testBeforeInsert(flowKey.data,flowKey.len) == false);
+    else
+	newFlowKeyBf = (bfilter.testBeforeInsert(flowKey.data,flowKey.len) == false);
+
+    if(heavyHitters)
+    {
+	// no tables to detect bloom filter collisions
+	uint64_t flows = newFlowKeyBf ? 1 : 0;
+	if(countPerSrcIp)
+	    srcIpHitters.update(srcIp, octets, packets, flows);
+	if(countPerDstIp)
+	    dstIpHitters.update(dstIp, octets, packets, flows);
+	if(countPerSrcPort)
+	    srcPortHitters.update(srcPort, octets, packets, flows);
+	if(countPerDstPort)
+	    dstPortHitters.update(dstPort, octets, packets, flows);
+	return;
+    }
 
-    bool newFlowKeyBf = (bfilter.testBeforeInsert(flowKey.data,flowKey.len) == false);
     bool newFlowKey = newFlowKeyBf;
 
-    IpCountMap::iterator srcIpIter, dstIpIter; 
-    PortCountMap::iterator srcPortIter, dstPortIter; 
+    Counters *srcIpCounters = NULL, *dstIpCounters = NULL;
+    Counters *srcPortCounters = NULL, *dstPortCounters = NULL;
     
     // search flow key in tables first to eventually detect bloom filter colisions
     if(countPerSrcIp)
     {	
-	srcIpIter = srcIpCounts.find(srcIp);
-	if(srcIpIter == srcIpCounts.end())
+	srcIpCounters = srcIpCounts.find(srcIp);
+	if(!srcIpCounters)
 	    newFlowKey = true;
     }
     if(countPerDstIp)
     {	
-	dstIpIter = dstIpCounts.find(dstIp);
-	if(dstIpIter == dstIpCounts.end())
+	dstIpCounters = dstIpCounts.find(dstIp);
+	if(!dstIpCounters)
 	    newFlowKey = true;
     }
     if(countPerSrcPort)
     {	
-	srcPortIter = srcPortCounts.find(srcPort);
-	if(srcPortIter == srcPortCounts.end())
+	srcPortCounters = srcPortCounts.find(srcPort);
+	if(!srcPortCounters)
 	    newFlowKey = true;
     }
     if(countPerDstPort)
     {	
-	dstPortIter = dstPortCounts.find(dstPort);
-	if(dstPortIter == dstPortCounts.end())
+	dstPortCounters = dstPortCounts.find(dstPort);
+	if(!dstPortCounters)
 	    newFlowKey = true;
     }
 
@@ -164,111 +262,174 @@ void CountStore::recordEnd()
     if(countPerSrcIp)
     {
 	msgStr << MsgStream::INFO << "SrcIp: ";
-	updateIpCountMap(srcIpCounts, srcIpIter, srcIp, newFlowKey);
+	updateCountMap(srcIpCounts, srcIpCounters, srcIp, newFlowKey, true);
     }
 
     // DstIp
     if(countPerDstIp)
     {
 	msgStr << MsgStream::INFO << "DstIp: ";
-	updateIpCountMap(dstIpCounts, dstIpIter, dstIp, newFlowKey);
+	updateCountMap(dstIpCounts, dstIpCounters, dstIp, newFlowKey, true);
     }
 
     // SrcPort
     if(countPerSrcPort)
     {
 	msgStr << MsgStream::INFO << "SrcPort: ";
-	updatePortCountMap(srcPortCounts, srcPortIter, srcPort, newFlowKey);
+	updateCountMap(srcPortCounts, srcPortCounters, srcPort, newFlowKey, false);
     }
 
     // DstPort
     if(countPerDstPort)
     {
 	msgStr << MsgStream::INFO << "DstPort: ";
-	updatePortCountMap(dstPortCounts, dstPortIter, dstPort, newFlowKey);
+	updateCountMap(dstPortCounts, dstPortCounters, dstPort, newFlowKey, false);
     }
-
-    recordStarted = false;
 }
 
-void CountStore::updateIpCountMap(IpCountMap& countmap, IpCountMap::iterator& iter, const IpAddress& addr, const bool newFlowKey)
+void CountStore::updateCountMap(CountTable& countmap, Counters* counters, uint32_t key, const bool newFlowKey, bool ipKey)
 {
-    if(iter != countmap.end()) 
+    if(counters) 
     {
 	if(newFlowKey) 
 	{
 	    msgStr << "Update octets, packets, and flows.";
-	    iter->second.update(octets, packets, 1);
+	    counters->update(octets, packets, 1);
 	}
 	else
 	{
 	    msgStr << "Update octets and packets only.";
-	    iter->second.update(octets, packets, 0);
+	    counters->update(octets, packets, 0);
 	}
     }
-    else if(countmap.size() < (countmap.max_size()-1))
+    else if((counters = countmap.insert(key, Counters(octets, packets, 1))) != NULL)
     {
 	msgStr << "Create new table entry.";
-	countmap.insert(std::pair<IpAddress,Counters>(addr, Counters(octets, packets, 1)));
     }
     else
     {
 	msgStr << "I'm out of memory. Update default table entry.";
-	if((iter = countmap.find(IpAddress(0,0,0,0))) != countmap.end())
+	key = 0;
+	if((counters = countmap.find(0)) != NULL)
+	    counters->update(octets, packets, newFlowKey ? 1 : 0);
+	else if((counters = countmap.insert(0, Counters(octets, packets, 1))) == NULL)
 	{
-	    if(newFlowKey)
-		iter->second.update(octets, packets, 1);
-	    else
-		iter->second.update(octets, packets, 0);
+	    msgStr << " Record lost." << MsgStream::endl;
+	    return;
 	}
-	else
-	    countmap.insert(std::pair<IpAddress,Counters>(IpAddress(0,0,0,0), Counters(octets, packets, 1)));
     }
 
     if(CountModule::verbose)
-	if((iter = countmap.find(addr)) != countmap.end())
-	    msgStr << " Table entry: " << iter->first.toString().c_str() 
-		<< " o:"<< iter->second.octetCount <<" p:" << iter->second.packetCount << " f:" << iter->second.flowCount
-		<< MsgStream::endl;
+    {
+	msgStr << " Table entry: ";
+	if(ipKey)
+	    msgStr << IpAddress(key >> 24, key >> 16, key >> 8, key).toString().c_str();
+	else
+	    msgStr << (key >> 16) << "." << (key & 0x0000FFFF);
+	msgStr << " o:"<< counters->octetCount <<" p:" << counters->packetCount << " f:" << counters->flowCount
+	    << MsgStream::endl;
+    }
 }
 
-void CountStore::updatePortCountMap(PortCountMap& countmap, PortCountMap::iterator& iter, ProtoPort port, const bool newFlowKey)
+void CountStore::sketchRecordEnd(uint64_t flowHash)
 {
-    if(iter != countmap.end()) 
+    if(countPerSrcIp)
     {
-	if(newFlowKey) 
-	{
-	    msgStr << "Update octets, packets, and flows.";
-	    iter->second.update(octets, packets, 1);
-	}
-	else
-	{
-	    msgStr << "Update octets and packets only.";
-	    iter->second.update(octets, packets, 0);
-	}
+	msgStr << MsgStream::INFO << "SrcIp: ";
+	updateSketch(srcIpCounts, srcIp, flowHash, true);
+    }
+    if(countPerDstIp)
+    {
+	msgStr << MsgStream::INFO << "DstIp: ";
+	updateSketch(dstIpCounts, dstIp, flowHash, true);
+    }
+    if(countPerSrcPort)
+    {
+	msgStr << MsgStream::INFO << "SrcPort: ";
+	updateSketch(srcPortCounts, srcPort, flowHash, false);
+    }
+    if(countPerDstPort)
+    {
+	msgStr << MsgStream::INFO << "DstPort: ";
+	updateSketch(dstPortCounts, dstPort, flowHash, false);
+    }
+}
+
+void CountStore::updateSketch(CountTable& countmap, uint32_t key, uint64_t flowHash, bool ipKey)
+{
+    Counters* counters = countmap.find(key);
+    if(counters)
+    {
+	msgStr << "Update octets, packets, and flow sketch.";
+	counters->update(octets, packets, 0);
     }
-    else if(countmap.size() < (countmap.max_size()-1))
+    else if((counters = countmap.insert(key, Counters(octets, packets, 0))) != NULL)
     {
 	msgStr << "Create new table entry.";
-	countmap.insert(std::pair<ProtoPort,Counters>(port, Counters(octets, packets, 1)));
+	counters->flowSketch = new (std::nothrow) HyperLogLog();
     }
     else
     {
 	msgStr << "I'm out of memory. Update default table entry.";
-	if((iter = countmap.find(0)) != countmap.end())
+	key = 0;
+	if((counters = countmap.find(0)) != NULL)
+	    counters->update(octets, packets, 0);
+	else if((counters = countmap.insert(0, Counters(octets, packets, 0))) == NULL)
 	{
-	    if(newFlowKey)
-		iter->second.update(octets, packets, 1);
-	    else
-		iter->second.update(octets, packets, 0);
+	    msgStr << " Record lost." << MsgStream::endl;
+	    return;
 	}
+    }
+    if(counters->flowSketch)
+    {
+	if(batchSketches)
+	    sketchUpdates.push_back(SketchUpdate(counters->flowSketch, flowHash));
 	else
-	    countmap.insert(std::pair<ProtoPort,Counters>(0, Counters(octets, packets, 1)));
+	    counters->flowSketch->add(flowHash);
     }
-    
+
     if(CountModule::verbose)
-	if((iter = countmap.find(port)) != countmap.end())
-	    msgStr << " Table entry: " << (iter->first >> 16) << "." << (iter->first & 0x0000FFFF)
-		<< " o:"<< iter->second.octetCount <<" p:" << iter->second.packetCount << " f:" << iter->second.flowCount
-		<< MsgStream::endl;
+    {
+	msgStr << " Table entry: ";
+	if(ipKey)
+	    msgStr << IpAddress(key >> 24, key >> 16, key >> 8, key).toString().c_str();
+	else
+	    msgStr << (key >> 16) << "." << (key & 0x0000FFFF);
+	msgStr << " o:"<< counters->octetCount <<" p:" << counters->packetCount << " f:"
+	    << (counters->flowSketch ? counters->flowSketch->estimate() : 0) << MsgStream::endl;
+    }
+}
+
+void CountStore::flushSketchUpdates()
+{
+    /* the sketches are heap objects, so their addresses don't change if a table grows */
+    std::sort(sketchUpdates.begin(), sketchUpdates.end());
+    for(std::vector<SketchUpdate>::const_iterator it = sketchUpdates.begin(); it != sketchUpdates.end(); )
+    {
+	HyperLogLog* sketch = it->first;
+	sketchHashes.clear();
+	for(; it != sketchUpdates.end() && it->first == sketch; ++it)
+	    sketchHashes.push_back(it->second);
+	sketch->add(&sketchHashes[0], sketchHashes.size());
+    }
+    sketchUpdates.clear();
+}
+
+void CountStore::estimateFlowCounts()
+{
+    if(!flowSketches)
+	return;
+    srcIpCounts.estimateFlows();
+    dstIpCounts.estimateFlows();
+    srcPortCounts.estimateFlows();
+    dstPortCounts.estimateFlows();
+}
+
+void CountStore::initHeavyHitters()
+{
+    /* the dimensions may be switched on later via xmlBlaster, so all of them get a summary */
+    srcIpHitters.init(hhTopK, hhWidth, hhDepth);
+    dstIpHitters.init(hhTopK, hhWidth, hhDepth);
+    srcPortHitters.init(hhTopK, hhWidth, hhDepth);
+    dstPortHitters.init(hhTopK, hhWidth, hhDepth);
 }
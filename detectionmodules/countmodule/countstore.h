@@ -19,45 +19,40 @@
 #ifndef _COUNTSTORE_H_
 #define _COUNTSTORE_H_
 
-#include <map>
 #include <vector>
+#include <utility>
 #include <ostream>
 #include <stdexcept>
 #include <datastore.h>
+#include <recordbatch.h>
 #include <ipaddress.h>
 #include <iostream>
 #include "bloomfilter.h"
-
-
-struct Counters {
-    public:
-	Counters(): octetCount(0), packetCount(0), flowCount(0) {}
-	Counters(uint64_t octets, uint64_t packets, uint64_t flows)
-	    : octetCount(octets), packetCount(packets), flowCount(flows) {}
-	~Counters() {}
-
-	void update(uint64_t octets, uint64_t packets, uint64_t flows)
-	{
-	    octetCount += octets;
-	    packetCount += packets;
-	    flowCount += flows;
-	}
-	
-	uint64_t octetCount, packetCount, flowCount;
-};
+#include "counttable.h"
+#include "hyperloglog.h"
+#include "heavyhitters.h"
 
 
 class CountStore : public DataStore 
 {
     public:
 	//typedef GenericKey<15> FiveTuple;
-	typedef std::map<IpAddress, Counters> IpCountMap;
-	typedef std::map<uint32_t, Counters> PortCountMap;
+	/* keyed by IP address in host byte order */
+	typedef CountTable IpCountMap;
+	/* keyed by proto<<16|port */
+	typedef CountTable PortCountMap;
 	typedef uint32_t ProtoPort;
 
-	CountStore() : recordStarted(false)
+	CountStore() : srcIpCounts(!heavyHitters), dstIpCounts(!heavyHitters),
+		       srcPortCounts(!heavyHitters), dstPortCounts(!heavyHitters),
+		       batchSketches(false), recordStarted(false)
 	{
-	    bfilter.clear();
+	    if(blockedFilter)
+		bbfilter.clear();
+	    else
+		bfilter.clear();
+	    if(heavyHitters)
+		initHeavyHitters();
 	}
 
 	~CountStore() {}
@@ -80,29 +75,124 @@ class CountStore : public DataStore
 	 */
 	void addFieldData(int id, byte* fieldData, int fieldDataLength, EnterpriseNo eid = 0);
 
-	static void init(uint32_t size, unsigned hashfunctions)
+	/**
+	 * Inserts all records of a batch into the storage class
+	 * Will be used by BatchInputPolicy
+	 */
+	void addRecordBatch(const RecordBatch& batch);
+
+	/**
+	 * Initialises the Bloom filter used to detect new flows.
+	 * @param blocked use a cache-line blocked Bloom filter (for large filters)
+	 */
+	static void init(uint32_t size, unsigned hashfunctions, bool blocked = false)
+	{
+	    blockedFilter = blocked;
+	    if(blocked)
+		bbfilter.init(size, hashfunctions);
+	    else
+		bfilter.init(size, hashfunctions);
+	}
+
+	/**
+	 * Counts distinct flows per key with HyperLogLog sketches instead of
+	 * the global Bloom filter.
+	 * @param precision sketches have 2^precision registers
+	 */
+	static void initSketches(unsigned precision)
+	{
+	    HyperLogLog::setPrecision(precision);
+	    flowSketches = true;
+	}
+
+	/**
+	 * Replaces the count tables by fixed size heavy-hitter summaries.
+	 * @param topK number of keys monitored per counter and dimension
+	 * @param width width of the Count-Min sketches
+	 * @param depth depth of the Count-Min sketches
+	 */
+	static void initHeavyHitters(unsigned topK, uint32_t width, unsigned depth)
 	{
-	    bfilter.init(size, hashfunctions);
+	    hhTopK = topK;
+	    hhWidth = width;
+	    hhDepth = depth;
+	    heavyHitters = true;
 	}
 
+	static bool heavyHitterMode() { return heavyHitters; }
+
+	/**
+	 * Sets the flow counts of all table entries to the estimates of
+	 * their sketches. Has to be called before the flow counts are used.
+	 */
+	void estimateFlowCounts();
+
 	static bool countPerSrcIp, countPerDstIp, countPerSrcPort, countPerDstPort;
 	    
 	IpCountMap srcIpCounts, dstIpCounts;
 	PortCountMap srcPortCounts, dstPortCounts;
+	/* used instead of the tables in heavy-hitter mode */
+	HeavyHitters srcIpHitters, dstIpHitters, srcPortHitters, dstPortHitters;
 
     private:
-	void updateIpCountMap(IpCountMap& countmap, IpCountMap::iterator& iter, const IpAddress& addr, const bool newFlowKey);
-	void updatePortCountMap(PortCountMap& countmap, PortCountMap::iterator& iter, ProtoPort port, const bool newFlowKey);
+	/**
+	 * Takes over the fields of record i of a batch, like recordStart()
+	 * and addFieldData() do for a single record.
+	 */
+	void loadRecord(const RecordBatch& batch, unsigned i);
+
+	/**
+	 * Counts the current record. Common part of recordEnd() and addRecordBatch()
+	 */
+	void countRecord();
+
+	/**
+	 * Updates the counters of key or creates a new table entry.
+	 * @param counters counters of key or NULL if key isn't in the table yet
+	 * @param ipKey true if key is an IP address, false if key is proto<<16|port
+	 */
+	void updateCountMap(CountTable& countmap, Counters* counters, uint32_t key, const bool newFlowKey, bool ipKey);
+
+	/**
+	 * Updates the counters and the flow sketch of key, creates the entry if needed.
+	 */
+	void updateSketch(CountTable& countmap, uint32_t key, uint64_t flowHash, bool ipKey);
+
+	/**
+	 * recordEnd() for flow sketches
+	 */
+	void sketchRecordEnd(uint64_t flowHash);
+
+	/**
+	 * Adds the flow hashes collected during addRecordBatch() to their
+	 * sketches, all hashes of a sketch at once.
+	 */
+	void flushSketchUpdates();
+
+	void initHeavyHitters();
 	
 	static BloomFilter bfilter;
+	static BlockedBloomFilter bbfilter;
+	static bool blockedFilter;
+	static bool flowSketches;
+	static bool heavyHitters;
+	static unsigned hhTopK, hhDepth;
+	static uint32_t hhWidth;
+	static HashFunctions flowHasher;
 	
-	IpAddress srcIp, dstIp;
+	uint32_t srcIp, dstIp; /**< host byte order */
 	ProtoPort  srcPort, dstPort;
 	uint64_t octets, packets;
 
 	//FiveTuple flowKey;
 	QuintupleKey flowKey;
 
+	/* flow sketch updates of the current batch */
+	typedef std::pair<HyperLogLog*, uint64_t> SketchUpdate;
+	std::vector<SketchUpdate> sketchUpdates;
+	std::vector<uint64_t> sketchHashes;
+	bool batchSketches;
+
 	bool recordStarted;
 };
 
@@ -0,0 +1,186 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#include "counttable.h"
+
+#include <commonutils/mutex.h>
+
+#include <algorithm>
+#include <new>
+
+
+/**
+ * Keeps the entry arrays of destroyed tables, one free list per table size.
+ * Arrays are cleared before they are put into a free list.
+ */
+class CountArena
+{
+    public:
+	/**
+	 * @return cleared entry array or NULL if there is not enough memory
+	 */
+	static CountTable::Entry* allocate(unsigned bits)
+	{
+	    CountTable::Entry* ret = NULL;
+	    lock.lock();
+	    if (!freeLists[bits].empty()) {
+		ret = freeLists[bits].back();
+		freeLists[bits].pop_back();
+	    }
+	    lock.unlock();
+
+	    if (!ret)
+		ret = new (std::nothrow) CountTable::Entry[(size_t)1 << bits]();
+	    if (!ret)
+		return NULL;
+
+	    lock.lock();
+	    if (++outstanding[bits] > peak[bits])
+		peak[bits] = outstanding[bits];
+	    lock.unlock();
+	    return ret;
+	}
+
+	static void release(CountTable::Entry* entries, unsigned bits)
+	{
+	    std::fill(entries, entries + ((size_t)1 << bits), CountTable::Entry());
+	    lock.lock();
+	    --outstanding[bits];
+	    try {
+		freeLists[bits].push_back(entries);
+		entries = NULL;
+	    } catch (std::bad_alloc&) {
+	    }
+	    lock.unlock();
+	    delete[] entries;
+	}
+
+	/**
+	 * Keeps as many arrays of every size as were in use at the peak
+	 * since the last call, frees the others.
+	 */
+	static void trim()
+	{
+	    lock.lock();
+	    for (unsigned bits = 0; bits != 32; ++bits) {
+		size_t keep = peak[bits] > outstanding[bits] ? peak[bits] - outstanding[bits] : 0;
+		while (freeLists[bits].size() > keep) {
+		    delete[] freeLists[bits].back();
+		    freeLists[bits].pop_back();
+		}
+		peak[bits] = outstanding[bits];
+	    }
+	    lock.unlock();
+	}
+
+    private:
+	static std::vector<CountTable::Entry*> freeLists[32];
+	static size_t outstanding[32]; /**< arrays in use by tables */
+	static size_t peak[32];        /**< most arrays in use since the last trim() */
+	static Mutex lock;
+};
+
+std::vector<CountTable::Entry*> CountArena::freeLists[32];
+size_t CountArena::outstanding[32];
+size_t CountArena::peak[32];
+Mutex CountArena::lock;
+
+CountTable::Entry CountTable::emptyEntries[2];
+
+
+CountTable::CountTable(bool allocate)
+    : mask((1 << INITIAL_BITS) - 1), bits(INITIAL_BITS), count(0)
+{
+    entries = allocate ? CountArena::allocate(bits) : NULL;
+    if (!entries) {
+	/* every insert() fails, find() finds nothing */
+	entries = emptyEntries;
+	mask = 1;
+	bits = 1;
+    }
+}
+
+CountTable::~CountTable()
+{
+    if (entries == emptyEntries)
+	return;
+    for (uint32_t i = 0; i <= mask; ++i)
+	delete entries[i].counters.flowSketch;
+    CountArena::release(entries, bits);
+}
+
+Counters* CountTable::insert(uint32_t key, const Counters& counters)
+{
+    if (entries == emptyEntries)
+	return NULL;
+
+    /* keep the load factor below 1/2 */
+    if (2 * (count + 1) > mask + 1 && !grow()) {
+	/* keep one slot empty to end the probe sequences and one for the default entry */
+	if (mask + 1 - count < (key ? 3u : 2u))
+	    return NULL;
+    }
+
+    uint32_t i = hash(key);
+    while (entries[i].used)
+	i = (i + 1) & mask;
+
+    entries[i].key = key;
+    entries[i].used = 1;
+    entries[i].counters = counters;
+    ++count;
+    return &entries[i].counters;
+}
+
+bool CountTable::grow()
+{
+    Entry* old = entries;
+    uint32_t oldMask = mask;
+    unsigned oldBits = bits;
+
+    Entry* grown = CountArena::allocate(bits + 1);
+    if (!grown)
+	return false;
+
+    entries = grown;
+    ++bits;
+    mask = (1 << bits) - 1;
+
+    for (uint32_t j = 0; j <= oldMask; ++j) {
+	if (!old[j].used)
+	    continue;
+	uint32_t i = hash(old[j].key);
+	while (entries[i].used)
+	    i = (i + 1) & mask;
+	entries[i] = old[j];
+    }
+
+    CountArena::release(old, oldBits);
+    return true;
+}
+
+void CountTable::trimArena()
+{
+    CountArena::trim();
+}
+
+void CountTable::estimateFlows()
+{
+    for (uint32_t i = 0; i <= mask; ++i) {
+	if (entries[i].used && entries[i].counters.flowSketch)
+	    entries[i].counters.flowCount = entries[i].counters.flowSketch->estimate();
+    }
+}
@@ -0,0 +1,152 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#ifndef _COUNTTABLE_H_
+#define _COUNTTABLE_H_
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include "hyperloglog.h"
+
+
+struct Counters {
+    public:
+	Counters(): octetCount(0), packetCount(0), flowCount(0), flowSketch(NULL) {}
+	Counters(uint64_t octets, uint64_t packets, uint64_t flows)
+	    : octetCount(octets), packetCount(packets), flowCount(flows), flowSketch(NULL) {}
+	~Counters() {}
+
+	void update(uint64_t octets, uint64_t packets, uint64_t flows)
+	{
+	    octetCount += octets;
+	    packetCount += packets;
+	    flowCount += flows;
+	}
+	
+	uint64_t octetCount, packetCount, flowCount;
+	/* distinct flows of the key if flows are counted with HyperLogLog, owned by the table */
+	HyperLogLog* flowSketch;
+};
+
+
+/**
+ * Flat hash table mapping 32 bit keys (IPv4 addresses in host byte order or
+ * proto<<16|port) to counters. Open addressing with linear probing, so a
+ * lookup usually touches a single cache line.
+ * The entry arrays are taken from a process wide arena and handed back when
+ * the table is destroyed, so the tables of the next interval reuse the memory
+ * of the previous ones instead of allocating every entry separately.
+ * Call @c trimArena() at the end of every interval to give the arrays that
+ * weren't needed anymore back to the system.
+ */
+class CountTable
+{
+    public:
+	struct Entry {
+	    uint32_t key;
+	    uint32_t used;
+	    Counters counters;
+	};
+
+	/**
+	 * @param allocate false creates a table without entries, every
+	 *        insert() fails (for stores which don't use their tables)
+	 */
+	explicit CountTable(bool allocate = true);
+	~CountTable();
+
+	/**
+	 * Returns the counters of key or NULL if key is not in the table.
+	 */
+	Counters* find(uint32_t key)
+	{
+	    for (uint32_t i = hash(key);; i = (i + 1) & mask) {
+		if (!entries[i].used)
+		    return NULL;
+		if (entries[i].key == key)
+		    return &entries[i].counters;
+	    }
+	}
+
+	/**
+	 * Inserts a key which is not yet in the table.
+	 * If the table can't grow anymore, it is filled up to the last free
+	 * slots. The last but one slot is only used for key 0, which serves as
+	 * default entry when memory runs out.
+	 * @return counters of the new entry, NULL if the table is full
+	 */
+	Counters* insert(uint32_t key, const Counters& counters);
+
+	unsigned size() const { return count; }
+
+	/**
+	 * Sets the flow counts of all entries with a sketch to the sketch's estimate.
+	 */
+	void estimateFlows();
+
+	/**
+	 * Frees the cached entry arrays beyond the peak demand of the interval
+	 * that just ended.
+	 */
+	static void trimArena();
+
+	/**
+	 * Collects all entries whose counters match pred, sorted by key.
+	 */
+	template <class Pred>
+	void collect(std::vector<const Entry*>& out, Pred pred) const
+	{
+	    out.clear();
+	    for (uint32_t i = 0; i <= mask; ++i) {
+		if (entries[i].used && pred(entries[i].counters))
+		    out.push_back(&entries[i]);
+	    }
+	    std::sort(out.begin(), out.end(), lessKey);
+	}
+
+    private:
+	/* hidden, the table owns its entry array */
+	CountTable(const CountTable&);
+	CountTable& operator=(const CountTable&);
+
+	static const unsigned INITIAL_BITS = 10;
+
+	uint32_t hash(uint32_t key) const
+	{
+	    /* multiplicative hashing, the upper bits are the best mixed ones */
+	    return (key * 0x9E3779B1U) >> (32 - bits);
+	}
+
+	static bool lessKey(const Entry* a, const Entry* b) { return a->key < b->key; }
+
+	/**
+	 * Doubles the size of the table.
+	 * @return false if there is not enough memory, the table is unchanged then
+	 */
+	bool grow();
+
+	/* used if not even the initial entry array could be allocated */
+	static Entry emptyEntries[2];
+
+	Entry* entries;
+	uint32_t mask;
+	unsigned bits;
+	unsigned count;
+};
+
+#endif
@@ -0,0 +1,208 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#include "heavyhitters.h"
+#include "bloomfilter.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+
+void CountMinSketch::init(uint32_t width, unsigned depth)
+{
+    if(depth == 0)
+	depth = 1;
+    /* index() shifts by 64 - width_bits, so at least one index bit is needed */
+    if(width < 2)
+	width = 2;
+    width = HashFunctions::roundSize(width);
+    for(width_bits = 0; (1U << width_bits) < width; width_bits++);
+    width_mask = width - 1;
+
+    cells.assign((size_t)width * depth, Cell());
+    seeds.resize(depth);
+    offsets.resize(depth);
+    for(unsigned i=0; i<depth; i++) {
+	seeds[i] = (((uint64_t)rand() << 32) ^ (uint64_t)rand()) | 1;
+	offsets[i] = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+    }
+    sum = Counters();
+}
+
+void CountMinSketch::update(uint32_t key, uint64_t octets, uint64_t packets, uint64_t flows)
+{
+    for(unsigned i=0; i<seeds.size(); i++) {
+	Cell& c = cells[((size_t)i << width_bits) + index(i, key)];
+	c.octets += octets;
+	c.packets += packets;
+	c.flows += flows;
+    }
+    sum.update(octets, packets, flows);
+}
+
+Counters CountMinSketch::estimate(uint32_t key) const
+{
+    Counters ret;
+    for(unsigned i=0; i<seeds.size(); i++) {
+	const Cell& c = cells[((size_t)i << width_bits) + index(i, key)];
+	if(i == 0 || c.octets < ret.octetCount)
+	    ret.octetCount = c.octets;
+	if(i == 0 || c.packets < ret.packetCount)
+	    ret.packetCount = c.packets;
+	if(i == 0 || c.flows < ret.flowCount)
+	    ret.flowCount = c.flows;
+    }
+    return ret;
+}
+
+double CountMinSketch::epsilon() const
+{
+    return M_E / (width_mask + 1);
+}
+
+double CountMinSketch::delta() const
+{
+    return exp(-(double)seeds.size());
+}
+
+
+void SpaceSaving::init(unsigned k)
+{
+    capacity = k;
+    heap.clear();
+    heap.reserve(k);
+    index.assign(HashFunctions::roundSize(2 * k), 0);
+    index_mask = index.size() - 1;
+}
+
+uint32_t SpaceSaving::slot(uint32_t key) const
+{
+    uint32_t i = hash(key);
+    while(index[i] && heap[index[i] - 1].key != key)
+	i = (i + 1) & index_mask;
+    return i;
+}
+
+void SpaceSaving::removeSlot(uint32_t key)
+{
+    /* backward shift deletion keeps the probe sequences intact */
+    uint32_t i = slot(key);
+    index[i] = 0;
+    for(uint32_t j = (i + 1) & index_mask; index[j]; j = (j + 1) & index_mask) {
+	uint32_t home = hash(heap[index[j] - 1].key);
+	if(((j - home) & index_mask) >= ((j - i) & index_mask)) {
+	    index[i] = index[j];
+	    index[j] = 0;
+	    i = j;
+	}
+    }
+}
+
+void SpaceSaving::swap(unsigned a, unsigned b)
+{
+    uint32_t sa = slot(heap[a].key), sb = slot(heap[b].key);
+    std::swap(heap[a], heap[b]);
+    index[sa] = b + 1;
+    index[sb] = a + 1;
+}
+
+void SpaceSaving::siftUp(unsigned pos)
+{
+    while(pos > 0 && heap[(pos - 1) / 2].count > heap[pos].count) {
+	swap(pos, (pos - 1) / 2);
+	pos = (pos - 1) / 2;
+    }
+}
+
+void SpaceSaving::siftDown(unsigned pos)
+{
+    for(;;) {
+	unsigned min = pos;
+	unsigned l = 2 * pos + 1, r = 2 * pos + 2;
+	if(l < heap.size() && heap[l].count < heap[min].count)
+	    min = l;
+	if(r < heap.size() && heap[r].count < heap[min].count)
+	    min = r;
+	if(min == pos)
+	    return;
+	swap(pos, min);
+	pos = min;
+    }
+}
+
+void SpaceSaving::update(uint32_t key, uint64_t weight)
+{
+    if(weight == 0 || capacity == 0)
+	return;
+
+    uint32_t i = slot(key);
+    if(index[i]) {
+	unsigned pos = index[i] - 1;
+	heap[pos].count += weight;
+	siftDown(pos);
+    }
+    else if(heap.size() < capacity) {
+	Item item = { key, weight, 0 };
+	heap.push_back(item);
+	index[i] = heap.size();
+	siftUp(heap.size() - 1);
+    }
+    else {
+	/* replace the key with the smallest count */
+	removeSlot(heap[0].key);
+	heap[0].error = heap[0].count;
+	heap[0].count += weight;
+	heap[0].key = key;
+	index[slot(key)] = 1;
+	siftDown(0);
+    }
+}
+
+
+void HeavyHitters::init(unsigned k, uint32_t width, unsigned depth)
+{
+    cm.init(width, depth);
+    byOctets.init(k);
+    byPackets.init(k);
+    byFlows.init(k);
+}
+
+void HeavyHitters::update(uint32_t key, uint64_t octets, uint64_t packets, uint64_t flows)
+{
+    cm.update(key, octets, packets, flows);
+    byOctets.update(key, octets);
+    byPackets.update(key, packets);
+    byFlows.update(key, flows);
+}
+
+void HeavyHitters::candidates(std::vector<CountTable::Entry>& out) const
+{
+    std::vector<uint32_t> keys;
+    const SpaceSaving* tables[] = { &byOctets, &byPackets, &byFlows };
+    for(unsigned t=0; t<3; t++)
+	for(unsigned i=0; i<tables[t]->items().size(); i++)
+	    keys.push_back(tables[t]->items()[i].key);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    out.resize(keys.size());
+    for(unsigned i=0; i<keys.size(); i++) {
+	out[i].key = keys[i];
+	out[i].used = 1;
+	out[i].counters = cm.estimate(keys[i]);
+    }
+}
@@ -0,0 +1,150 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#ifndef _HEAVYHITTERS_H_
+#define _HEAVYHITTERS_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "counttable.h"
+
+
+/**
+ * Count-Min sketch (cf. Cormode and Muthukrishnan 2005) for octets, packets
+ * and flows of 32 bit keys. Estimates never underestimate. With width w and
+ * depth d an estimate exceeds the true value by at most e/w times the total
+ * with probability 1 - e^-d.
+ */
+class CountMinSketch
+{
+    public:
+	CountMinSketch() : width_mask(0), width_bits(0) {}
+
+	/**
+	 * @param width number of cells per row, rounded up to a power of two
+	 * @param depth number of rows
+	 */
+	void init(uint32_t width, unsigned depth);
+
+	void update(uint32_t key, uint64_t octets, uint64_t packets, uint64_t flows);
+	Counters estimate(uint32_t key) const;
+
+	/* sums of all updates */
+	const Counters& total() const { return sum; }
+
+	/* relative error bound (of the total) and probability of exceeding it */
+	double epsilon() const;
+	double delta() const;
+
+    private:
+	struct Cell {
+	    uint64_t octets, packets, flows;
+	};
+
+	uint32_t index(unsigned row, uint32_t key) const
+	{
+	    /* multiply-shift hashing with a random odd multiplier per row */
+	    return (uint32_t)((seeds[row] * key + offsets[row]) >> (64 - width_bits));
+	}
+
+	std::vector<Cell> cells;
+	std::vector<uint64_t> seeds, offsets;
+	uint32_t width_mask;
+	unsigned width_bits;
+	Counters sum;
+};
+
+
+/**
+ * Space-Saving top-k table (cf. Metwally et al. 2005) for weighted updates.
+ * Keeps k keys. A key which is not monitored replaces the key with the
+ * smallest count and inherits its count as error. Every key whose weight
+ * exceeds total/k is monitored.
+ */
+class SpaceSaving
+{
+    public:
+	struct Item {
+	    uint32_t key;
+	    uint64_t count;
+	    uint64_t error; /* count overestimates the weight by at most error */
+	};
+
+	SpaceSaving() : capacity(0), index_mask(0) {}
+
+	void init(unsigned k);
+	void update(uint32_t key, uint64_t weight);
+
+	/* monitored keys in no particular order */
+	const std::vector<Item>& items() const { return heap; }
+
+    private:
+	/* heap positions are kept in an open addressing table, slot value is position + 1 */
+	uint32_t slot(uint32_t key) const;
+	void removeSlot(uint32_t key);
+	void swap(unsigned a, unsigned b);
+	void siftUp(unsigned pos);
+	void siftDown(unsigned pos);
+
+	uint32_t hash(uint32_t key) const { return (key * 0x9E3779B1U) & index_mask; }
+
+	std::vector<Item> heap; /* min heap by count */
+	std::vector<uint32_t> index;
+	unsigned capacity;
+	uint32_t index_mask;
+};
+
+
+/**
+ * Fixed memory replacement for a CountTable during heavy-hitter counting:
+ * a Count-Min sketch for the counters and one Space-Saving table per counter
+ * to find the candidate keys.
+ */
+class HeavyHitters
+{
+    public:
+	void init(unsigned k, uint32_t width, unsigned depth);
+
+	void update(uint32_t key, uint64_t octets, uint64_t packets, uint64_t flows);
+
+	/**
+	 * Collects all candidate keys whose estimated counters match pred,
+	 * sorted by key. The entries are valid until the next call.
+	 */
+	template <class Pred>
+	void collect(std::vector<const CountTable::Entry*>& out, Pred pred)
+	{
+	    candidates(reported);
+	    out.clear();
+	    for (unsigned i = 0; i != reported.size(); ++i) {
+		if (pred(reported[i].counters))
+		    out.push_back(&reported[i]);
+	    }
+	}
+
+	const CountMinSketch& sketch() const { return cm; }
+
+    private:
+	/* monitored keys of all Space-Saving tables with their Count-Min estimates */
+	void candidates(std::vector<CountTable::Entry>& out) const;
+
+	CountMinSketch cm;
+	SpaceSaving byOctets, byPackets, byFlows;
+	std::vector<CountTable::Entry> reported;
+};
+
+#endif
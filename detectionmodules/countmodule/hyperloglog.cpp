@@ -0,0 +1,169 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#include "hyperloglog.h"
+
+#include <math.h>
+#include <algorithm>
+#include <iterator>
+
+
+unsigned HyperLogLog::precision = 12;
+
+
+void HyperLogLog::setPrecision(unsigned p)
+{
+    if(p < 4)
+	p = 4;
+    if(p > 16)
+	p = 16;
+    precision = p;
+}
+
+double HyperLogLog::standardError()
+{
+    return 1.04 / sqrt((double)(1 << precision));
+}
+
+void HyperLogLog::add(uint64_t hash)
+{
+    if(isSparse())
+	insertSparse(encode(hash));
+    else
+	setRegister(encode(hash));
+}
+
+void HyperLogLog::add(const uint64_t* hashes, unsigned count)
+{
+    if(!isSparse()) {
+	for(unsigned i=0; i<count; i++)
+	    setRegister(encode(hashes[i]));
+	return;
+    }
+
+    std::vector<uint32_t> entries(count);
+    for(unsigned i=0; i<count; i++)
+	entries[i] = encode(hashes[i]);
+    std::sort(entries.begin(), entries.end());
+    mergeSparse(entries);
+}
+
+void HyperLogLog::merge(const HyperLogLog& other)
+{
+    if(other.isSparse()) {
+	if(isSparse()) {
+	    std::vector<uint32_t> entries(other.sparse);
+	    mergeSparse(entries);
+	}
+	else {
+	    for(unsigned i=0; i<other.sparse.size(); i++)
+		setRegister(other.sparse[i]);
+	}
+	return;
+    }
+
+    if(isSparse())
+	toDense();
+    for(unsigned i=0; i<registers.size(); i++)
+	registers[i] = std::max(registers[i], other.registers[i]);
+}
+
+uint64_t HyperLogLog::estimate() const
+{
+    if(isSparse()) {
+	/* linear counting on the 2^25 sparse indices */
+	double m = (double)(1 << SPARSE_PRECISION);
+	return (uint64_t)(m * log(m / (m - sparse.size())) + 0.5);
+    }
+
+    unsigned m = registers.size();
+    double sum = 0;
+    unsigned zeros = 0;
+    for(unsigned i=0; i<m; i++) {
+	sum += ldexp(1.0, -registers[i]);
+	if(registers[i] == 0)
+	    zeros++;
+    }
+
+    double alpha;
+    switch(m) {
+	case 16: alpha = 0.673; break;
+	case 32: alpha = 0.697; break;
+	case 64: alpha = 0.709; break;
+	default: alpha = 0.7213 / (1 + 1.079 / m);
+    }
+    double e = alpha * m * m / sum;
+    /* small range correction, no large range correction needed with 64 bit hashes */
+    if(e <= 2.5 * m && zeros != 0)
+	e = m * log((double)m / zeros);
+    return (uint64_t)(e + 0.5);
+}
+
+void HyperLogLog::insertSparse(uint32_t e)
+{
+    std::vector<uint32_t>::iterator it = std::lower_bound(sparse.begin(), sparse.end(), e & ~0x3fU);
+    if(it != sparse.end() && sparseIndex(*it) == sparseIndex(e)) {
+	if(e > *it)
+	    *it = e;
+	return;
+    }
+    sparse.insert(it, e);
+    if(sparse.size() > (1U << precision) / sizeof(uint32_t))
+	toDense();
+}
+
+void HyperLogLog::mergeSparse(std::vector<uint32_t>& entries)
+{
+    /* entries are sorted, keep the highest rank per index */
+    std::vector<uint32_t> merged;
+    merged.reserve(sparse.size() + entries.size());
+    std::merge(sparse.begin(), sparse.end(), entries.begin(), entries.end(), std::back_inserter(merged));
+    unsigned n = 0;
+    for(unsigned i=0; i<merged.size(); i++) {
+	if(n && sparseIndex(merged[n-1]) == sparseIndex(merged[i]))
+	    merged[n-1] = merged[i];
+	else
+	    merged[n++] = merged[i];
+    }
+    merged.resize(n);
+    sparse.swap(merged);
+    if(sparse.size() > (1U << precision) / sizeof(uint32_t))
+	toDense();
+}
+
+void HyperLogLog::setRegister(uint32_t e)
+{
+    /* the upper p bits of the sparse index are the register index, the
+       rank has to take the remaining 25-p bits of the sparse index into account */
+    const unsigned extra = SPARSE_PRECISION - precision;
+    uint32_t index = sparseIndex(e) >> extra;
+    uint32_t rest = sparseIndex(e) & ((1U << extra) - 1);
+    uint8_t rank;
+    if(rest)
+	rank = __builtin_clz(rest) - (32 - extra) + 1;
+    else
+	rank = extra + (e & 0x3f);
+    if(rank > registers[index])
+	registers[index] = rank;
+}
+
+void HyperLogLog::toDense()
+{
+    registers.assign(1 << precision, 0);
+    for(unsigned i=0; i<sparse.size(); i++)
+	setRegister(sparse[i]);
+    std::vector<uint32_t>().swap(sparse);
+}
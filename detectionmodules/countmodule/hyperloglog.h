@@ -0,0 +1,93 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#ifndef _HYPERLOGLOG_H_
+#define _HYPERLOGLOG_H_
+
+#include <stdint.h>
+#include <vector>
+
+
+/**
+ * HyperLogLog cardinality estimator (cf. Flajolet et al. 2007, Heule et al.
+ * 2013) fed with 64 bit hashes. All sketches share the same precision p,
+ * a dense sketch has 2^p one byte registers and a relative standard error
+ * of about 1.04/sqrt(2^p).
+ * Sketches start with a sparse representation: a sorted list of
+ * (index, rank) pairs with a 25 bit index, which is exact enough for small
+ * cardinalities and needs only a few bytes for keys with few flows. The
+ * list is converted into registers once it would take more memory than
+ * the registers.
+ * Sketches of the same precision can be merged.
+ */
+class HyperLogLog
+{
+    public:
+	HyperLogLog() {}
+	~HyperLogLog() {}
+
+	/**
+	 * Sets the precision of all sketches. Must be called before the
+	 * first sketch is filled.
+	 * @param p number of index bits, 4 <= p <= 16
+	 */
+	static void setPrecision(unsigned p);
+	static unsigned getPrecision() { return precision; }
+
+	/**
+	 * Relative standard error of the estimate for the current precision
+	 */
+	static double standardError();
+
+	void add(uint64_t hash);
+
+	/**
+	 * Adds a bunch of hashes at once. Cheaper than adding them one by
+	 * one while the sketch is sparse.
+	 */
+	void add(const uint64_t* hashes, unsigned count);
+
+	void merge(const HyperLogLog& other);
+
+	uint64_t estimate() const;
+
+	bool isSparse() const { return registers.empty(); }
+
+    private:
+	static const unsigned SPARSE_PRECISION = 25;
+
+	/* sparse entry: index << 6 | rank */
+	static uint32_t encode(uint64_t hash)
+	{
+	    uint64_t w = hash << SPARSE_PRECISION;
+	    uint32_t rank = w ? __builtin_clzll(w) + 1 : 64 - SPARSE_PRECISION + 1;
+	    return (uint32_t)(hash >> (64 - SPARSE_PRECISION)) << 6 | rank;
+	}
+
+	static uint32_t sparseIndex(uint32_t e) { return e >> 6; }
+
+	void insertSparse(uint32_t e);
+	void mergeSparse(std::vector<uint32_t>& entries);
+	void setRegister(uint32_t e);
+	void toDense();
+
+	std::vector<uint32_t> sparse;
+	std::vector<uint8_t> registers;
+
+	static unsigned precision;
+};
+
+#endif
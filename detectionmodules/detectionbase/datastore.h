@@ -38,6 +38,11 @@ extern MsgStream msgStr;; // is defined in detectionbase.cpp
  * - void addFieldData(int id, byte* fieldData, int len);
  * - bool recordStart(SourceID&);
  * - void recordEnd();
+ * Storage classes used with @c BatchInputPolicy must additionally provide
+ * - void addRecordBatch(const RecordBatch&);
+ * Storage objects handed back with @c DetectionBase::releaseStorage() must provide
+ * - void recycle();
+ * which prepares the object for the next record.
  */
 class DataStore 
 {
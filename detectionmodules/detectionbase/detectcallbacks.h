@@ -20,11 +20,66 @@
 #define _DETECT_CALLBACKS_H_
 
 
+#include "recordbatch.h"
+
+
 #include <concentrator/rcvIpfix.h>
 //#include <concentrator/msg.h>
 #include <iostream>
+#include <vector>
 
 
+/**
+ * Decoder plan for one template. The plan is compiled once when the template
+ * arrives and is stored in the templates userData field. It contains the
+ * indices of all fields the module subscribed to, so the record callbacks
+ * don't have to check every field against the subscription list.
+ * Offsets of fixed-length templates are constant, offsets of variable-length
+ * templates are updated by the concentrator for every record.
+ */
+struct DecoderPlan {
+	/**
+	 * Subscribed field that has a column within a @c RecordBatch
+	 */
+	struct BatchColumn {
+		uint16_t column;
+		uint16_t index;  /**< index into fieldInfo or dataInfo */
+		bool fixed;      /**< true if the field is a fixed field of a data template (dataInfo) */
+	};
+
+	std::vector<uint16_t> fields;     /**< subscribed indices into fieldInfo */
+	std::vector<uint16_t> dataFields; /**< subscribed indices into dataInfo (data templates only) */
+	std::vector<BatchColumn> columns; /**< subscribed fields decoded by the batched callbacks */
+
+	void addColumn(const FieldInfo& fi, uint16_t index, bool fixed)
+	{
+		int column = RecordBatch::columnForField(fi.type.id);
+		if (column >= 0 && fi.type.eid == 0) {
+			BatchColumn c;
+			c.column = column;
+			c.index = index;
+			c.fixed = fixed;
+			columns.push_back(c);
+		}
+	}
+};
+
+/**
+ * Builds a decoder plan for the subscribed fields within fieldInfo.
+ */
+template <class PacketReader>
+DecoderPlan* compileDecoderPlan(PacketReader* input, const FieldInfo* fieldInfo, uint16_t fieldCount)
+{
+	DecoderPlan* plan = new DecoderPlan();
+	for (uint16_t i = 0; i < fieldCount; ++i) {
+		if (input->isIdInList(fieldInfo[i].type.id)) {
+			plan->fields.push_back(i);
+			plan->addColumn(fieldInfo[i], i, false);
+		}
+	}
+	return plan;
+}
+
 /**
  * Will be called whenever a new template with SetId 2 arrives.
  * @param handle Control structure
@@ -34,6 +89,8 @@
 template <class PacketReader, class Storage>
 int newTemplateArrived(void* handle,  SourceID sourceID, TemplateInfo* ti) 
 {
+        PacketReader* input = static_cast<PacketReader*>(handle);
+	ti->userData = compileDecoderPlan(input, ti->fieldInfo, ti->fieldCount);
         return 0;
 }
 
@@ -51,19 +108,22 @@ int newDataRecordArrived(void* handle, SourceID sourceID, TemplateInfo* ti,
                             uint16_t length, FieldData* data) 
 {
         PacketReader* input = static_cast<PacketReader*>(handle);
+	if (!ti->userData) {
+		ti->userData = compileDecoderPlan(input, ti->fieldInfo, ti->fieldCount);
+	}
+	const std::vector<uint16_t>& fields = static_cast<DecoderPlan*>(ti->userData)->fields;
         input->recordMutex.lock();
         Storage* buf;
         if(buf = input->getBuffer()) {
 		if (buf->recordStart(sourceID)) {
 			buf->setValid(true);
-			for (int i = 0; i < ti->fieldCount; ++i) {
-				if (input->isIdInList(ti->fieldInfo[i].type.id)) {
-					buf->addFieldData(ti->fieldInfo[i].type.id, data + ti->fieldInfo[i].offset,
-							ti->fieldInfo[i].type.length, ti->fieldInfo[i].type.length);
-				}
+			for (unsigned i = 0; i != fields.size(); ++i) {
+				const FieldInfo& fi = ti->fieldInfo[fields[i]];
+				buf->addFieldData(fi.type.id, data + fi.offset, fi.type.length, fi.type.eid);
 			}
 			buf->recordEnd();
 		}
+		input->publishBuffer(buf);
 	}/* Error message is printed in filepolicy.h with an error counter
 	else { 
 		msg(MSG_ERROR, "DetectionBase: getBuffer() returned NULL, record dropped!");
@@ -81,6 +141,8 @@ int newDataRecordArrived(void* handle, SourceID sourceID, TemplateInfo* ti,
 template <class PacketReader, class Storage>
 int templateDestroyed(void* handle, SourceID sourceID, TemplateInfo* ti) 
 {
+	delete static_cast<DecoderPlan*>(ti->userData);
+	ti->userData = 0;
         return 0;
 }
 
@@ -135,6 +197,15 @@ int optionsTemplateDestroyed(void* handle, SourceID sourceID, OptionsTemplateInf
 template <class PacketReader, class Storage>
 int newDataTemplateArrived(void* handle, SourceID sourceID, DataTemplateInfo* dataTemplateInfo) 
 {
+        PacketReader* input = static_cast<PacketReader*>(handle);
+	DecoderPlan* plan = compileDecoderPlan(input, dataTemplateInfo->fieldInfo, dataTemplateInfo->fieldCount);
+	for (uint16_t i = 0; i < dataTemplateInfo->dataCount; ++i) {
+		if (input->isIdInList(dataTemplateInfo->dataInfo[i].type.id)) {
+			plan->dataFields.push_back(i);
+			plan->addColumn(dataTemplateInfo->dataInfo[i], i, true);
+		}
+	}
+	dataTemplateInfo->userData = plan;
         return 0;
 }
 
@@ -152,27 +223,28 @@ int newDataRecordFixedFieldsArrived(void* handle, SourceID sourceID,
 {
         /* same as with new_data_record_arrived */
         PacketReader* input = static_cast<PacketReader*>(handle);
+	if (!ti->userData) {
+		newDataTemplateArrived<PacketReader, Storage>(handle, sourceID, ti);
+	}
+	const DecoderPlan* plan = static_cast<DecoderPlan*>(ti->userData);
         input->recordMutex.lock();
         Storage* buf;
         if(buf = input->getBuffer()) {
 		if (buf->recordStart(sourceID)) {
 			buf->setValid(true);
-			for (int i = 0; i < ti->fieldCount; ++i) {
-				if (input->isIdInList(ti->fieldInfo[i].type.id)) {
-					buf->addFieldData(ti->fieldInfo[i].type.id, data + ti->fieldInfo[i].offset,
-							ti->fieldInfo[i].type.length, ti->fieldInfo[i].type.eid);
-				}
+			for (unsigned i = 0; i != plan->fields.size(); ++i) {
+				const FieldInfo& fi = ti->fieldInfo[plan->fields[i]];
+				buf->addFieldData(fi.type.id, data + fi.offset, fi.type.length, fi.type.eid);
 			}
 
 			/* pass fixed fields now */
-			for (int i = 0; i < ti->dataCount; ++i) {
-				if (input->isIdInList(ti->dataInfo[i].type.id)) {
-					buf->addFieldData(ti->dataInfo[i].type.id, ti->data +ti->dataInfo[i].offset,
-							ti->dataInfo[i].type.length, ti->fieldInfo[i].type.eid);
-				}
+			for (unsigned i = 0; i != plan->dataFields.size(); ++i) {
+				const FieldInfo& fi = ti->dataInfo[plan->dataFields[i]];
+				buf->addFieldData(fi.type.id, ti->data + fi.offset, fi.type.length, fi.type.eid);
 			}
 			buf->recordEnd();
 		}
+		input->publishBuffer(buf);
 	}/* Error message is printed in filepolicy.h with an error counter
 	else { 
 		msg(MSG_ERROR, "DetectionBase: getBuffer() returned NULL, record dropped!");
@@ -190,7 +262,66 @@ int newDataRecordFixedFieldsArrived(void* handle, SourceID sourceID,
 template <class PacketReader, class Storage>
 int dataTemplateDestroyed(void* handle, SourceID sourceID, DataTemplateInfo* dataTemplateInfo) 
 {
+	delete static_cast<DecoderPlan*>(dataTemplateInfo->userData);
+	dataTemplateInfo->userData = 0;
         return 0;
 }
 
+
+/**
+ * Appends a record to the batch of a @c BatchInputPolicy.
+ * Only the fields of the decoder plan are decoded, no storage is involved
+ * and no lock is taken. The batch is passed to the storage when it is full,
+ * when records of another source arrive or when the packets are imported.
+ */
+template <class BatchReader>
+void appendToBatch(BatchReader* input, SourceID sourceID, const DecoderPlan* plan,
+		   const FieldInfo* fieldInfo, FieldData* data,
+		   const FieldInfo* dataInfo, FieldData* fixedData)
+{
+	FlowRecord record;
+	record.clear();
+	for (unsigned i = 0; i != plan->columns.size(); ++i) {
+		const DecoderPlan::BatchColumn& c = plan->columns[i];
+		if (c.fixed) {
+			record.setField(c.column, fixedData + dataInfo[c.index].offset, dataInfo[c.index].type.length);
+		} else {
+			record.setField(c.column, data + fieldInfo[c.index].offset, fieldInfo[c.index].type.length);
+		}
+	}
+	input->appendRecord(sourceID, record);
+}
+
+/**
+ * Batched variant of @c newDataRecordArrived(), used by @c BatchInputPolicy.
+ * The handle points to the PacketReader base class of the policy.
+ */
+template <class BatchReader>
+int newDataRecordBatched(void* handle, SourceID sourceID, TemplateInfo* ti,
+			 uint16_t length, FieldData* data)
+{
+	BatchReader* input = static_cast<BatchReader*>(static_cast<typename BatchReader::Reader*>(handle));
+	if (!ti->userData) {
+		ti->userData = compileDecoderPlan(static_cast<typename BatchReader::Reader*>(input), ti->fieldInfo, ti->fieldCount);
+	}
+	appendToBatch(input, sourceID, static_cast<DecoderPlan*>(ti->userData), ti->fieldInfo, data, (FieldInfo*)0, (FieldData*)0);
+	return 0;
+}
+
+/**
+ * Batched variant of @c newDataRecordFixedFieldsArrived(), used by @c BatchInputPolicy.
+ * The handle points to the PacketReader base class of the policy.
+ */
+template <class BatchReader>
+int newDataRecordFixedFieldsBatched(void* handle, SourceID sourceID, DataTemplateInfo* ti,
+				    uint16_t length, FieldData* data)
+{
+	BatchReader* input = static_cast<BatchReader*>(static_cast<typename BatchReader::Reader*>(handle));
+	if (!ti->userData) {
+		newDataTemplateArrived<typename BatchReader::Reader, typename BatchReader::StorageType>(handle, sourceID, ti);
+	}
+	appendToBatch(input, sourceID, static_cast<DecoderPlan*>(ti->userData), ti->fieldInfo, data, ti->dataInfo, ti->data);
+	return 0;
+}
+
 #endif
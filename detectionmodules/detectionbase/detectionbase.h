@@ -203,6 +203,34 @@ class DetectionBase
 	{
 		inputPolicy.subscribeSourceId(id);
 	}
+
+	/**
+	 * Hands a storage object passed to test() back to the input policy
+	 * for reuse, instead of deleting it.
+	 * Only for input policies with a storage pool (@c UnbufferedFilesInputPolicy).
+	 */
+	void releaseStorage(DataStorage* ds)
+	{
+		inputPolicy.releaseStorage(ds);
+	}
+
+	/**
+	 * Sets the number of records that may wait for test() before further
+	 * records are dropped, and preallocates as many storage objects.
+	 * Only for input policies with a storage pool (@c UnbufferedFilesInputPolicy).
+	 */
+	void setStorageHighWaterMark(unsigned n)
+	{
+		inputPolicy.setHighWaterMark(n);
+	}
+
+	/**
+	 * Gives access to the input policy, e.g. to read its statistics.
+	 */
+	static InputPolicy& getInputPolicy()
+	{
+		return inputPolicy;
+	}
         
 
         /**
@@ -38,12 +38,20 @@
 SemShmNotifier::SemShmNotifier() 
 {
 	std::string tmp;
+	int shmConsumer = -1;
+	int recordConsumer = -1;
         std::cin >> semKey >> shmKey >> tmp;
 	
+	useSpool_ = false;
+	useDecodedRecords_ = false;
 	if (tmp == "USE_FILES") {
 		useFiles_ = true;
+	} else if (tmp == "USE_SPOOL") {
+		useFiles_ = true;
+		useSpool_ = true;
 	} else {
 		useFiles_ = false;
+		std::cin >> shmConsumer >> recordConsumer;
 	}
 	
 	std::cin >> packetDir;
@@ -56,19 +64,42 @@ SemShmNotifier::SemShmNotifier()
 	
         nps = new shared::SharedObj(shmKey);
 	
+	if (useSpool_) {
+		IpfixSpool::attachSpool(packetDir);
+	}
+
 	if (!useFiles_) {
 		int id = shmget(nps->getStorageKey(), nps->getStorageSize(), S_IRWXU);
 		if (-1 == id) {
 			throw std::runtime_error("Could not get shm id!");
 		}
-		void* ptr = shmat(id, NULL, SHM_RDONLY);
+		// not read only: we have to publish our read position within the ring
+		void* ptr = shmat(id, NULL, 0);
 		if ((void*)-1 == ptr) {
 			throw std::runtime_error(std::string("SemShmNotifier: Could not attach shared memory storage area: ") + strerror(errno));
 			
 		}
 		
-		IpfixShm::setShmPointer((byte*)ptr);
-		IpfixShm::setShmSize(nps->getStorageSize());
+		if (shmConsumer == -1 && recordConsumer == -1) {
+			throw std::runtime_error("SemShmNotifier: Collector didn't assign a shared memory consumer slot");
+		}
+		/* the collector assigns a slot only within the ring we read */
+		if (shmConsumer != -1) {
+			IpfixShm::attachRing((byte*)ptr, nps->getStorageSize(), shmConsumer);
+		}
+
+		if (recordConsumer != -1 && nps->getRecordKey() != 0) {
+			id = shmget(nps->getRecordKey(), nps->getRecordSize(), S_IRWXU);
+			if (-1 == id) {
+				throw std::runtime_error("Could not get shm id of the flow record ring!");
+			}
+			ptr = shmat(id, NULL, 0);
+			if ((void*)-1 == ptr) {
+				throw std::runtime_error(std::string("SemShmNotifier: Could not attach flow record ring: ") + strerror(errno));
+			}
+			FlowRecordShm::attachRing((byte*)ptr, nps->getRecordSize(), recordConsumer);
+			useDecodedRecords_ = true;
+		}
 	}
 }
 
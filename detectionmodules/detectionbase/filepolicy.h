@@ -28,17 +28,21 @@
 #include <commonutils/sharedobj.h>
 #include <commonutils/metering.h>
 #include <commonutils/packetstats.h>
+#include <commonutils/spscqueue.h>
 
 
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <semaphore.h>
+#include <arpa/inet.h>
 #include <errno.h>
 
 
 #include <list>
+#include <vector>
 #include <iostream>
+#include <stdexcept>
 
 /**
  * Uses signals, semaphores and a shared memory block
@@ -91,6 +95,18 @@ public:
 	 * TODO: REMOVE THIS TESTING WORKAROUND!
 	 */
 	bool useFiles() { return useFiles_; }
+
+	/**
+	 * True if the collector appends the packets to a spool of segment
+	 * files instead of writing one file per packet (only with @c useFiles()).
+	 */
+	bool useSpool() { return useSpool_; }
+
+	/**
+	 * True if the collector publishes decoded flow records (see @c FlowRecordShm)
+	 * in addition to the raw packets (only without @c useFiles()).
+	 */
+	bool useDecodedRecords() { return useDecodedRecords_; }
 private:
         key_t semKey, shmKey;
         int semId;
@@ -99,6 +115,8 @@ private:
         std::string packetDir;
 
 	bool useFiles_;
+	bool useSpool_;
+	bool useDecodedRecords_;
 };
 
 
@@ -114,8 +132,12 @@ template <
 >
 class PacketReader {
 public:
-        PacketReader()
-                : packetProcessor(NULL), data(NULL)
+	/**
+	 * @param decodedRecords true if the module wants to read the flow records
+	 *        decoded by the collector instead of the raw packets (if available)
+	 */
+        PacketReader(bool decodedRecords = false)
+                : packetProcessor(NULL), data(NULL), useDecodedRecords(false)
         {
 		Metering::setDirectoryName("metering/");
 		metering = new Metering("packetreader");
@@ -146,6 +168,16 @@ public:
                                 
                 packetProcessor = createIpfixPacketProcessor();
                 setIpfixParser(packetProcessor, ipfixParser);
+
+		/* the collector assigned us a slot within only one of the two
+		   rings, see <decodedRecords> of the module in its config */
+		if (FlowRecordShm::isAttached()) {
+			if (!decodedRecords) {
+				throw std::runtime_error("PacketReader: Module parses raw packets, "
+							 "don't configure decodedRecords for it");
+			}
+			useDecodedRecords = true;
+		}
         }
 
         ~PacketReader() 
@@ -165,33 +197,57 @@ public:
                 static char* filename = new char[filesize];
 		static uint16_t len = 0;
 
-                for ( i = notifier.getFrom(); i != notifier.getTo(); ++i) {
-			if (notifier.useFiles()) {
-				snprintf(filename, filesize, "%s%i", notifier.getPacketDir().c_str(), (int)i);
-				if (NULL == (fd = fopen(filename, "rb"))) {
-					std::cerr << "Detection modul: Could not open file"
-						  << filename << ": " << strerror(errno) 
-						  << std::endl;
-				}
-				
-				read(fileno(fd), &len, sizeof(uint16_t));
-				read(fileno(fd), data, len);
-				if (isSourceIdInList(*(uint16_t*)(data + 12))) {
-					packetProcessor->processPacketCallbackFunction(packetProcessor->ipfixParser, data, len);
+		if (!notifier.useFiles()) {
+			/* our read position within the shared memory ring tells us which
+			   packets are new. Read everything published so far (the collector
+			   doesn't have to wait for us, see asynchronous delivery) */
+			byte* packet;
+			while (0 != (len = IpfixShm::readPacket(&packet))) {
+                                metering->addValue();
+				if (isSourceIdInList(*(uint16_t*)(packet+12))) {
+					packetProcessor->processPacketCallbackFunction(packetProcessor->ipfixParser, packet, len);
 				}
-				metering->addValue();
-				if (EOF == fclose(fd)) {
-					std::cerr << "Detection Modul: Could not close "
-						  << filename << ": " << strerror(errno)
-						  << std::endl;
+			}
+			IpfixShm::releasePacket();
+			return;
+		}
+
+		if (notifier.useSpool()) {
+			/* packets are looked up by their file number within the mapped segments */
+			const byte* packet;
+			for (i = notifier.getFrom(); i != notifier.getTo(); ++i) {
+				if (0 == (len = IpfixSpool::readPacket((unsigned)i, &packet))) {
+					std::cerr << "Detection modul: Packet " << i
+						  << " is not within the spool" << std::endl;
+					continue;
 				}
-			} else {
-				len = IpfixShm::readPacket(&data);
                                 metering->addValue();
-				if (isSourceIdInList(*(uint16_t*)(data+12))) {
-					packetProcessor->processPacketCallbackFunction(packetProcessor->ipfixParser, data, len);
+				if (isSourceIdInList(*(uint16_t*)(packet+12))) {
+					packetProcessor->processPacketCallbackFunction(packetProcessor->ipfixParser, (byte*)packet, len);
 				}
 			}
+			return;
+		}
+
+                for ( i = notifier.getFrom(); i != notifier.getTo(); ++i) {
+			snprintf(filename, filesize, "%s%i", notifier.getPacketDir().c_str(), (int)i);
+			if (NULL == (fd = fopen(filename, "rb"))) {
+				std::cerr << "Detection modul: Could not open file"
+					  << filename << ": " << strerror(errno) 
+					  << std::endl;
+			}
+			
+			read(fileno(fd), &len, sizeof(uint16_t));
+			read(fileno(fd), data, len);
+			if (isSourceIdInList(*(uint16_t*)(data + 12))) {
+				packetProcessor->processPacketCallbackFunction(packetProcessor->ipfixParser, data, len);
+			}
+			metering->addValue();
+			if (EOF == fclose(fd)) {
+				std::cerr << "Detection Modul: Could not close "
+					  << filename << ": " << strerror(errno)
+					  << std::endl;
+			}
                 }
         }
 
@@ -213,9 +269,15 @@ protected:
 	Mutex recordMutex;
         byte* data;
 	Metering* metering;
+	bool useDecodedRecords;
 
 	virtual Buffer* getBuffer() = 0;
 
+	/**
+	 * Called when a record has been stored in a buffer returned by @c getBuffer().
+	 */
+	virtual void publishBuffer(Buffer*) {}
+
 
         bool isIdInList(int id) const
         {
@@ -257,6 +319,7 @@ protected:
 									 DataTemplateInfo* ti, uint16_t length,
 									 FieldData* data);
         friend int dataTemplateDestroyed<PacketReader, Buffer>(void* handle, SourceID sourceID, DataTemplateInfo* dataTemplateInfo);
+        friend DecoderPlan* compileDecoderPlan<PacketReader>(PacketReader* input, const FieldInfo* fieldInfo, uint16_t fieldCount);
 };
 
 
@@ -313,6 +376,12 @@ private:
 /** 
  * Extracts IPFIX packets from files and imports them into a storage class. 
  * Each IPFIX record is seperately stored within an instance of the Storage class.
+ * Storage objects are taken from a pool. If the module hands them back with
+ * @c releaseStorage() instead of deleting them, no memory is allocated per
+ * record. At most highWaterMark records wait for test(), further records
+ * are dropped; the pool holds at most highWaterMark free objects.
+ * The records are handed from the import thread to the test thread through
+ * a lock-free @c SpscQueue; the test thread takes them in batches.
  */ 
 template <
 	class Notifier,
@@ -320,11 +389,47 @@ template <
 >
 class UnbufferedFilesInputPolicy : public InputPolicyBase<Notifier, Storage>, public PacketReader<Notifier, Storage> {
 public:
-	UnbufferedFilesInputPolicy() : maxBuffers(4096), bufferErrors(0) {
-		packetLock.lock();
+	UnbufferedFilesInputPolicy() : queue(4096), highWaterMark(4096), batchCount(0), batchPos(0),
+		droppedRecords(0), maxDepth(0) {
 	}
 
 	~UnbufferedFilesInputPolicy() {
+		for (typename std::vector<Storage*>::iterator i = pool.begin(); i != pool.end(); ++i)
+			delete *i;
+	}
+
+	/**
+	 * Sets the number of records that may wait for test() and fills the
+	 * pool with that many storage objects. Must be called before the
+	 * module starts.
+	 */
+	void setHighWaterMark(unsigned n) {
+		queue.resize(n);
+		poolLock.lock();
+		highWaterMark = n;
+		while (pool.size() < highWaterMark)
+			pool.push_back(new Storage());
+		while (pool.size() > highWaterMark) {
+			delete pool.back();
+			pool.pop_back();
+		}
+		poolLock.unlock();
+	}
+
+	/**
+	 * Returns a storage object (received from @c getStorage()) to the pool.
+	 * Storage::recycle() is called to prepare it for the next record.
+	 */
+	void releaseStorage(Storage* s) {
+		s->recycle();
+		s->setValid(false);
+		poolLock.lock();
+		if (pool.size() < highWaterMark) {
+			pool.push_back(s);
+			s = NULL;
+		}
+		poolLock.unlock();
+		delete s;
 	}
 
 	void importToStorage() {
@@ -336,32 +441,222 @@ public:
 	 */
         Storage* getStorage()
         {
-		packetLock.lock();
-		PacketReader<Notifier, Storage>::recordMutex.lock();
-		Storage* ret = *buffers.begin();
-		buffers.pop_front();
-		PacketReader<Notifier, Storage>::recordMutex.unlock();
-		return ret;
+		if (batchPos == batchCount) {
+			batchCount = queue.waitBatch(batch, BATCH_SIZE);
+			batchPos = 0;
+		}
+		return batch[batchPos++];
         }
 
+	/**
+	 * Number of records waiting for test() (estimate).
+	 */
+	unsigned getQueueDepth() const { return queue.depth() + (batchCount - batchPos); }
+
+	/**
+	 * Largest number of records that waited in the queue.
+	 */
+	unsigned getMaxQueueDepth() const { return maxDepth; }
+
+	/**
+	 * Number of records dropped because highWaterMark records were waiting.
+	 */
+	unsigned long getDroppedRecords() const { return droppedRecords; }
+
 private:
+	static const unsigned BATCH_SIZE = 64;
+
 	Storage* getBuffer() {
-		if(buffers.size() >= maxBuffers) // Buffer is full
+		if(queue.depth() >= highWaterMark) // Buffer is full
 		{
-			bufferErrors++;
-			msg(MSG_ERROR, "DetectionBase: getBuffer() returns NULL, record will be dropped! %lu", bufferErrors);
+			droppedRecords++;
+			/* don't flood the log, report 1, 2, 4, 8, ... drops */
+			if ((droppedRecords & (droppedRecords - 1)) == 0)
+				msg(MSG_ERROR, "DetectionBase: %u records wait for test(), %lu records dropped so far", queue.depth(), droppedRecords);
 			return NULL;
 		}
-		Storage* ret = new Storage();
-		buffers.push_back(ret);
-		packetLock.unlock();
+		Storage* ret = NULL;
+		poolLock.lock();
+		if (!pool.empty()) {
+			ret = pool.back();
+			pool.pop_back();
+		}
+		poolLock.unlock();
+		if (!ret)
+			ret = new Storage();
 		return ret;
 	}
 
-	std::list<Storage*> buffers;
-	unsigned maxBuffers;	
-	unsigned bufferErrors;
-	Mutex packetLock; // locked as long as buffers is empty
+	/* the record is complete, hand it to the test thread */
+	void publishBuffer(Storage* s) {
+		queue.push(s); // can't fail, depth < highWaterMark <= capacity
+		unsigned depth = queue.depth();
+		if (depth > maxDepth)
+			maxDepth = depth;
+	}
+
+	SpscQueue<Storage*> queue;
+	std::vector<Storage*> pool; // free storage objects
+	unsigned highWaterMark;
+	Mutex poolLock; // pool (test thread and import thread)
+
+	/* consumer side: records taken from the queue, but not yet returned */
+	Storage* batch[BATCH_SIZE];
+	unsigned batchCount;
+	unsigned batchPos;
+
+	/* producer side */
+	unsigned long droppedRecords;
+	unsigned maxDepth;
+};
+
+
+
+/**
+ * Extracts IPFIX packets from files (or the shared memory ring) and imports
+ * them into a storage class in batches. Instead of calling recordStart(),
+ * addFieldData() and recordEnd() for every record, the subscribed fields of
+ * up to RecordBatch::CAPACITY records are decoded into a column oriented
+ * @c RecordBatch, which is passed to the storage with one call to
+ * Storage::addRecordBatch(const RecordBatch&).
+ * Only fields that have a column within @c RecordBatch are passed to the storage.
+ * Like @c BufferedFilesInputPolicy, all data is buffered into one storage
+ * object till the data is fetched using @c getStorage().
+ * If the collector publishes decoded flow records, the records are taken
+ * from the record ring and no IPFIX packet is parsed within the module.
+ */
+template <
+	class Notifier,
+	class Storage
+>
+class BatchInputPolicy : public InputPolicyBase<Notifier, Storage>, public PacketReader<Notifier, Storage> {
+public:
+	typedef PacketReader<Notifier, Storage> Reader;
+	typedef Storage StorageType;
+
+	BatchInputPolicy() : Reader(true) {
+		buffer = new Storage();
+
+		/* replace the record callbacks installed by PacketReader */
+		CallbackInfo* cbi = &this->packetProcessor->ipfixParser->callbackInfo[0];
+		cbi->dataRecordCallbackFunction = newDataRecordBatched<BatchInputPolicy>;
+		cbi->dataDataRecordCallbackFunction = newDataRecordFixedFieldsBatched<BatchInputPolicy>;
+	}
+
+	~BatchInputPolicy() {
+		if (buffer)
+			delete buffer;
+	}
+
+	void importToStorage() {
+		if (this->useDecodedRecords) {
+			importRecords();
+		} else {
+			import(this->getNotifier());
+		}
+		flushBatch();
+	}
+
+	/**
+	 * Returns a storage object. This object contains all data buffered since last call to @c getStorage().
+	 * The method returns an empty object if no data was buffered.
+	 * @return buffered IFPIX data.
+	 */
+        Storage* getStorage()
+        {
+                packetLock.lock();
+                Storage* ret = buffer;
+                buffer = new Storage();
+                packetLock.unlock();
+                return ret;
+        }
+
+private:
+	Storage* buffer;
+	Mutex packetLock;
+	RecordBatch batch;
+
+	Storage* getBuffer() { return buffer; }
+
+	/**
+	 * Appends a record to the batch. The batch is passed to the storage when
+	 * it is full or when records of another source arrive.
+	 * @param mask fields of the record that are taken over
+	 */
+	void appendRecord(SourceID sourceID, const FlowRecord& record, uint16_t mask = 0xffff) {
+		if (!batch.empty() && batch.sourceId != sourceID) {
+			flushBatch();
+		}
+		batch.sourceId = sourceID;
+		batch.append(record, mask);
+		if (batch.full()) {
+			flushBatch();
+		}
+	}
+
+	/**
+	 * Reads all flow records the collector published since the last call.
+	 */
+	void importRecords() {
+		/* only the subscribed fields are passed to the storage */
+		uint16_t mask = 0;
+		if (this->idList.empty()) {
+			mask = 0xffff;
+		}
+		for (unsigned i = 0; i != this->idList.size(); ++i) {
+			int field = FlowRecord::fieldForType(this->idList[i]);
+			if (field >= 0)
+				mask |= (1 << field);
+		}
+
+		const byte* records;
+		unsigned count;
+		FlowRecord record;
+		while (0 != (count = FlowRecordShm::readRecords(&records))) {
+			this->metering->addValue();
+			for (unsigned i = 0; i != count; ++i) {
+				/* records within the ring are not aligned */
+				memcpy(&record, records + i * sizeof(FlowRecord), sizeof(FlowRecord));
+				switch (record.type) {
+				case FlowRecord::FLOW:
+					break;
+				case FlowRecord::TEMPLATE_ADDED:
+				case FlowRecord::TEMPLATE_DESTROYED:
+					/* the storages don't keep any per template state, so
+					   template changes don't concern us */
+					continue;
+				default:
+					/* unknown control record of a newer collector */
+					continue;
+				}
+				/* same check as for raw packets (bytes 12 and 13 of the packet header) */
+				uint32_t header = htonl(record.sourceId);
+				uint16_t id;
+				memcpy(&id, &header, sizeof(id));
+				if (this->isSourceIdInList(id)) {
+					appendRecord(record.sourceId, record, mask);
+				}
+			}
+		}
+		FlowRecordShm::releaseRecords();
+	}
+
+	/**
+	 * Passes all records collected in the batch to the storage.
+	 */
+	void flushBatch() {
+		if (batch.empty())
+			return;
+		packetLock.lock();
+		buffer->setValid(true);
+		buffer->addRecordBatch(batch);
+		packetLock.unlock();
+		batch.clear();
+	}
+
+	friend void appendToBatch<BatchInputPolicy>(BatchInputPolicy* input, SourceID sourceID, const DecoderPlan* plan,
+						    const FieldInfo* fieldInfo, FieldData* data,
+						    const FieldInfo* dataInfo, FieldData* fixedData);
 };
 
 #endif
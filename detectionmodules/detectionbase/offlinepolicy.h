@@ -22,20 +22,33 @@
 
 #include "inputpolicybase.h"
 
+#include <semaphore.h>
+
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 
 /** 
  * Reads storage data from file and returns them into a storage object. 
+ *
+ * The storage objects are read by the working thread of DetectionBase while
+ * the test thread is testing the previous ones. Up to @c prefetch intervals
+ * are read ahead (one by default).
  */ 
 template <
 	class Storage
 >
 class OfflineInputPolicy : public InputPolicyBase<InputNotificationBase, Storage> {
 public:
+	/**
+	 * Function reading the next storage object from a source other than
+	 * a text file (see @c openOfflineReader()).
+	 * @returns false if there is no more data
+	 */
+	typedef bool (*ReadFunction)(Storage*);
+
 	OfflineInputPolicy() {
-		dataAvailableLock.lock();
 	}
 
 	~OfflineInputPolicy() {
@@ -45,25 +58,45 @@ public:
 
 	/**
 	 * Sets input file name. 
+	 * @param prefetch number of storage objects read ahead
 	 * @returns returns false if operation failed
 	 */
-	static bool openOfflineFile(const char* filename)
+	static bool openOfflineFile(const char* filename, unsigned prefetch = 1)
 	{
 	    inputstr.open(filename);
 	    if(!inputstr)
 		return false;
+	    initQueue(prefetch);
 	    return true;
 	} 
+
+	/**
+	 * Reads the storage objects with the given function instead of
+	 * operator>> from a file.
+	 * @param prefetch number of storage objects read ahead
+	 */
+	static void openOfflineReader(ReadFunction function, unsigned prefetch = 1)
+	{
+	    reader = function;
+	    readerDone = false;
+	    initQueue(prefetch);
+	}
 		
 	/**
+	 * Blocks until there is place for another storage object.
 	 * Checks if file is opened and data is available.
 	 * @returns returns 1 if more data is available, 0 otherwise
 	 */
 	int wait()
 	{
-	    bufferLock.lock();
-	    if(inputstr.is_open() && !inputstr.eof())
+	    if (queue.empty()) // no file opened
+		return 0;
+	    sem_wait(&freeSlots);
+	    if(reader ? !readerDone : (inputstr.is_open() && !inputstr.eof()))
 		return 1;
+	    // let the test thread take all storage objects read so far
+	    for (unsigned i = 1; i < queue.size(); i++)
+		sem_wait(&freeSlots);
 	    return 0;
 	}
 	    
@@ -72,32 +105,68 @@ public:
 	 */
 	void importToStorage() 
 	{
-                buffer = new Storage();
-		inputstr >> buffer;
-		if(!(!inputstr))
-		    buffer->setValid(true);
-		dataAvailableLock.unlock();
+		Storage* buffer = new Storage();
+		if (reader) {
+		    if (reader(buffer))
+			buffer->setValid(true);
+		    else
+			readerDone = true;
+		}
+		else {
+		    inputstr >> buffer;
+		    if(!(!inputstr))
+			buffer->setValid(true);
+		}
+		queue[tail] = buffer;
+		tail = (tail + 1) % queue.size();
+		sem_post(&usedSlots);
 	}
 
 	/**
-	 * Returns storage if importToStorage has been called. Blocks otherwise.
+	 * Returns the next storage object read by importToStorage.
+	 * Blocks if there is none yet.
 	 */
         Storage* getStorage()
         {
 		Storage* ret;
-		dataAvailableLock.lock();
-		ret = buffer;
-		bufferLock.unlock();
+		sem_wait(&usedSlots);
+		ret = queue[head];
+		head = (head + 1) % queue.size();
+		sem_post(&freeSlots);
 		return ret;
         }
 
 private:
-	Storage* buffer;
+	static void initQueue(unsigned prefetch)
+	{
+	    if (prefetch == 0)
+		prefetch = 1;
+	    queue.assign(prefetch, (Storage*)NULL);
+	    head = tail = 0;
+	    sem_init(&freeSlots, 0, prefetch);
+	    sem_init(&usedSlots, 0, 0);
+	}
+
 	static std::ifstream inputstr;
-	Mutex bufferLock;
-	Mutex dataAvailableLock;
+	static ReadFunction reader;
+	static bool readerDone;
+
+	/* storage objects read ahead; single producer (working thread)
+	   and single consumer (test thread), the semaphores count the
+	   free and used slots */
+	static std::vector<Storage*> queue;
+	static unsigned head, tail;
+	static sem_t freeSlots;
+	static sem_t usedSlots;
 };
 
 template <class Storage> std::ifstream OfflineInputPolicy<Storage>::inputstr;
+template <class Storage> typename OfflineInputPolicy<Storage>::ReadFunction OfflineInputPolicy<Storage>::reader = NULL;
+template <class Storage> bool OfflineInputPolicy<Storage>::readerDone = false;
+template <class Storage> std::vector<Storage*> OfflineInputPolicy<Storage>::queue;
+template <class Storage> unsigned OfflineInputPolicy<Storage>::head = 0;
+template <class Storage> unsigned OfflineInputPolicy<Storage>::tail = 0;
+template <class Storage> sem_t OfflineInputPolicy<Storage>::freeSlots;
+template <class Storage> sem_t OfflineInputPolicy<Storage>::usedSlots;
 
 #endif
@@ -0,0 +1,105 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#ifndef _RECORD_BATCH_H_
+#define _RECORD_BATCH_H_
+
+
+#include <commonutils/flowrecord.h>
+
+
+#include <stdint.h>
+
+
+/**
+ * Column oriented batch of flow records. Used by @c BatchInputPolicy to
+ * hand a whole bunch of records to a storage class with a single call to
+ * Storage::addRecordBatch(const RecordBatch&).
+ * Record i consists of the i-th element of every column. Fields that were
+ * not contained in the record (or were not subscribed to) are 0 and their
+ * bit in present[i] is not set. Fields that were contained with a length
+ * they can't be decoded from are 0 and their bit in malformed[i] is set.
+ * All records of one batch were exported by the same source.
+ */
+struct RecordBatch {
+	static const unsigned CAPACITY = 256;
+
+	/* columns are numbered like the fields of a FlowRecord */
+	enum Column {
+		SRC_IP = FlowRecord::SRC_IP,
+		DST_IP = FlowRecord::DST_IP,
+		SRC_PORT = FlowRecord::SRC_PORT,
+		DST_PORT = FlowRecord::DST_PORT,
+		PROTO = FlowRecord::PROTO,
+		PACKETS = FlowRecord::PACKETS,
+		OCTETS = FlowRecord::OCTETS,
+		FLOW_START = FlowRecord::FLOW_START,
+		FLOW_END = FlowRecord::FLOW_END,
+		COLUMN_COUNT = FlowRecord::FIELD_COUNT
+	};
+
+	RecordBatch() : sourceId(0), count(0) {}
+
+	/**
+	 * Maps an IPFIX field id to its column.
+	 * @return column number or -1 if the field has no column
+	 */
+	static int columnForField(uint16_t id) { return FlowRecord::fieldForType(id); }
+
+	bool empty() const { return count == 0; }
+	bool full() const { return count == CAPACITY; }
+	void clear() { count = 0; }
+
+	/**
+	 * Appends a decoded record. Only the fields within mask are taken over.
+	 */
+	void append(const FlowRecord& r, uint16_t mask = 0xffff)
+	{
+		uint16_t p = r.present & mask;
+		srcIp[count] = (p & (1 << SRC_IP)) ? r.srcIp : 0;
+		dstIp[count] = (p & (1 << DST_IP)) ? r.dstIp : 0;
+		srcPort[count] = (p & (1 << SRC_PORT)) ? r.srcPort : 0;
+		dstPort[count] = (p & (1 << DST_PORT)) ? r.dstPort : 0;
+		proto[count] = (p & (1 << PROTO)) ? r.proto : 0;
+		packets[count] = (p & (1 << PACKETS)) ? r.packets : 0;
+		octets[count] = (p & (1 << OCTETS)) ? r.octets : 0;
+		flowStart[count] = (p & (1 << FLOW_START)) ? r.flowStart : 0;
+		flowEnd[count] = (p & (1 << FLOW_END)) ? r.flowEnd : 0;
+		present[count] = p;
+		malformed[count] = r.malformed & mask;
+		++count;
+	}
+
+	bool hasField(unsigned record, Column column) const { return present[record] & (1 << column); }
+	bool isMalformed(unsigned record) const { return malformed[record] != 0; }
+
+	SourceID sourceId;
+	unsigned count;
+
+	uint32_t srcIp[CAPACITY];     /**< network byte order */
+	uint32_t dstIp[CAPACITY];     /**< network byte order */
+	uint16_t srcPort[CAPACITY];   /**< host byte order */
+	uint16_t dstPort[CAPACITY];   /**< host byte order */
+	uint8_t proto[CAPACITY];
+	uint64_t packets[CAPACITY];
+	uint64_t octets[CAPACITY];
+	uint32_t flowStart[CAPACITY];
+	uint32_t flowEnd[CAPACITY];
+	uint16_t present[CAPACITY];   /**< bit (1 << column) is set if the field was contained in the record */
+	uint16_t malformed[CAPACITY]; /**< bit (1 << column) is set if the field had an unsupported length */
+};
+
+#endif
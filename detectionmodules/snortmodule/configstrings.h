@@ -19,6 +19,14 @@ namespace ConfigStrings
 	static const std::string DEBUG_LEVEL     = "debug_level";
 	static const std::string CALC_THCS = "calculate_transportheader_checksum";
 	static const std::string CALC_IPHCS = "calculate_ipheader_checksum";
+	static const std::string INSTANCES = "instances";
+	static const unsigned	 DEFAULT_INSTANCES = 1;
+	static const std::string HIGH_WATER_MARK = "high_water_mark";
+	static const unsigned	 DEFAULT_HIGH_WATER_MARK = 4096;
+	static const std::string BATCH_SIZE = "batch_size";
+	static const unsigned	 DEFAULT_BATCH_SIZE = 65536;
+	static const std::string BATCH_LATENCY = "batch_latency";
+	static const unsigned	 DEFAULT_BATCH_LATENCY = 10;
 	static const std::string ACCEPT_SOURCE_IDS = "accept_source_ids";
 	static const std::string WRAPPERSECTION = "xmlwrapper";
 	static const std::string ENABLE = "enable";
@@ -35,13 +35,80 @@
 
 #include "pcappacket.h"
 
+#include <string.h>
 
-PcapPacket::PcapPacket() : iphps_p(0), iphps_size(0), ippps_p(0), ippps_size(0), hdr_tcp(false), hdr_udp(false), ts_sec(0), ts_usec(0) {};
+
+PcapPacket::PcapPacket() : hdr_udp(false), hdr_tcp(false), hdr_dest_port(0), hdr_src_port(0), ts_sec(0), ts_usec(0), iphps_p(0), iphps_size(0), ippps_p(0), ippps_size(0), iphps_capacity(0), ippps_capacity(0) {};
 PcapPacket::~PcapPacket(){
-delete iphps_p;
-delete ippps_p;
+delete[] iphps_p;
+delete[] ippps_p;
 };
 
+void PcapPacket::reset(){
+	hdr_udp = false;
+	hdr_tcp = false;
+	hdr_dest_port = 0;
+	hdr_src_port = 0;
+	ts_sec = 0;
+	ts_usec = 0;
+	HDR_IP = hdr_ip_t();
+	HDR_UDP = hdr_udp_t();
+	HDR_TCP = hdr_tcp_t();
+	iphps_size = 0;
+	ippps_size = 0;
+}
+
+/* Addresses and ports are combined with xor (which doesn't care about
+ * the direction) and mixed with the finalizer of MurmurHash3.
+ * If only the IP header section was exported, the 5-tuple is taken
+ * from there. */
+uint32_t PcapPacket::flow_hash() const{
+	uint32_t src = HDR_IP.src_addr, dst = HDR_IP.dest_addr;
+	uint16_t sport = hdr_src_port, dport = hdr_dest_port;
+	uint8_t proto = HDR_IP.protocol;
+
+	if (iphps_size >= 20) {
+		const unsigned char* p = (const unsigned char*)iphps_p;
+		int hlen = (p[0] & 0x0f) * 4;
+		proto = p[9];
+		memcpy(&src, p + 12, 4);
+		memcpy(&dst, p + 16, 4);
+		if ((proto == 6 || proto == 17) && iphps_size >= hlen + 4) {
+			memcpy(&sport, p + hlen, 2);
+			memcpy(&dport, p + hlen + 2, 2);
+		}
+	}
+
+	uint32_t h = (src ^ dst) + 0x9e3779b9 * (uint32_t)(sport ^ dport) + proto;
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+/* the buffers only grow, so a recycled packet rarely allocates */
+void PcapPacket::set_iphps(const void* data, int size){
+	if (size > iphps_capacity) {
+		delete[] iphps_p;
+		iphps_p = new char[size];
+		iphps_capacity = size;
+	}
+	memcpy(iphps_p, data, size);
+	iphps_size = size;
+}
+
+void PcapPacket::set_ippps(const void* data, int size){
+	if (size > ippps_capacity) {
+		delete[] ippps_p;
+		ippps_p = new char[size];
+		ippps_capacity = size;
+	}
+	memcpy(ippps_p, data, size);
+	ippps_size = size;
+}
+
 char *PcapPacket::ts_fmt = NULL;
 PcapPacket::hdr_ethernet_t PcapPacket::HDR_ETHERNET = {
     {0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
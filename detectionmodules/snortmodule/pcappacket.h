@@ -50,6 +50,11 @@ public:
 
 	PcapPacket();	///< default constructor
 	~PcapPacket();	///< default destructor
+
+	void reset();	///< restores the defaults for the next record, keeps the payload buffers
+	void set_iphps(const void* data, int size); ///< stores the IP header packet section
+	void set_ippps(const void* data, int size); ///< stores the IP payload packet section
+	uint32_t flow_hash() const; ///< hash of the 5-tuple, the same for both directions of a flow
 	
 	bool hdr_udp; ///< used to determine if UDP data has been stored
 	bool hdr_tcp; ///< used to determine if TCP data has been stored	
@@ -135,6 +140,8 @@ public:
 	int   iphps_size; ///< Size of stored IPHeader payload
 	char *ippps_p;	///< Pointer to IPPacket payload
 	int ippps_size;	///< Size of stored IPPacket payload
+	int iphps_capacity; ///< Size of the buffer behind iphps_p
+	int ippps_capacity; ///< Size of the buffer behind ippps_p
 
 private:
 
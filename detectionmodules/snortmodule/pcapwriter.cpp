@@ -25,33 +25,83 @@
 #include "pcapwriter.h"
 #include <iostream>
 
+#include <concentrator/msg.h>
+
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/time.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* hardware CRC32C, selected at runtime (needs __builtin_cpu_supports and
+ * the target attribute, i.e. GCC >= 4.9 on x86) */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define PCAPWRITER_HAVE_SSE42
+#include <nmmintrin.h>
+#endif
+
+unsigned char pcapwriter::padding[PADDING];
 
 
 /*----------------------------------------------------------------------
  * Compute one's complement checksum (from RFC1071)
+ *
+ * The one's complement sum doesn't depend on the byte order (RFC1071,
+ * 2.B), so we add 64-bit words in host byte order with end-around carry
+ * and fold the sum at the end. The result is in network byte order.
  */
 uint16_t pcapwriter::in_checksum (void *buf, unsigned long count)
 {
-    unsigned long sum = 0;
-    uint16_t *addr = (uint16_t *)buf;
+    const uint8_t *addr = (const uint8_t *)buf;
+    uint64_t sum = 0;
+    uint64_t w64;
+    uint32_t w32;
+    uint16_t w16;
 
-    while( count > 1 )  {
+    while( count >= 8 )  {
         /*  This is the inner loop */
-        sum += ntohs(* (uint16_t *) addr);
-        addr++;
+        memcpy(&w64, addr, 8);
+        sum += w64;
+        sum += (sum < w64);
+        addr += 8;
+        count -= 8;
+    }
+    if( count >= 4 ) {
+        memcpy(&w32, addr, 4);
+        sum += w32;
+        sum += (sum < w32);
+        addr += 4;
+        count -= 4;
+    }
+    if( count >= 2 ) {
+        memcpy(&w16, addr, 2);
+        sum += w16;
+        sum += (sum < w16);
+        addr += 2;
         count -= 2;
     }
 
-    /*  Add left-over byte, if any */
-    if( count > 0 )
-        sum += ntohs(* (uint8_t *) addr);
+    /*  Add left-over byte, if any (padded with a zero octet) */
+    if( count > 0 ) {
+        w16 = 0;
+        memcpy(&w16, addr, 1);
+        sum += w16;
+        sum += (sum < w16);
+    }
 
-    /*  Fold 32-bit sum to 16 bits */
-    while (sum>>16)
-        sum = (sum & 0xffff) + (sum >> 16);
+    /*  Fold 64-bit sum to 16 bits */
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
 
-    return htons(~sum);
+    return (uint16_t)~sum;
 }
 
 
@@ -129,18 +179,103 @@ uint32_t pcapwriter::crc_c[256] =
 0xBE2DA0A5L, 0x4C4623A6L, 0x5F16D052L, 0xAD7D5351L,
 };
 
+uint32_t pcapwriter::crc_c8[8][256];
+pcapwriter::Crc32cKernel pcapwriter::crc32c_kernel = pcapwriter::select_crc32c_kernel();
+
 uint32_t pcapwriter::crc32c(const uint8_t* buf, unsigned int len, uint32_t crc32_init)
+{
+  return crc32c_kernel(buf, len, crc32_init);
+}
+
+/* one octet per step, also used for the head and tail of the other kernels */
+uint32_t pcapwriter::crc32c_table(const uint8_t* buf, unsigned int len, uint32_t crc32)
 {
   unsigned int i;
-  uint32_t crc32;
 
-  crc32 = crc32_init;
   for (i = 0; i < len; i++)
     CRC32C(crc32, buf[i]);
 
   return ( crc32 );
 }
 
+uint32_t pcapwriter::crc32c_sliced(const uint8_t* buf, unsigned int len, uint32_t crc32)
+{
+  uint32_t lo, hi;
+
+  while (len >= 8) {
+    /* the CRC is reflected, so the octets are taken in little endian order */
+    lo = crc32 ^ ((uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24));
+    hi = (uint32_t)buf[4] | ((uint32_t)buf[5] << 8) | ((uint32_t)buf[6] << 16) | ((uint32_t)buf[7] << 24);
+    crc32 = crc_c8[7][lo & 0xff] ^ crc_c8[6][(lo >> 8) & 0xff] ^
+            crc_c8[5][(lo >> 16) & 0xff] ^ crc_c8[4][lo >> 24] ^
+            crc_c8[3][hi & 0xff] ^ crc_c8[2][(hi >> 8) & 0xff] ^
+            crc_c8[1][(hi >> 16) & 0xff] ^ crc_c8[0][hi >> 24];
+    buf += 8;
+    len -= 8;
+  }
+
+  return crc32c_table(buf, len, crc32);
+}
+
+#ifdef PCAPWRITER_HAVE_SSE42
+__attribute__((target("sse4.2")))
+uint32_t pcapwriter::crc32c_sse42(const uint8_t* buf, unsigned int len, uint32_t crc32)
+{
+  /* the crc32 instruction uses the same (reflected) Castagnoli polynomial as crc_c */
+#if defined(__x86_64__)
+  uint64_t crc64 = crc32;
+  uint64_t w;
+
+  while (len >= 8) {
+    memcpy(&w, buf, 8);
+    crc64 = _mm_crc32_u64(crc64, w);
+    buf += 8;
+    len -= 8;
+  }
+  crc32 = (uint32_t)crc64;
+#endif
+  uint32_t w32;
+
+  while (len >= 4) {
+    memcpy(&w32, buf, 4);
+    crc32 = _mm_crc32_u32(crc32, w32);
+    buf += 4;
+    len -= 4;
+  }
+  while (len > 0) {
+    crc32 = _mm_crc32_u8(crc32, *buf);
+    ++buf;
+    --len;
+  }
+
+  return ( crc32 );
+}
+#else
+uint32_t pcapwriter::crc32c_sse42(const uint8_t* buf, unsigned int len, uint32_t crc32)
+{
+  return crc32c_sliced(buf, len, crc32);
+}
+#endif
+
+/* fills crc_c8 and chooses the kernel for this CPU (at program start) */
+pcapwriter::Crc32cKernel pcapwriter::select_crc32c_kernel()
+{
+  int i, k;
+
+  for (i = 0; i < 256; i++)
+    crc_c8[0][i] = crc_c[i];
+  for (k = 1; k < 8; k++)
+    for (i = 0; i < 256; i++)
+      crc_c8[k][i] = (crc_c8[k-1][i] >> 8) ^ crc_c[crc_c8[k-1][i] & 0xff];
+
+#ifdef PCAPWRITER_HAVE_SSE42
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2"))
+    return crc32c_sse42;
+#endif
+  return crc32c_sliced;
+}
+
 uint32_t pcapwriter::finalize_crc32c(uint32_t crc32)
 {
   uint32_t result;
@@ -161,6 +296,9 @@ uint32_t pcapwriter::finalize_crc32c(uint32_t crc32)
  */
 void pcapwriter::writepacket (PcapPacket* packet)
 {
+    lock.lock();
+    if (batch_octets == 0)
+	gettimeofday(&batch_start, NULL);
     ++packets_read;	
     int length = 0;
     int ip_length = 0;
@@ -199,6 +337,13 @@ void pcapwriter::writepacket (PcapPacket* packet)
 	packet->HDR_IP.packet_length = htons(length);
     }
 
+    /* a total length shorter than the IP header we assemble cannot be
+       written without breaking incl_len, drop the packet */
+    if (packet->iphps_size == 0 && ip_length < (int)sizeof(packet->HDR_IP)) {
+	msg(MSG_DEBUG, "pcapwriter: dropping packet with totalLengthIPv4 %d", ip_length);
+	lock.unlock();
+	return;
+    }
 
     length += sizeof(packet->HDR_ETHERNET);
     /* we do not need to respeect minimum frame size
@@ -214,11 +359,11 @@ void pcapwriter::writepacket (PcapPacket* packet)
     if (packet->ts_fmt == NULL) { packet->ts_usec++; }      /* fake packet counter */
     ph.incl_len = length;
     ph.orig_len = length;
-    fwrite(&ph, sizeof(ph), 1, output_file);
+    append(&ph, sizeof(ph));
 
     /* Write Ethernet header */
     packet->HDR_ETHERNET.l3pid = htons(2048);
-    fwrite(&packet->HDR_ETHERNET, sizeof(packet->HDR_ETHERNET), 1, output_file);
+    append(&packet->HDR_ETHERNET, sizeof(packet->HDR_ETHERNET));
 
     /* Write the packet
      * if ipHeaderPacketSection (iphps) is present:
@@ -236,7 +381,7 @@ void pcapwriter::writepacket (PcapPacket* packet)
 	    packet->HDR_IP.hdr_checksum = 0;
 	    packet->HDR_IP.hdr_checksum = in_checksum(&packet->HDR_IP, sizeof(packet->HDR_IP));
 	}
-	fwrite(&packet->HDR_IP, sizeof(packet->HDR_IP), 1, output_file);
+	append(&packet->HDR_IP, sizeof(packet->HDR_IP));
 	written_ip_octets += sizeof(packet->HDR_IP);
 
 	if (packet->ippps_size == 0){
@@ -264,7 +409,7 @@ void pcapwriter::writepacket (PcapPacket* packet)
 		    if (packet->HDR_UDP.checksum == 0) /* differenciate between 'none' and 0 */
 			packet->HDR_UDP.checksum = htons(1);
 		}
-		fwrite(&packet->HDR_UDP, sizeof(packet->HDR_UDP), 1, output_file);
+		append(&packet->HDR_UDP, sizeof(packet->HDR_UDP));
 		written_ip_octets += sizeof(packet->HDR_UDP);
 	    }
 
@@ -290,7 +435,7 @@ void pcapwriter::writepacket (PcapPacket* packet)
 		    if (packet->HDR_TCP.checksum == 0) /* differenciate between 'none' and 0 */
 			packet->HDR_TCP.checksum = htons(1);
 		}
-		fwrite(&packet->HDR_TCP, sizeof(packet->HDR_TCP), 1, output_file);
+		append(&packet->HDR_TCP, sizeof(packet->HDR_TCP));
 		written_ip_octets += sizeof(packet->HDR_TCP);
 	    }
 	    //fwrite(packet_buf, curr_offset, 1, output_file);
@@ -344,7 +489,7 @@ void pcapwriter::writepacket (PcapPacket* packet)
 	    if ((size + written_ip_octets) >= ip_length) // a bad exporter might export ethernet padding as ip payload
 		size = ip_length  - written_ip_octets;
 
-	    fwrite(packet->ippps_p,size, 1, output_file);
+	    append(packet->ippps_p, size);
 	    written_ip_octets += size;
 	}
     }
@@ -354,44 +499,193 @@ void pcapwriter::writepacket (PcapPacket* packet)
         if ((size + written_ip_octets) >= ip_length) // a bad exporter might export ethernet padding as ip payload
 	    size = ip_length  - written_ip_octets;
 
-	fwrite(packet->iphps_p,size, 1, output_file);
+	append(packet->iphps_p, size);
 	written_ip_octets += size;
     }
 
     /* Add padding */
     padding_length = ip_length - written_ip_octets;
-    while(padding_length > 0) {
-	if (sizeof(padding) < padding_length) {
-	    fwrite(padding, sizeof(padding), 1, output_file);
-	    padding_length -= sizeof(padding);
-	} else {
-	    fwrite(padding, padding_length, 1, output_file);
-	    padding_length -= padding_length;
-	}
-    }
+    if (padding_length > 0)
+	append_padding(padding_length);
 
     /* Write Ethernet trailer
     if (eth_trailer_length > 0 ) {
 	memset(tempbuf, 0, eth_trailer_length);
 	fwrite(tempbuf, eth_trailer_length, 1, output_file);
     } */
-    fflush(output_file);
     ++packets_written;
+    packet_done();
+    lock.unlock();
+
+}
+
+
+/*----------------------------------------------------------------------
+ * Staging and batched output
+ */
+void pcapwriter::append(const void* data, size_t len)
+{
+    if (len == 0)
+	return;
+    /* extend the last iovec if it points to the staging buffer as well */
+    if (!iov.empty() && (unsigned char*)iov.back().iov_base + iov.back().iov_len == stage + stage_used)
+	iov.back().iov_len += len;
+    else {
+	struct iovec v;
+	v.iov_base = stage + stage_used;
+	v.iov_len = len;
+	iov.push_back(v);
+    }
+    memcpy(stage + stage_used, data, len);
+    stage_used += len;
+    batch_octets += len;
+}
+
+void pcapwriter::append_padding(size_t len)
+{
+    while (len > 0) {
+	struct iovec v;
+	v.iov_base = padding;
+	v.iov_len = (len < sizeof(padding)) ? len : sizeof(padding);
+	iov.push_back(v);
+	len -= v.iov_len;
+	batch_octets += v.iov_len;
+    }
+}
+
+void pcapwriter::packet_done()
+{
+    /* a packet never stages more than STAGE_RESERVE octets, so the
+     * staging buffer has room for the next one as long as the batch
+     * is smaller than batch_size */
+    if (batch_octets >= batch_size) {
+	write_batch();
+	return;
+    }
+    if (batch_latency > 0) {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	if ((unsigned long)((now.tv_sec - batch_start.tv_sec) * 1000000 + (now.tv_usec - batch_start.tv_usec)) >= batch_latency)
+	    write_batch();
+    }
+}
+
+void pcapwriter::write_batch()
+{
+    if (iov.empty())
+	return;
+
+    int fd = fileno(output_file);
+
+    /* would we have to wait for the reader? */
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    struct timeval start, end;
+    bool stalled = (poll(&pfd, 1, 0) == 0);
+    if (stalled) {
+	++write_stalls;
+	gettimeofday(&start, NULL);
+    }
+
+    size_t i = 0;
+    while (i < iov.size()) {
+	int n = (iov.size() - i < IOV_MAX) ? iov.size() - i : IOV_MAX;
+	ssize_t ret = writev(fd, &iov[i], n);
+	if (ret < 0 && errno == EINTR)
+	    continue;
+	if (ret <= 0) {
+	    msg(MSG_ERROR, "pcapwriter: Couldn't write to fifo: %s", strerror(errno));
+	    break;
+	}
+	/* skip what was written, a partial write ends within an iovec */
+	while (ret > 0) {
+	    if ((size_t)ret >= iov[i].iov_len) {
+		ret -= iov[i].iov_len;
+		++i;
+	    } else {
+		iov[i].iov_base = (unsigned char*)iov[i].iov_base + ret;
+		iov[i].iov_len -= ret;
+		ret = 0;
+	    }
+	}
+    }
+
+    if (stalled) {
+	gettimeofday(&end, NULL);
+	stall_usec += (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+    }
 
+    ++batches_written;
+    if (batch_octets > max_batch_size)
+	max_batch_size = batch_octets;
+
+    iov.clear();
+    stage_used = 0;
+    batch_octets = 0;
 }
 
-pcapwriter::pcapwriter() : pcap_link_type(1),packets_read(0),packets_written(0),output_file(NULL){
-    memset(padding, 0, sizeof(padding));
+void pcapwriter::flush()
+{
+    lock.lock();
+    write_batch();
+    lock.unlock();
 }
 
-void pcapwriter::init(FILE *output, bool b1, bool b2){
+/* writes batches which didn't fill up within batch_latency */
+void* pcapwriter::flushThread(void* writer_)
+{
+    pcapwriter* writer = (pcapwriter*)writer_;
+    while (!writer->exiting) {
+	usleep(writer->batch_latency);
+	writer->lock.lock();
+	if (writer->batch_octets > 0) {
+	    struct timeval now;
+	    gettimeofday(&now, NULL);
+	    if ((unsigned long)((now.tv_sec - writer->batch_start.tv_sec) * 1000000 + (now.tv_usec - writer->batch_start.tv_usec)) >= writer->batch_latency)
+		writer->write_batch();
+	}
+	writer->lock.unlock();
+    }
+    return NULL;
+}
+
+pcapwriter::pcapwriter() : pcap_link_type(1),packets_read(0),packets_written(0),output_file(NULL),
+	stage(NULL),stage_used(0),batch_octets(0),batch_size(0),batch_latency(0),
+	batches_written(0),max_batch_size(0),write_stalls(0),stall_usec(0),
+	flush_thread_running(false),exiting(false){
+    batch_start.tv_sec = 0;
+    batch_start.tv_usec = 0;
+}
+
+void pcapwriter::init(FILE *output, bool b1, bool b2, unsigned size, unsigned latency){
 	output_file=output;
 	calc_thcs=b1;
 	calc_iphcs=b2;
+	batch_size=size;
+	batch_latency=latency*1000;
+	stage = new unsigned char[batch_size + STAGE_RESERVE];
 	writefileheader();
+	if (batch_size > 0 && batch_latency > 0) {
+		if (pthread_create(&flush_thread, NULL, flushThread, this) == 0)
+			flush_thread_running = true;
+		else
+			msg(MSG_ERROR, "pcapwriter: Couldn't start flush thread, batches are only written when full");
+	}
 }
 
-pcapwriter::~pcapwriter(){}
+pcapwriter::~pcapwriter(){
+	if (flush_thread_running) {
+		exiting = true;
+		pthread_join(flush_thread, NULL);
+	}
+	/* we may be called from a signal handler while a packet is assembled */
+	if (output_file != NULL && lock.tryLock()) {
+		write_batch();
+		lock.unlock();
+	}
+	delete[] stage;
+}
 	
 
 //Generate a loopback packet
@@ -418,8 +712,10 @@ void pcapwriter::writefileheader(){
 	fh.sigfigs = 0;
 	fh.snaplen = 102400;
 	fh.network = pcap_link_type;
-	fwrite(&fh, sizeof(fh), 1, output_file);
-	fflush(output_file);
+	lock.lock();
+	append(&fh, sizeof(fh));
+	write_batch();
+	lock.unlock();
 }
 
 unsigned long pcapwriter::get_packets_written(){
@@ -430,3 +726,19 @@ unsigned long pcapwriter::get_packets_read(){
 	return packets_read;
 }
 
+unsigned long pcapwriter::get_batches_written(){
+	return batches_written;
+}
+
+unsigned long pcapwriter::get_max_batch_size(){
+	return max_batch_size;
+}
+
+unsigned long pcapwriter::get_write_stalls(){
+	return write_stalls;
+}
+
+unsigned long pcapwriter::get_stall_usec(){
+	return stall_usec;
+}
+
@@ -23,13 +23,24 @@
 #include <stdint.h>
 #include <netinet/in.h>
 #include "pcappacket.h"
+#include <commonutils/mutex.h>
 #include <stdio.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <vector>
 
 #define PCAP_MAGIC 0xa1b2c3d4 ///< Special PCAP_MAGIC to show what file format we are using
 #define PADDING 2048
+#define STAGE_RESERVE 65600 ///< room for one more packet in the staging buffer (IP packets have at most 65535 octets)
 
 /**\brief Does all the logic, calculate checksums and write the packet into the fifo
  *
+ * The packets are assembled in a staging buffer and written to the fifo in
+ * batches with one writev() call: when the batch has reached batch_size
+ * octets or when its oldest packet has waited batch_latency milliseconds.
+ * The padding is not copied, the iovecs point to a block of zeros.
+ * A flush thread writes batches that didn't fill up in time.
  */
 
 class pcapwriter {
@@ -47,12 +58,20 @@ public:
 	 * \param output_file is the output file/fifo the writer should hook on
 	 * \param b1 calculate IPHeader checksum
 	 * \param b2 calculate Transportheader checksum
+	 * \param batch_size write when this many octets are staged (0: write every packet at once)
+	 * \param batch_latency write staged packets after this many milliseconds at the latest
 	 */
 	
-	void init(FILE* output_file, bool b1, bool b2);
+	void init(FILE* output_file, bool b1, bool b2, unsigned batch_size = 0, unsigned batch_latency = 0);
+
+	void flush(); ///< writes all staged packets to the fifo
 	
 	unsigned long get_packets_written(); ///< returns number of already written packets
 	unsigned long get_packets_read(); ///< returns number of read packets
+	unsigned long get_batches_written(); ///< returns number of writev() batches
+	unsigned long get_max_batch_size(); ///< returns size of the largest batch in octets
+	unsigned long get_write_stalls(); ///< returns number of batches which found the fifo full
+	unsigned long get_stall_usec(); ///< returns time spent waiting for the full fifo
 
 private:
 	FILE *output_file;	
@@ -66,16 +85,55 @@ private:
 	
 	
 	char tempbuf[64];
-	unsigned char padding[PADDING];
+	static unsigned char padding[PADDING];
+
+	/* staging buffer and the iovecs of the current batch */
+	unsigned char* stage;
+	size_t stage_used;
+	std::vector<struct iovec> iov;
+	unsigned long batch_octets;
+	unsigned long batch_size;
+	unsigned long batch_latency; // microseconds
+	struct timeval batch_start;
+
+	unsigned long batches_written;
+	unsigned long max_batch_size;
+	unsigned long write_stalls;
+	unsigned long stall_usec;
+
+	Mutex lock; // staging buffer (test thread and flush thread)
+	pthread_t flush_thread;
+	bool flush_thread_running;
+	volatile bool exiting;
+
+	void append(const void* data, size_t len); ///< copies data into the staging buffer
+	void append_padding(size_t len); ///< adds zeros to the batch
+	void packet_done(); ///< writes the batch if it is big or old enough
+	void write_batch(); ///< writes the batch, called with lock held
+	static void* flushThread(void* writer);
+
+	/* tools/pcapwriter-bench checks and times the checksum kernels */
+	friend class PcapwriterBench;
 
 	uint16_t in_checksum (void *buf, unsigned long count);
 
 	/*
 	 * The CRC32C code is taken from draft-ietf-tsvwg-sctpcsum-01.txt.
 	 *  That code is copyrighted by D. Otis and has been modified.
+	 *
+	 * crc32c() calls the fastest kernel for this CPU: the SSE4.2 crc32
+	 * instruction if available, else slicing-by-8 (eight octets per step
+	 * with the tables in crc_c8, derived from crc_c).
 	*/
 	
 	static uint32_t crc_c[256];
+	static uint32_t crc_c8[8][256];
+	typedef uint32_t (*Crc32cKernel)(const uint8_t* buf, unsigned int len, uint32_t crc32);
+	static Crc32cKernel crc32c_kernel;
+	static Crc32cKernel select_crc32c_kernel();
+	static uint32_t crc32c_table(const uint8_t* buf, unsigned int len, uint32_t crc32);
+	static uint32_t crc32c_sliced(const uint8_t* buf, unsigned int len, uint32_t crc32);
+	static uint32_t crc32c_sse42(const uint8_t* buf, unsigned int len, uint32_t crc32);
 	uint32_t crc32c(const uint8_t* buf, unsigned int len, uint32_t crc32_init);
 	uint32_t finalize_crc32c(uint32_t crc32);
 					
@@ -26,21 +26,21 @@
 #include <sys/wait.h>
 #include <errno.h>      
 #include <pthread.h>
+#include <stdlib.h>
 #include "snortmodule.h"
 
 #include <concentrator/msg.h>
 
 #include <fstream>
+#include <sstream>
 
 using namespace ConfigStrings;
 bool Snortmodule::shutdown=false;
 
-pid_t Snortmodule::pid=0;
-FILE* Snortmodule::fifofd=NULL;
-const char* Snortmodule::FIFO=NULL;
-pcapwriter* Snortmodule::writer = new pcapwriter;
+std::vector<Snortmodule::Instance> Snortmodule::instances;
 #ifdef IDMEF_SUPPORT_ENABLED
 Snortmodule::wrapperConfig_t Snortmodule::wrapperConfig;
+Mutex Snortmodule::wrapperLock;
 #endif
 
 Snortmodule::Snortmodule(const std::string& filename) : DetectionBase<SnortStore, UnbufferedFilesInputPolicy<SemShmNotifier, SnortStore> >(filename)
@@ -92,31 +92,55 @@ Snortmodule::~Snortmodule(){
 }
 
 
-void Snortmodule::init(){
-	msg(MSG_INFO, "Snortmodule: Setting up...");
-	/* create FIFO */
-	if ((mknod(FIFO, S_IFIFO | 0666, 0)) < 0){
-		msg(MSG_ERROR, "Snortmodule: mknod failed on %s: %s", FIFO, strerror(errno));
-		throw exceptions::DetectionModuleError("Snortmodule", "Can't create FIFO", strerror(errno));
-	}
+std::string Snortmodule::instanceName(const std::string& name, unsigned i) const
+{
+	if (instance_count == 1)
+		return name;
+	std::stringstream ss;
+	ss << name << "-" << i;
+	return ss.str();
+}
 
-#ifdef IDMEF_SUPPORT_ENABLED
+std::string Snortmodule::instanceCommand(unsigned i) const
+{
+	if (instance_count == 1)
+		return execute;
 
-	if (wrapperConfig.enable){
-		wrapperConfig.module = (void *) this;
-		wrapperConfig_t* args=&wrapperConfig;
-		if(pthread_create(&wrapperConfig.Id, NULL, Snortmodule::xmlWrapperEntry, (void *)args)){
-			msg(MSG_ERROR, "Snortmodule: xmlWrapper startup FAILED");
-			throw exceptions::DetectionModuleError("Snortmodule", "Wrapper failed", strerror(errno));
+	std::stringstream number;
+	number << i;
+	std::vector<std::pair<std::string, std::string> > names;
+	names.push_back(std::make_pair(std::string("%i"), number.str()));
+#ifdef IDMEF_SUPPORT_ENABLED
+	names.push_back(std::make_pair(wrapperConfig.fifoname, instances[i].wrapperfifo));
+#endif
+	names.push_back(std::make_pair(fifo, instances[i].fifo));
+	/* the longer name first, one fifo name may be the prefix of the other */
+	if (names.size() == 3 && names[1].first.size() < names[2].first.size())
+		std::swap(names[1], names[2]);
+
+	std::string command;
+	unsigned pos = 0;
+	while (pos < execute.size()) {
+		unsigned n;
+		for (n = 0; n != names.size(); ++n) {
+			if (!names[n].first.empty() && execute.compare(pos, names[n].first.size(), names[n].first) == 0)
+				break;
 		}
-	} 
-	else msg(MSG_INFO, "Snortmodule: xmlWrapper is DISABLED");
+		if (n != names.size()) {
+			command += names[n].second;
+			pos += names[n].first.size();
+		} else {
+			command += execute[pos];
+			++pos;
+		}
+	}
+	return command;
+}
 
-#else 
-	msg(MSG_INFO, "Snortmodule: xmlWrapper is DISABLED (not supported)");
+pid_t Snortmodule::spawn(const std::string& execute)
+{
+	pid_t pid;
 
-#endif
-	
 	/* fork the external module */
 	if (-1 == (pid = fork())) {
                 throw exceptions::DetectionModuleError("Snortmodule", "Can't fork a new process for starting the module", strerror(errno));
@@ -159,19 +183,73 @@ void Snortmodule::init(){
 			
 			throw exceptions::DetectionModuleError("Snortmodule", "Can't execute the detection module", strerror(errno));
 		}
+	return pid;
+}
+
+void Snortmodule::init(){
+	msg(MSG_INFO, "Snortmodule: Setting up %u instance(s)...", instance_count);
+	instances.resize(instance_count);
+	for (unsigned i = 0; i != instances.size(); ++i) {
+		instances[i].fifo = instanceName(fifo, i);
+		instances[i].pid = 0;
+		instances[i].fifofd = NULL;
+		instances[i].writer = new pcapwriter;
+#ifdef IDMEF_SUPPORT_ENABLED
+		instances[i].wrapperfifo = instanceName(wrapperConfig.fifoname, i);
+		instances[i].wrapperStarted = false;
+#endif
+	}
+
+	/* create FIFOs */
+	for (unsigned i = 0; i != instances.size(); ++i) {
+		if ((mknod(instances[i].fifo.c_str(), S_IFIFO | 0666, 0)) < 0){
+			msg(MSG_ERROR, "Snortmodule: mknod failed on %s: %s", instances[i].fifo.c_str(), strerror(errno));
+			throw exceptions::DetectionModuleError("Snortmodule", "Can't create FIFO", strerror(errno));
+		}
+	}
+
+#ifdef IDMEF_SUPPORT_ENABLED
+
+	if (wrapperConfig.enable){
+		wrapperConfig.module = (void *) this;
+		/* one thread per instance, they all send to the same topic */
+		for (unsigned i = 0; i != instances.size(); ++i) {
+			if(pthread_create(&instances[i].wrapperId, NULL, Snortmodule::xmlWrapperEntry, (void *)&instances[i])){
+				msg(MSG_ERROR, "Snortmodule: xmlWrapper startup FAILED");
+				throw exceptions::DetectionModuleError("Snortmodule", "Wrapper failed", strerror(errno));
+			}
+			instances[i].wrapperStarted = true;
+		}
+	} 
+	else msg(MSG_INFO, "Snortmodule: xmlWrapper is DISABLED");
+
+#else 
+	msg(MSG_INFO, "Snortmodule: xmlWrapper is DISABLED (not supported)");
+
+#endif
+	
+	for (unsigned i = 0; i != instances.size(); ++i) {
+		std::string command = instanceCommand(i);
+		msg(MSG_INFO, "Snortmodule: Starting %s", command.c_str());
+		instances[i].pid = spawn(command);
+	}
   	
-	/* Wait for Child to init */
+	/* Wait for Children to init */
 	sleep(3);
-	fifofd=fopen(FIFO, "w");
-	if(fifofd < 0){
-		msg(MSG_ERROR, "Snortmodule: Can't open FIFO");
-		throw exceptions::DetectionModuleError("Snortmodule", "Can't open FIFO", strerror(errno));
+	for (unsigned i = 0; i != instances.size(); ++i) {
+		instances[i].fifofd=fopen(instances[i].fifo.c_str(), "w");
+		if(instances[i].fifofd == NULL){
+			msg(MSG_ERROR, "Snortmodule: Can't open FIFO %s", instances[i].fifo.c_str());
+			throw exceptions::DetectionModuleError("Snortmodule", "Can't open FIFO", strerror(errno));
+		}
 	}
  	
 	/*Write initial pcap file header to external application*/
 	msg(MSG_INFO, "Snortmodule: External application running... Init writer and sending pcap file header");
-	writer->init(fifofd,calc_thcs,calc_iphcs);
-	writer->writedummypacket(); // for debug proposes only
+	for (unsigned i = 0; i != instances.size(); ++i) {
+		instances[i].writer->init(instances[i].fifofd,calc_thcs,calc_iphcs,batch_size,batch_latency);
+		instances[i].writer->writedummypacket(); // for debug proposes only
+	}
 	msg(MSG_INFO, "Snortmodule: All set up");
 
 #ifdef IDMEF_SUPPORT_ENABLED
@@ -187,16 +265,42 @@ void Snortmodule::init(){
 
 void Snortmodule::CleanExit(){
 	msg(MSG_INFO, "Snortmodule: Shutting down...");
-	std::cout << "Snortmodule: <---- "<<writer->get_packets_read() <<" packets read " << writer->get_packets_written() << " written and " << (writer->get_packets_read()-writer->get_packets_written()) << " dropped. ---->"<<std::endl;
+	unsigned long read = 0, written = 0;
+	for (unsigned i = 0; i != instances.size(); ++i) {
+		pcapwriter* writer = instances[i].writer;
+		writer->flush();
+		read += writer->get_packets_read();
+		written += writer->get_packets_written();
+		if (instances.size() > 1)
+			std::cout << "Snortmodule: <---- instance " << i << ": " << writer->get_packets_written() << " packets written ---->"<<std::endl;
+		std::cout << "Snortmodule: <---- "<<writer->get_batches_written() <<" batches written (" << (writer->get_batches_written() ? writer->get_packets_written()/writer->get_batches_written() : 0) << " packets per batch, largest " << writer->get_max_batch_size() << " octets), fifo was full " << writer->get_write_stalls() << " times for " << writer->get_stall_usec()/1000 << " ms ---->"<<std::endl;
+	}
+	std::cout << "Snortmodule: <---- "<<read <<" packets read " << written << " written and " << (read-written) << " dropped. ---->"<<std::endl;
+	std::cout << "Snortmodule: <---- "<<getInputPolicy().getDroppedRecords() <<" records dropped by the input queue (at most " << getInputPolicy().getMaxQueueDepth() << " records waiting) ---->"<<std::endl;
 	msg(MSG_INFO, "Snortmodule: Cleaning up...");
 
-	delete writer;
-	kill(pid, SIGINT);
-	fclose(fifofd);
-	unlink(FIFO);
+	for (unsigned i = 0; i != instances.size(); ++i) {
+		delete instances[i].writer;
+		kill(instances[i].pid, SIGINT);
+		if (instances[i].fifofd)
+			fclose(instances[i].fifofd);
+		unlink(instances[i].fifo.c_str());
+	}
 #ifdef IDMEF_SUPPORT_ENABLED
-	unlink(wrapperConfig.fifoname.c_str());
+	/* the wrapper threads use their instance, they end when the wrapper fifo
+	   has no writer anymore. A thread which still waits for snort to open the
+	   fifo is woken up by opening it for writing */
+	for (unsigned i = 0; i != instances.size(); ++i) {
+		if (!instances[i].wrapperStarted)
+			continue;
+		int fd = open(instances[i].wrapperfifo.c_str(), O_WRONLY | O_NONBLOCK);
+		if (fd >= 0)
+			close(fd);
+		pthread_join(instances[i].wrapperId, NULL);
+		unlink(instances[i].wrapperfifo.c_str());
+	}
 #endif
+	instances.clear();
 	msg(MSG_INFO, "Snortmodule: Exiting");
 }
 
@@ -355,7 +459,13 @@ void Snortmodule::readConfig(const std::string& filename)
 	} else {
 	fifo = DEFAULT_FIFO;
 	}
-	FIFO=fifo.c_str();
+	if (doRead && NULL != (tmp = config->getValue(INSTANCES))) {
+		instance_count = atoi(tmp);
+		if (instance_count == 0)
+			instance_count = 1;
+	} else {
+		instance_count = DEFAULT_INSTANCES;
+	}
 
         if (doRead && NULL != (tmp = config->getValue(CALC_THCS))) {
 		                if ((std::string)tmp == "false") calc_thcs=false;
@@ -365,6 +475,21 @@ void Snortmodule::readConfig(const std::string& filename)
 			                if ((std::string)tmp== "false") calc_iphcs= false; 
 					 else calc_iphcs= true;
 	}
+	if (doRead && NULL != (tmp = config->getValue(HIGH_WATER_MARK))) {
+		setStorageHighWaterMark(atoi(tmp));
+	} else {
+		setStorageHighWaterMark(DEFAULT_HIGH_WATER_MARK);
+	}
+	if (doRead && NULL != (tmp = config->getValue(BATCH_SIZE))) {
+		batch_size = atoi(tmp);
+	} else {
+		batch_size = DEFAULT_BATCH_SIZE;
+	}
+	if (doRead && NULL != (tmp = config->getValue(BATCH_LATENCY))) {
+		batch_latency = atoi(tmp);
+	} else {
+		batch_latency = DEFAULT_BATCH_LATENCY;
+	}
 		
 
         if (doRead && (NULL != config->getValue(ACCEPT_SOURCE_IDS))) {
@@ -406,9 +531,11 @@ void Snortmodule::readConfig(const std::string& filename)
 void Snortmodule::test(SnortStore* snortstore)
 {
 	if(snortstore->is_valid){
-		writer->writepacket(snortstore->get_record());
-		delete snortstore;
+		PcapPacket* packet = snortstore->get_record();
+		unsigned i = (instances.size() == 1) ? 0 : packet->flow_hash() % instances.size();
+		instances[i].writer->writepacket(packet);
 	}
+	releaseStorage(snortstore);
 }
 
 
@@ -456,7 +583,8 @@ void Snortmodule::sigInt(int signum)
 #ifdef IDMEF_SUPPORT_ENABLED
 void * Snortmodule::xmlWrapperEntry(void *args)
 {
-	wrapperConfig_t* config=(wrapperConfig_t* ) args;
+	Instance* instance=(Instance* ) args;
+	wrapperConfig_t* config=&wrapperConfig;
 
 	std::string message="";
 
@@ -466,7 +594,7 @@ void * Snortmodule::xmlWrapperEntry(void *args)
 	msg(MSG_INFO, "Snortmodule: xmlWrapper startup...");
    
 	/* create FIFO */
-	if ((mknod(config->fifoname.c_str(), S_IFIFO | 0666, 0)) < 0){
+	if ((mknod(instance->wrapperfifo.c_str(), S_IFIFO | 0666, 0)) < 0){
 	      	msg(MSG_ERROR, "Snortmodule: Wrapper mknod failed");
 		throw exceptions::DetectionModuleError("Snortmodule", "Can't create wrapper-FIFO", strerror(errno));
    	}
@@ -475,7 +603,7 @@ void * Snortmodule::xmlWrapperEntry(void *args)
         char * line = NULL;
         size_t len = 0;
         ssize_t read;
-        fp = fopen(config->fifoname.c_str(), "r");
+        fp = fopen(instance->wrapperfifo.c_str(), "r");
         if (fp == NULL){
 		msg(MSG_ERROR, "Snortmodule: Wrapper FIFO open failed");
 		throw exceptions::DetectionModuleError("Snortmodule", "Can't open wrapper-FIFO", strerror(errno));
@@ -512,14 +640,18 @@ void * Snortmodule::xmlWrapperEntry(void *args)
 			 } else {
 				 msg(MSG_ERROR, "Snortmodule: analyzerid attribute or <Node> tag is missing");
 			 }
+			 wrapperLock.lock();
 			 object->sendIdmefMessage(config->topic,message);
+			 wrapperLock.unlock();
 			 message="";
 		 }else {
 			 message+=line;
 		 }
             }
-        
-    	unlink(config->fifoname.c_str());
+
+	free(line);
+	fclose(fp);
+	/* CleanExit() removes the fifo */
 	pthread_exit(NULL);
 }
 #endif
@@ -27,6 +27,7 @@
 #include <commonutils/confobj.h>
 
 #include <string>
+#include <vector>
 #include <fstream>
 
 /**\brief Manages external detecion engine.
@@ -47,10 +48,10 @@ public:
 	
 	~Snortmodule();
 
-	/**\brief Returns actuall Pid
+	/**\brief Returns Pid of the (first) external detection modul
 	 */
 	
-	pid_t getPid() const { return pid; }
+	pid_t getPid() const { return instances.empty() ? 0 : instances[0].pid; }
 
 	/**\brief Called by the collector to process the new arrived packets
 	 *
@@ -94,14 +95,15 @@ private:
 	std::string rule_file;
 	std::string execute;
 	std::string fifo;
-	static const char* FIFO;
+	unsigned instance_count; // number of external detection moduls
 	bool calc_thcs;
 	bool calc_iphcs;
+	unsigned batch_size; // octets written to the fifo at once
+	unsigned batch_latency; // milliseconds
 #ifdef IDMEF_SUPPORT_ENABLED	
 	struct wrapperConfig_t {
 		bool enable;
 		std::string fifoname;
-		pthread_t Id;
 		void * module;
 		std::string topic;
 		std::string analyzerid;
@@ -109,13 +111,47 @@ private:
 	};
 
 	static wrapperConfig_t wrapperConfig;
+	static Mutex wrapperLock; // the xmlWrapper threads send one message at a time
 #endif	
 	/**
-	 * Pid and Pipe descriptors
+	 * External detection moduls. Each one reads its own fifo, fed by its
+	 * own writer. Packets are distributed by PcapPacket::flow_hash(), so
+	 * both directions of a flow go to the same instance.
+	 * With more than one instance, the fifo names get the suffix "-<number>".
 	 */
-	
-	static pid_t pid;
-	static FILE* fifofd;
+
+	struct Instance {
+		std::string fifo;
+		pid_t pid;
+		FILE* fifofd;
+		pcapwriter* writer;
+#ifdef IDMEF_SUPPORT_ENABLED
+		std::string wrapperfifo; // IDMEF messages of this instance
+		pthread_t wrapperId;
+		bool wrapperStarted;
+#endif
+	};
+
+	static std::vector<Instance> instances;
+
+	/**
+	 * Appends the instance number to name if there is more than one instance
+	 */
+
+	std::string instanceName(const std::string& name, unsigned i) const;
+
+	/**
+	 * Command line of an instance: the fifo names are replaced by the
+	 * names of the instance, "%i" by the instance number
+	 */
+
+	std::string instanceCommand(unsigned i) const;
+
+	/**
+	 * Forks and executes the external detection modul
+	 */
+
+	static pid_t spawn(const std::string& command);
        
 
 	/**
@@ -126,12 +162,6 @@ private:
 	static void sigTerm(int);
 	static void sigInt(int);
 
-	/**
-	 * Packetwriter
-	 */
-
-	static pcapwriter* writer;
-	
 	/**
 	 * stuff 
 	 */
@@ -144,7 +174,7 @@ private:
 	 * Entrypoint for xmlWrapper thread
 	 */
 
-	static void * xmlWrapperEntry(void *pipename);
+	static void * xmlWrapperEntry(void *instance);
 #endif
 
 };
@@ -34,6 +34,7 @@
 #include <algorithm>
 
 SnortStore::SnortStore():is_valid(false) {
+	packet = new PcapPacket;
 }
 
 SnortStore::~SnortStore() {
@@ -115,14 +116,10 @@ void SnortStore::addFieldData(int id, byte* fieldData, int fieldDataLength, Ente
 		
 		//DATA
 		case 313: //PSAMP_TYPEID_ipHeaderPacketSection 
-			packet->iphps_p = new char[fieldDataLength];
-			packet->iphps_size=fieldDataLength;
-			bcopy(fieldData, packet->iphps_p, fieldDataLength);
+			packet->set_iphps(fieldData, fieldDataLength);
 			break;
 		case 314: //PSAMP_TYPEID_ipPayloadPacketSection  
-			packet->ippps_p = new char[fieldDataLength];
-			packet->ippps_size=fieldDataLength;
-			bcopy(fieldData, packet->ippps_p, fieldDataLength);
+			packet->set_ippps(fieldData, fieldDataLength);
 			break;			
 
 		//Timestamps
@@ -146,7 +143,6 @@ void SnortStore::addFieldData(int id, byte* fieldData, int fieldDataLength, Ente
 
 bool SnortStore::recordStart(SourceID sourceid) {
 	is_valid=true;
-	packet = new PcapPacket;
 	packet->ts_sec =time(NULL);
 	return true;
 
@@ -155,6 +151,11 @@ bool SnortStore::recordStart(SourceID sourceid) {
 void SnortStore::recordEnd() {
 }
 
+void SnortStore::recycle() {
+	is_valid=false;
+	packet->reset();
+}
+
 PcapPacket* SnortStore::get_record(){
 	return packet;
 }
@@ -36,6 +36,7 @@ public:
 
         bool recordStart(SourceID);
         void recordEnd();
+        void recycle(); ///< prepares the store for the next record (see UnbufferedFilesInputPolicy::releaseStorage)
 
         void addFieldData(int id, byte* fieldData, int fieldDataLength, EnterpriseNo eid = 0); ///< Used by the collector to store data
 
@@ -104,90 +104,97 @@ void Print::update(XMLConfObj* xmlObj)
 
 void Print::test(PrintStore * store) {
 
-  int len;
-
-  // output Flow Start
-  std::ostringstream flow_start;
-  flow_start << '|' << store->flowStart;
-  len = flow_start.str().length();
-
-  outfile << store->flowStart;
-  for (int i = 0; i != 10 - len; i++)
-    outfile << ' ';
-
-  // output Flow End
-  std::ostringstream flow_end;
-  flow_end << store->flowEnd;
-  len = flow_end.str().length();
-
-  outfile << '|' << store->flowEnd;
-  for (int i = 0; i != 10 - len; i++)
-    outfile << ' ';
-
-  // output Source IP
-  len = store->sourceAddress.toString().length();
-
-  outfile << '|' << store->sourceAddress.toString();
-  for (int i = 0; i != 15 - len; i++)
-    outfile << ' ';
-
-  // output Destination IP
-  len = store->destinationAddress.toString().length();
-
-  outfile << '|' << store->destinationAddress.toString();
-  for (int i = 0; i != 15 - len; i++)
-    outfile << ' ';
-
-  // output Protocol
-  std::ostringstream protocol;
-  protocol << store->protocol;
-  len = protocol.str().length();
-
-  outfile << '|' << store->protocol;
-  for (int i = 0; i != 5 - len; i++)
-    outfile << ' ';
-
-  // output Source Port
-  std::ostringstream source_port;
-  source_port << store->sourcePort;
-  len = source_port.str().length();
-
-  outfile << '|' << store->sourcePort;
-  for (int i = 0; i != 7 - len; i++)
-    outfile << ' ';
-
-  // output Destination Port
-  std::ostringstream dest_port;
-  dest_port << store->destinationPort;
-  len = dest_port.str().length();
-
-  outfile << '|' << store->destinationPort;
-  for (int i = 0; i != 8 - len; i++)
-    outfile << ' ';
-
-  // output Packet number
-  std::ostringstream nb_packets;
-  nb_packets << store->nb_packets;
-  len = nb_packets.str().length();
-
-  outfile << '|' << store->nb_packets;
-  for (int i = 0; i != 10 - len; i++)
-    outfile << ' ';
-
-  // output Packet number
-  std::ostringstream nb_bytes;
-  nb_bytes << store->nb_bytes;
-  len = nb_bytes.str().length();
-
-  outfile << '|' << store->nb_bytes;
-  for (int i = 0; i != 10 - len; i++)
-    outfile << ' ';
-
-  // add \n and flush
-  outfile << std::endl;
-
-  /* don't forget to free the store-object */
-  delete store;
+  // one line per flow record; with UnbufferedFilesInputPolicy there is
+  // exactly one, with BatchInputPolicy there may be any number
+  for (std::vector<PrintStore::Flow>::const_iterator flow = store->flows.begin();
+       flow != store->flows.end(); ++flow) {
+
+    int len;
+
+    // output Flow Start
+    std::ostringstream flow_start;
+    flow_start << '|' << flow->flowStart;
+    len = flow_start.str().length();
+
+    outfile << flow->flowStart;
+    for (int i = 0; i != 10 - len; i++)
+      outfile << ' ';
+
+    // output Flow End
+    std::ostringstream flow_end;
+    flow_end << flow->flowEnd;
+    len = flow_end.str().length();
+
+    outfile << '|' << flow->flowEnd;
+    for (int i = 0; i != 10 - len; i++)
+      outfile << ' ';
+
+    // output Source IP
+    len = flow->sourceAddress.toString().length();
+
+    outfile << '|' << flow->sourceAddress.toString();
+    for (int i = 0; i != 15 - len; i++)
+      outfile << ' ';
+
+    // output Destination IP
+    len = flow->destinationAddress.toString().length();
+
+    outfile << '|' << flow->destinationAddress.toString();
+    for (int i = 0; i != 15 - len; i++)
+      outfile << ' ';
+
+    // output Protocol
+    std::ostringstream protocol;
+    protocol << flow->protocol;
+    len = protocol.str().length();
+
+    outfile << '|' << flow->protocol;
+    for (int i = 0; i != 5 - len; i++)
+      outfile << ' ';
+
+    // output Source Port
+    std::ostringstream source_port;
+    source_port << flow->sourcePort;
+    len = source_port.str().length();
+
+    outfile << '|' << flow->sourcePort;
+    for (int i = 0; i != 7 - len; i++)
+      outfile << ' ';
+
+    // output Destination Port
+    std::ostringstream dest_port;
+    dest_port << flow->destinationPort;
+    len = dest_port.str().length();
+
+    outfile << '|' << flow->destinationPort;
+    for (int i = 0; i != 8 - len; i++)
+      outfile << ' ';
+
+    // output Packet number
+    std::ostringstream nb_packets;
+    nb_packets << flow->nb_packets;
+    len = nb_packets.str().length();
+
+    outfile << '|' << flow->nb_packets;
+    for (int i = 0; i != 10 - len; i++)
+      outfile << ' ';
+
+    // output Packet number
+    std::ostringstream nb_bytes;
+    nb_bytes << flow->nb_bytes;
+    len = nb_bytes.str().length();
+
+    outfile << '|' << flow->nb_bytes;
+    for (int i = 0; i != 10 - len; i++)
+      outfile << ' ';
+
+    // add \n and flush
+    outfile << std::endl;
+
+  }
+
+  /* hand the store-object back for the next record */
+  releaseStorage(store);
 
 }
 
@@ -20,7 +20,7 @@
 
 #include "print-store.h"
 
-PrintStore::PrintStore()
+PrintStore::Flow::Flow()
   : sourceAddress(0,0,0,0), destinationAddress(0,0,0,0) {
 
   flowStart = flowEnd = 0;
@@ -28,6 +28,10 @@ PrintStore::PrintStore()
   sourcePort = destinationPort = 0;
   nb_packets = nb_bytes = 0;
 
+}
+
+PrintStore::PrintStore() {
+
   recordNumber = 0;
   recordStarted = false;
 
@@ -38,6 +42,7 @@ bool PrintStore::recordStart(SourceID) {
   if (recordStarted)
     std::cerr << "PrintStore::recordStart() was called while having a started record!\n";
   recordNumber++;
+  flows.push_back(Flow());
   return recordStarted = true;
 
 }
@@ -58,6 +63,8 @@ void PrintStore::addFieldData(int id, byte * fieldData, int fieldDataLength,
   // we subscribed to (so don't get worried because of
   // the "breaks" in the "switch" loop hereafter)
 
+  Flow & flow = flows.back();
+
   switch (id) {
 
   case IPFIX_TYPEID_flowStartSeconds:
@@ -67,7 +74,7 @@ void PrintStore::addFieldData(int id, byte * fieldData, int fieldDataLength,
 		<< "Skipping record.\n";
       return;
     }
-    flowStart = ntohl(uint32_t(*fieldData));
+    flow.flowStart = ntohl(uint32_t(*fieldData));
     break;
 
   case IPFIX_TYPEID_flowEndSeconds:
@@ -77,7 +84,7 @@ void PrintStore::addFieldData(int id, byte * fieldData, int fieldDataLength,
 		<< "Skipping record.\n";
       return;
     }
-    flowEnd = ntohl(uint32_t(*fieldData));
+    flow.flowEnd = ntohl(uint32_t(*fieldData));
     break;
 
   case IPFIX_TYPEID_protocolIdentifier:
@@ -87,7 +94,7 @@ void PrintStore::addFieldData(int id, byte * fieldData, int fieldDataLength,
 		<< "Skipping record.\n";
       return;
     }
-    protocol = uint16_t(*fieldData);
+    flow.protocol = uint16_t(*fieldData);
     // *fielData is a protocol number, so is 1 byte (= uint8_t) long
     // hence the cast into an uint16_t (= unsigned int) as we want to print it
     break;
@@ -99,8 +106,8 @@ void PrintStore::addFieldData(int id, byte * fieldData, int fieldDataLength,
 		<< "Skipping record.\n";
       return;
     }
-    sourceAddress.setAddress(fieldData[0], fieldData[1],
-			     fieldData[2], fieldData[3]);
+    flow.sourceAddress.setAddress(fieldData[0], fieldData[1],
+				  fieldData[2], fieldData[3]);
     break;
 
   case IPFIX_TYPEID_destinationIPv4Address:
@@ -110,8 +117,8 @@ void PrintStore::addFieldData(int id, byte * fieldData, int fieldDataLength,
 		<< "Skipping record.\n";
       return;
     }
-    destinationAddress.setAddress(fieldData[0], fieldData[1],
-				  fieldData[2], fieldData[3]);
+    flow.destinationAddress.setAddress(fieldData[0], fieldData[1],
+				       fieldData[2], fieldData[3]);
     break;
 
   case IPFIX_TYPEID_sourceTransportPort:
@@ -123,12 +130,12 @@ void PrintStore::addFieldData(int id, byte * fieldData, int fieldDataLength,
       return;
     }
     if (fieldDataLength == IPFIX_LENGTH_sourceTransportPort)
-      sourcePort = ntohs(uint16_t(*fieldData));
+      flow.sourcePort = ntohs(uint16_t(*fieldData));
     // fieldData must be casted into an uint16_t (= unsigned int)
     // as it is a port number
     // (and, also, converted from network order to host order)
     if (fieldDataLength == IPFIX_LENGTH_sourceTransportPort-1)
-      sourcePort = uint16_t(*fieldData);
+      flow.sourcePort = uint16_t(*fieldData);
     // fieldData must be casted into an uint16_t (= unsigned int
     // as it is a port number
     break;
@@ -143,12 +150,12 @@ void PrintStore::addFieldData(int id, byte * fieldData, int fieldDataLength,
       return;
     }
     if (fieldDataLength == IPFIX_LENGTH_destinationTransportPort)
-      destinationPort = ntohs(uint16_t(*fieldData));
+      flow.destinationPort = ntohs(uint16_t(*fieldData));
     // fieldData must be casted into an uint16_t (= unsigned int)
     // as it is a port number
     // (and, also, converted from network order to host order)
     if (fieldDataLength == IPFIX_LENGTH_destinationTransportPort-1)
-      destinationPort = uint16_t(*fieldData);
+      flow.destinationPort = uint16_t(*fieldData);
     // fieldData must be casted into an uint16_t (= unsigned int)
     // as it is a port number
     break;
@@ -160,7 +167,7 @@ void PrintStore::addFieldData(int id, byte * fieldData, int fieldDataLength,
 		<< "Skipping record.\n";
       return;
     }
-    nb_packets = ntohll(uint64_t(*fieldData));
+    flow.nb_packets = ntohll(uint64_t(*fieldData));
     break;
 
   case IPFIX_TYPEID_octetDeltaCount:
@@ -170,7 +177,7 @@ void PrintStore::addFieldData(int id, byte * fieldData, int fieldDataLength,
 		<< "Skipping record.\n";
       return;
     }
-    nb_bytes = ntohll(uint64_t(*fieldData));
+    flow.nb_bytes = ntohll(uint64_t(*fieldData));
     break;
 
   default:
@@ -195,3 +202,43 @@ void PrintStore::recordEnd() {
   return;
 
 }
+
+void PrintStore::addRecordBatch(const RecordBatch & batch) {
+
+  for (unsigned i = 0; i != batch.count; ++i) {
+
+    // the batch decoder has already checked the field lengths
+    if (batch.isMalformed(i)) {
+      std::cerr << "Error! Got invalid IPFIX field data! "
+		<< "Skipping record.\n";
+      continue;
+    }
+
+    flows.push_back(Flow());
+    Flow & flow = flows.back();
+    flow.flowStart = batch.flowStart[i];
+    flow.flowEnd = batch.flowEnd[i];
+    if (batch.hasField(i, RecordBatch::SRC_IP))
+      flow.sourceAddress.setAddress((const byte*)&batch.srcIp[i]);
+    if (batch.hasField(i, RecordBatch::DST_IP))
+      flow.destinationAddress.setAddress((const byte*)&batch.dstIp[i]);
+    flow.protocol = batch.proto[i];
+    flow.sourcePort = batch.srcPort[i];
+    flow.destinationPort = batch.dstPort[i];
+    flow.nb_packets = batch.packets[i];
+    flow.nb_bytes = batch.octets[i];
+
+  }
+
+  return;
+
+}
+
+void PrintStore::recycle() {
+
+  // keeps the capacity of flows, so recordStart() doesn't allocate
+  flows.clear();
+  recordNumber = 0;
+  recordStarted = false;
+
+}
@@ -22,8 +22,10 @@
 #define _PRINT_STORE_H_
 
 #include <datastore.h>
+#include <recordbatch.h>
 #include <ipaddress.h>
 #include <iostream>
+#include <vector>
 
 class PrintStore : public DataStore {
 
@@ -36,26 +38,37 @@ class PrintStore : public DataStore {
   void addFieldData(int id, byte* fieldData, int fieldDataLength,
 		    EnterpriseNo eid = 0);
   void recordEnd();
+  void addRecordBatch(const RecordBatch & batch);
+  void recycle();
 
-  // the following members should be private and all have a 'getter',
+  // one flow record
+  // the members should be private and all have a 'getter',
   // but for such a simple module, let's not bother about those things...
-  uint32_t flowStart;
-  uint32_t flowEnd;
-  IpAddress sourceAddress;
-  IpAddress destinationAddress;
-  uint16_t protocol;
-  uint16_t sourcePort;
-  uint16_t destinationPort;
-  uint64_t nb_packets;
-  uint64_t nb_bytes;
+  struct Flow {
+    Flow();
+    uint32_t flowStart;
+    uint32_t flowEnd;
+    IpAddress sourceAddress;
+    IpAddress destinationAddress;
+    uint16_t protocol;
+    uint16_t sourcePort;
+    uint16_t destinationPort;
+    uint64_t nb_packets;
+    uint64_t nb_bytes;
+  };
+
+  // the records in this store, in order of arrival
+  std::vector<Flow> flows;
 
  private:
 
   // in the Print module source code (see print-main.cpp), we set AlarmTime
   // to 0 so that the Print::test() method will be called as soon as a record
   // is ready ('real-time monitoring').
-  // hence a PrintStore object will contain no more than one record; we use
-  // recordNumber as a flag to spot such errors
+  // hence a PrintStore object filled by recordStart(), addFieldData() and
+  // recordEnd() will contain no more than one record; we use recordNumber
+  // as a flag to spot such errors. Batches (see BatchInputPolicy) may contain
+  // any number of records.
   unsigned int recordNumber;
 
   bool recordStarted;
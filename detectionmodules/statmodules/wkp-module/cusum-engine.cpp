@@ -0,0 +1,196 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software   */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          */
+/*    MA  02110-1301, USA                                                 */
+/*                                                                        */
+/**************************************************************************/
+
+#include "cusum-engine.h"
+#include <cmath>
+#include <algorithm>
+
+
+void CusumEngine::init(unsigned metrics, double smoothing_constant, bool log_variance_ewma,
+		       double amplitude_percentage, uint16_t repetition_factor) {
+
+  this->metrics = metrics;
+  this->smoothing_constant = smoothing_constant;
+  this->log_variance_ewma = log_variance_ewma;
+  this->amplitude_percentage = amplitude_percentage;
+  this->repetition_factor = repetition_factor;
+
+  slots = 0;
+  mean.assign(metrics, std::vector<double>());
+  variance.assign(metrics, std::vector<double>());
+  g.assign(metrics, std::vector<double>());
+  X.assign(metrics, std::vector<double>());
+  next.assign(metrics, std::vector<double>());
+  ewma.assign(metrics, std::vector<double>());
+  N.assign(metrics, std::vector<double>());
+  beta.assign(metrics, std::vector<double>());
+  alarm.assign(metrics, std::vector<double>());
+  ready.clear();
+  active.clear();
+  staged.clear();
+  updated.clear();
+}
+
+unsigned CusumEngine::addSlot() {
+
+  for (unsigned m = 0; m < metrics; m++) {
+    mean[m].push_back(0.0);
+    variance[m].push_back(0.0);
+    g[m].push_back(0.0);
+    X[m].push_back(0.0);
+    next[m].push_back(0.0);
+    ewma[m].push_back(0.0);
+    N[m].push_back(0.0);
+    beta[m].push_back(0.0);
+    alarm[m].push_back(0.0);
+  }
+  ready.push_back(0.0);
+  active.push_back(0.0);
+  staged.push_back(0.0);
+  updated.push_back(0.0);
+
+  return slots++;
+}
+
+void CusumEngine::start(unsigned slot, const std::vector<double> & mean,
+			const std::vector<double> & variance, const std::vector<int64_t> & value) {
+
+  for (unsigned m = 0; m < metrics; m++) {
+    this->mean[m][slot] = mean.at(m);
+    this->variance[m][slot] = variance.at(m);
+    X[m][slot] = (int)value.at(m);
+    g[m][slot] = 0.0;
+  }
+  ready[slot] = 1.0;
+  updated[slot] = 1.0;
+}
+
+void CusumEngine::setValue(unsigned slot, unsigned m, int64_t value, bool ewma) {
+
+  // truncated like Params::X_curr, so the results are the same
+  next[m][slot] = (int)value;
+  this->ewma[m][slot] = ewma ? 1.0 : 0.0;
+  staged[slot] = 1.0;
+  updated[slot] = 1.0;
+}
+
+// The loops over the slots are kept in separate functions whose array
+// arguments are declared __restrict, otherwise the compiler has to assume
+// that they overlap and gives up on vectorizing. Every element is stored,
+// the flags only select the stored value, as a conditional store isn't
+// vectorized either. Selecting instead of blending with the 0.0/1.0 flags
+// keeps the results bit for bit the same as those of the per endpoint code.
+// sqrt() needs -fno-math-errno, the selects need -fno-trapping-math (see
+// CMakeLists.txt), neither changes the results.
+
+static void ewma_linear(double * __restrict mu, double * __restrict var,
+			const double * __restrict x, const double * __restrict e,
+			unsigned slots, double a) {
+
+  for (unsigned s = 0; s < slots; s++) {
+    double m0 = mu[s], v0 = var[s], x0 = x[s];
+    double nm = m0 * (1 - a) + x0 * a;
+    double nv = v0 * (1 - a) + (x0 - nm)*(x0 - nm) * a;
+    double m1 = e[s] != 0.0 ? nm : m0;
+    double v1 = e[s] != 0.0 ? nv : v0;
+    mu[s] = m1;
+    var[s] = v1;
+  }
+}
+
+static void ewma_log(double * __restrict mu, double * __restrict var,
+		     const double * __restrict x, const double * __restrict e,
+		     unsigned slots, double a) {
+
+  // log() and exp() aren't vectorized anyway, only do them where needed
+  for (unsigned s = 0; s < slots; s++) {
+    if (e[s] != 0.0) {
+      mu[s] = mu[s] * (1 - a) + x[s] * a;
+      var[s] = exp(log(var[s]) * (1 - a) + log((x[s] - mu[s])*(x[s] - mu[s])) * a);
+    }
+  }
+}
+
+static void take_values(double * __restrict x, const double * __restrict nx,
+			const double * __restrict st, unsigned slots) {
+
+  for (unsigned s = 0; s < slots; s++)
+  {
+    double x0 = x[s], x1 = nx[s];
+    x[s] = st[s] != 0.0 ? x1 : x0;
+  }
+}
+
+// same computation as Stat::cusum_test() and cusum() for a single endpoint
+static void cusum_kernel(const double * __restrict mu, const double * __restrict var,
+			 const double * __restrict x, const double * __restrict act,
+			 double * __restrict gm, double * __restrict n,
+			 double * __restrict b, double * __restrict al,
+			 unsigned slots, double amplitude_percentage,
+			 double repetition_factor) {
+
+  for (unsigned s = 0; s < slots; s++) {
+    double half = amplitude_percentage * sqrt(var[s]) / 2.0;
+    n[s] = repetition_factor * half;
+    b[s] = mu[s] + half;
+    double gn = std::max(gm[s] + (x[s] - b[s]), 0.0);
+    gm[s] = act[s] != 0.0 ? gn : 0.0;
+    al[s] = (gm[s] > n[s]) ? act[s] : 0.0;
+  }
+}
+
+void CusumEngine::update() {
+
+  if (slots == 0)
+    return;
+
+  for (unsigned m = 0; m < metrics; m++) {
+
+    // the EWMA of the variance uses the updated mean
+    if (log_variance_ewma)
+      ewma_log(&mean[m][0], &variance[m][0], &X[m][0], &ewma[m][0],
+	       slots, smoothing_constant);
+    else
+      ewma_linear(&mean[m][0], &variance[m][0], &X[m][0], &ewma[m][0],
+		  slots, smoothing_constant);
+
+    take_values(&X[m][0], &next[m][0], &staged[0], slots);
+
+    std::fill(ewma[m].begin(), ewma[m].end(), 0.0);
+  }
+
+  std::fill(staged.begin(), staged.end(), 0.0);
+}
+
+void CusumEngine::test() {
+
+  if (slots == 0)
+    return;
+
+  // only endpoints which are out of the learning phase and got new values
+  // are tested, g of the others is reset
+  for (unsigned s = 0; s < slots; s++)
+    active[s] = ready[s] * updated[s];
+
+  for (unsigned m = 0; m < metrics; m++)
+    cusum_kernel(&mean[m][0], &variance[m][0], &X[m][0], &active[0],
+		 &g[m][0], &N[m][0], &beta[m][0], &alarm[m][0],
+		 slots, amplitude_percentage, repetition_factor);
+
+  std::fill(updated.begin(), updated.end(), 0.0);
+}
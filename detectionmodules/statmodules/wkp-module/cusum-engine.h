@@ -0,0 +1,115 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software   */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          */
+/*    MA  02110-1301, USA                                                 */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef _CUSUM_ENGINE_H_
+#define _CUSUM_ENGINE_H_
+
+#include <stdint.h>
+#include <vector>
+
+
+// ==================== CLASS CusumEngine ====================
+
+// CUSUM state of all endpoints in structure-of-arrays layout
+// (cusum_parameters/soa_backend): for every metric, each variable
+// (mean, variance, g, ...) is one contiguous array indexed by the slot
+// of the endpoint. update() and test() process all endpoints in plain
+// loops over these arrays, which the compiler vectorizes, instead of
+// visiting the vectors of thousands of Params objects.
+//
+// Flags are stored as doubles (0.0 or 1.0), so the selects in the loops
+// work on vectors of the same width as the data. Values are truncated to
+// int like Params::X_curr; mean, variance, g, N and beta are the same as
+// computed by Stat for each endpoint.
+//
+// The per endpoint logic (learning phase, pausing of updates, alarms,
+// output) stays in Stat; it uses setValue() and start() for a single
+// slot, which may be called for different slots at the same time.
+
+class CusumEngine {
+
+  public:
+
+    CusumEngine() :
+      metrics(0), slots(0), smoothing_constant(0), log_variance_ewma(false),
+      amplitude_percentage(0), repetition_factor(0)
+    {}
+
+    void init(unsigned metrics, double smoothing_constant, bool log_variance_ewma,
+	      double amplitude_percentage, uint16_t repetition_factor);
+
+    // adds an endpoint; it isn't tested before start() is called for it
+    unsigned addSlot();
+    unsigned size() const { return slots; }
+
+    // end of the learning phase of an endpoint: initial mean and variance
+    // and current value of every metric
+    void start(unsigned slot, const std::vector<double> & mean,
+	       const std::vector<double> & variance, const std::vector<int64_t> & value);
+
+    // new value of metric m; if ewma is false, mean and variance of the
+    // metric are not updated with the previous value (pause_update_when_attack)
+    void setValue(unsigned slot, unsigned m, int64_t value, bool ewma);
+
+    // EWMA update of mean and variance with the previous values,
+    // for all endpoints which got new values since the last call
+    void update();
+
+    // CUSUM test of all started endpoints: threshold N, beta and g of every
+    // metric; g is reset for endpoints without new values since the last test
+    void test();
+
+    // results (of metric m for an endpoint)
+    bool attack(unsigned m, unsigned slot) const { return alarm[m][slot] != 0.0; }
+    double getN(unsigned m, unsigned slot) const { return N[m][slot]; }
+    double getBeta(unsigned m, unsigned slot) const { return beta[m][slot]; }
+    double getG(unsigned m, unsigned slot) const { return g[m][slot]; }
+    double getMean(unsigned m, unsigned slot) const { return mean[m][slot]; }
+    double getVariance(unsigned m, unsigned slot) const { return variance[m][slot]; }
+    double getValue(unsigned m, unsigned slot) const { return X[m][slot]; }
+
+  private:
+
+    unsigned metrics;
+    unsigned slots;
+
+    double smoothing_constant;
+    bool log_variance_ewma;
+    double amplitude_percentage;
+    uint16_t repetition_factor;
+
+    // one array per metric, indexed by slot
+    std::vector<std::vector<double> > mean;
+    std::vector<std::vector<double> > variance;
+    std::vector<std::vector<double> > g;
+    std::vector<std::vector<double> > X;      // current value
+    std::vector<std::vector<double> > next;   // value set by setValue()
+    std::vector<std::vector<double> > ewma;   // update mean and variance
+    std::vector<std::vector<double> > N;
+    std::vector<std::vector<double> > beta;
+    std::vector<std::vector<double> > alarm;
+
+    // one value per slot
+    std::vector<double> ready;    // learning phase over
+    std::vector<double> active;   // ready and updated, computed by test()
+    std::vector<double> staged;   // new values since last update()
+    std::vector<double> updated;  // new values since last test()
+
+};
+
+#endif
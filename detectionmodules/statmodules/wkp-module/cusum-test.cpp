@@ -1,5 +1,7 @@
 #include "cusum-test.h"
 
+#include <cmath>
+
 // update the cumulative sum g
 double cusum(int64_t X, double beta, double g) {
 
@@ -11,3 +13,14 @@ double cusum(int64_t X, double beta, double g) {
 
   return g;
 }
+
+// update mean and variance per EWMA with the value X of the last interval
+void cusum_ewma(double & mean, double & variance, int64_t X,
+		double smoothing_constant, bool log_variance_ewma) {
+
+  mean = mean * (1 - smoothing_constant) + X * smoothing_constant;
+  if (log_variance_ewma)
+    variance = exp(log(variance) * (1 - smoothing_constant) + log((X - mean)*(X - mean)) * smoothing_constant);
+  else
+    variance = variance * (1 - smoothing_constant) + (X - mean)*(X - mean) * smoothing_constant;
+}
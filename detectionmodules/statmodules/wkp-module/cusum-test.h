@@ -3,5 +3,7 @@
 
 #include <stdint.h>
 double cusum(int64_t X, double beta, double g);
+void cusum_ewma(double & mean, double & variance, int64_t X,
+		double smoothing_constant, bool log_variance_ewma);
 
 #endif
@@ -0,0 +1,142 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software   */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          */
+/*    MA  02110-1301, USA                                                 */
+/*                                                                        */
+/**************************************************************************/
+
+#include "endpoint-filter.h"
+#include <algorithm>
+
+
+// ==================== CLASS EndPointFilterTable ====================
+
+void EndPointFilterTable::add (const FilterEndPoint & fep, short netmask) {
+
+  const IpAddress ip = fep.getIpAddress();
+  uint32_t addr = ((uint32_t)ip[0] << 24) | ((uint32_t)ip[1] << 16)
+    | ((uint32_t)ip[2] << 8) | (uint32_t)ip[3];
+
+  // prefix length the address is compared with
+  // (cf. FilterEndPoint::matchesWithEndPoint)
+  short len;
+  if (fep.getNetmask() == 0)
+    len = 0;
+  else if (fep.getNetmask() < netmask && fep.getNetmask() < 32)
+    len = fep.getNetmask();
+  else
+    len = 32;
+
+  if (len == 0) {
+    addRule(all, fep.getPortNr(), fep.getProtocolID());
+    return;
+  }
+
+  // a filter address with bits set behind the prefix never matches
+  uint32_t mask = len == 32 ? 0xFFFFFFFF : ~(0xFFFFFFFF >> len);
+  if ((addr & mask) != addr)
+    return;
+
+  if (nodes.empty())
+    newNode();
+
+  // walk down to the level the prefix ends in
+  unsigned level = (len - 1) / 8;
+  int32_t node = 0;
+  for (unsigned l = 0; l != level; l++) {
+    unsigned b = (addr >> (24 - 8 * l)) & 0xFF;
+    if (nodes[node].child[b] < 0) {
+      int32_t c = newNode();
+      nodes[node].child[b] = c;
+    }
+    node = nodes[node].child[b];
+  }
+
+  // expand the prefix to all slots it covers at this level
+  unsigned first = (addr >> (24 - 8 * level)) & 0xFF;
+  unsigned span = 1 << (8 * (level + 1) - len);
+  for (unsigned b = first; b != first + span; b++) {
+    if (nodes[node].rules[b] < 0) {
+      ruleSets.push_back(RuleSet());
+      nodes[node].rules[b] = ruleSets.size() - 1;
+    }
+    addRule(ruleSets[nodes[node].rules[b]], fep.getPortNr(), fep.getProtocolID());
+  }
+
+}
+
+bool EndPointFilterTable::matches (const EndPoint & ep) const {
+
+  int port = ep.getPortNr();
+  int protocol = ep.getProtocolID();
+
+  if (all.matches(port, protocol))
+    return true;
+  if (nodes.empty())
+    return false;
+
+  const IpAddress ip = ep.getIpAddress();
+  const unsigned addr[4] = { (unsigned)(ip[0] & 0xFF), (unsigned)(ip[1] & 0xFF),
+                             (unsigned)(ip[2] & 0xFF), (unsigned)(ip[3] & 0xFF) };
+
+  int32_t node = 0;
+  for (unsigned l = 0; l != 4; l++) {
+    int32_t r = nodes[node].rules[addr[l]];
+    if (r >= 0 && ruleSets[r].matches(port, protocol))
+      return true;
+    node = nodes[node].child[addr[l]];
+    if (node < 0)
+      return false;
+  }
+
+  return false;
+
+}
+
+void EndPointFilterTable::addRule (RuleSet & rs, int port, int protocol) {
+
+  if (port == -1 && protocol == -1) {
+    rs.any = true;
+    return;
+  }
+
+  uint32_t key = ruleKey(port, protocol);
+  std::vector<uint32_t>::iterator it = std::lower_bound(rs.keys.begin(), rs.keys.end(), key);
+  if (it == rs.keys.end() || *it != key)
+    rs.keys.insert(it, key);
+
+}
+
+bool EndPointFilterTable::RuleSet::matches (int port, int protocol) const {
+
+  if (any)
+    return true;
+  if (keys.empty())
+    return false;
+
+  return std::binary_search(keys.begin(), keys.end(), ruleKey(port, protocol))
+    || std::binary_search(keys.begin(), keys.end(), ruleKey(port, -1))
+    || std::binary_search(keys.begin(), keys.end(), ruleKey(-1, protocol));
+
+}
+
+int32_t EndPointFilterTable::newNode() {
+
+  nodes.push_back(Node());
+  Node & n = nodes.back();
+  std::fill(n.child, n.child + 256, -1);
+  std::fill(n.rules, n.rules + 256, -1);
+  return nodes.size() - 1;
+
+}
@@ -0,0 +1,79 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software   */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          */
+/*    MA  02110-1301, USA                                                 */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef _ENDPOINT_FILTER_H_
+#define _ENDPOINT_FILTER_H_
+
+#include "shared.h"
+#include <stdint.h>
+#include <vector>
+
+
+// ==================== CLASS EndPointFilterTable ====================
+
+// Compiled form of the FilterEndPoint list: a multibit trie with a stride
+// of 8 bits over the (masked) IPv4 address. The prefix of every filter is
+// expanded to the slots of the level it ends in; every slot keeps the
+// port/protocol rules of the filters ending there.
+// matches() gives the same result as trying FilterEndPoint::matchesWithEndPoint
+// with every filter, but walks at most 4 trie levels, regardless of the
+// number of filters.
+
+class EndPointFilterTable {
+
+ public:
+
+  EndPointFilterTable() {}
+
+  // adds a filter; netmask is the global netmask applied to the
+  // endpoints which will be matched (cf. StatStore::netmask)
+  void add (const FilterEndPoint & fep, short netmask);
+
+  bool matches (const EndPoint & ep) const;
+
+ private:
+
+  // port/protocol rules of the filters ending in one slot
+  struct RuleSet {
+    RuleSet() : any(false) {}
+    bool any;                   // some filter has wildcards for both
+    std::vector<uint32_t> keys; // sorted, see ruleKey()
+    bool matches (int port, int protocol) const;
+  };
+
+  struct Node {
+    int32_t child[256];  // index into nodes or -1
+    int32_t rules[256];  // index into ruleSets or -1
+  };
+
+  // (port + 1) << 9 | (protocol + 1), a wildcard (-1) becomes 0
+  static uint32_t ruleKey (int port, int protocol) {
+    return (uint32_t)(port + 1) << 9 | (uint32_t)(protocol + 1);
+  }
+
+  static void addRule (RuleSet & rs, int port, int protocol);
+
+  int32_t newNode();
+
+  RuleSet all;                  // filters matching every address
+  std::vector<Node> nodes;      // nodes[0] is the root
+  std::vector<RuleSet> ruleSets;
+
+};
+
+#endif
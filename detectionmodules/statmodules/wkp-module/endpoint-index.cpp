@@ -0,0 +1,65 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software   */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          */
+/*    MA  02110-1301, USA                                                 */
+/*                                                                        */
+/**************************************************************************/
+
+#include "endpoint-index.h"
+
+
+// ==================== CLASS EndPointIndex ====================
+
+EndPointIndex::EndPointIndex()
+  : mask(1023) {
+
+  Entry empty = { 0, 0 };
+  entries.assign(mask + 1, empty);
+
+}
+
+uint32_t EndPointIndex::insert(uint64_t key) {
+
+  // keep the load factor below 1/2
+  if (2 * (keys.size() + 1) > entries.size())
+    grow();
+
+  uint32_t i = hash(key);
+  while (entries[i].slot != 0)
+    i = (i + 1) & mask;
+
+  keys.push_back(key);
+  entries[i].key = key;
+  entries[i].slot = keys.size();
+
+  return keys.size() - 1;
+
+}
+
+void EndPointIndex::grow() {
+
+  Entry empty = { 0, 0 };
+  entries.assign(2 * entries.size(), empty);
+  mask = entries.size() - 1;
+
+  // the keys are kept in slot order, so the table can be rebuilt from them
+  for (uint32_t slot = 0; slot != keys.size(); slot++) {
+    uint32_t i = hash(keys[slot]);
+    while (entries[i].slot != 0)
+      i = (i + 1) & mask;
+    entries[i].key = keys[slot];
+    entries[i].slot = slot + 1;
+  }
+
+}
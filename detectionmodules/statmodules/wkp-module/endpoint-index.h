@@ -0,0 +1,79 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software   */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          */
+/*    MA  02110-1301, USA                                                 */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef _ENDPOINT_INDEX_H_
+#define _ENDPOINT_INDEX_H_
+
+#include <stdint.h>
+#include <vector>
+
+
+// ==================== CLASS EndPointIndex ====================
+
+// Hash table from packed EndPoint keys (cf. EndPoint::toKey()) to slot
+// numbers. Slots are handed out in the order in which the endpoints are
+// added and are never taken back, so they can be used as index into
+// per-interval arrays. Open addressing with linear probing, so a lookup
+// usually costs one probe.
+
+class EndPointIndex {
+
+ public:
+
+  static const uint32_t NOT_FOUND = 0xFFFFFFFF;
+
+  EndPointIndex();
+
+  // returns the slot of key or NOT_FOUND
+  uint32_t find(uint64_t key) const {
+    for (uint32_t i = hash(key);; i = (i + 1) & mask) {
+      if (entries[i].slot == 0)
+	return NOT_FOUND;
+      if (entries[i].key == key)
+	return entries[i].slot - 1;
+    }
+  }
+
+  // adds a key which is not yet in the index and returns its slot
+  uint32_t insert(uint64_t key);
+
+  uint32_t size() const { return keys.size(); }
+
+  // key of a slot
+  uint64_t key(uint32_t slot) const { return keys[slot]; }
+
+ private:
+
+  struct Entry {
+    uint64_t key;
+    uint32_t slot; // slot + 1, 0 means empty
+  };
+
+  uint32_t hash(uint64_t key) const {
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+  }
+
+  void grow();
+
+  std::vector<Entry> entries;
+  std::vector<uint64_t> keys;
+  uint32_t mask;
+
+};
+
+#endif
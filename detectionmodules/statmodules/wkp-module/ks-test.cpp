@@ -313,7 +313,8 @@ double K(int n,double d)
  * makes sense, cannot be computed easily with our current means (Marsaglia's
  * procedure or the limiting form of D_nm).
  */
-double ks_test (std::list<int64_t> sample1, std::list<int64_t> sample2,
+double ks_test (const std::multiset<int64_t> & sample1,
+		const std::multiset<int64_t> & sample2,
 		std::ofstream & outfile) {
 
   unsigned int n1, n2, n_approx;
@@ -321,10 +322,15 @@ double ks_test (std::list<int64_t> sample1, std::list<int64_t> sample2,
   float d;
     // the value of Kolmogorov's statistic
     // for the particular values of sample1 and sample2
-  int D, Dmin, Dmax, s;
+  int D, Dmin, Dmax;
     // used in computing this value d
+  int64_t s;
+    // current (possibly tied) value
 
-  std::list<int64_t>::iterator it1, it2;
+  std::multiset<int64_t>::const_iterator it1, it2;
+
+  // debug output is expensive, skip it if nobody reads it
+  bool debug = outfile.is_open();
 
   // Determine sample sizes
   n1 = sample1.size();
@@ -332,11 +338,13 @@ double ks_test (std::list<int64_t> sample1, std::list<int64_t> sample2,
 
   // Calculate a conservative n approximation
   n_approx = (unsigned) ceil(float(n1*n2)/(n1+n2));
-  outfile << "n_approx=" << n_approx << std::endl;
 
-  // Sort samples
-  sample1.sort(); outfile << "sorted sample1: " << sample1 << std::endl;
-  sample2.sort(); outfile << "sorted sample2: " << sample2 << std::endl;
+  // The samples are kept sorted by the caller
+  if (debug) {
+    outfile << "n_approx=" << n_approx << std::endl;
+    outfile << "sorted sample1: " << sample1 << std::endl;
+    outfile << "sorted sample2: " << sample2 << std::endl;
+  }
 
   // We divide the range 0..1 into n1*n2 intervals of equal size 1/(n1*n2).
   //
@@ -345,8 +353,8 @@ double ks_test (std::list<int64_t> sample1, std::list<int64_t> sample2,
   // Each item in sample2 makes the sample c.d.f of sample2
   // jump by a step of n1 intervals.
   //
-  // For each item we compute D, related to the distance between the two
-  // sample c.d.f., s_cdf_1 - s_cdf_2, by:
+  // For each distinct value we compute D, related to the distance between
+  // the two sample c.d.f., s_cdf_1 - s_cdf_2, by:
   //
   //    D/(n1*n2) = s_cdf_1 - s_cdf_2
   //
@@ -359,6 +367,8 @@ double ks_test (std::list<int64_t> sample1, std::list<int64_t> sample2,
   //
   //    D_n1n2 = sup |s_cdf_1 - s_cdf_2|
   //           = max [ |Dmin/(n1*n2)| ; |Dmax/(n1*n2)| ]
+  //
+  // Once one of the samples is exhausted, D only moves back to 0.
 
   D = 0; Dmin = 0; Dmax = 0;
   it1 = sample1.begin();
@@ -366,59 +376,25 @@ double ks_test (std::list<int64_t> sample1, std::list<int64_t> sample2,
 
   while ( (it1 != sample1.end()) && (it2 != sample2.end()) ) {
 
-    if (*it1 == *it2) {
-
-      outfile << *it1 << " tie!";
-      // steps in both sample c.d.f., we need to perform all steps
-      // in this point before comparing D to Dmin and Dmax
-
-      s = *it1;
-      // perform all steps in s_cdf_1 first
-      do {
-	D += n2;
-	it1++;
-      }
-      while ( (*it1 == s) && (it1 != sample1.end()) );
-      // perform all steps in s_cdf_2 now
-      do {
-	D -= n1;
-	it2++;
-      }
-      while ( (*it2 == s) && (it2 != sample2.end()) );
-
-      // now adapt Dmin, Dmax if necessary
-      if (D > Dmax)
-	Dmax = D;
-      else if (D < Dmin)
-	Dmin = D;
-
-    }
-
-    else if (*it1 < *it2) {
-
-      outfile << *it1;
-      // step in s_cdf_1, increase D by n2
+    // perform all steps of the smallest value in both sample c.d.f.
+    // before comparing D to Dmin and Dmax
+    s = (*it1 < *it2) ? *it1 : *it2;
+    while (it1 != sample1.end() && *it1 == s) {
       D += n2;
       it1++;
-
-      if (D > Dmax)
-	Dmax = D;
-
     }
-
-    else {
-
-      outfile << *it2;
-      // step in F2, decrease D by n1
+    while (it2 != sample2.end() && *it2 == s) {
       D -= n1;
       it2++;
-
-      if (D < Dmin)
-	Dmin = D;
-
     }
 
-    outfile << " D=" << D << " Dmin=" << Dmin << " Dmax=" << Dmax << std::endl;
+    if (D > Dmax)
+      Dmax = D;
+    else if (D < Dmin)
+      Dmin = D;
+
+    if (debug)
+      outfile << s << " D=" << D << " Dmin=" << Dmin << " Dmax=" << Dmax << std::endl;
 
   }
 
@@ -21,13 +21,15 @@
 #ifndef _KS_TEST_H
 #define _KS_TEST_H
 
-#include <list>
+#include <set>
+#include <stdint.h>
 #include <fstream>
 
 void mMultiply(double *,double *,double *,int);
 void mPower(double *,int,double *,int *,int,int);
 double K(int,double);
 
-double ks_test(std::list<int64_t>, std::list<int64_t>, std::ofstream &);
+// the samples are sorted; output only if the ofstream is open
+double ks_test(const std::multiset<int64_t> &, const std::multiset<int64_t> &, std::ofstream &);
 
 #endif
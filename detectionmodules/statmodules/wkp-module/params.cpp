@@ -14,3 +14,38 @@ void Params::init(int size)
 	sumsOfProducts.push_back(v);
     }
 }
+
+// the sorted windows are created with the first sample
+
+void Params::pushOld(const std::vector<int64_t> & v)
+{
+    Old.push_back(v);
+    OldSorted.resize(v.size());
+    for (unsigned i = 0; i < v.size(); i++)
+	OldSorted[i].insert(v[i]);
+}
+
+void Params::pushNew(const std::vector<int64_t> & v)
+{
+    New.push_back(v);
+    NewSorted.resize(v.size());
+    for (unsigned i = 0; i < v.size(); i++)
+	NewSorted[i].insert(v[i]);
+}
+
+void Params::popOld()
+{
+    const std::vector<int64_t> & v = Old.front();
+    // erase only one of the equal values
+    for (unsigned i = 0; i < v.size(); i++)
+	OldSorted[i].erase(OldSorted[i].find(v[i]));
+    Old.pop_front();
+}
+
+void Params::popNew()
+{
+    const std::vector<int64_t> & v = New.front();
+    for (unsigned i = 0; i < v.size(); i++)
+	NewSorted[i].erase(NewSorted[i].find(v[i]));
+    New.pop_front();
+}
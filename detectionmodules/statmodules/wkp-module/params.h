@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <set>
+#include <stdint.h>
 // for pca (matrices etc.)
 #include <gsl/gsl_matrix.h>
 
@@ -16,7 +18,7 @@ class Params {
 
 public:
   Params() :
-      ready_to_test(false), cusum_learning_phase_nr(0), 
+      ready_to_test(false), cusum_slot(-1), cusum_learning_phase_nr(0), 
       pca_learning_phase_nr(0), pca_ready(false), wkp_updated(false), cusum_updated(false)
   {}
 
@@ -32,6 +34,17 @@ public:
   std::list<std::vector<int64_t> > Old;
   std::list<std::vector<int64_t> > New;
 
+  // the same samples sorted, one multiset per metric; kept up to date by
+  // the following functions (O(log n) per value), so the tests
+  // don't have to copy and sort the samples
+  std::vector<std::multiset<int64_t> > OldSorted;
+  std::vector<std::multiset<int64_t> > NewSorted;
+
+  void pushOld(const std::vector<int64_t> &);
+  void pushNew(const std::vector<int64_t> &);
+  void popOld();
+  void popNew();
+
   // every test has its was-attack flag for every metric
   // (needed to count the alarms correctly)
   // (Formerly, if e. g. WMW raised an alarm for packets_in
@@ -74,6 +87,10 @@ public:
 
   bool ready_to_test;
 
+  // slot of the endpoint in Stat::cusumEngine (-1 if not used);
+  // mean, variance, g and X_curr are then only copies of the values there
+  int cusum_slot;
+
   ///////////////
   // PCA STUFF //
   ///////////////
@@ -22,6 +22,7 @@
 #include "shared.h"
 #include <iostream>
 #include <fstream>
+#include <iterator>
 
 
 /* PEARSON CHI-SQUARE TEST OF HOMOGENEITY
@@ -204,21 +205,29 @@
  * number of categories)
  * WARNING: categories1 and categories2 MUST be empty vectors!
  */
-void pcs_categories ( std::list<int64_t> sample1, std::list<int64_t> sample2,
+void pcs_categories ( const std::multiset<int64_t> & sample1,
+		      const std::multiset<int64_t> & sample2,
 		      std::vector<unsigned> & categories1,
 		      std::vector<unsigned> & categories2,
 		      std::ofstream & outfile ) {
 
-  sample1.sort(); outfile << "sorted sample1: " << sample1 << std::endl;
-  sample2.sort(); outfile << "sorted sample2: " << sample2 << std::endl;
+  // debug output is expensive, skip it if nobody reads it
+  bool debug = outfile.is_open();
+
+  // The samples are kept sorted by the caller
+  if (debug) {
+    outfile << "sorted sample1: " << sample1 << std::endl;
+    outfile << "sorted sample2: " << sample2 << std::endl;
+  }
 
   unsigned lg1 = sample1.size();
   unsigned lg2 = sample2.size();
   unsigned n = lg1 + lg2;
 
-  int64_t min = sample1.front()<sample2.front() ? sample1.front():sample2.front();
-  unsigned sample1_oldsize = lg1;
-  unsigned sample2_oldsize = lg2;
+  std::multiset<int64_t>::const_iterator it1 = sample1.begin();
+  std::multiset<int64_t>::const_iterator it2 = sample2.begin();
+
+  int64_t min = *it1<*it2 ? *it1:*it2;
   double E1, E2;
 
   // M.L.E. of the probability that an item in sample1 (E1) and sample2 (E2)
@@ -236,22 +245,22 @@ void pcs_categories ( std::list<int64_t> sample1, std::list<int64_t> sample2,
 
     while (E1 < 5 || E2 < 5) {
 
-      sample1.remove(min);
-      sample2.remove(min);
+      // skip all elements = min in both samples
+      while (it1 != sample1.end() && *it1 == min) {
+	n1++;
+	it1++;
+      }
+      while (it2 != sample2.end() && *it2 == min) {
+	n2++;
+	it2++;
+      }
 
-      n1 += sample1_oldsize - sample1.size();
-        // number of elements = min in sample1
-      n2 += sample2_oldsize - sample2.size();
-        // number of elements = min in sample2
-
-      if (sample1.empty() == true || sample2.empty() == true) goto end;
+      if (it1 == sample1.end() || it2 == sample2.end()) goto end;
 
       E1 = double(lg1 * (n1+n2)) / n;
       E2 = double(lg2 * (n1+n2)) / n;
 
-      min = sample1.front()<sample2.front() ? sample1.front():sample2.front();
-      sample1_oldsize = sample1.size();
-      sample2_oldsize = sample2.size();
+      min = *it1<*it2 ? *it1:*it2;
 
     }
 
@@ -262,18 +271,19 @@ void pcs_categories ( std::list<int64_t> sample1, std::list<int64_t> sample2,
 
   end : {
 
-    if (sample1.empty() == true && sample2.empty() == false)
-      n2 += sample2.size();
-    if (sample1.empty() == false && sample2.empty() == true)
-      n1 += sample1.size();
+    // the remaining elements of the other sample go into the last category
+    n1 += std::distance(it1, sample1.end());
+    n2 += std::distance(it2, sample2.end());
 
     categories1.push_back(n1);
     categories2.push_back(n2);
 
   }
 
-  outfile << "categories1: " << categories1 << std::endl;
-  outfile << "categories2: " << categories2 << std::endl;
+  if (debug) {
+    outfile << "categories1: " << categories1 << std::endl;
+    outfile << "categories2: " << categories2 << std::endl;
+  }
 
   return;
 
@@ -304,8 +314,8 @@ void pcs_categories ( std::list<int64_t> sample1, std::list<int64_t> sample2,
  * As explained in this text, Pearson chi-square test is one-sided and
  * should not be put into a two-sided form; it would not make sense.
  */
-double pcs_test ( const std::list<int64_t> & sample1,
-		  const std::list<int64_t> & sample2,
+double pcs_test ( const std::multiset<int64_t> & sample1,
+		  const std::multiset<int64_t> & sample2,
 		  std::ofstream & outfile ) {
 
   std::vector<unsigned> categories1;
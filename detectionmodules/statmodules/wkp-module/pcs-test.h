@@ -22,17 +22,18 @@
 #define _PCS_TEST_H_
 
 #include <vector>
-#include <list>
+#include <set>
 #include <gsl/gsl_cdf.h>
 #include <stdint.h>
 #include <ostream>
 
-void pcs_categories ( std::list<int64_t>, std::list<int64_t>,
+// the samples are sorted; output only if the ofstream is open
+void pcs_categories ( const std::multiset<int64_t> &, const std::multiset<int64_t> &,
 		      std::vector<unsigned> &, std::vector<unsigned> &,
 		      std::ofstream & outfile );
 
-double pcs_test ( const std::list<int64_t> &,
-		  const std::list<int64_t> &,
+double pcs_test ( const std::multiset<int64_t> &,
+		  const std::multiset<int64_t> &,
 		  std::ofstream & outfile );
 
 #endif
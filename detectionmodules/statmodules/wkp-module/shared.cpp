@@ -145,6 +145,15 @@ std::ostream & operator << (std::ostream & os, const std::list<int64_t> & L) {
   return os;
 }
 
+std::ostream & operator << (std::ostream & os, const std::multiset<int64_t> & S) {
+  std::multiset<int64_t>::const_iterator it = S.begin();
+  while (it != S.end()) {
+    os << *it << ',';
+    it++;
+  }
+  return os;
+}
+
 std::ostream & operator << (std::ostream & os, const std::vector<unsigned> & V) {
   std::vector<unsigned>::const_iterator it = V.begin();
   while (it != V.end()) {
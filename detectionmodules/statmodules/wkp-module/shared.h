@@ -27,6 +27,7 @@
 #include <list>
 #include <map>
 #include <vector>
+#include <set>
 #include <iostream>
 
 // ======================== STRUCT Info ========================
@@ -128,6 +129,19 @@ class EndPoint {
       ipAddr.remanent_mask(n);
     }
 
+    // Packs ip address, port and protocol into one word
+    // (ip << 32 | port << 8 | protocol); used as key by EndPointIndex
+    uint64_t toKey() const {
+      return ((uint64_t)ipAddr[0] << 56) | ((uint64_t)ipAddr[1] << 48)
+        | ((uint64_t)ipAddr[2] << 40) | ((uint64_t)ipAddr[3] << 32)
+        | ((uint64_t)(portNr & 0xFFFF) << 8) | (uint64_t)(protocolID & 0xFF);
+    }
+
+    static EndPoint fromKey(uint64_t key) {
+      return EndPoint(IpAddress(key >> 56, key >> 48, key >> 40, key >> 32),
+                      (key >> 8) & 0xFFFF, key & 0xFF);
+    }
+
 };
 
 // ==================== FILTER CLASS FilterEndPoint ====================
@@ -174,6 +188,7 @@ class FilterEndPoint : public EndPoint
 // ======================== Output Operators ========================
 
 std::ostream & operator << (std::ostream &, const std::list<int64_t> &);
+std::ostream & operator << (std::ostream &, const std::multiset<int64_t> &);
 std::ostream & operator << (std::ostream &, const std::vector<unsigned> &);
 std::ostream & operator << (std::ostream &, const std::vector<int64_t> &);
 std::ostream & operator << (std::ostream &, const std::vector<double> &);
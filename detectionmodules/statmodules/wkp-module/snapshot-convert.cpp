@@ -0,0 +1,96 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software   */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          */
+/*    MA  02110-1301, USA                                                 */
+/*                                                                        */
+/**************************************************************************/
+
+// Converts a text offline file (written by the wkp-module with
+// <offline_file> in online mode) into the binary format of snapshot.h.
+// The wkp-module detects the format of its offline file on its own.
+
+#include "snapshot.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <string.h>
+
+int main(int argc, char ** argv) {
+
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <text offline file> <binary offline file>\n";
+    exit(-1);
+  }
+
+  std::ifstream in(argv[1]);
+  if (!in) {
+    std::cerr << "Couldn't open " << argv[1] << "\n";
+    exit(-1);
+  }
+
+  SnapshotWriter out;
+  if (!out.open(argv[2])) {
+    std::cerr << "Couldn't create " << argv[2] << "\n";
+    exit(-1);
+  }
+
+  // same parsing as operator>>(std::ifstream&, StatStore*), but without
+  // aggregation: that's done when the binary file is read
+  std::map<EndPoint,Info> data;
+  std::string line;
+  unsigned intervals = 0;
+  while (getline(in, line)) {
+
+    if (0 == strncmp("---", line.c_str(), 3)) {
+      int64_t counter = atoll(line.c_str() + 3);
+      if (!out.write(data, counter)) {
+	std::cerr << "Couldn't write " << argv[2] << "\n";
+	exit(-1);
+      }
+      data.clear();
+      intervals++;
+      continue;
+    }
+
+    EndPoint ep;
+    ep.fromString(line);
+    std::string::size_type k = line.find('_', 0);
+    if (k == std::string::npos)
+      continue;
+    std::stringstream values(line.substr(k+1));
+    Info info;
+    values >> info.packets_in >> info.packets_out >> info.bytes_in >> info.bytes_out >> info.records_in >> info.records_out;
+
+    Info & d = data[ep];
+    d.packets_in += info.packets_in;
+    d.packets_out += info.packets_out;
+    d.bytes_in += info.bytes_in;
+    d.bytes_out += info.bytes_out;
+    d.records_in += info.records_in;
+    d.records_out += info.records_out;
+  }
+
+  if (!data.empty())
+    std::cerr << "Last interval has no \"---\" line, skipped (as by the wkp-module)\n";
+
+  if (!out.close()) {
+    std::cerr << "Couldn't write " << argv[2] << "\n";
+    exit(-1);
+  }
+
+  std::cout << intervals << " intervals converted\n";
+  return 0;
+
+}
@@ -0,0 +1,246 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software   */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          */
+/*    MA  02110-1301, USA                                                 */
+/*                                                                        */
+/**************************************************************************/
+
+#include "snapshot.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define SNAPSHOT_MAGIC "TOPASWKP"
+#define SNAPSHOT_INDEX_MAGIC "TOPASIDX"
+#define SNAPSHOT_VERSION 1
+
+// number of columns (key and the six Info fields)
+#define SNAPSHOT_COLUMNS 7
+
+
+// ==================== CLASS SnapshotWriter ====================
+
+bool SnapshotWriter::open(const std::string & filename) {
+
+  file.open(filename.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+  if (!file)
+    return false;
+
+  SnapshotFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  file.write((const char *)&header, sizeof(header));
+
+  offsets.clear();
+  position = sizeof(header);
+
+  return file.good();
+
+}
+
+bool SnapshotWriter::write(const std::map<EndPoint,Info> & data, int64_t testCounter) {
+
+  if (!file.is_open())
+    return false;
+
+  SnapshotBlockHeader header;
+  memset(&header, 0, sizeof(header));
+  header.count = data.size();
+  header.length = sizeof(header) + SNAPSHOT_COLUMNS * sizeof(uint64_t) * header.count;
+  header.testCounter = testCounter;
+
+  // collect the columns first, the map is only walked once
+  std::vector<uint64_t> columns(SNAPSHOT_COLUMNS * header.count);
+  uint64_t * c = columns.empty() ? NULL : &columns[0];
+  uint32_t n = header.count;
+  uint32_t i = 0;
+  for (std::map<EndPoint,Info>::const_iterator it = data.begin(); it != data.end(); it++, i++) {
+    c[i] = it->first.toKey();
+    c[n + i] = it->second.packets_in;
+    c[2*n + i] = it->second.packets_out;
+    c[3*n + i] = it->second.bytes_in;
+    c[4*n + i] = it->second.bytes_out;
+    c[5*n + i] = it->second.records_in;
+    c[6*n + i] = it->second.records_out;
+  }
+
+  file.write((const char *)&header, sizeof(header));
+  if (c != NULL)
+    file.write((const char *)c, columns.size() * sizeof(uint64_t));
+
+  offsets.push_back(position);
+  position += header.length;
+
+  return file.good();
+
+}
+
+bool SnapshotWriter::close() {
+
+  if (!file.is_open())
+    return true;
+
+  SnapshotFileTrailer trailer;
+  memset(&trailer, 0, sizeof(trailer));
+  trailer.indexOffset = position;
+  trailer.intervals = offsets.size();
+  memcpy(trailer.magic, SNAPSHOT_INDEX_MAGIC, sizeof(trailer.magic));
+
+  if (!offsets.empty())
+    file.write((const char *)&offsets[0], offsets.size() * sizeof(uint64_t));
+  file.write((const char *)&trailer, sizeof(trailer));
+
+  bool ok = file.good();
+  file.close();
+  offsets.clear();
+  return ok;
+
+}
+
+
+// ==================== CLASS SnapshotFile ====================
+
+bool SnapshotFile::isSnapshot(const std::string & filename) {
+
+  std::ifstream f(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+  char magic[8];
+  if (!f.read(magic, sizeof(magic)))
+    return false;
+  return memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+
+}
+
+bool SnapshotFile::fail(const std::string & msg) {
+
+  errorMsg = msg;
+  close();
+  return false;
+
+}
+
+bool SnapshotFile::open(const std::string & filename) {
+
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    return fail(strerror(errno));
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    ::close(fd);
+    return fail(strerror(errno));
+  }
+  size = st.st_size;
+  if (size < sizeof(SnapshotFileHeader) + sizeof(SnapshotFileTrailer)) {
+    ::close(fd);
+    return fail("file too short");
+  }
+
+  void * ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (ptr == MAP_FAILED) {
+    data = NULL;
+    return fail(strerror(errno));
+  }
+  data = (const char *)ptr;
+
+  const SnapshotFileHeader * header = (const SnapshotFileHeader *)data;
+  if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0)
+    return fail("not a snapshot file");
+  if (header->version != SNAPSHOT_VERSION)
+    return fail("unsupported version or byte order");
+
+  const SnapshotFileTrailer * trailer =
+    (const SnapshotFileTrailer *)(data + size - sizeof(SnapshotFileTrailer));
+  if (memcmp(trailer->magic, SNAPSHOT_INDEX_MAGIC, sizeof(trailer->magic)) != 0)
+    return fail("no interval index (incomplete file?)");
+  uint64_t indexEnd = size - sizeof(SnapshotFileTrailer);
+  if (trailer->indexOffset % sizeof(uint64_t) != 0
+      || trailer->indexOffset < sizeof(SnapshotFileHeader)
+      || trailer->indexOffset > indexEnd
+      || indexEnd - trailer->indexOffset != (uint64_t)trailer->intervals * sizeof(uint64_t))
+    return fail("damaged interval index");
+
+  index = (const uint64_t *)(data + trailer->indexOffset);
+  count = trailer->intervals;
+
+  // check the blocks once, interval() can then trust them
+  for (uint32_t i = 0; i != count; i++) {
+    uint64_t offset = index[i];
+    if (offset % sizeof(uint64_t) != 0 || offset < sizeof(SnapshotFileHeader)
+	|| offset + sizeof(SnapshotBlockHeader) > trailer->indexOffset)
+      return fail("damaged interval index");
+    const SnapshotBlockHeader * block = (const SnapshotBlockHeader *)(data + offset);
+    if (block->length != sizeof(SnapshotBlockHeader)
+	+ SNAPSHOT_COLUMNS * sizeof(uint64_t) * (uint64_t)block->count
+	|| offset + block->length > trailer->indexOffset)
+      return fail("damaged block");
+  }
+
+  return true;
+
+}
+
+void SnapshotFile::close() {
+
+  if (data != NULL)
+    munmap((void *)data, size);
+  data = NULL;
+  size = 0;
+  index = NULL;
+  count = 0;
+
+}
+
+SnapshotFile::Interval SnapshotFile::interval(uint32_t i) const {
+
+  const SnapshotBlockHeader * block = (const SnapshotBlockHeader *)(data + index[i]);
+  const uint64_t * c = (const uint64_t *)(block + 1);
+  uint32_t n = block->count;
+
+  Interval ret;
+  ret.count = n;
+  ret.testCounter = block->testCounter;
+  ret.key = c;
+  ret.packets_in = c + n;
+  ret.packets_out = c + 2*n;
+  ret.bytes_in = c + 3*n;
+  ret.bytes_out = c + 4*n;
+  ret.records_in = c + 5*n;
+  ret.records_out = c + 6*n;
+  return ret;
+
+}
+
+void SnapshotFile::prefetch(uint32_t i, uint32_t n) const {
+
+  if (i >= count || n == 0)
+    return;
+  uint32_t last = (i + n < count) ? i + n : count;
+
+  // madvise() wants a page aligned start
+  long page = sysconf(_SC_PAGESIZE);
+  uint64_t begin = index[i] & ~(uint64_t)(page - 1);
+  const SnapshotBlockHeader * block = (const SnapshotBlockHeader *)(data + index[last - 1]);
+  uint64_t end = index[last - 1] + block->length;
+
+  madvise((void *)(data + begin), end - begin, MADV_WILLNEED);
+
+}
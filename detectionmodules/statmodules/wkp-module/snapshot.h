@@ -0,0 +1,151 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software   */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,          */
+/*    MA  02110-1301, USA                                                 */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include "shared.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <fstream>
+#include <string>
+#include <map>
+#include <vector>
+
+
+// ==================== BINARY OFFLINE SNAPSHOTS ====================
+
+// Binary alternative to the text offline file written by Stat::test()
+// (storefile << Data). The file contains one block per interval; every
+// block stores its endpoints column by column, so a block can be used
+// directly from a read-only mapping of the file without any parsing:
+//
+//   FileHeader
+//   block 0: BlockHeader, key[count], packets_in[count], packets_out[count],
+//            bytes_in[count], bytes_out[count], records_in[count],
+//            records_out[count]
+//   block 1: ...
+//   index:   offset of every block (uint64_t)
+//   FileTrailer
+//
+// key is EndPoint::toKey(). Blocks are length-prefixed and everything is
+// 8 byte aligned. Numbers are stored in host byte order, so snapshots
+// can't be exchanged between machines of different endianness (the
+// version field detects that).
+
+struct SnapshotFileHeader {
+  char magic[8];        // "TOPASWKP"
+  uint32_t version;
+  uint32_t reserved;
+};
+
+struct SnapshotBlockHeader {
+  uint64_t length;      // of the whole block, header included
+  uint32_t count;       // number of endpoints
+  uint32_t reserved;
+  int64_t testCounter;  // test_counter of Stat::test() when written
+};
+
+struct SnapshotFileTrailer {
+  uint64_t indexOffset;
+  uint32_t intervals;
+  uint32_t reserved;
+  char magic[8];        // "TOPASIDX"
+};
+
+
+// ==================== CLASS SnapshotWriter ====================
+
+class SnapshotWriter {
+
+ public:
+
+  SnapshotWriter() {}
+  ~SnapshotWriter() { close(); }
+
+  bool open(const std::string & filename);
+  bool isOpen() const { return file.is_open(); }
+
+  // appends the data of one interval
+  bool write(const std::map<EndPoint,Info> & data, int64_t testCounter);
+
+  // writes the index; the file isn't readable without it
+  bool close();
+
+ private:
+
+  std::ofstream file;
+  std::vector<uint64_t> offsets;
+  uint64_t position;
+
+};
+
+
+// ==================== CLASS SnapshotFile ====================
+
+// Read-only mapping of a snapshot file
+
+class SnapshotFile {
+
+ public:
+
+  // one block, pointing into the mapping
+  struct Interval {
+    uint32_t count;
+    int64_t testCounter;
+    const uint64_t * key;
+    const uint64_t * packets_in;
+    const uint64_t * packets_out;
+    const uint64_t * bytes_in;
+    const uint64_t * bytes_out;
+    const uint64_t * records_in;
+    const uint64_t * records_out;
+  };
+
+  SnapshotFile() : data(NULL), size(0), index(NULL), count(0) {}
+  ~SnapshotFile() { close(); }
+
+  // returns false if the file couldn't be mapped or isn't a (complete)
+  // snapshot; error() tells why
+  bool open(const std::string & filename);
+  void close();
+
+  // true if the file starts like a snapshot file
+  static bool isSnapshot(const std::string & filename);
+
+  const std::string & error() const { return errorMsg; }
+
+  uint32_t intervals() const { return count; }
+  Interval interval(uint32_t i) const;
+
+  // asks the kernel to read the blocks of intervals i ... i+n-1 ahead
+  void prefetch(uint32_t i, uint32_t n) const;
+
+ private:
+
+  bool fail(const std::string & msg);
+
+  const char * data;
+  size_t size;
+  const uint64_t * index;
+  uint32_t count;
+  std::string errorMsg;
+
+};
+
+#endif
@@ -35,6 +35,8 @@
 
 #include<signal.h>
 #include<math.h>
+#include<unistd.h>
+#include<pthread.h>
 
 #include "stat-main.h"
 #include "wmw-test.h"
@@ -50,6 +52,8 @@
 #define CONFIGTAG_AlarmTime "alarm_time"
 #define CONFIGTAG_SourceIds "accepted_source_ids"
 #define CONFIGTAG_OfflineFile "offline_file"
+#define CONFIGTAG_OfflineFileFormat "offline_file_format"
+#define CONFIGTAG_OfflinePrefetch "offline_prefetch"
 #define CONFIGTAG_EndpointKey "endpoint_key"
 #define CONFIGTAG_EndpointKeyProtocol "protocol"
 #define CONFIGTAG_EndpointKeyPort "port"
@@ -69,6 +73,7 @@
 #define CONFIGTAG_TestFrequency "test_frequency"
 #define CONFIGTAG_ReportOnlyFirstAttack "report_only_first_attack"
 #define CONFIGTAG_PauseUpdateWhenAttack "pause_update_when_attack"
+#define CONFIGTAG_WorkerThreads "worker_threads"
 #define CONFIGTAG_XFrequentEndpoints "x_frequent_endpoints"
 #define CONFIGTAG_EndpointsToMonitor "endpoints_to_monitor"
 #define CONFIGTAG_CusumParams "cusum_parameters"
@@ -78,6 +83,7 @@
 #define CONFIGTAG_CusumLearningPhase "cusum_learning_phase"
 #define CONFIGTAG_RepetitionFactor "repetition_factor"
 #define CONFIGTAG_SmoothingConstant "smoothing_constant"
+#define CONFIGTAG_CusumSoaBackend "soa_backend"
 #define CONFIGTAG_WkpParams "wkp_parameters"
 #define CONFIGTAG_WMWTest "wmw_test"
 #define CONFIGTAG_KSTest "ks_test"
@@ -96,7 +102,9 @@
 #define DEFAULT_NoiseThresholdBytes 0
 #define DEFAULT_MaxEndpoints 500
 #define DEFAULT_TestFrequency 1
+#define DEFAULT_WorkerThreads 1
 #define DEFAULT_XFrequentEndpoints 10
+#define DEFAULT_OfflinePrefetch 1
 #define DEFAULT_AmplitudePercentage 3
 #define DEFAULT_CusumLearningPhase 10
 #define DEFAULT_RepetitionFactor 2
@@ -142,7 +150,7 @@ Stat::Stat(const std::string & configfile)
 #ifdef OFFLINE_ENABLED
 : DetectionBase<StatStore, OfflineInputPolicy<StatStore> >(configfile)
 #else
-: DetectionBase<StatStore>(configfile)
+: DetectionBase<StatStore, BatchInputPolicy<SemShmNotifier, StatStore> >(configfile)
 #endif
 {
     msgStr.setName("wkp-/cusum-module");
@@ -166,15 +174,27 @@ Stat::Stat(const std::string & configfile)
     init(configfile);
 
 #ifdef OFFLINE_ENABLED
-    /* open file with offline data */
-    if(!OfflineInputPolicy<StatStore>::openOfflineFile(offlineFile.c_str())) {
+    /* open file with offline data, binary or text */
+    if (SnapshotFile::isSnapshot(offlineFile)) {
+	if (!StatStore::openSnapshot(offlineFile, offline_prefetch)) {
+	    msgStr.print(MsgStream::FATAL, "Could not open offline data file: " + StatStore::getSnapshot().error());
+	    stop();
+	}
+	else
+	    OfflineInputPolicy<StatStore>::openOfflineReader(StatStore::readSnapshot, offline_prefetch);
+    }
+    else if(!OfflineInputPolicy<StatStore>::openOfflineFile(offlineFile.c_str(), offline_prefetch)) {
 	msgStr.print(MsgStream::FATAL, "Could not open offline data file!");
 	stop();
     }
 #else
-    if(offlineFile != "")
+    if(offlineFile != "") {
 	/* open file to store data for offline use */
-	storefile.open(offlineFile.c_str());
+	if (binaryOfflineFile)
+	    snapshotfile.open(offlineFile);
+	else
+	    storefile.open(offlineFile.c_str());
+    }
 #endif
 
 }
@@ -185,6 +205,7 @@ Stat::~Stat()
 
     if(storefile.is_open())
 	storefile.close();
+    snapshotfile.close();
 
 }
 
@@ -335,6 +356,25 @@ void Stat::init(const std::string & configfile) {
 #endif
     }
 
+#ifdef OFFLINE_ENABLED
+    // how many intervals are read ahead while testing
+    // (the format of the offline file is detected)
+    if (config->nodeExists(CONFIGTAG_OfflinePrefetch) && !(config->getValue(CONFIGTAG_OfflinePrefetch)).empty())
+	offline_prefetch = atoi(config->getValue(CONFIGTAG_OfflinePrefetch).c_str());
+    else
+	offline_prefetch = DEFAULT_OfflinePrefetch;
+    if (offline_prefetch == 0)
+	offline_prefetch = DEFAULT_OfflinePrefetch;
+    msgStr << MsgStream::INFO << "Reading " << offline_prefetch << " interval(s) of the offline file ahead." << MsgStream::endl;
+#else
+    // text (default) or binary (cf. snapshot.h) offline file
+    binaryOfflineFile = false;
+    if (config->nodeExists(CONFIGTAG_OfflineFileFormat) && (config->getValue(CONFIGTAG_OfflineFileFormat) == "binary")) {
+	binaryOfflineFile = true;
+	msgStr.print(MsgStream::INFO, "Offline file is written in binary format.");
+    }
+#endif
+
     // extracting the netmask, which will be applied
     // to the ip of each endpoint; for aggregating
     // in ON- and OFFLINE MODE
@@ -508,6 +548,18 @@ void Stat::init(const std::string & configfile) {
 	    break;
     }
 
+    // extracting number of threads processing the endpoints in test()
+    // (0 means one per online processor)
+    if(config->nodeExists(CONFIGTAG_WorkerThreads) && !(config->getValue(CONFIGTAG_WorkerThreads).empty()))
+	worker_threads = atoi(config->getValue(CONFIGTAG_WorkerThreads).c_str());
+    else
+	worker_threads = DEFAULT_WorkerThreads;
+    if (worker_threads <= 0) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	worker_threads = (cpus > 0) ? cpus : 1;
+    }
+    msgStr << MsgStream::INFO << "Endpoints are processed by " << worker_threads << " thread(s)." << MsgStream::endl;
+
     config->leaveNode();
 
     //
@@ -520,6 +572,7 @@ void Stat::init(const std::string & configfile) {
 	config->leaveNode();
     } else {
 	enable_cusum_test = false;
+	cusum_soa_backend = false;
     }
 
     //
@@ -583,6 +636,28 @@ void Stat::update(XMLConfObj* xmlObj)
 
 
 
+#ifdef OFFLINE_ENABLED
+// counts an endpoint of the offline file for x_frequently_endpoints
+static void count_endpoint(std::map<FilterEndPoint,int> & endPointCount, FilterEndPoint fep)
+{
+    // AGGREGATION (specified by endpoint_key and netmask)
+    // as our data will be aggregated, the x_frequently_endpoints
+    // need to be aggregated, too
+    if (StatStore::ipMonitoring == false)
+	fep.setIpAddress(IpAddress(0,0,0,0));
+    else
+	// apply the global aggregation netmask to fep's ip address
+	fep.applyNetmask(StatStore::netmask);
+    if (StatStore::portMonitoring == false)
+	fep.setPortNr(0);
+    if (StatStore::protocolMonitoring == false)
+	fep.setProtocolID(0);
+
+    // count number of appearings of each EndPoint
+    endPointCount[fep]++;
+}
+#endif
+
 void Stat::init_endpoints(XMLConfObj * config) 
 {
     int endpointlist_maxsize;
@@ -648,43 +723,49 @@ void Stat::init_endpoints(XMLConfObj * config)
 	    x_frequently_endpoints = DEFAULT_XFrequentEndpoints;
 	msgStr << MsgStream::INFO << "Monitoring the " << x_frequently_endpoints << " most frequent endpoints." << MsgStream::endl;
 
-	std::ifstream dataFile;
-	dataFile.open(offlineFile.c_str());
-	if (!dataFile) {
-	    msgStr.print(MsgStream::FATAL, "Could't open offline file \"" + offlineFile + "\"!");
-	    stop();
-	    return;
+	if (SnapshotFile::isSnapshot(offlineFile)) {
+	    SnapshotFile snapshot;
+	    if (!snapshot.open(offlineFile)) {
+		msgStr.print(MsgStream::FATAL, "Could't open offline file \"" + offlineFile + "\": " + snapshot.error());
+		stop();
+		return;
+	    }
+	    for (uint32_t i = 0; i != snapshot.intervals(); i++) {
+		SnapshotFile::Interval iv = snapshot.interval(i);
+		for (uint32_t j = 0; j != iv.count; j++) {
+		    FilterEndPoint fep;
+		    EndPoint ep = EndPoint::fromKey(iv.key[j]);
+		    fep.setIpAddress(ep.getIpAddress());
+		    fep.setPortNr(ep.getPortNr());
+		    fep.setProtocolID(ep.getProtocolID());
+		    count_endpoint(endPointCount, fep);
+		}
+	    }
 	}
+	else {
+	    std::ifstream dataFile;
+	    dataFile.open(offlineFile.c_str());
+	    if (!dataFile) {
+		msgStr.print(MsgStream::FATAL, "Could't open offline file \"" + offlineFile + "\"!");
+		stop();
+		return;
+	    }
 
-	std::string tmp;
-	FilterEndPoint fep;
-	while ( !dataFile.eof() && getline(dataFile, tmp) ) {
+	    std::string tmp;
+	    while ( !dataFile.eof() && getline(dataFile, tmp) ) {
 
-	    if (0 == strncmp("---",tmp.c_str(),3) )
-		continue;
+		if (0 == strncmp("---",tmp.c_str(),3) )
+		    continue;
 
-	    // extract endpoint-data
-	    fep.fromString(tmp, false);
+		// extract endpoint-data
+		FilterEndPoint fep;
+		fep.fromString(tmp, false);
+		count_endpoint(endPointCount, fep);
+	    }
 
-	    // AGGREGATION (specified by endpoint_key and netmask)
-	    // as our data will be aggregated, the x_frequently_endpoints
-	    // need to be aggregated, too
-	    if (StatStore::ipMonitoring == false)
-		fep.setIpAddress(IpAddress(0,0,0,0));
-	    else
-		// apply the global aggregation netmask to fep's ip address
-		fep.applyNetmask(StatStore::netmask);
-	    if (StatStore::portMonitoring == false)
-		fep.setPortNr(0);
-	    if (StatStore::protocolMonitoring == false)
-		fep.setProtocolID(0);
-
-	    // count number of appearings of each EndPoint
-	    endPointCount[fep]++;
+	    dataFile.close();
 	}
 
-	dataFile.close();
-
 	// if all data was read
 	// search the X most frequently appeared endpoints
 	// but first check, if there are so many at all
@@ -745,6 +826,7 @@ void Stat::init_cusum_test(XMLConfObj * config)
 {
     // cusum_test
     enable_cusum_test = true;
+    cusum_soa_backend = false;
     if (config->nodeExists(CONFIGTAG_CusumTest) && (config->getValue(CONFIGTAG_CusumTest) == "false")) {
 	enable_cusum_test = false;
 	msgStr.print(MsgStream::INFO, "CUSUM test is disabled.");
@@ -804,6 +886,14 @@ void Stat::init_cusum_test(XMLConfObj * config)
 	msgStr.print(MsgStream::INFO, "CUSUM deploys EWMA on log(variance).");
     }
 
+    // soa_backend
+    if (config->nodeExists(CONFIGTAG_CusumSoaBackend) && (config->getValue(CONFIGTAG_CusumSoaBackend) != "false")) {
+	cusum_soa_backend = true;
+	cusumEngine.init(metrics.size(), smoothing_constant, log_variance_ewma,
+			 amplitude_percentage, repetition_factor);
+	msgStr.print(MsgStream::INFO, "CUSUM state of all endpoints is kept in one structure of arrays.");
+    }
+
 }
 
 void Stat::init_wkp_test(XMLConfObj * config) {
@@ -910,7 +1000,8 @@ std::string Stat::config_overview()
 	    << "repetition_factor = " << repetition_factor << "\n"
 	    << "cusum_learning_phase = " << cusum_learning_phase << "\n"
 	    << "smoothing_constant = " << smoothing_constant << "\n"
-	    << "log_variance_ewma = " << (log_variance_ewma?"true":"false") << "\n\n";
+	    << "log_variance_ewma = " << (log_variance_ewma?"true":"false") << "\n"
+	    << "soa_backend = " << (cusum_soa_backend?"true":"false") << "\n\n";
     } else {
 	config << "disabled\n\n";
     }
@@ -944,6 +1035,8 @@ void Stat::test(StatStore * store) {
     if (storefile.is_open() == true)
 	// store data storage for offline use
 	storefile << Data << "--- " << test_counter << std::endl << std::flush;
+    else if (snapshotfile.isOpen() == true)
+	snapshotfile.write(Data, test_counter);
 #endif
 
     // Dumping empty records:
@@ -959,11 +1052,9 @@ void Stat::test(StatStore * store) {
 
     std::map<EndPoint,Info>::iterator Data_it = Data.begin();
 
+    // Needed for extraction of packets(t)-packets(t-1) and bytes(t)-bytes(t-1)
     std::map<EndPoint,Info> PreviousData = store->getPreviousData();
     //std::map<EndPoint,Info> PreviousData = store->getPreviousDataFromFile();
-    // Needed for extraction of packets(t)-packets(t-1) and bytes(t)-bytes(t-1)
-    // Holds information about the Info used in the last call to test()
-    Info prev;
 
     // 1) LEARN/UPDATE PHASE
     // Parsing data to see whether the recorded EndPoints already exist
@@ -973,177 +1064,38 @@ void Stat::test(StatStore * store) {
     // std::vector<int64_t> extracted data.
     logStr.rawPrint (MsgStream::WARN, "#### LEARN/UPDATE PHASE");
 
-    // for every EndPoint, extract the data
+    // Collect the work for every EndPoint. New EndPoints are added to
+    // "EndpointParams" here, as the map must not be changed while the
+    // endpoints are processed; there will not be jeopardy of memory
+    // exhaustion through endless growth of the "EndpointParams" map
+    // as limits are implemented in the StatStore class (EndPointListMaxSize)
+    std::vector<EndpointWork *> work;
     while (Data_it != Data.end()) {
-	logStr << MsgStream::raw << MsgStream::WARN << "[[ " << Data_it->first.toString() << " ]]" << MsgStream::endl;
-
-	prev = PreviousData[Data_it->first];
+	EndpointWork * W = new EndpointWork;
+	W->endPoint = &Data_it->first;
+	W->info = &Data_it->second;
+	W->prev = PreviousData[Data_it->first];
 	// it doesn't matter much if Data_it->first is an EndPoint that exists
 	// only in Data, but not in PreviousData, because
 	// PreviousData[Data_it->first] will automaticaly be an Info structure
 	// with all fields set to 0.
-
-	std::vector<int64_t> metric_data;
-	std::vector<int64_t> pca_metric_data;
-
-	std::map<EndPoint, Params>::iterator EndpointParams_it =
-	    EndpointParams.find(Data_it->first);
-
-	if (EndpointParams_it == EndpointParams.end()) {
-	    // We didn't find the recorded EndPoint Data_it->first
-	    // in our container "EndpointParams"; that means it's a new one,
-	    // so we just add it in "EndpointParams"; there will not be jeopardy
-	    // of memory exhaustion through endless growth of the "EndpointParams" map
-	    // as limits are implemented in the StatStore class (EndPointListMaxSize)
-
-	    // Initialization
-	    Params P;
-	    P.correspondingEndPoint = (Data_it->first).toString();
-	    if (enable_wkp_test == true) {
-		for (int i=0; i < metrics.size(); i++) {
-		    (P.last_wmw_test_was_attack).push_back(false);
-		    (P.last_ks_test_was_attack).push_back(false);
-		    (P.last_pcs_test_was_attack).push_back(false);
-		    (P.wmw_alarms).push_back(0);
-		    (P.ks_alarms).push_back(0);
-		    (P.pcs_alarms).push_back(0);
-		}
-	    }
-	    if (enable_cusum_test == true) {
-		for (int i = 0; i != metrics.size(); i++) {
-		    (P.mean).push_back(0);
-		    (P.variance).push_back(0.0);
-		    (P.N).push_back(0);
-		    (P.beta).push_back(0.0);
-		    (P.g).push_back(0.0);
-		    (P.last_cusum_test_was_attack).push_back(false);
-		    (P.X_curr).push_back(0);
-		    (P.cusum_alarms).push_back(0);
-		}
-	    }
-
-	    logStr.rawPrint(MsgStream::WARN , "Add as new monitored endpoint");
-	    if (use_pca == true) {
-		// initialize PCA parameters
-		P.init(metrics.size());
-		pca_metric_data = extract_pca_data(P, Data_it->second, prev);
-	    }
-	    else {
-		metric_data = extract_data(Data_it->second, prev);
-		if (enable_wkp_test == true) {
-		    (P.Old).push_back(metric_data);
-		    if(logStr.getLogLevel() >= MsgStream::INFO) {
-			std::stringstream tmp;
-			tmp << "  (WKP): with first element of sample_old: " << metric_data;
-			logStr.rawPrint(MsgStream::INFO, tmp.str());
-		    }
-		}
-		if (enable_cusum_test == true) {
-		    // add first value of each metric to the sum, which is needed
-		    // only to calculate the initial mean and variance after cusum_learning_phase
-		    // is over
-		    for (int i = 0; i != metric_data.size(); i++) {
-			P.mean.at(i) = metric_data.at(i);
-			P.variance.at(i) = metric_data.at(i) * metric_data.at(i);
-		    }
-		    P.cusum_learning_phase_nr = 1;
-		    logStr.rawPrint(MsgStream::WARN, "  (CUSUM): with initial values for mean and variance of metrics.");
-		}
-	    }
-
-	    EndpointParams[Data_it->first] = P;
-	}
-	else {
-	    // We found the recorded EndPoint Data_it->first
-	    // in our container "EndpointParams"; so we update the data
-	    if (use_pca == true) {
-		pca_metric_data = extract_pca_data(EndpointParams_it->second, Data_it->second, prev);
-		// Updates for pca metrics have to wait for the pca learning phase
-		// needed to calculate the eigenvectors
-		// NOTE: The overall learning phases for the tests will thus sum up to
-		// WKP: learning_phase_pca + learning_phase_samples
-		// Cusum: learning_phase_pca + cusum_learning_phase
-		if ((EndpointParams_it->second).pca_ready == false)
-		    logStr.rawPrint(MsgStream::WARN, "Learning phase for PCA ...");
-		// this case happens exactly one time: when PCA is ready for the first time
-		else if ((EndpointParams_it->second).pca_ready == true && pca_metric_data.empty() == true) {
-		    logStr.rawPrint(MsgStream::WARN, "PCA learning phase is over! PCA is now ready!");
-		    if (logStr.getLogLevel() == MsgStream::DEBUG) {
-			logStr << MsgStream::raw << MsgStream::DEBUG 
-			    << "Calculated " << ((use_correlation_matrix == true)?"correlation matrix:":"covariance matrix:\n");
-			for (int i = 0; i < metrics.size(); i++) {
-			    for (int j = 0; j < metrics.size(); j++)
-				logStr << gsl_matrix_get((EndpointParams_it->second).cov,i,j) << "\t";
-			    logStr << "\n";
-			}
-			logStr << MsgStream::endl;
-		    }
-		}
-		else {
-		    if (enable_wkp_test == true)
-			wkp_update ( EndpointParams_it->second, pca_metric_data );
-		    if (enable_cusum_test == true)
-			cusum_update ( EndpointParams_it->second, pca_metric_data );
-		}
-	    }
-	    else {
-		metric_data = extract_data(Data_it->second, prev);
-		if (enable_wkp_test == true)
-		    wkp_update ( EndpointParams_it->second, metric_data );
-		if (enable_cusum_test == true)
-		    cusum_update ( EndpointParams_it->second, metric_data );
-	    }
-	}
-
-	// Create metric files, if wished so
-	// (this can be done here, because metrics are the same for both tests)
-	// in case of pca: don't create file until learning phase is over
-	if ((createFiles == true) && ((use_pca == false) || (pca_metric_data.size() > 0))) {
-
-	    std::string fname;
-
-	    fname = (Data_it->first).toString() + "_metrics.txt";
-
-	    chdir(output_dir.c_str());
-
-	    std::ofstream file(fname.c_str(),std::ios_base::app);
-
-	    // are we at the beginning of the file?
-	    // if yes, write the metric names to the file ...
-	    long pos;
-	    pos = file.tellp();
-
-	    if (use_pca == true) {
-		if (pos == 0) {
-		    file << "# ";
-		    for (int i = 0; i < pca_metric_data.size(); i++)
-			file << "pca_comp_" << i << "\t";
-		    file << "Test-Run" << "\n";
-		}
-		for (int i = 0; i < pca_metric_data.size(); i++)
-		    file << pca_metric_data.at(i) << "\t";
-		file << test_counter << "\n";
-	    }
-	    else {
-		if (pos == 0) {
-		    file << "# ";
-		    for(std::vector<MetricData>::iterator val = metrics.begin(); val != metrics.end(); val++)
-			file << val->name << "\t";
-		    file << "Test-Run" << "\n";
-		}
-		for (int i = 0; i < metric_data.size(); i++)
-		    file << metric_data.at(i) << "\t";
-		file << test_counter << "\n";
-	    }
-
-	    file.close();
-
-	    chdir("..");
-	}
-
+	std::pair<std::map<EndPoint, Params>::iterator, bool> inserted =
+	    EndpointParams.insert(std::make_pair(Data_it->first, Params()));
+	W->params = &inserted.first->second;
+	W->isNew = inserted.second;
+	if (inserted.second && cusum_soa_backend)
+	    W->params->cusum_slot = cusumEngine.addSlot();
+	work.push_back(W);
 	Data_it++;
     }
 
+    process_endpoints(work, &Stat::update_endpoint);
+
+    // the values given to the CUSUM engine by cusum_update() are
+    // applied to all endpoints at once
+    if (cusum_soa_backend)
+	cusumEngine.update();
+
     // 1.5) MAP PRINTING (OPTIONAL, DEPENDS ON VERBOSITY SETTINGS)
 
     // how many endpoints do we already monitor?
@@ -1165,6 +1117,8 @@ void Stat::test(StatStore * store) {
 	    if (enable_cusum_test == true) {
 		std::stringstream tmp;
 		if(logStr.getLogLevel() >= MsgStream::INFO) {
+		    if (cusum_soa_backend)
+			get_cusum_state(EndpointParams_it->second);
 		    logStr << MsgStream::raw << MsgStream::INFO << " (CUSUM):\n" << "   mean: ";
 		    for (int i = 0; i != (EndpointParams_it->second).mean.size(); i++)
 			logStr << (EndpointParams_it->second).mean.at(i) << " ";
@@ -1207,18 +1161,20 @@ void Stat::test(StatStore * store) {
 
 	std::map<EndPoint,Params>::iterator EndpointParams_it = EndpointParams.begin();
 	while (EndpointParams_it != EndpointParams.end()) {
-	    if ( enable_wkp_test == true && ((EndpointParams_it->second).New).size() == sample_new_size ) {
-		// i.e. learning phase over
-		logStr.rawPrint(MsgStream::FATAL, "\n#### WKP TESTS for EndPoint [[ " + EndpointParams_it->first.toString() + " ]]");
-		wkp_test ( EndpointParams_it->second );
-	    }
-	    if ( enable_cusum_test == true && (EndpointParams_it->second).ready_to_test == true ) {
-		// i.e. learning phase for cusum is over and it has an initial value
-		logStr.rawPrint(MsgStream::FATAL, "\n#### CUSUM TESTS for EndPoint [[ " + EndpointParams_it->first.toString() + " ]]");
-		cusum_test ( EndpointParams_it->second );
-	    }
+	    EndpointWork * W = new EndpointWork;
+	    W->endPoint = &EndpointParams_it->first;
+	    W->info = NULL;
+	    W->params = &EndpointParams_it->second;
+	    W->isNew = false;
+	    work.push_back(W);
 	    EndpointParams_it++;
 	}
+
+	// N, beta and g of all endpoints, cusum_test() only reads them
+	if (cusum_soa_backend)
+	    cusumEngine.test();
+
+	process_endpoints(work, &Stat::test_endpoint);
     }
 
     test_counter++;
@@ -1232,6 +1188,267 @@ void Stat::test(StatStore * store) {
 
 // =================== FUNCTIONS USED BY THE TEST FUNCTION ====================
 
+// learn/update phase for a single endpoint (see test())
+void Stat::update_endpoint(EndpointWork & W) {
+
+    MsgStream & logOut = *W.logOut;
+
+    logOut << MsgStream::raw << MsgStream::WARN << "[[ " << W.endPoint->toString() << " ]]" << MsgStream::endl;
+
+    std::vector<int64_t> metric_data;
+    std::vector<int64_t> pca_metric_data;
+
+    if (W.isNew == true) {
+	// The EndPoint was just added to "EndpointParams" by test()
+
+	// Initialization
+	Params & P = *W.params;
+	P.correspondingEndPoint = W.endPoint->toString();
+	if (enable_wkp_test == true) {
+	    for (int i=0; i < metrics.size(); i++) {
+		(P.last_wmw_test_was_attack).push_back(false);
+		(P.last_ks_test_was_attack).push_back(false);
+		(P.last_pcs_test_was_attack).push_back(false);
+		(P.wmw_alarms).push_back(0);
+		(P.ks_alarms).push_back(0);
+		(P.pcs_alarms).push_back(0);
+	    }
+	}
+	if (enable_cusum_test == true) {
+	    for (int i = 0; i != metrics.size(); i++) {
+		(P.mean).push_back(0);
+		(P.variance).push_back(0.0);
+		(P.N).push_back(0);
+		(P.beta).push_back(0.0);
+		(P.g).push_back(0.0);
+		(P.last_cusum_test_was_attack).push_back(false);
+		(P.X_curr).push_back(0);
+		(P.cusum_alarms).push_back(0);
+	    }
+	}
+
+	logOut.rawPrint(MsgStream::WARN , "Add as new monitored endpoint");
+	if (use_pca == true) {
+	    // initialize PCA parameters
+	    P.init(metrics.size());
+	    pca_metric_data = extract_pca_data(P, *W.info, W.prev);
+	}
+	else {
+	    metric_data = extract_data(*W.info, W.prev);
+	    if (enable_wkp_test == true) {
+		P.pushOld(metric_data);
+		if(logOut.getLogLevel() >= MsgStream::INFO) {
+		    std::stringstream tmp;
+		    tmp << "  (WKP): with first element of sample_old: " << metric_data;
+		    logOut.rawPrint(MsgStream::INFO, tmp.str());
+		}
+	    }
+	    if (enable_cusum_test == true) {
+		// add first value of each metric to the sum, which is needed
+		// only to calculate the initial mean and variance after cusum_learning_phase
+		// is over
+		for (int i = 0; i != metric_data.size(); i++) {
+		    P.mean.at(i) = metric_data.at(i);
+		    P.variance.at(i) = metric_data.at(i) * metric_data.at(i);
+		}
+		P.cusum_learning_phase_nr = 1;
+		logOut.rawPrint(MsgStream::WARN, "  (CUSUM): with initial values for mean and variance of metrics.");
+	    }
+	}
+    }
+    else {
+	// We found the recorded EndPoint in our container
+	// "EndpointParams"; so we update the data
+	Params & P = *W.params;
+	if (use_pca == true) {
+	    pca_metric_data = extract_pca_data(P, *W.info, W.prev);
+	    // Updates for pca metrics have to wait for the pca learning phase
+	    // needed to calculate the eigenvectors
+	    // NOTE: The overall learning phases for the tests will thus sum up to
+	    // WKP: learning_phase_pca + learning_phase_samples
+	    // Cusum: learning_phase_pca + cusum_learning_phase
+	    if (P.pca_ready == false)
+		logOut.rawPrint(MsgStream::WARN, "Learning phase for PCA ...");
+	    // this case happens exactly one time: when PCA is ready for the first time
+	    else if (P.pca_ready == true && pca_metric_data.empty() == true) {
+		logOut.rawPrint(MsgStream::WARN, "PCA learning phase is over! PCA is now ready!");
+		if (logOut.getLogLevel() == MsgStream::DEBUG) {
+		    logOut << MsgStream::raw << MsgStream::DEBUG 
+			<< "Calculated " << ((use_correlation_matrix == true)?"correlation matrix:":"covariance matrix:\n");
+		    for (int i = 0; i < metrics.size(); i++) {
+			for (int j = 0; j < metrics.size(); j++)
+			    logOut << gsl_matrix_get(P.cov,i,j) << "\t";
+			logOut << "\n";
+		    }
+		    logOut << MsgStream::endl;
+		}
+	    }
+	    else {
+		if (enable_wkp_test == true)
+		    wkp_update ( W, pca_metric_data );
+		if (enable_cusum_test == true)
+		    cusum_update ( W, pca_metric_data );
+	    }
+	}
+	else {
+	    metric_data = extract_data(*W.info, W.prev);
+	    if (enable_wkp_test == true)
+		wkp_update ( W, metric_data );
+	    if (enable_cusum_test == true)
+		cusum_update ( W, metric_data );
+	}
+    }
+
+    // Create metric files, if wished so
+    // (this can be done here, because metrics are the same for both tests)
+    // in case of pca: don't create file until learning phase is over
+    if ((createFiles == true) && ((use_pca == false) || (pca_metric_data.size() > 0))) {
+
+	std::string fname;
+
+	fname = W.endPoint->toString() + "_metrics.txt";
+
+	std::ofstream file((output_dir + "/" + fname).c_str(),std::ios_base::app);
+
+	// are we at the beginning of the file?
+	// if yes, write the metric names to the file ...
+	long pos;
+	pos = file.tellp();
+
+	if (use_pca == true) {
+	    if (pos == 0) {
+		file << "# ";
+		for (int i = 0; i < pca_metric_data.size(); i++)
+		    file << "pca_comp_" << i << "\t";
+		file << "Test-Run" << "\n";
+	    }
+	    for (int i = 0; i < pca_metric_data.size(); i++)
+		file << pca_metric_data.at(i) << "\t";
+	    file << test_counter << "\n";
+	}
+	else {
+	    if (pos == 0) {
+		file << "# ";
+		for(std::vector<MetricData>::iterator val = metrics.begin(); val != metrics.end(); val++)
+		    file << val->name << "\t";
+		file << "Test-Run" << "\n";
+	    }
+	    for (int i = 0; i < metric_data.size(); i++)
+		file << metric_data.at(i) << "\t";
+	    file << test_counter << "\n";
+	}
+
+	file.close();
+    }
+
+}
+
+// statistical tests for a single endpoint (see test())
+void Stat::test_endpoint(EndpointWork & W) {
+
+    Params & P = *W.params;
+    MsgStream & logOut = *W.logOut;
+
+    if ( enable_wkp_test == true && (P.New).size() == sample_new_size ) {
+	// i.e. learning phase over
+	logOut.rawPrint(MsgStream::FATAL, "\n#### WKP TESTS for EndPoint [[ " + W.endPoint->toString() + " ]]");
+	wkp_test ( W );
+    }
+    if ( enable_cusum_test == true && P.ready_to_test == true ) {
+	// i.e. learning phase for cusum is over and it has an initial value
+	logOut.rawPrint(MsgStream::FATAL, "\n#### CUSUM TESTS for EndPoint [[ " + W.endPoint->toString() + " ]]");
+	cusum_test ( W );
+    }
+
+}
+
+// arguments of the worker threads of process_endpoints()
+struct Stat::WorkerArgs {
+    Stat * stat;
+    std::vector<EndpointWork *> * work;
+    EndpointFunction function;
+    unsigned next; // next work item to process
+};
+
+void * Stat::worker_thread(void * arg) {
+
+    WorkerArgs * args = (WorkerArgs *) arg;
+    unsigned i;
+
+    // work items are handed out one by one, as the amount of work
+    // differs a lot between endpoints (learning phases, PCA)
+    while ((i = __sync_fetch_and_add(&args->next, 1)) < args->work->size())
+	(args->stat->*(args->function))(*(*args->work)[i]);
+
+    return NULL;
+}
+
+void Stat::process_endpoints(std::vector<EndpointWork *> & work, EndpointFunction function) {
+
+    // the details of the tests (log level DEBUG) are written directly
+    // into the logfile, so they require the serial mode
+    unsigned threads = worker_threads;
+    if (logStr.getLogLevel() == MsgStream::DEBUG)
+	threads = 1;
+    if (threads > work.size())
+	threads = work.size();
+
+    for (unsigned i = 0; i < work.size(); i++) {
+	if (threads > 1) {
+	    work[i]->logBuffer = new MsgStream;
+	    work[i]->msgBuffer = new MsgStream;
+	    work[i]->logBuffer->bufferFor(logStr);
+	    work[i]->msgBuffer->bufferFor(msgStr);
+	    work[i]->logOut = work[i]->logBuffer;
+	    work[i]->msgOut = work[i]->msgBuffer;
+	}
+	else {
+	    work[i]->logOut = &logStr;
+	    work[i]->msgOut = &msgStr;
+	}
+    }
+
+    if (threads > 1) {
+	WorkerArgs args;
+	args.stat = this;
+	args.work = &work;
+	args.function = function;
+	args.next = 0;
+
+	// the calling thread is one of the workers
+	std::vector<pthread_t> ids(threads - 1);
+	unsigned started = 0;
+	while (started < ids.size() && pthread_create(&ids[started], NULL, worker_thread, &args) == 0)
+	    started++;
+	if (started < ids.size())
+	    msgStr << MsgStream::WARN << "Could only start " << started + 1 << " of " << threads << " worker threads" << MsgStream::endl;
+	worker_thread(&args);
+	for (unsigned i = 0; i < started; i++)
+	    pthread_join(ids[i], NULL);
+    }
+    else {
+	for (unsigned i = 0; i < work.size(); i++)
+	    (this->*function)(*work[i]);
+    }
+
+    // output and alerts in the order of the endpoints
+    for (unsigned i = 0; i < work.size(); i++) {
+	if (threads > 1) {
+	    work[i]->logBuffer->flushTo(logStr);
+	    work[i]->msgBuffer->flushTo(msgStr);
+	}
+#ifdef IDMEF_SUPPORT_ENABLED
+	for (unsigned j = 0; j < work[i]->alerts.size(); j++) {
+	    idmefMessage.setAnalyzerAttr("", "", work[i]->alerts[j], "");
+	    sendIdmefMessage("DDoS", idmefMessage);
+	    idmefMessage = getNewIdmefMessage();
+	}
+#endif
+	delete work[i];
+    }
+    work.clear();
+}
+
 // calculates the desired metric and returns true on success
 int64_t Stat::get_metric (const Info & info, Metric m)
 {
@@ -1543,31 +1760,35 @@ std::vector<int64_t> Stat::extract_pca_data (Params & P, const Info & info, cons
 
 // learn/update function for samples (called everytime test() is called)
 //
-void Stat::wkp_update ( Params & P, const std::vector<int64_t> & new_value ) {
+void Stat::wkp_update ( EndpointWork & W, const std::vector<int64_t> & new_value ) {
+
+    Params & P = *W.params;
+    MsgStream & logOut = *W.logOut;
+
 
     // Learning phase?
     if (P.Old.size() != sample_old_size) {
 
-	P.Old.push_back(new_value);
+	P.pushOld(new_value);
 
-	logStr.rawPrint(MsgStream::WARN, "  (WKP): Learning phase for sample_old ...");
-	if((unsigned)logStr.getLogLevel() >= (unsigned)MsgStream::INFO) {
+	logOut.rawPrint(MsgStream::WARN, "  (WKP): Learning phase for sample_old ...");
+	if((unsigned)logOut.getLogLevel() >= (unsigned)MsgStream::INFO) {
 	    std::stringstream tmp;
 	    tmp << "   sample_old: " << P.Old << "\n   sample_new: " << P.New;
-	    logStr.rawPrint(MsgStream::INFO, tmp.str());
+	    logOut.rawPrint(MsgStream::INFO, tmp.str());
 	}
 
 	return;
     }
     else if (P.New.size() != sample_new_size) {
 
-	P.New.push_back(new_value);
+	P.pushNew(new_value);
 
-	logStr.rawPrint(MsgStream::WARN, "  (WKP): Learning phase for sample_new...");
-	if((unsigned)logStr.getLogLevel() >= (unsigned)MsgStream::INFO) {
+	logOut.rawPrint(MsgStream::WARN, "  (WKP): Learning phase for sample_new...");
+	if((unsigned)logOut.getLogLevel() >= (unsigned)MsgStream::INFO) {
 	    std::stringstream tmp;
 	    tmp << "   sample_old: " << P.Old << "\n   sample_new: " << P.New;
-	    logStr.rawPrint(MsgStream::INFO, tmp.str());
+	    logOut.rawPrint(MsgStream::INFO, tmp.str());
 	}
 
 	return;
@@ -1611,29 +1832,29 @@ void Stat::wkp_update ( Params & P, const std::vector<int64_t> & new_value ) {
 		    && at_least_one_ks_test_was_attack  == true
 		    && at_least_one_pcs_test_was_attack == true )) ) {
 
-	P.New.pop_front();
-	P.New.push_back(new_value);
+	P.popNew();
+	P.pushNew(new_value);
 
-	logStr.rawPrint(MsgStream::WARN, "  (WKP): Update done (for new sample only)");
-	if((unsigned)logStr.getLogLevel() >= (unsigned)MsgStream::INFO) {
+	logOut.rawPrint(MsgStream::WARN, "  (WKP): Update done (for new sample only)");
+	if((unsigned)logOut.getLogLevel() >= (unsigned)MsgStream::INFO) {
 	    std::stringstream tmp;
 	    tmp << "   sample_old: " << P.Old << "\n   sample_new: " << P.New;
-	    logStr.rawPrint(MsgStream::INFO, tmp.str());
+	    logOut.rawPrint(MsgStream::INFO, tmp.str());
 	}
     }
     // if parameter is 0 (or 3) or there was no attack detected
     // update both samples
     else {
-	P.Old.pop_front();
-	P.Old.push_back(P.New.front());
-	P.New.pop_front();
-	P.New.push_back(new_value);
+	P.popOld();
+	P.pushOld(P.New.front());
+	P.popNew();
+	P.pushNew(new_value);
 
-	logStr.rawPrint(MsgStream::WARN, "  (WKP): Update done (for both samples)");
-	if((unsigned)logStr.getLogLevel() >= (unsigned)MsgStream::INFO) {
+	logOut.rawPrint(MsgStream::WARN, "  (WKP): Update done (for both samples)");
+	if((unsigned)logOut.getLogLevel() >= (unsigned)MsgStream::INFO) {
 	    std::stringstream tmp;
 	    tmp << "   sample_old: " << P.Old << "\n   sample_new: " << P.New;
-	    logStr.rawPrint(MsgStream::INFO, tmp.str());
+	    logOut.rawPrint(MsgStream::INFO, tmp.str());
 	}
     }
 
@@ -1644,7 +1865,11 @@ void Stat::wkp_update ( Params & P, const std::vector<int64_t> & new_value ) {
 
 
 // and the update function for the cusum-test
-void Stat::cusum_update ( Params & P, const std::vector<int64_t> & new_value ) {
+void Stat::cusum_update ( EndpointWork & W, const std::vector<int64_t> & new_value ) {
+
+    Params & P = *W.params;
+    MsgStream & logOut = *W.logOut;
+
 
     // getting here means that we received data for this endpoint and apply the necessary updates for cusum
     P.cusum_updated = true;
@@ -1661,7 +1886,7 @@ void Stat::cusum_update ( Params & P, const std::vector<int64_t> & new_value ) {
 		P.variance.at(i) += new_value.at(i)*new_value.at(i);
 	    }
 
-	    logStr.rawPrint(MsgStream::WARN, "  (CUSUM): Learning phase for mean and variance ...");
+	    logOut.rawPrint(MsgStream::WARN, "  (CUSUM): Learning phase for mean and variance ...");
 
 	    P.cusum_learning_phase_nr++;
 
@@ -1672,18 +1897,20 @@ void Stat::cusum_update ( Params & P, const std::vector<int64_t> & new_value ) {
 	// and set ready_to_test-flag to true (so we never visit this
 	// code here again for the current endpoint)
 
-	logStr.rawPrint(MsgStream::WARN, "  (CUSUM): Learning phase for mean and variance is over.");
-	logStr.rawPrint(MsgStream::INFO, "   Calculated initial mean and standard deviation values:");
+	logOut.rawPrint(MsgStream::WARN, "  (CUSUM): Learning phase for mean and variance is over.");
+	logOut.rawPrint(MsgStream::INFO, "   Calculated initial mean and standard deviation values:");
 
 	for (int i = 0; i != P.mean.size(); i++) {
 	    // calculate initial mean and variance from sum and sum of squares
 	    P.mean.at(i) = P.mean.at(i) / cusum_learning_phase;
 	    P.variance.at(i) = (P.variance.at(i) - (P.mean.at(i)*P.mean.at(i))/cusum_learning_phase)/(cusum_learning_phase-1);
 	    P.X_curr.at(i) = new_value.at(i);
-	    logStr << MsgStream::raw << MsgStream::INFO << P.mean.at(i) << "," << sqrt(P.variance.at(i)) << MsgStream::endl;
+	    logOut << MsgStream::raw << MsgStream::INFO << P.mean.at(i) << "," << sqrt(P.variance.at(i)) << MsgStream::endl;
 	}
 
 	P.ready_to_test = true;
+	if (P.cusum_slot >= 0)
+	    cusumEngine.start(P.cusum_slot, P.mean, P.variance, new_value);
 	return;
     }
 
@@ -1698,62 +1925,80 @@ void Stat::cusum_update ( Params & P, const std::vector<int64_t> & new_value ) {
 	if (P.last_cusum_test_was_attack.at(i) == false)
 	    all_tests_were_attacks = false;
 
+    // which metrics get their mean and variance updated
+    std::vector<bool> update_metric(P.mean.size(), true);
+    bool paused = false;
+
     // pause, if at least one metric yielded an alarm
     if ( pause_update_when_attack == 1
 	    && at_least_one_test_was_attack == true) {
-	logStr.rawPrint(MsgStream::WARN, "  (CUSUM): Pausing update for mean and variance (at least one test was attack)");
-	// update values for X
-	for (int i = 0; i != P.X_curr.size(); i++) {
-	    P.X_curr.at(i) = new_value.at(i);
-	}
-	return;
+	logOut.rawPrint(MsgStream::WARN, "  (CUSUM): Pausing update for mean and variance (at least one test was attack)");
+	update_metric.assign(P.mean.size(), false);
+	paused = true;
     }
     // pause, if all metrics yielded an alarm
     else if ( pause_update_when_attack == 2
 	    && all_tests_were_attacks == true) {
-	logStr.rawPrint(MsgStream::WARN, "  (CUSUM): Pausing update for mean and variance (all tests were attacks)");
-	// update values for X
-	for (int i = 0; i != P.X_curr.size(); i++) {
-	    P.X_curr.at(i) = new_value.at(i);
-	}
-	return;
+	logOut.rawPrint(MsgStream::WARN, "  (CUSUM): Pausing update for mean and variance (all tests were attacks)");
+	update_metric.assign(P.mean.size(), false);
+	paused = true;
     }
     // pause for those metrics, which yielded an alarm
     // and update only the others
     else if (pause_update_when_attack == 3
 	    && at_least_one_test_was_attack == true) {
-	logStr.rawPrint(MsgStream::WARN, "  (CUSUM): Pausing update for mean and variance (for those metrics which were attacks)");
+	logOut.rawPrint(MsgStream::WARN, "  (CUSUM): Pausing update for mean and variance (for those metrics which were attacks)");
+	for (int i = 0; i != P.mean.size(); i++)
+	    update_metric.at(i) = (P.last_cusum_test_was_attack.at(i) == false);
+    }
+    // Otherwise update all mean and variance per EWMA
+    else {
+	logOut.rawPrint(MsgStream::WARN, "  (CUSUM): Update mean and variance for all metrics");
+    }
+
+    // with the SoA backend, the update is done for all endpoints
+    // together by cusumEngine.update() (see test()); for the output,
+    // the new mean and variance of this endpoint are computed here
+    if (P.cusum_slot >= 0) {
 	for (int i = 0; i != P.mean.size(); i++) {
-	    if (P.last_cusum_test_was_attack.at(i) == false) {
-		// update mean and variance with X value from last time
-		P.mean.at(i) = P.mean.at(i) * (1 - smoothing_constant) + P.X_curr.at(i) * smoothing_constant;
-		if(log_variance_ewma)
-		    P.variance.at(i) = exp(log(P.variance.at(i)) * (1 - smoothing_constant) + log((P.X_curr.at(i) - P.mean.at(i))*(P.X_curr.at(i) - P.mean.at(i))) * smoothing_constant);
-		else
-		    P.variance.at(i) = P.variance.at(i) * (1 - smoothing_constant) + (P.X_curr.at(i) - P.mean.at(i))*(P.X_curr.at(i) - P.mean.at(i)) * smoothing_constant;
+	    if(!paused && logOut.getLogLevel() >= MsgStream::INFO) {
+		P.mean.at(i) = cusumEngine.getMean(i, P.cusum_slot);
+		P.variance.at(i) = cusumEngine.getVariance(i, P.cusum_slot);
+		if (update_metric.at(i) == true)
+		    cusum_ewma(P.mean.at(i), P.variance.at(i), (int)cusumEngine.getValue(i, P.cusum_slot),
+			       smoothing_constant, log_variance_ewma);
 	    }
-	    // update value for X
-	    P.X_curr.at(i) = new_value.at(i);
+	    cusumEngine.setValue(P.cusum_slot, i, new_value.at(i), update_metric.at(i));
 	}
     }
-    // Otherwise update all mean and variance per EWMA
     else {
-	logStr.rawPrint(MsgStream::WARN, "  (CUSUM): Update mean and variance for all metrics");
 	for (int i = 0; i != P.mean.size(); i++) {
 	    // update mean and variance with X value from last time
-	    P.mean.at(i) = P.mean.at(i) * (1 - smoothing_constant) + P.X_curr.at(i) * smoothing_constant;
-	    if(log_variance_ewma)
-		P.variance.at(i) = exp(log(P.variance.at(i)) * (1 - smoothing_constant) + log((P.X_curr.at(i) - P.mean.at(i))*(P.X_curr.at(i) - P.mean.at(i))) * smoothing_constant);
-	    else
-		P.variance.at(i) = P.variance.at(i) * (1 - smoothing_constant) + (P.X_curr.at(i) - P.mean.at(i))*(P.X_curr.at(i) - P.mean.at(i)) * smoothing_constant;
+	    if (update_metric.at(i) == true)
+		cusum_ewma(P.mean.at(i), P.variance.at(i), P.X_curr.at(i),
+			   smoothing_constant, log_variance_ewma);
 	    // update value for X
 	    P.X_curr.at(i) = new_value.at(i);
 	}
     }
 
-    if(logStr.getLogLevel() >= MsgStream::INFO) {
+    if(!paused && logOut.getLogLevel() >= MsgStream::INFO) {
 	for (int i = 0; i != P.mean.size(); i++)
-	    logStr << MsgStream::raw << MsgStream::INFO << P.mean.at(i) << ", " << sqrt(P.variance.at(i)) << MsgStream::endl;
+	    logOut << MsgStream::raw << MsgStream::INFO << P.mean.at(i) << ", " << sqrt(P.variance.at(i)) << MsgStream::endl;
+    }
+}
+
+// copies the CUSUM state of an endpoint from the SoA backend to its Params
+void Stat::get_cusum_state(Params & P) {
+
+    if (P.cusum_slot < 0)
+	return;
+
+    for (int i = 0; i != P.mean.size(); i++) {
+	P.mean.at(i) = cusumEngine.getMean(i, P.cusum_slot);
+	P.variance.at(i) = cusumEngine.getVariance(i, P.cusum_slot);
+	P.g.at(i) = cusumEngine.getG(i, P.cusum_slot);
+	P.X_curr.at(i) = (int)cusumEngine.getValue(i, P.cusum_slot);
     }
 }
 
@@ -1761,11 +2006,11 @@ void Stat::cusum_update ( Params & P, const std::vector<int64_t> & new_value ) {
 
 // statistical test function for wkp-tests
 // (optional, depending on how often the user wishes to do it)
-void Stat::wkp_test (Params & P) {
+void Stat::wkp_test (EndpointWork & W) {
+
+    Params & P = *W.params;
+    MsgStream & logOut = *W.logOut;
 
-    // Containers for the values of single metrics
-    std::list<int64_t> sample_old_single_metric;
-    std::list<int64_t> sample_new_single_metric;
 
     std::vector<MetricData>::iterator it = metrics.begin();
 
@@ -1783,22 +2028,23 @@ void Stat::wkp_test (Params & P) {
 	    metricstr = it->name;
 	}
 
-	logStr << MsgStream::raw << MsgStream::WARN << "### Performing WKP-Tests for " << metricstr << ":" << MsgStream::endl;
+	logOut << MsgStream::raw << MsgStream::WARN << "### Performing WKP-Tests for " << metricstr << ":" << MsgStream::endl;
 
 	// storing the last-test flags
 	bool tmp_wmw = P.last_wmw_test_was_attack.at(index);
 	bool tmp_ks = P.last_ks_test_was_attack.at(index);
 	bool tmp_pcs = P.last_pcs_test_was_attack.at(index);
 
-	sample_old_single_metric = getSingleMetric(P.Old, index);
-	sample_new_single_metric = getSingleMetric(P.New, index);
+	// sorted samples of this metric
+	const std::multiset<int64_t> & sample_old_single_metric = P.OldSorted.at(index);
+	const std::multiset<int64_t> & sample_new_single_metric = P.NewSorted.at(index);
 
 	double p_wmw, p_ks, p_pcs;
 	p_wmw = p_ks = p_pcs = 1.0;
 
 	// Wilcoxon-Mann-Whitney test:
 	if (enable_wmw_test == true && P.wkp_updated) {
-	    p_wmw = stat_test_wmw(sample_old_single_metric, sample_new_single_metric, tmp_wmw, metricstr);
+	    p_wmw = stat_test_wmw(W, sample_old_single_metric, sample_new_single_metric, tmp_wmw, metricstr);
 	    // New anomaly?
 	    if (significance_level > p_wmw && (report_only_first_attack == false || P.last_wmw_test_was_attack.at(index) == false))
 		(P.wmw_alarms).at(index)++;
@@ -1807,7 +2053,7 @@ void Stat::wkp_test (Params & P) {
 
 	// Kolmogorov-Smirnov test:
 	if (enable_ks_test == true && P.wkp_updated) {
-	    p_ks = stat_test_ks (sample_old_single_metric, sample_new_single_metric, tmp_ks, metricstr);
+	    p_ks = stat_test_ks (W, sample_old_single_metric, sample_new_single_metric, tmp_ks, metricstr);
 	    if (significance_level > p_ks && (report_only_first_attack == false || P.last_ks_test_was_attack.at(index) == false))
 		(P.ks_alarms).at(index)++;
 	    P.last_ks_test_was_attack.at(index) = tmp_ks;
@@ -1815,7 +2061,7 @@ void Stat::wkp_test (Params & P) {
 
 	// Pearson chi-square test:
 	if (enable_pcs_test == true && P.wkp_updated) {
-	    p_pcs = stat_test_pcs(sample_old_single_metric, sample_new_single_metric, tmp_pcs, metricstr);
+	    p_pcs = stat_test_pcs(W, sample_old_single_metric, sample_new_single_metric, tmp_pcs, metricstr);
 	    if (significance_level > p_pcs && (report_only_first_attack == false || P.last_pcs_test_was_attack.at(index) == false))
 		(P.pcs_alarms).at(index)++;
 	    P.last_pcs_test_was_attack.at(index) = tmp_pcs;
@@ -1833,9 +2079,7 @@ void Stat::wkp_test (Params & P) {
 	    std::string filename;
 	    filename = P.correspondingEndPoint + "." + metricstr + ".wkpparams.txt";
 
-	    chdir(output_dir.c_str());
-
-	    std::ofstream file(filename.c_str(), std::ios_base::app);
+	    std::ofstream file((output_dir + "/" + filename).c_str(), std::ios_base::app);
 
 	    // are we at the beginning of the file?
 	    // if yes, write the param names to the file ...
@@ -1849,7 +2093,7 @@ void Stat::wkp_test (Params & P) {
 	    // metric p-value(wmw) #alarms(wmw) p-value(ks) #alarms(ks)
 	    // p-value(pcs) #alarms(pcs) counter
 	    if(P.wkp_updated) {
-		file << sample_new_single_metric.back() << "\t" << p_wmw << "\t"
+		file << P.New.back().at(index) << "\t" << p_wmw << "\t"
 		    << (P.wmw_alarms).at(index) << "\t" << p_ks << "\t"
 		    << (P.ks_alarms).at(index) << "\t" << p_pcs << "\t"
 		    << (P.pcs_alarms).at(index) << "\t" << significance_level << "\t"
@@ -1864,7 +2108,6 @@ void Stat::wkp_test (Params & P) {
 	    }
 
 	    file.close();
-	    chdir("..");
 	}
 
 	it++;
@@ -1878,7 +2121,12 @@ void Stat::wkp_test (Params & P) {
 
 // statistical test function / cusum-test
 // (optional, depending on how often the user wishes to do it)
-void Stat::cusum_test(Params & P) {
+void Stat::cusum_test(EndpointWork & W) {
+
+    Params & P = *W.params;
+    MsgStream & logOut = *W.logOut;
+    MsgStream & msgOut = *W.msgOut;
+
 
     // we have to store, for which metrics an attack was detected and set
     // the corresponding last_cusum_test_was_attack-flags to true/false
@@ -1895,6 +2143,12 @@ void Stat::cusum_test(Params & P) {
 
     std::string metricstr;
 
+    // with the SoA backend, N, beta and g were already computed by
+    // cusumEngine.test() (see test())
+    bool soa = (P.cusum_slot >= 0);
+    if (soa)
+	get_cusum_state(P);
+
     for (std::vector<MetricData>::iterator it = metrics.begin(); it != metrics.end(); it++) {
 
 	if(use_pca) {
@@ -1905,13 +2159,19 @@ void Stat::cusum_test(Params & P) {
 	    metricstr = it->name;
 	}
 
-	logStr << MsgStream::raw << MsgStream::WARN << "### Performing CUSUM-Test for " << metricstr << ":" << MsgStream::endl;
+	logOut << MsgStream::raw << MsgStream::WARN << "### Performing CUSUM-Test for " << metricstr << ":" << MsgStream::endl;
 
 	// Calculate N and beta
-	N = repetition_factor * (amplitude_percentage * sqrt(P.variance.at(i)) / 2.0);
-	beta = P.mean.at(i) + (amplitude_percentage * sqrt(P.variance.at(i)) / 2.0);
+	if (soa) {
+	    N = cusumEngine.getN(i, P.cusum_slot);
+	    beta = cusumEngine.getBeta(i, P.cusum_slot);
+	}
+	else {
+	    N = repetition_factor * (amplitude_percentage * sqrt(P.variance.at(i)) / 2.0);
+	    beta = P.mean.at(i) + (amplitude_percentage * sqrt(P.variance.at(i)) / 2.0);
+	}
 
-	logStr << MsgStream::raw << MsgStream::DEBUG << " Cusum test returned:\n"
+	logOut << MsgStream::raw << MsgStream::DEBUG << " Cusum test returned:\n"
 	    << "  Threshold: " << N << "\n"
 	    << "  reject H0 (no attack) if current value of statistic g > " << N << MsgStream::endl;
 
@@ -1919,31 +2179,28 @@ void Stat::cusum_test(Params & P) {
 	// "attack still in progress"-message?
 
 	// perform the test and if g > N raise an alarm
-	if ( P.cusum_updated && ((P.g.at(i) = cusum(P.X_curr.at(i), beta, P.g.at(i))) > N )) {
+	if ( soa ? cusumEngine.attack(i, P.cusum_slot) :
+		(P.cusum_updated && ((P.g.at(i) = cusum(P.X_curr.at(i), beta, P.g.at(i))) > N ))) {
 
 	    if (report_only_first_attack == false
 		    || P.last_cusum_test_was_attack.at(i) == false) {
 
 		(P.cusum_alarms).at(i)++;
 
-		logStr << MsgStream::raw << MsgStream::FATAL << "cusum: attack for " << metricstr << " detected!" << MsgStream::endl;
-		logStr << MsgStream::raw << MsgStream::ERROR
+		logOut << MsgStream::raw << MsgStream::FATAL << "cusum: attack for " << metricstr << " detected!" << MsgStream::endl;
+		logOut << MsgStream::raw << MsgStream::ERROR
 		    << "Test counter: " << test_counter << "\n"
 		    << "g = " << P.g.at(i) << "\n"
 		    << "N = " << N << MsgStream::endl;
-		msgStr << MsgStream::INFO << "cusum: attack for " << metricstr << " detected!" << MsgStream::endl;
+		msgOut << MsgStream::INFO << "cusum: attack for " << metricstr << " detected!" << MsgStream::endl;
 
-#ifdef IDMEF_SUPPORT_ENABLED
-		idmefMessage.setAnalyzerAttr("", "", "cusum-test", "");
-		sendIdmefMessage("DDoS", idmefMessage);
-		idmefMessage = getNewIdmefMessage();
-#endif
+		W.alerts.push_back("cusum-test");
 	    }
 
 	    was_attack.at(i) = true;
 
 	}
-	else if (!P.cusum_updated) // reset g to 0 if no new value for that Endpoint occurred
+	else if (!P.cusum_updated && !soa) // reset g to 0 if no new value for that Endpoint occurred
 	    P.g.at(i) = 0;
 
 	if (createFiles == true) {
@@ -1951,9 +2208,7 @@ void Stat::cusum_test(Params & P) {
 	    std::string filename;
 	    filename = P.correspondingEndPoint  + "." + metricstr + ".cusumparams.txt";
 
-	    chdir(output_dir.c_str());
-
-	    std::ofstream file(filename.c_str(), std::ios_base::app);
+	    std::ofstream file((output_dir + "/" + filename).c_str(), std::ios_base::app);
 
 	    // are we at the beginning of the file?
 	    // if yes, write the param names to the file ...
@@ -1976,7 +2231,6 @@ void Stat::cusum_test(Params & P) {
 		    << "\t" << (P.cusum_alarms).at(i) << "\t" << test_counter << "\n";
 	    }
 	    file.close();
-	    chdir("..");
 	}
 
 	i++;
@@ -2000,31 +2254,23 @@ void Stat::cusum_test(Params & P) {
 }
 
 // functions called by the wkp_test()-function
-std::list<int64_t> Stat::getSingleMetric(const std::list<std::vector<int64_t> > & l, const short & i) {
-    std::list<int64_t> result;
-    std::list<std::vector<int64_t> >::const_iterator it = l.begin();
-    while ( it != l.end() ) {
-	result.push_back(it->at(i));
-	it++;
-    }
-    return result;
-}
-
+double Stat::stat_test_wmw (EndpointWork & W, const std::multiset<int64_t> & sample_old,
+	const std::multiset<int64_t> & sample_new, bool & last_wmw_test_was_attack, std::string metric) {
 
-double Stat::stat_test_wmw (std::list<int64_t> & sample_old,
-	std::list<int64_t> & sample_new, bool & last_wmw_test_was_attack, std::string metric) {
+    MsgStream & logOut = *W.logOut;
+    MsgStream & msgOut = *W.msgOut;
 
     double p;
 
-    if (logStr.getLogLevel() == MsgStream::DEBUG) {
-	logStr.rawPrint(MsgStream::DEBUG, " Wilcoxon-Mann-Whitney test details:");
-	p = wmw_test(sample_old, sample_new, wmw_two_sided, logStr.getLogfile());
-	logStr << MsgStream::raw << MsgStream::DEBUG << " Wilcoxon-Mann-Whitney test returned\n"
+    if (logOut.getLogLevel() == MsgStream::DEBUG) {
+	logOut.rawPrint(MsgStream::DEBUG, " Wilcoxon-Mann-Whitney test details:");
+	p = wmw_test(sample_old, sample_new, wmw_two_sided, logOut.getLogfile());
+	logOut << MsgStream::raw << MsgStream::DEBUG << " Wilcoxon-Mann-Whitney test returned\n"
 	    << "  p-value: " << p << "\n"
 	    << "  reject H0 (no attack) to any significance level alpha > " << p << MsgStream::endl;
     }
     else {
-	std::ofstream dump("/dev/null");
+	std::ofstream dump; // not opened, no output
 	p = wmw_test(sample_old, sample_new, wmw_two_sided, dump);
     }
 
@@ -2032,15 +2278,11 @@ double Stat::stat_test_wmw (std::list<int64_t> & sample_old,
     if (significance_level > p) {
 	if (report_only_first_attack == false
 		|| last_wmw_test_was_attack == false) {
-	    logStr << MsgStream::raw << MsgStream::FATAL << "wmw: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
-	    logStr << MsgStream::raw << MsgStream::ERROR 
+	    logOut << MsgStream::raw << MsgStream::FATAL << "wmw: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
+	    logOut << MsgStream::raw << MsgStream::ERROR 
 		<< "Test counter: " << test_counter << "\np-value: " << p << MsgStream::endl;
-	    msgStr << MsgStream::INFO << "wmw: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
-#ifdef IDMEF_SUPPORT_ENABLED
-	    idmefMessage.setAnalyzerAttr("", "", "wmw-test", "");
-	    sendIdmefMessage("DDoS", idmefMessage);
-	    idmefMessage = getNewIdmefMessage();
-#endif
+	    msgOut << MsgStream::INFO << "wmw: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
+	    W.alerts.push_back("wmw-test");
 	}
 	last_wmw_test_was_attack = true;
     }
@@ -2050,20 +2292,23 @@ double Stat::stat_test_wmw (std::list<int64_t> & sample_old,
     return p;
 }
 
-double Stat::stat_test_ks (std::list<int64_t> & sample_old,
-	std::list<int64_t> & sample_new, bool & last_ks_test_was_attack, std::string metric) {
+double Stat::stat_test_ks (EndpointWork & W, const std::multiset<int64_t> & sample_old,
+	const std::multiset<int64_t> & sample_new, bool & last_ks_test_was_attack, std::string metric) {
+
+    MsgStream & logOut = *W.logOut;
+    MsgStream & msgOut = *W.msgOut;
 
     double p;
 
-    if (logStr.getLogLevel() == MsgStream::DEBUG) {
-	logStr.rawPrint(MsgStream::DEBUG, " Kolmogorov-Smirnov test details:");
-	p = ks_test(sample_old, sample_new, logStr.getLogfile());
-	logStr << MsgStream::raw << MsgStream::DEBUG << " Kolmogorov-Smirnov test returned\n"
+    if (logOut.getLogLevel() == MsgStream::DEBUG) {
+	logOut.rawPrint(MsgStream::DEBUG, " Kolmogorov-Smirnov test details:");
+	p = ks_test(sample_old, sample_new, logOut.getLogfile());
+	logOut << MsgStream::raw << MsgStream::DEBUG << " Kolmogorov-Smirnov test returned\n"
 	    << "  p-value: " << p << "\n"
 	    << "  reject H0 (no attack) to any significance level alpha > " << p << MsgStream::endl;
     }
     else {
-	std::ofstream dump ("/dev/null");
+	std::ofstream dump; // not opened, no output
 	p = ks_test(sample_old, sample_new, dump);
     }
 
@@ -2071,15 +2316,11 @@ double Stat::stat_test_ks (std::list<int64_t> & sample_old,
     if (significance_level > p) {
 	if (report_only_first_attack == false
 		|| last_ks_test_was_attack == false) {
-	    logStr << MsgStream::raw << MsgStream::FATAL << "ks: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
-	    logStr << MsgStream::raw << MsgStream::ERROR 
+	    logOut << MsgStream::raw << MsgStream::FATAL << "ks: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
+	    logOut << MsgStream::raw << MsgStream::ERROR 
 		<< "Test counter: " << test_counter << "\np-value: " << p << MsgStream::endl;
-	    msgStr << MsgStream::INFO << "ks: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
-#ifdef IDMEF_SUPPORT_ENABLED
-	    idmefMessage.setAnalyzerAttr("", "", "ks-test", "");
-	    sendIdmefMessage("DDoS", idmefMessage);
-	    idmefMessage = getNewIdmefMessage();
-#endif
+	    msgOut << MsgStream::INFO << "ks: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
+	    W.alerts.push_back("ks-test");
 	}
 	last_ks_test_was_attack = true;
     }
@@ -2090,20 +2331,22 @@ double Stat::stat_test_ks (std::list<int64_t> & sample_old,
 }
 
 
-double Stat::stat_test_pcs (std::list<int64_t> & sample_old,
-	std::list<int64_t> & sample_new, bool & last_pcs_test_was_attack, std::string metric) {
+double Stat::stat_test_pcs (EndpointWork & W, const std::multiset<int64_t> & sample_old,
+	const std::multiset<int64_t> & sample_new, bool & last_pcs_test_was_attack, std::string metric) {
+
+    MsgStream & logOut = *W.logOut;
 
     double p;
 
-    if (logStr.getLogLevel() == MsgStream::DEBUG) {
-	logStr.rawPrint(MsgStream::DEBUG, " Pearson chi-square test details:");
-	p = pcs_test(sample_old, sample_new, logStr.getLogfile());
-	logStr << MsgStream::raw << MsgStream::DEBUG << " Pearson chi-square test returned\n"
+    if (logOut.getLogLevel() == MsgStream::DEBUG) {
+	logOut.rawPrint(MsgStream::DEBUG, " Pearson chi-square test details:");
+	p = pcs_test(sample_old, sample_new, logOut.getLogfile());
+	logOut << MsgStream::raw << MsgStream::DEBUG << " Pearson chi-square test returned\n"
 	    << "  p-value: " << p << "\n"
 	    << "  reject H0 (no attack) to any significance level alpha > " << p << MsgStream::endl;
     }
     else {
-	std::ofstream dump ("/dev/null");
+	std::ofstream dump; // not opened, no output
 	p = pcs_test(sample_old, sample_new, dump);
     }
 
@@ -2111,15 +2354,11 @@ double Stat::stat_test_pcs (std::list<int64_t> & sample_old,
     if (significance_level > p) {
 	if (report_only_first_attack == false
 		|| last_pcs_test_was_attack == false) {
-	    logStr << MsgStream::raw << MsgStream::FATAL << "pcs: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
-	    logStr << MsgStream::raw << MsgStream::ERROR 
+	    logOut << MsgStream::raw << MsgStream::FATAL << "pcs: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
+	    logOut << MsgStream::raw << MsgStream::ERROR 
 		<< "Test counter: " << test_counter << "\np-value: " << p << MsgStream::endl;
-	    logStr << MsgStream::raw << MsgStream::INFO << "pcs: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
-#ifdef IDMEF_SUPPORT_ENABLED
-	    idmefMessage.setAnalyzerAttr("", "", "pcs-test", "");
-	    sendIdmefMessage("DDoS", idmefMessage);
-	    idmefMessage = getNewIdmefMessage();
-#endif
+	    logOut << MsgStream::raw << MsgStream::INFO << "pcs: attack detected to significance level " << significance_level << " in metric " << metric << "!" << MsgStream::endl;
+	    W.alerts.push_back("pcs-test");
 	}
 	last_pcs_test_was_attack = true;
     }
@@ -26,6 +26,7 @@
 #include "stat-store.h"
 #include "shared.h"
 #include "params.h"
+#include "cusum-engine.h"
 #include <detectionbase.h>
 #include <sstream>
 #include <algorithm> // sort(...), unique(...)
@@ -63,7 +64,7 @@ class Stat
 #ifdef OFFLINE_ENABLED
 : public DetectionBase<StatStore, OfflineInputPolicy<StatStore> >
 #else
-: public DetectionBase<StatStore>
+: public DetectionBase<StatStore, BatchInputPolicy<SemShmNotifier, StatStore> >
 #endif
 {
 
@@ -104,6 +105,39 @@ class Stat
 
     private:
 
+	// work of test() for a single endpoint. The endpoints are independent,
+	// so their work items can be processed by several worker threads.
+	// Output and alerts of a work item are handed on afterwards in the order
+	// of the endpoints, so they don't depend on the number of threads.
+	struct EndpointWork {
+	    EndpointWork() : logBuffer(NULL), msgBuffer(NULL) {}
+	    ~EndpointWork() { delete logBuffer; delete msgBuffer; }
+
+	    const EndPoint * endPoint;
+	    const Info * info;     // data of this test() call (update phase only)
+	    Info prev;             // data of the previous call (update phase only)
+	    Params * params;
+	    bool isNew;            // endpoint is monitored from now on
+	    MsgStream * logOut;    // logStr or logBuffer
+	    MsgStream * msgOut;    // msgStr or msgBuffer
+	    MsgStream * logBuffer; // only created if several threads are used
+	    MsgStream * msgBuffer;
+	    std::vector<std::string> alerts; // names of the tests that detected an attack
+
+	  private:
+	    /* hidden, the work item owns its buffers */
+	    EndpointWork(const EndpointWork &);
+	    EndpointWork & operator=(const EndpointWork &);
+	};
+
+	typedef void (Stat::*EndpointFunction)(EndpointWork &);
+	struct WorkerArgs;
+
+	// processes all work items with worker_threads threads (or in the calling
+	// thread), then prints their output and sends their alerts in order
+	void process_endpoints(std::vector<EndpointWork *> &, EndpointFunction);
+	static void * worker_thread(void *);
+
 	// signal handlers
 	static void sigTerm(int);
 	static void sigInt(int);
@@ -121,14 +155,19 @@ class Stat
 	// create string with full configuration
 	std::string config_overview();
 
-	// the following functions are called by the test()-function:
+	// the following functions are called by the test()-function
+	// (update_endpoint and test_endpoint for every endpoint, possibly
+	// in parallel):
+	void update_endpoint(EndpointWork &);
+	void test_endpoint(EndpointWork &);
 	int64_t get_metric (const Info &, Metric );
 	std::vector<int64_t> extract_data (const Info &, const Info &);
 	std::vector<int64_t> extract_pca_data (Params &, const Info &, const Info &);
-	void wkp_update(Params &, const std::vector<int64_t> &);
-	void wkp_test(Params &);
-	void cusum_update(Params &, const std::vector<int64_t> &);
-	void cusum_test(Params &);
+	void wkp_update(EndpointWork &, const std::vector<int64_t> &);
+	void wkp_test(EndpointWork &);
+	void cusum_update(EndpointWork &, const std::vector<int64_t> &);
+	void cusum_test(EndpointWork &);
+	void get_cusum_state(Params &);
 
 	// these functions are called by extract_pca_data() to calculate ...
 	// ... a single entry of the covariance matrix
@@ -136,18 +175,19 @@ class Stat
 	// ... the standard deviation of a single metric
 	double standard_deviation (const double &, const double &);
 
-	// this function is called by wkp_test() and cusum_test() to extract a
-	// single metric to test from a std::vector<int64_t>
-	std::list<int64_t> getSingleMetric(const std::list<std::vector<int64_t> > &, const short &);
-
 	// the following functions are called by the wkp_test()-function
-	double stat_test_wmw(std::list<int64_t> &, std::list<int64_t> &, bool &, std::string);
-	double stat_test_ks (std::list<int64_t> &, std::list<int64_t> &, bool &, std::string);
-	double stat_test_pcs(std::list<int64_t> &, std::list<int64_t> &, bool &, std::string);
+	// (with the sorted samples of a single metric, cf. Params::OldSorted)
+	double stat_test_wmw(EndpointWork &, const std::multiset<int64_t> &, const std::multiset<int64_t> &, bool &, std::string);
+	double stat_test_ks (EndpointWork &, const std::multiset<int64_t> &, const std::multiset<int64_t> &, bool &, std::string);
+	double stat_test_pcs(EndpointWork &, const std::multiset<int64_t> &, const std::multiset<int64_t> &, bool &, std::string);
 
 	// File where data will be stored to (in ONLINE MODE)
 	// or be read from (in OFFLINE MODE)
 	std::string offlineFile;
+	// write it in the binary format of snapshot.h (in ONLINE MODE)
+	bool binaryOfflineFile;
+	// number of intervals read ahead (in OFFLINE MODE)
+	unsigned offline_prefetch;
 
 	// If the user specifies an output_dir, this flag will be set to true
 	// and output files (for test-params and metrics) will be generated and
@@ -174,6 +214,7 @@ class Stat
 	int stat_test_frequency;
 	bool report_only_first_attack;
 	short pause_update_when_attack;
+	int worker_threads;
 	// fix PCA stuff
 	bool use_pca;
 	int pca_learning_phase;
@@ -189,6 +230,9 @@ class Stat
 	uint16_t repetition_factor;
 	uint16_t cusum_learning_phase;
 	double smoothing_constant;
+	bool cusum_soa_backend;
+	// CUSUM state of all endpoints if cusum_soa_backend is set
+	CusumEngine cusumEngine;
 
 	// for wkp-tests
 	bool enable_wmw_test;
@@ -207,6 +251,7 @@ class Stat
 	int test_counter;
 
 	std::ofstream storefile;
+	SnapshotWriter snapshotfile;
 };
 
 
@@ -38,7 +38,16 @@ StatStore::StatStore()
 
 StatStore::~StatStore() {
 
-    PreviousData = Data;
+    PreviousData = getData();
+
+}
+
+std::map<EndPoint,Info> StatStore::getData() const {
+
+    std::map<EndPoint,Info> ret;
+    for (unsigned i = 0; i != Data.size(); i++)
+	ret.insert(std::make_pair(EndPoint::fromKey(Data[i].first), Data[i].second));
+    return ret;
 
 }
 
@@ -171,106 +180,104 @@ void StatStore::addFieldData(int id, byte * fieldData, int fieldDataLength, Ente
 }
 
 
+// Same as recordStart(), addFieldData() and recordEnd() for every record
+// of the batch; used by BatchInputPolicy
+void StatStore::addRecordBatch(const RecordBatch & batch) {
+
+    if (beginMonitoring != true)
+	return;
+
+    for (unsigned i = 0; i != batch.count; ++i) {
+
+	// the batch decoder has already checked the field lengths
+	if (batch.isMalformed(i)) {
+	    msgStr << MsgStream::ERROR << "Got IPFIX field(s) with unsupported length. Skipping record." << MsgStream::endl;
+	    continue;
+	}
+
+	IpAddress SourceIP(0,0,0,0);
+	IpAddress DestIP(0,0,0,0);
+	if (batch.hasField(i, RecordBatch::SRC_IP)) {
+	    SourceIP.setAddress((const byte*)&batch.srcIp[i]);
+	    SourceIP.remanent_mask(netmask);
+	}
+	if (batch.hasField(i, RecordBatch::DST_IP)) {
+	    DestIP.setAddress((const byte*)&batch.dstIp[i]);
+	    DestIP.remanent_mask(netmask);
+	}
+
+	e_source = EndPoint(SourceIP, batch.srcPort[i], batch.proto[i]);
+	e_dest = EndPoint(DestIP, batch.dstPort[i], batch.proto[i]);
+	packet_nb = batch.hasField(i, RecordBatch::PACKETS) ? batch.packets[i] : 0;
+	byte_nb = batch.hasField(i, RecordBatch::OCTETS) ? batch.octets[i] : 0;
+
+	recordEnd();
+    }
+
+}
+
+
 // For every call to recordEnd, two endpoints will be considered:
 // One consisting of SourceIP, SourcePort and Protocol (e_source)
 // And one consisting of DestIP, DestPort and Protocol (e_dest)
 void StatStore::recordEnd() {
 
-    std::stringstream Warning;
-    Warning
-	<< "WARNING: New EndPoint observed but EndPointListMaxSize reached!\n"
-	<< "Couldn't monitor new EndPoint: ";
+    Info * info;
 
     // Handle EndPoint e_source (with SourceIP and SourcePort)
+    if ( (info = getInfo(e_source)) != NULL ) {
+	info->packets_out += packet_nb;
+	info->bytes_out += byte_nb;
+	info->records_out++;
+    }
 
-    // FILTER: Consider only EndPoints we are interested in
-    if (monitorEndPoint(e_source) == true || monitorEveryEndPoint == true) {
-
-	// EndPoint already known and thus in our List?
-	if ( find(endPointList.begin(), endPointList.end(), e_source) != endPointList.end() ) {
-	    // Since Data is destroyed after every test()-run,
-	    // we need to check, if the endpoint was already seen in the
-	    // current run
-	    std::map<EndPoint,Info>::iterator it = Data.find(e_source);
-	    if( it != Data.end() ) {
-		it->second.packets_out += packet_nb;
-		it->second.bytes_out += byte_nb;
-		it->second.records_out++;
-	    }
-	    else {
-		Data[e_source].packets_out += packet_nb;
-		it = Data.find(e_source);
-		it->second.bytes_out += byte_nb;
-		it->second.records_out++;
-	    }
-	}
-	// EndPoint not known, still place to add it?
-	else {
-	    if (endPointList.size() < endPointListMaxSize) {
-		Info newinfo;
-		newinfo.bytes_in = newinfo.packets_in = newinfo.records_in = 0;
-		newinfo.packets_out = packet_nb;
-		newinfo.bytes_out = byte_nb;
-		newinfo.records_out = 1;
-		Data.insert(std::make_pair<EndPoint,Info>(e_source, newinfo));
-		endPointList.push_back(e_source);
-	    }
-	    else
-		std::cerr << Warning.str() << e_source << std::endl;
-	}
+    // Handle EndPoint e_dest (with DestIP and DestPort)
+    if ( (info = getInfo(e_dest)) != NULL ) {
+	info->packets_in += packet_nb;
+	info->bytes_in += byte_nb;
+	info->records_in++;
     }
 
+    return;
+}
 
-    // Handle EndPoint e_dest (with DestIP and DestPort)
+Info * StatStore::getInfo (const EndPoint & ep) {
+
+    uint64_t key = ep.toKey();
+
+    // EndPoint already known and thus in our index?
+    uint32_t slot = endPointIndex.find(key);
+    if (slot == EndPointIndex::NOT_FOUND) {
+
+	// FILTER: Consider only EndPoints we are interested in
+	if (monitorEveryEndPoint == false && monitorEndPoint(ep) == false)
+	    return NULL;
 
-    // FILTER: Consider only EndPoints we are interested in
-    if (monitorEndPoint(e_dest) == true || monitorEveryEndPoint == true) {
-
-	// EndPoint already known and thus in our List?
-	if ( find(endPointList.begin(), endPointList.end(), e_dest) != endPointList.end() ) {
-	    // Since Data is destroyed after every test()-run,
-	    // we need to check, if the endpoint was already seen in the
-	    // current run
-	    std::map<EndPoint,Info>::iterator it = Data.find(e_dest);
-	    if ( it != Data.end() ) {
-		it->second.packets_in += packet_nb;
-		it->second.bytes_in += byte_nb;
-		it->second.records_in++;
-	    }
-	    else {
-		Data[e_dest].packets_in += packet_nb;
-		it = Data.find(e_dest);
-		it->second.bytes_in += byte_nb;
-		it->second.records_in++;
-	    }
-	}
 	// EndPoint not known, still place to add it?
-	else {
-	    if (endPointList.size() < endPointListMaxSize) {
-		Info newinfo;
-		newinfo.bytes_out = newinfo.packets_out = newinfo.records_out = 0;
-		newinfo.packets_in = packet_nb;
-		newinfo.bytes_in = byte_nb;
-		newinfo.records_in = 1;
-		Data.insert(std::make_pair<EndPoint,Info>(e_dest, newinfo));
-		endPointList.push_back(e_dest);
-	    }
-	    else
-		std::cerr << Warning.str() << e_dest << std::endl;
+	if (endPointIndex.size() >= (uint32_t)endPointListMaxSize) {
+	    std::cerr << "WARNING: New EndPoint observed but EndPointListMaxSize reached!\n"
+		<< "Couldn't monitor new EndPoint: " << ep << std::endl;
+	    return NULL;
 	}
+	slot = endPointIndex.insert(key);
     }
 
-    return;
+    // Since Data is destroyed after every test()-run,
+    // we need to check, if the endpoint was already seen in the
+    // current run
+    if (slot >= DataPos.size())
+	DataPos.resize(endPointIndex.size(), 0);
+    if (DataPos[slot] == 0) {
+	Data.push_back(std::make_pair(key, Info()));
+	DataPos[slot] = Data.size();
+    }
+
+    return &Data[DataPos[slot] - 1].second;
 }
 
 // input from file (for offline usage)
 std::ifstream& operator>>(std::ifstream& is, StatStore* store) {
 
-    std::stringstream Warning;
-    Warning
-	<< "WARNING: New EndPoint observed but endPointListMaxSize reached!\n"
-	<< "Couldn't monitor new EndPoint: ";
-
     if ( is.eof() ) {
 	std::cerr << "INFORMATION: All Data read from file.\n";
 	is.close();
@@ -279,6 +286,7 @@ std::ifstream& operator>>(std::ifstream& is, StatStore* store) {
 
     std::string tmp;
     store->Data.clear();
+    store->DataPos.clear();
     while ( getline(is, tmp) ) {
 	if (0 == strncmp("---",tmp.c_str(),3) )
 	    break;
@@ -297,52 +305,7 @@ std::ifstream& operator>>(std::ifstream& is, StatStore* store) {
 	Info info;
 	tmp1 >> info.packets_in >> info.packets_out >> info.bytes_in >> info.bytes_out >> info.records_in >> info.records_out;
 
-	// AGGREGATION: Use endpoint_key and netmask parameters to aggregate endpoints
-	if (store->ipMonitoring == false)
-	    ep.setIpAddress(IpAddress(0,0,0,0));
-	else // apply global netmask
-	    ep.applyNetmask(store->netmask);
-	if (store->portMonitoring == false)
-	    ep.setPortNr(0);
-	if (store->protocolMonitoring == false)
-	    ep.setProtocolID(0);
-
-	// FILTER: Consider only EndPoints we are interested in
-	if (store->monitorEndPoint(ep) == true || store->monitorEveryEndPoint == true) {
-	    // EndPoint already known and thus in our List?
-	    if ( find(store->endPointList.begin(), store->endPointList.end(), ep) != store->endPointList.end() ) {
-		// Since Data is destroyed after every test()-run,
-		// we need to check, if the endpoint was already seen in the
-		// current run
-		std::map<EndPoint,Info>::iterator it = store->Data.find(ep);
-		if ( it != store->Data.end() ) {
-		    it->second.packets_in += info.packets_in;
-		    it->second.bytes_in += info.bytes_in;
-		    it->second.records_in += info.records_in;
-		    it->second.packets_out += info.packets_out;
-		    it->second.bytes_out += info.bytes_out;
-		    it->second.records_out += info.records_out;
-		}
-		else {
-		    store->Data[ep].packets_in += info.packets_in;
-		    it = store->Data.find(ep);
-		    it->second.bytes_in += info.bytes_in;
-		    it->second.records_in += info.records_in;
-		    it->second.packets_out += info.packets_out;
-		    it->second.bytes_out += info.bytes_out;
-		    it->second.records_out += info.records_out;
-		}
-	    }
-	    // EndPoint not known, still place to add it?
-	    else {
-		if (store->endPointList.size() < store->endPointListMaxSize) {
-		    store->Data.insert(std::make_pair<EndPoint,Info>(ep, info));
-		    store->endPointList.push_back(ep);
-		}
-		else
-		    std::cerr << Warning.str() << ep << std::endl;
-	    }
-	}
+	store->addOfflineData(ep, info);
 
 	tmp.clear();
 	tmp1.clear();
@@ -351,6 +314,68 @@ std::ifstream& operator>>(std::ifstream& is, StatStore* store) {
     return is;
 }
 
+void StatStore::addOfflineData (EndPoint ep, const Info & info) {
+
+    // AGGREGATION: Use endpoint_key and netmask parameters to aggregate endpoints
+    if (ipMonitoring == false)
+	ep.setIpAddress(IpAddress(0,0,0,0));
+    else // apply global netmask
+	ep.applyNetmask(netmask);
+    if (portMonitoring == false)
+	ep.setPortNr(0);
+    if (protocolMonitoring == false)
+	ep.setProtocolID(0);
+
+    Info * data = getInfo(ep);
+    if (data != NULL) {
+	data->packets_in += info.packets_in;
+	data->bytes_in += info.bytes_in;
+	data->records_in += info.records_in;
+	data->packets_out += info.packets_out;
+	data->bytes_out += info.bytes_out;
+	data->records_out += info.records_out;
+    }
+}
+
+bool StatStore::openSnapshot(const std::string & filename, unsigned prefetch) {
+
+    if (!snapshot.open(filename))
+	return false;
+    snapshotPos = 0;
+    snapshotPrefetch = prefetch;
+    snapshot.prefetch(0, prefetch);
+    return true;
+}
+
+// input from binary file (for offline usage)
+bool StatStore::readSnapshot(StatStore * store) {
+
+    if (snapshotPos >= snapshot.intervals()) {
+	std::cerr << "INFORMATION: All Data read from file.\n";
+	return false;
+    }
+
+    SnapshotFile::Interval iv = snapshot.interval(snapshotPos++);
+    // the blocks of the following intervals are loaded while this one
+    // is aggregated and tested
+    snapshot.prefetch(snapshotPos, snapshotPrefetch);
+
+    store->Data.clear();
+    store->DataPos.clear();
+    for (uint32_t i = 0; i != iv.count; i++) {
+	Info info;
+	info.packets_in = iv.packets_in[i];
+	info.packets_out = iv.packets_out[i];
+	info.bytes_in = iv.bytes_in[i];
+	info.bytes_out = iv.bytes_out[i];
+	info.records_in = iv.records_in[i];
+	info.records_out = iv.records_out[i];
+	store->addOfflineData(EndPoint::fromKey(iv.key[i]), info);
+    }
+
+    return true;
+}
+
 // returns true, if we are interested in EndPoint ep.
 // That means, that ep matches one of the FilterEndPoints defined
 // in endPointFilter (initialized either by x_frequently_endpoints
@@ -358,15 +383,8 @@ std::ifstream& operator>>(std::ifstream& is, StatStore* store) {
 // (returns false otherwise)
 bool StatStore::monitorEndPoint (const EndPoint & ep) {
 
-    std::vector<FilterEndPoint>::iterator it = endPointFilter.begin();
-    while ( it != endPointFilter.end() ) {
-	if (it->matchesWithEndPoint(ep, netmask) == true)
-	    return true;
-	//    std::cout << *it << "\t | \t" << ep << std::endl;
-	it++;
-    }
+    return endPointFilterTable.matches(ep);
 
-    return false;
 }
 
 
@@ -395,9 +413,13 @@ bool StatStore::portMonitoring = false;
 bool StatStore::protocolMonitoring = false;
 
 std::vector<FilterEndPoint> StatStore::endPointFilter;
+EndPointFilterTable StatStore::endPointFilterTable;
 bool StatStore::monitorEveryEndPoint = false;
 
-std::vector<EndPoint> StatStore::endPointList;
+EndPointIndex StatStore::endPointIndex;
+SnapshotFile StatStore::snapshot;
+uint32_t StatStore::snapshotPos = 0;
+unsigned StatStore::snapshotPrefetch = 1;
 int StatStore::endPointListMaxSize = 0;
 
 bool StatStore::beginMonitoring = false;
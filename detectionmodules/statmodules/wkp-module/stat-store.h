@@ -24,7 +24,11 @@
 #define _STAT_STORE_H_
 
 #include "shared.h"
+#include "endpoint-index.h"
+#include "endpoint-filter.h"
+#include "snapshot.h"
 #include <datastore.h>
+#include <recordbatch.h>
 #include <concentrator/ipfix.h>
 #include <map>
 #include <vector>
@@ -45,8 +49,22 @@ class StatStore : public DataStore {
   EndPoint e_source;
   EndPoint e_dest;
 
-  std::map<EndPoint,Info> Data;     // data collected from all records received
-                                    // since last call to Stat::test()
+  std::vector<std::pair<uint64_t,Info> > Data;
+  // data collected from all records received since last call to Stat::test(),
+  // as (EndPoint::toKey(), Info) pairs in the order the endpoints were seen
+
+  std::vector<uint32_t> DataPos;
+  // position + 1 of the Info of every endPointIndex slot in Data,
+  // 0 if the endpoint wasn't seen since last call to Stat::test()
+
+  Info * getInfo (const EndPoint &);
+  // returns the Info slot of the endpoint in Data or NULL if the endpoint
+  // isn't monitored; new endpoints are added to endPointIndex if they pass
+  // the filter and there is still place
+
+  void addOfflineData (EndPoint, const Info &);
+  // adds the data of an endpoint read from an offline file, aggregated
+  // according to endpoint_key and netmask
 
   static std::map<EndPoint,Info> PreviousData;
    // data collected from all records received before last call to Stat::test()
@@ -65,14 +83,25 @@ class StatStore : public DataStore {
   void recordEnd();
   void addFieldData(int id, byte * fieldData, int fieldDataLength,
 		    EnterpriseNo eid = 0);
+  void addRecordBatch(const RecordBatch & batch);
 
-  std::map<EndPoint,Info> getData() const {return Data;}
+  std::map<EndPoint,Info> getData() const;
   std::map<EndPoint,Info> getPreviousData() const {return PreviousData;}
 
   bool monitorEndPoint (const EndPoint &);
 
   friend std::ifstream& operator>>(std::ifstream&, StatStore*);
 
+  static bool openSnapshot(const std::string & filename, unsigned prefetch);
+  // opens a binary offline file (cf. snapshot.h) for readSnapshot();
+  // the blocks of the next prefetch intervals are read ahead
+
+  static bool readSnapshot(StatStore *);
+  // reads the next interval of the binary offline file into the store,
+  // returns false if there is none; used by OfflineInputPolicy
+
+  static const SnapshotFile & getSnapshot() { return snapshot; }
+
   static short netmask;
   // will be applied to the ip addresses directly when they are
   // handled in addFieldData(); this is for aggregating ip addresses
@@ -105,6 +134,7 @@ class StatStore : public DataStore {
 
   static void AddEndPointToFilter (FilterEndPoint fep) {
     endPointFilter.push_back(fep);
+    endPointFilterTable.add(fep, netmask);
   }
 
   static std::string EndPointFilters();
@@ -116,9 +146,18 @@ class StatStore : public DataStore {
   // this file is read by Stat::init(), which then initializes
   // endPointFilter.
 
-  static std::vector<EndPoint> endPointList;
+  static EndPointFilterTable endPointFilterTable;
+  // endPointFilter compiled into a trie, used by monitorEndPoint();
+  // filled by AddEndPointToFilter() with the netmask set at that time
+
+  static EndPointIndex endPointIndex;
   // Currently monitored EndPoints. Every Endpoint we are interested in
-  // is added to this List until EndPointListMaxSize is reached.
+  // is added to this index until EndPointListMaxSize is reached.
+
+  static SnapshotFile snapshot;
+  static uint32_t snapshotPos;
+  static unsigned snapshotPrefetch;
+  // binary offline file, next interval to read and read ahead
 
   // All these are static because they are the same for every StatStore object.
   // As they will be set by a function, Stat::init(), that doesn't have any
@@ -306,7 +306,8 @@
  * is stochastically larger than the other. Both sample sizes have
  * to be >= 8, for excellent approximation n1+n2 > 60.
  */
-double wmw_test( std::list<int64_t> sample1, std::list<int64_t> sample2,
+double wmw_test( const std::multiset<int64_t> & sample1,
+		 const std::multiset<int64_t> & sample2,
 		 bool twosided, std::ofstream & outfile ) {
 
   unsigned int n1, n2, n_sum;
@@ -317,14 +318,12 @@ double wmw_test( std::list<int64_t> sample1, std::list<int64_t> sample2,
   float exp_rs1, exp_rs2;
     // expectation values of the sums of the ranks of the two samples
 
-  int64_t tie;
-    // tied value
+  int64_t value;
+    // current (possibly tied) value
   unsigned int to1, to2, to;
-    // numbers of tie occurences of a particular tied value
-  unsigned int tie_rs;
-    // sum of the ranks of a particular tied value
+    // numbers of occurences of the current value
   float tie_rank;
-    // mean rank of a particular tied value (= tie_rs/to)
+    // mean rank of the current value
 
   float d;
     // deviation of rs2 from the expectation value exp_rs2
@@ -334,128 +333,67 @@ double wmw_test( std::list<int64_t> sample1, std::list<int64_t> sample2,
   float tc, sigma;
     // standard deviation and tie correction to this standard deviation
 
-  std::list<int64_t>::iterator it1, it2;
+  std::multiset<int64_t>::const_iterator it1, it2;
+
+  // debug output is expensive, skip it if nobody reads it
+  bool debug = outfile.is_open();
 
   // Determine sample sizes and the sum since we need it various times
 
   n1 = sample1.size();
   n2 = sample2.size();
   n_sum = n1 + n2;
-    
-  // Sort samples
 
-  sample1.sort();
-  sample2.sort();
-  outfile << "sorted sample old: " << sample1 << std::endl;
-  outfile << "sorted sample new: " << sample2 << std::endl;
+  // The samples are kept sorted by the caller
+  if (debug) {
+    outfile << "sorted sample old: " << sample1 << std::endl;
+    outfile << "sorted sample new: " << sample2 << std::endl;
+  }
 
-  // Calculate the sums of ranks for the two samples
+  // Calculate the sums of ranks for the two samples.
+  // We walk through both samples at once, one distinct value at a time.
+  // All occurences of a value get the mean of their ranks. As this does
+  // not change the rank sums, only values occuring in both samples are
+  // taken into account for the tie correction.
 
   rs1 = 0; rs2 = 0; tc = 0;
   it1 = sample1.begin(); it2 = sample2.begin();
 
-  for (unsigned int i = 1; i <= n_sum; i++) {
-
-    outfile << i << ": ";
-
-    if (*it1 == *it2) {
-
-      outfile << *it1 << " tie! ";
-
-      // special treatment for tie: assign mean rank
-      tie = *it1;
-      tie_rs = 0;
-      to1 = 0; to2 = 0;
-
-      // sum up all ranks for the current value:
-
-      // in sample1
-      do {
-	tie_rs += i;
-	to1++; // count number of occurences in sample1
-	i++;
-	it1++;
-      }
-      while ( (*it1 == tie) && (it1 != sample1.end()) );
-
-      // in sample2
-      do {
-	tie_rs += i;
-	to2++; // count number of occurences in sample2
-	i++;
-	it2++;
-      }
-      while ( (*it2 == tie) && (it2 != sample2.end()) );
-
-      // we have to decrease i before next iteration begins,
-      // as last loop increased it
-      i--;
-
-      // calculate the tie degree
-      to = to1 + to2;
-      // calculate mean rank
-      tie_rank = float(tie_rs) / to;
-      // print tie degrees and mean rank
-      outfile << "to1=" << to1 << " to2=" << to2 << " meanrank=" <<tie_rank;
-      // add mean rank to rs1 and rs2
-      // as much as there are tie occurences in the samples
-      rs1 += to1 * tie_rank;
-      rs2 += to2 * tie_rank;
+  for (unsigned int i = 1; i <= n_sum; i += to) {
 
-      // add value for sigma correction
-      tc += to*to*to - to;
-
-    }
-
-    else if (*it1 < *it2) {
+    if (it2 == sample2.end() || (it1 != sample1.end() && *it1 < *it2))
+      value = *it1;
+    else
+      value = *it2;
 
-      outfile << *it1;
-      // this rank belongs to sample1, thus we add it to the rank sum:
-      rs1 += i;
+    to1 = 0; to2 = 0;
+    while (it1 != sample1.end() && *it1 == value) {
+      to1++;
       it1++;
-
     }
-
-    else {
-
-      outfile << *it2;
-      // this rank belongs to sample2, thus we add it to the rank sum:
-      rs2 += i;
+    while (it2 != sample2.end() && *it2 == value) {
+      to2++;
       it2++;
-
     }
+    to = to1 + to2;
 
-    outfile << " rs1=" << rs1 << " rs2=" << rs2 << std::endl;
-
-    // check if sample1 has reached its end
-    if (it1 == sample1.end()) {
-
-      // all the remaining ranks belong to sample2
-      outfile << "sample1 parsed\n";
-      for (i++; i<=n_sum; i++) {
-	// thus we add them to the rank sum
-	rs2 += i;
-	outfile << i << ": " << *it2
-		<< " rs1=" << rs1 << " rs2=" << rs2 << std::endl;
-	it2++;
-      }
+    // ranks i .. i+to-1
+    tie_rank = i + float(to - 1) / 2;
+    rs1 += to1 * tie_rank;
+    rs2 += to2 * tie_rank;
 
+    if (to1 != 0 && to2 != 0) {
+      // add value for sigma correction
+      tc += float(to)*to*to - to;
+      if (debug)
+	outfile << i << ": " << value << " tie! to1=" << to1 << " to2=" << to2
+		<< " meanrank=" << tie_rank;
     }
+    else if (debug)
+      outfile << i << ": " << value;
 
-    // check if sample2 has reached its end
-    else if (it2 == sample2.end()) {
-
-      // all the remaining ranks belong to sample1
-      outfile << "sample2 parsed\n";
-      for(i++; i<=n_sum; i++) {
-	// thus we add them to the rank sum
-	rs1 += i;
-	outfile << i << ": " << *it1
-		<< " rs1=" << rs1 << " rs2=" << rs2 << std::endl;
-	it1++;
-      }
-
-    }
+    if (debug)
+      outfile << " rs1=" << rs1 << " rs2=" << rs2 << std::endl;
 
   }
 
@@ -473,7 +411,8 @@ double wmw_test( std::list<int64_t> sample1, std::list<int64_t> sample2,
 
   exp_rs1 = float(n1*(n_sum+1))/2;
   exp_rs2 = float(n2*(n_sum+1))/2;
-  outfile << "exp. rs1=" << exp_rs1 << " exp. rs2=" << exp_rs2 << std::endl;
+  if (debug)
+    outfile << "exp. rs1=" << exp_rs1 << " exp. rs2=" << exp_rs2 << std::endl;
 
   // In fact we are more interested in the random variable rs2, as we
   // decided that our test statistic would be computed with respect to
@@ -490,7 +429,8 @@ double wmw_test( std::list<int64_t> sample1, std::list<int64_t> sample2,
   // (see Lothar Sachs: "Angewandte Statistik", 10th edition, p. 389)
 
   sigma = sqrt(float(n1*n2*(n_sum+1))/12 - tc/(12*(n_sum)*(n_sum-1)));
-  outfile << "d=" << d << " sigma=" << sigma << std::endl;
+  if (debug)
+    outfile << "d=" << d << " sigma=" << sigma << std::endl;
 
   // Return p-value
 
@@ -21,9 +21,11 @@
 #ifndef _WMW_TEST_H_
 #define _WMW_TEST_H_
 
-#include <list>
+#include <set>
+#include <stdint.h>
 #include <fstream>
 
-double wmw_test(std::list<int64_t>, std::list<int64_t>, bool, std::ofstream &);
+// the samples are sorted; output only if the ofstream is open
+double wmw_test(const std::multiset<int64_t> &, const std::multiset<int64_t> &, bool, std::ofstream &);
 
 #endif
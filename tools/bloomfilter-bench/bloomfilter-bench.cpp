@@ -0,0 +1,123 @@
+/*
+ * Microbenchmark for the Bloom filters of the count module.
+ *
+ * Inserts distinct IP 5-tuples with testBeforeInsert() and reports the time
+ * per call and the number of false positives (keys reported as known
+ * although they were never inserted before) for
+ *  - the old hashing scheme: one GSL fishman18 generator reseeded for each
+ *    of the k hash functions and stepped once per key byte (emulated, so
+ *    GSL isn't needed),
+ *  - BloomFilter with the double hashed 64 bit hash,
+ *  - BlockedBloomFilter.
+ *
+ * usage: bloomfilter-bench [keys] [filter bits] [hash functions]
+ */
+
+#include "bloomfilter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <vector>
+
+
+/* HashFunctions::hashU() before the switch to a 64 bit hash */
+class OldBloomFilter
+{
+    public:
+	OldBloomFilter(uint32_t size, unsigned hashfunctions)
+	    : filter(size), filter_size(size), seeds(hashfunctions)
+	{
+	    srand(time(0));
+	    for(unsigned i=0; i < seeds.size(); i++)
+		seeds[i] = rand();
+	}
+
+	bool testBeforeInsert(uint8_t* input, unsigned len)
+	{
+	    bool result = true;
+	    for(unsigned i=0; i < seeds.size(); i++) {
+		uint32_t index = hashU(input, len, filter_size, seeds[i]);
+		if(filter.test(index) == false)
+		    result = false;
+		filter.set(index);
+	    }
+	    return result;
+	}
+
+    private:
+	/* gsl_rng_fishman18: x(n+1) = 62089911 * x(n) mod (2^31 - 1) */
+	static uint32_t hashU(uint8_t* input, uint16_t len, uint32_t max, uint32_t seed)
+	{
+	    const uint64_t m = 2147483647UL;
+	    uint64_t x = seed % m;
+	    if(x == 0)
+		x = 1;
+	    uint32_t result = 0;
+	    for(unsigned i = 0; i < len; i++) {
+		x = (62089911UL * x) % m;
+		result = ((uint32_t)x*result + input[i]);
+	    }
+	    return result % max;
+	}
+
+	Bitmap filter;
+	uint32_t filter_size;
+	std::vector<uint32_t> seeds;
+};
+
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* i-th distinct key: addresses and ports vary like in real traffic */
+static void makeKey(QuintupleKey& key, uint32_t i)
+{
+    QuintupleKey::Quintuple* q = key.getQuintuple();
+    key.reset();
+    q->srcIp = htonl(0x0a000000 | (i & 0xffff));
+    q->dstIp = htonl(0xc0a80000 | ((i >> 16) & 0xff));
+    q->proto = (i & 1) ? 6 : 17;
+    q->srcPort = htons(1024 + ((i * 7) & 0x3fff));
+    q->dstPort = htons((i >> 24) ? 80 : 53);
+}
+
+template <class Filter>
+static void run(const char* name, Filter& filter, uint32_t keys)
+{
+    QuintupleKey key;
+    uint32_t falsePositives = 0;
+    double start = now();
+    for(uint32_t i = 0; i != keys; i++) {
+	makeKey(key, i);
+	if(filter.testBeforeInsert(key.data, key.len))
+	    falsePositives++;
+    }
+    double elapsed = now() - start;
+    printf("%-24s %8.1f ns/key %10u false positives\n", name, elapsed * 1e9 / keys, falsePositives);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t keys = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000000;
+    uint32_t bits = argc > 2 ? strtoul(argv[2], NULL, 0) : 1 << 24;
+    unsigned k = argc > 3 ? strtoul(argv[3], NULL, 0) : 3;
+
+    printf("%u keys, %u bits, %u hash functions\n", keys, bits, k);
+
+    OldBloomFilter old(bits, k);
+    run("fishman18 (old)", old, keys);
+
+    BloomFilter bf(bits, k);
+    run("BloomFilter", bf, keys);
+
+    BlockedBloomFilter bbf(bits, k);
+    run("BlockedBloomFilter", bbf, keys);
+
+    return 0;
+}
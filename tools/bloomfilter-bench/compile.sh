@@ -0,0 +1 @@
+g++ -O2 -I../../detectionmodules/countmodule -o bloomfilter-bench bloomfilter-bench.cpp ../../detectionmodules/countmodule/bloomfilter.cpp
@@ -0,0 +1 @@
+g++ -O3 -fno-math-errno -fno-trapping-math -I../../detectionmodules/statmodules/wkp-module -o cusum-engine-bench cusum-engine-bench.cpp ../../detectionmodules/statmodules/wkp-module/cusum-engine.cpp ../../detectionmodules/statmodules/wkp-module/cusum-test.cpp
@@ -0,0 +1,242 @@
+/*
+ * Equivalence check and microbenchmark for the structure-of-arrays CUSUM
+ * backend of the wkp-module (cusum_parameters/soa_backend).
+ *
+ * Runs the CUSUM update and test for a number of endpoints once like
+ * Stat does for each endpoint (Params with int X_curr, cusum_ewma(),
+ * cusum()) and once with CusumEngine. The values of the endpoints are
+ * random, with attacks now and then; some endpoints get no new values in
+ * an interval. Mean, variance, g, N, beta and the alarms of every
+ * endpoint and metric have to be the same, for all modes of
+ * pause_update_when_attack and with and without log_variance_ewma.
+ * Then prints the time per interval of both for larger numbers of
+ * endpoints.
+ *
+ * usage: cusum-engine-bench [endpoints to check] [intervals]
+ */
+
+#include "cusum-engine.h"
+#include "cusum-test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+
+
+static const unsigned METRICS = 4;
+static const double SMOOTHING_CONSTANT = 0.15;
+static const double AMPLITUDE_PERCENTAGE = 3.0;
+static const uint16_t REPETITION_FACTOR = 2;
+
+
+/* the CUSUM part of Params */
+struct Endpoint
+{
+    std::vector<double> mean, variance, g;
+    std::vector<int> X_curr;
+    std::vector<bool> last_attack;
+    bool updated;
+};
+
+
+/* which metrics get their mean and variance updated, see Stat::cusum_update() */
+static std::vector<bool> update_metrics(const Endpoint& e, int pause_update_when_attack)
+{
+    bool at_least_one = false, all = true;
+    for (unsigned i = 0; i < METRICS; i++) {
+	if (e.last_attack[i])
+	    at_least_one = true;
+	else
+	    all = false;
+    }
+
+    std::vector<bool> update(METRICS, true);
+    if ((pause_update_when_attack == 1 && at_least_one) || (pause_update_when_attack == 2 && all))
+	update.assign(METRICS, false);
+    else if (pause_update_when_attack == 3 && at_least_one)
+	for (unsigned i = 0; i < METRICS; i++)
+	    update[i] = !e.last_attack[i];
+    return update;
+}
+
+/* the CUSUM update of an endpoint with the per endpoint code of Stat */
+static void params_update(Endpoint& e, const std::vector<int64_t>& value, const std::vector<bool>& update,
+			  bool log_variance_ewma)
+{
+    e.updated = true;
+    for (unsigned i = 0; i < METRICS; i++) {
+	if (update[i])
+	    cusum_ewma(e.mean[i], e.variance[i], e.X_curr[i], SMOOTHING_CONSTANT, log_variance_ewma);
+	e.X_curr[i] = value[i];
+    }
+}
+
+/* the CUSUM test of metric i of an endpoint, see Stat::cusum_test() */
+static bool params_test(Endpoint& e, unsigned i, double& N, double& beta)
+{
+    N = REPETITION_FACTOR * (AMPLITUDE_PERCENTAGE * sqrt(e.variance[i]) / 2.0);
+    beta = e.mean[i] + (AMPLITUDE_PERCENTAGE * sqrt(e.variance[i]) / 2.0);
+    if (e.updated && ((e.g[i] = cusum(e.X_curr[i], beta, e.g[i])) > N))
+	return true;
+    if (!e.updated)
+	e.g[i] = 0;
+    return false;
+}
+
+/* value of metric i of endpoint n, with attacks in some intervals */
+static int64_t make_value(unsigned n, unsigned i, unsigned interval)
+{
+    int64_t value = 100 + 10 * i + n % 50 + rand() % 40;
+    if ((interval + n) % 50 > 42)
+	value += 300 + rand() % 300;
+    return value;
+}
+
+static void start(std::vector<Endpoint>& endpoints, CusumEngine& engine, bool log_variance_ewma)
+{
+    engine.init(METRICS, SMOOTHING_CONSTANT, log_variance_ewma, AMPLITUDE_PERCENTAGE, REPETITION_FACTOR);
+    for (unsigned n = 0; n < endpoints.size(); n++) {
+	Endpoint& e = endpoints[n];
+	e.mean.resize(METRICS);
+	e.variance.resize(METRICS);
+	e.g.assign(METRICS, 0.0);
+	e.X_curr.resize(METRICS);
+	e.last_attack.assign(METRICS, false);
+	std::vector<int64_t> value(METRICS);
+	for (unsigned i = 0; i < METRICS; i++) {
+	    e.mean[i] = 110 + 10 * i + n % 50;
+	    e.variance[i] = 100 + rand() % 200;
+	    value[i] = e.X_curr[i] = make_value(n, i, 0);
+	}
+	e.updated = true;
+	engine.addSlot();
+	engine.start(n, e.mean, e.variance, value);
+    }
+}
+
+/* runs both and returns the number of differences */
+static long check(unsigned count, unsigned intervals, int pause_update_when_attack, bool log_variance_ewma,
+		  long& alarms)
+{
+    std::vector<Endpoint> endpoints(count);
+    CusumEngine engine;
+    start(endpoints, engine, log_variance_ewma);
+
+    long differences = 0;
+    std::vector<int64_t> value(METRICS);
+    for (unsigned interval = 0; interval < intervals; interval++) {
+	if (interval > 0) {
+	    for (unsigned n = 0; n < count; n++) {
+		if (rand() % 5 == 0)
+		    continue;
+		std::vector<bool> update = update_metrics(endpoints[n], pause_update_when_attack);
+		for (unsigned i = 0; i < METRICS; i++)
+		    value[i] = make_value(n, i, interval);
+		params_update(endpoints[n], value, update, log_variance_ewma);
+		for (unsigned i = 0; i < METRICS; i++)
+		    engine.setValue(n, i, value[i], update[i]);
+	    }
+	    engine.update();
+	}
+	engine.test();
+
+	for (unsigned n = 0; n < count; n++) {
+	    Endpoint& e = endpoints[n];
+	    for (unsigned i = 0; i < METRICS; i++) {
+		double N, beta;
+		bool attack = params_test(e, i, N, beta);
+		if (attack != engine.attack(i, n) || e.g[i] != engine.getG(i, n) ||
+		    N != engine.getN(i, n) || beta != engine.getBeta(i, n) ||
+		    e.mean[i] != engine.getMean(i, n) || e.variance[i] != engine.getVariance(i, n) ||
+		    e.X_curr[i] != engine.getValue(i, n))
+		    differences++;
+		if (attack)
+		    alarms++;
+		/* the engine's alarms decide about the next update, like in Stat */
+		e.last_attack[i] = engine.attack(i, n);
+	    }
+	    e.updated = false;
+	}
+    }
+    return differences;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* time per interval of both, values are prepared beforehand */
+static void bench(unsigned count, unsigned intervals)
+{
+    std::vector<Endpoint> endpoints(count);
+    CusumEngine engine;
+    start(endpoints, engine, false);
+
+    std::vector<int64_t> values(count * METRICS);
+    for (unsigned n = 0; n < count; n++)
+	for (unsigned i = 0; i < METRICS; i++)
+	    values[n * METRICS + i] = make_value(n, i, 1);
+    std::vector<bool> update(METRICS, true);
+    std::vector<int64_t> value(METRICS);
+    volatile long alarms = 0;
+
+    double t0 = now();
+    for (unsigned interval = 0; interval < intervals; interval++) {
+	for (unsigned n = 0; n < count; n++) {
+	    value.assign(&values[n * METRICS], &values[n * METRICS] + METRICS);
+	    params_update(endpoints[n], value, update, false);
+	}
+	for (unsigned n = 0; n < count; n++) {
+	    for (unsigned i = 0; i < METRICS; i++) {
+		double N, beta;
+		alarms += params_test(endpoints[n], i, N, beta);
+	    }
+	    endpoints[n].updated = false;
+	}
+    }
+    double t1 = now();
+    for (unsigned interval = 0; interval < intervals; interval++) {
+	for (unsigned n = 0; n < count; n++)
+	    for (unsigned i = 0; i < METRICS; i++)
+		engine.setValue(n, i, values[n * METRICS + i], true);
+	engine.update();
+	engine.test();
+	for (unsigned n = 0; n < count; n++)
+	    for (unsigned i = 0; i < METRICS; i++)
+		alarms += engine.attack(i, n);
+    }
+    double t2 = now();
+
+    printf("%7u endpoints   %8.3f ms %8.3f ms\n", count,
+	   (t1 - t0) * 1e3 / intervals, (t2 - t1) * 1e3 / intervals);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000;
+    unsigned intervals = argc > 2 ? strtoul(argv[2], NULL, 0) : 200;
+
+    long differences = 0;
+    srand(1);
+    for (int log_variance_ewma = 0; log_variance_ewma < 2; log_variance_ewma++) {
+	for (int pause = 0; pause <= 3; pause++) {
+	    long alarms = 0;
+	    long d = check(count, intervals, pause, log_variance_ewma, alarms);
+	    printf("pause_update_when_attack %d, log_variance_ewma %s: %ld alarms, %ld differences\n",
+		   pause, log_variance_ewma ? "true " : "false", alarms, d);
+	    differences += d;
+	}
+    }
+
+    printf("\nms per interval   per endpoint   engine\n");
+    const unsigned sizes[] = { 1000, 10000, 50000 };
+    for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	bench(sizes[s], sizes[s] > 10000 ? 20 : 100);
+
+    return differences ? 1 : 0;
+}
@@ -0,0 +1 @@
+g++ -O2 -I../.. -I../../detectionmodules/snortmodule -o pcapwriter-bench pcapwriter-bench.cpp ../../detectionmodules/snortmodule/pcapwriter.cpp ../../detectionmodules/snortmodule/pcappacket.cpp ../../commonutils/mutex.cpp -lpthread
@@ -0,0 +1,223 @@
+/*
+ * Equivalence check and microbenchmark for the checksum kernels of the
+ * snort module's pcapwriter.
+ *
+ * Compares in_checksum() and all CRC32C kernels with the code they
+ * replaced on random, unaligned buffers: in_checksum() with one ntohs()
+ * per 16 bit word, and a bitwise CRC32C as reference for the kernels.
+ * Checks the CRC32C known answer and reports the time per call for some
+ * buffer sizes. crc32c_table() is the byte-at-a-time loop crc32c() used
+ * before.
+ *
+ * Also writes packets whose totalLengthIPv4 is shorter than the headers
+ * or the payload section and checks that every record written holds as
+ * many octets as its incl_len.
+ *
+ * usage: pcapwriter-bench [buffers to check] [calls per size]
+ */
+
+#include "pcapwriter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+
+/* pcapwriter logs with msg() of the collector */
+extern "C" void msg(int, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+
+/* access to the private kernels, see pcapwriter.h */
+class PcapwriterBench
+{
+    public:
+	typedef uint32_t (*Crc32cKernel)(const uint8_t* buf, unsigned int len, uint32_t crc32);
+
+	uint16_t in_checksum(void* buf, unsigned long count) { return writer.in_checksum(buf, count); }
+	uint32_t crc32c(const uint8_t* buf, unsigned int len, uint32_t crc32) { return writer.crc32c(buf, len, crc32); }
+	uint32_t finalize_crc32c(uint32_t crc32) { return writer.finalize_crc32c(crc32); }
+
+	static Crc32cKernel table() { return pcapwriter::crc32c_table; }
+	static Crc32cKernel sliced() { return pcapwriter::crc32c_sliced; }
+	static Crc32cKernel sse42() { return pcapwriter::crc32c_sse42; }
+	static bool usesSse42() { return pcapwriter::crc32c_kernel == pcapwriter::crc32c_sse42; }
+
+    private:
+	pcapwriter writer;
+};
+
+
+/* pcapwriter::in_checksum() before it summed 64 bit words */
+static uint16_t old_in_checksum(void* buf, unsigned long count)
+{
+    unsigned long sum = 0;
+    uint16_t* addr = (uint16_t*)buf;
+
+    while (count > 1) {
+	sum += ntohs(*addr);
+	addr++;
+	count -= 2;
+    }
+    if (count > 0)
+	sum += ntohs(*(uint8_t*)addr);
+    while (sum >> 16)
+	sum = (sum & 0xffff) + (sum >> 16);
+
+    return htons(~sum);
+}
+
+/* bitwise CRC32C (reflected polynomial 0x82F63B78), computes the same as
+   the old byte-at-a-time loop over crc_c */
+static uint32_t old_crc32c(const uint8_t* buf, unsigned int len, uint32_t crc32)
+{
+    for (unsigned int i = 0; i < len; i++) {
+	crc32 ^= buf[i];
+	for (int bit = 0; bit < 8; bit++)
+	    crc32 = (crc32 >> 1) ^ (0x82F63B78 & (0 - (crc32 & 1)));
+    }
+    return crc32;
+}
+
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+volatile uint32_t sink;
+
+/* writes a packet with the given total length and payload section and
+   returns the number of records it left in the file, -1 if a record's
+   incl_len does not match the octets written */
+static int short_length_records(uint16_t total_length, bool header_section, int section_size)
+{
+    FILE* f = tmpfile();
+    {
+	pcapwriter writer;
+	writer.init(f, true, true);
+
+	static char section[1500];
+	memset(section, 0x45, sizeof(section));
+	PcapPacket p;
+	p.HDR_IP.protocol = 17;
+	p.HDR_IP.packet_length = htons(total_length);
+	if (header_section)
+	    p.set_iphps(section, section_size);
+	else
+	    p.set_ippps(section, section_size);
+	writer.writepacket(&p);
+	writer.flush();
+    }
+
+    /* records follow the 24 octet file header */
+    struct stat st;
+    fstat(fileno(f), &st);
+    long offset = 24;
+    int records = 0;
+    while (offset < st.st_size) {
+	uint32_t hdr[4];
+	if (pread(fileno(f), hdr, sizeof(hdr), offset) != sizeof(hdr)) {
+	    records = -1;
+	    break;
+	}
+	offset += sizeof(hdr) + hdr[2];
+	records++;
+    }
+    if (offset != st.st_size)
+	records = -1;
+    fclose(f);
+    return records;
+}
+
+int main(int argc, char** argv)
+{
+    long buffers = argc > 1 ? atol(argv[1]) : 200000;
+    long calls = argc > 2 ? atol(argv[2]) : 2000000;
+
+    PcapwriterBench w;
+    static uint8_t buf[2100];
+    long mismatches = 0;
+
+    srand(1);
+    for (long n = 0; n < buffers; n++) {
+	unsigned len = rand() % 2050;
+	unsigned off = rand() % 8;
+	for (unsigned i = 0; i < len + off; i++)
+	    buf[i] = rand();
+	/* sums with many carries */
+	if (rand() % 4 == 0)
+	    memset(buf + off, 0xff, len);
+
+	if (old_in_checksum(buf + off, len) != w.in_checksum(buf + off, len))
+	    mismatches++;
+
+	uint32_t crc = rand();
+	uint32_t expected = old_crc32c(buf + off, len, crc);
+	if (PcapwriterBench::table()(buf + off, len, crc) != expected ||
+	    PcapwriterBench::sliced()(buf + off, len, crc) != expected ||
+	    (PcapwriterBench::usesSse42() && PcapwriterBench::sse42()(buf + off, len, crc) != expected) ||
+	    w.crc32c(buf + off, len, crc) != expected)
+	    mismatches++;
+    }
+    printf("%ld buffers checked, %ld mismatches, crc32c kernel: %s\n", buffers, mismatches,
+	   PcapwriterBench::usesSse42() ? "sse4.2" : "slicing-by-8");
+
+    /* CRC32C("123456789") is 0xE3069283, finalize_crc32c() swaps the octets */
+    uint32_t kat = w.finalize_crc32c(w.crc32c((const uint8_t*)"123456789", 9, ~0U));
+    printf("known answer %s (%08x)\n", kat == 0x839206E3 ? "ok" : "WRONG", kat);
+    if (kat != 0x839206E3)
+	mismatches++;
+
+    /* total lengths below the 20 octet IP header are dropped, everything
+       else is cut or padded to the total length */
+    const struct { uint16_t length; bool header_section; int size; int records; } shorts[] = {
+	{ 10, false, 200, 0 }, { 19, false, 200, 0 }, { 20, false, 200, 1 },
+	{ 28, false, 200, 1 }, { 300, false, 200, 1 }, { 5, true, 200, 1 }, { 300, true, 20, 1 },
+    };
+    for (unsigned i = 0; i < sizeof(shorts) / sizeof(shorts[0]); i++) {
+	int records = short_length_records(shorts[i].length, shorts[i].header_section, shorts[i].size);
+	if (records != shorts[i].records) {
+	    printf("totalLengthIPv4 %u with %d octets %s: %d records, expected %d\n", shorts[i].length,
+		   shorts[i].size, shorts[i].header_section ? "iphps" : "ippps", records, shorts[i].records);
+	    mismatches++;
+	}
+    }
+    printf("short total lengths checked\n");
+
+    printf("\nns per call  checksum old   new |  crc32c table  sliced  sse4.2\n");
+    const unsigned sizes[] = { 8, 12, 20, 28, 40, 64, 576, 1500 };
+    for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+	unsigned size = sizes[s];
+	double t[6];
+	t[0] = now();
+	for (long i = 0; i < calls; i++) { buf[0] = i; sink += old_in_checksum(buf, size); }
+	t[1] = now();
+	for (long i = 0; i < calls; i++) { buf[0] = i; sink += w.in_checksum(buf, size); }
+	t[2] = now();
+	for (long i = 0; i < calls; i++) { buf[0] = i; sink += PcapwriterBench::table()(buf, size, ~0U); }
+	t[3] = now();
+	for (long i = 0; i < calls; i++) { buf[0] = i; sink += PcapwriterBench::sliced()(buf, size, ~0U); }
+	t[4] = now();
+	if (PcapwriterBench::usesSse42())
+	    for (long i = 0; i < calls; i++) { buf[0] = i; sink += PcapwriterBench::sse42()(buf, size, ~0U); }
+	t[5] = now();
+	printf("%5u octets    %7.1f %5.1f |  %12.1f %7.1f %7.1f\n", size,
+	       (t[1] - t[0]) / calls, (t[2] - t[1]) / calls, (t[3] - t[2]) / calls,
+	       (t[4] - t[3]) / calls, (t[5] - t[4]) / calls);
+    }
+
+    return mismatches ? 1 : 0;
+}